@@ -0,0 +1,399 @@
+#include "AccessorView.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#define ACCESSOR_VIEW_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ACCESSOR_VIEW_SSE2
+#include <emmintrin.h>
+#endif
+
+u32 componentTypeSize(ComponentType componentType)
+{
+    switch (componentType) {
+    case ComponentType::BYTE:
+    case ComponentType::UNSIGNED_BYTE:
+        return 1;
+    case ComponentType::SHORT:
+    case ComponentType::UNSIGNED_SHORT:
+        return 2;
+    case ComponentType::UNSIGNED_INT:
+    case ComponentType::FLOAT:
+        return 4;
+    default:
+        LOG_ERROR("Unknown component type %u", static_cast<u32>(componentType));
+        throw std::runtime_error("Unknown component type");
+    }
+}
+
+template<typename S>
+static float normalize(S value);
+
+template<>
+float normalize(i8 value) { return std::max(static_cast<float>(value) / 127.f, -1.f); }
+template<>
+float normalize(u8 value) { return static_cast<float>(value) / 255.f; }
+template<>
+float normalize(i16 value) { return std::max(static_cast<float>(value) / 32767.f, -1.f); }
+template<>
+float normalize(u16 value) { return static_cast<float>(value) / 65535.f; }
+template<>
+float normalize(u32 value) { return static_cast<float>(value) / 4294967295.f; }
+template<>
+float normalize(float value) { return value; }
+
+template<typename D, typename S>
+static D convert(S value, bool normalized)
+{
+    if constexpr (std::is_same_v<D, float>) {
+        return normalized ? normalize(value) : static_cast<float>(value);
+    } else {
+        return static_cast<D>(value);
+    }
+}
+
+template<typename D>
+static D fillValue(u32 component)
+{
+    return component == 3 ? D(1) : D(0);
+}
+
+// Handles any stride and any component count mismatch, one element at a time
+template<typename D, typename S>
+static void readStrided(AccessorView const& view, D* dst, u32 dstComponents)
+{
+    auto components = std::min(view.componentCount, dstComponents);
+    for (u64 i = 0; i < view.count; ++i) {
+        auto src = view.data + i * view.stride;
+        auto element = dst + i * dstComponents;
+        for (u32 c = 0; c < components; ++c) {
+            S value;
+            memcpy(&value, src + c * sizeof(S), sizeof(S));
+            element[c] = convert<D>(value, view.normalized);
+        }
+        for (u32 c = components; c < dstComponents; ++c) {
+            element[c] = fillValue<D>(c);
+        }
+    }
+}
+
+template<typename D, typename S>
+static void readPackedScalar(S const* src, D* dst, u64 begin, u64 count, bool normalized)
+{
+    for (u64 i = begin; i < count; ++i) {
+        dst[i] = convert<D>(src[i], normalized);
+    }
+}
+
+// Packed kernels work on the accessor as a flat array of scalars and return how many they converted,
+// the remainder is left to readPackedScalar()
+
+#if defined(ACCESSOR_VIEW_AVX2)
+
+template<typename S>
+static __m256i load8(S const* src);
+
+template<>
+__m256i load8(u8 const* src) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src))); }
+template<>
+__m256i load8(i8 const* src) { return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src))); }
+template<>
+__m256i load8(u16 const* src) { return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src))); }
+template<>
+__m256i load8(i16 const* src) { return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src))); }
+
+template<typename S>
+static u64 convertToFloat(S const* src, float* dst, u64 count, float scale, bool clamp)
+{
+    auto scales = _mm256_set1_ps(scale);
+    auto minimum = _mm256_set1_ps(-1.f);
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto values = _mm256_mul_ps(_mm256_cvtepi32_ps(load8(src + i)), scales);
+        if (clamp) {
+            values = _mm256_max_ps(values, minimum);
+        }
+        _mm256_storeu_ps(dst + i, values);
+    }
+    return i;
+}
+
+static u64 widenToU16(u8 const* src, u16* dst, u64 count)
+{
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto values = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), values);
+    }
+    return i;
+}
+
+template<typename S>
+static u64 widenToU32(S const* src, u32* dst, u64 count)
+{
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), load8(src + i));
+    }
+    return i;
+}
+
+#elif defined(ACCESSOR_VIEW_SSE2)
+
+// Sign or zero extends 16 bytes into four vectors of 32 bit integers
+template<typename S>
+static void load16(S const* src, __m128i (&out)[4]);
+
+template<>
+void load16(u8 const* src, __m128i (&out)[4])
+{
+    auto zero = _mm_setzero_si128();
+    auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    auto low = _mm_unpacklo_epi8(bytes, zero);
+    auto high = _mm_unpackhi_epi8(bytes, zero);
+    out[0] = _mm_unpacklo_epi16(low, zero);
+    out[1] = _mm_unpackhi_epi16(low, zero);
+    out[2] = _mm_unpacklo_epi16(high, zero);
+    out[3] = _mm_unpackhi_epi16(high, zero);
+}
+
+template<>
+void load16(i8 const* src, __m128i (&out)[4])
+{
+    auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    auto low = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+    auto high = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+    out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(low, low), 16);
+    out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(low, low), 16);
+    out[2] = _mm_srai_epi32(_mm_unpacklo_epi16(high, high), 16);
+    out[3] = _mm_srai_epi32(_mm_unpackhi_epi16(high, high), 16);
+}
+
+template<>
+void load16(u16 const* src, __m128i (&out)[4])
+{
+    auto zero = _mm_setzero_si128();
+    auto low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    auto high = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 8));
+    out[0] = _mm_unpacklo_epi16(low, zero);
+    out[1] = _mm_unpackhi_epi16(low, zero);
+    out[2] = _mm_unpacklo_epi16(high, zero);
+    out[3] = _mm_unpackhi_epi16(high, zero);
+}
+
+template<>
+void load16(i16 const* src, __m128i (&out)[4])
+{
+    auto low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    auto high = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 8));
+    out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(low, low), 16);
+    out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(low, low), 16);
+    out[2] = _mm_srai_epi32(_mm_unpacklo_epi16(high, high), 16);
+    out[3] = _mm_srai_epi32(_mm_unpackhi_epi16(high, high), 16);
+}
+
+template<typename S>
+static u64 convertToFloat(S const* src, float* dst, u64 count, float scale, bool clamp)
+{
+    auto scales = _mm_set1_ps(scale);
+    auto minimum = _mm_set1_ps(-1.f);
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i integers[4];
+        load16(src + i, integers);
+        for (u32 j = 0; j < 4; ++j) {
+            auto values = _mm_mul_ps(_mm_cvtepi32_ps(integers[j]), scales);
+            if (clamp) {
+                values = _mm_max_ps(values, minimum);
+            }
+            _mm_storeu_ps(dst + i + j * 4, values);
+        }
+    }
+    return i;
+}
+
+static u64 widenToU16(u8 const* src, u16* dst, u64 count)
+{
+    auto zero = _mm_setzero_si128();
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+    return i;
+}
+
+template<typename S>
+static u64 widenToU32(S const* src, u32* dst, u64 count)
+{
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i integers[4];
+        load16(src + i, integers);
+        for (u32 j = 0; j < 4; ++j) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + j * 4), integers[j]);
+        }
+    }
+    return i;
+}
+
+#else
+
+template<typename S>
+static u64 convertToFloat(S const*, float*, u64, float, bool) { return 0; }
+static u64 widenToU16(u8 const*, u16*, u64) { return 0; }
+template<typename S>
+static u64 widenToU32(S const*, u32*, u64) { return 0; }
+
+#endif
+
+template<typename S>
+static void readPackedToFloat(S const* src, float* dst, u64 count, bool normalized)
+{
+    constexpr bool isSigned = std::is_signed_v<S>;
+    float scale = normalized ? 1.f / static_cast<float>(std::numeric_limits<S>::max()) : 1.f;
+    auto converted = convertToFloat(src, dst, count, scale, normalized && isSigned);
+    readPackedScalar(src, dst, converted, count, normalized);
+}
+
+template<typename D>
+static void readZero(AccessorView const& view, D* dst, u32 dstComponents)
+{
+    for (u64 i = 0; i < view.count; ++i) {
+        for (u32 c = 0; c < dstComponents; ++c) {
+            dst[i * dstComponents + c] = c < view.componentCount ? D(0) : fillValue<D>(c);
+        }
+    }
+}
+
+template<typename D>
+static void readAny(AccessorView const& view, D* dst, u32 dstComponents)
+{
+    switch (view.componentType) {
+    case ComponentType::BYTE:
+        readStrided<D, i8>(view, dst, dstComponents);
+        break;
+    case ComponentType::UNSIGNED_BYTE:
+        readStrided<D, u8>(view, dst, dstComponents);
+        break;
+    case ComponentType::SHORT:
+        readStrided<D, i16>(view, dst, dstComponents);
+        break;
+    case ComponentType::UNSIGNED_SHORT:
+        readStrided<D, u16>(view, dst, dstComponents);
+        break;
+    case ComponentType::UNSIGNED_INT:
+        readStrided<D, u32>(view, dst, dstComponents);
+        break;
+    case ComponentType::FLOAT:
+        readStrided<D, float>(view, dst, dstComponents);
+        break;
+    }
+}
+
+void readAccessor(AccessorView const& view, float* dst, u32 dstComponents)
+{
+    if (view.data == nullptr) {
+        readZero(view, dst, dstComponents);
+        return;
+    }
+
+    if (!view.isPacked() || view.componentCount != dstComponents) {
+        readAny(view, dst, dstComponents);
+        return;
+    }
+
+    auto count = view.count * view.componentCount;
+    switch (view.componentType) {
+    case ComponentType::BYTE:
+        readPackedToFloat(reinterpret_cast<i8 const*>(view.data), dst, count, view.normalized);
+        break;
+    case ComponentType::UNSIGNED_BYTE:
+        readPackedToFloat(reinterpret_cast<u8 const*>(view.data), dst, count, view.normalized);
+        break;
+    case ComponentType::SHORT:
+        readPackedToFloat(reinterpret_cast<i16 const*>(view.data), dst, count, view.normalized);
+        break;
+    case ComponentType::UNSIGNED_SHORT:
+        readPackedToFloat(reinterpret_cast<u16 const*>(view.data), dst, count, view.normalized);
+        break;
+    case ComponentType::FLOAT:
+        memcpy(dst, view.data, count * sizeof(float));
+        break;
+    default:
+        readAny(view, dst, dstComponents);
+        break;
+    }
+}
+
+void readAccessor(AccessorView const& view, u16* dst, u32 dstComponents)
+{
+    if (view.data == nullptr) {
+        readZero(view, dst, dstComponents);
+        return;
+    }
+
+    if (!view.isPacked() || view.componentCount != dstComponents) {
+        readAny(view, dst, dstComponents);
+        return;
+    }
+
+    auto count = view.count * view.componentCount;
+    switch (view.componentType) {
+    case ComponentType::UNSIGNED_BYTE: {
+        auto src = reinterpret_cast<u8 const*>(view.data);
+        auto converted = widenToU16(src, dst, count);
+        readPackedScalar(src, dst, converted, count, false);
+        break;
+    }
+    case ComponentType::UNSIGNED_SHORT:
+        memcpy(dst, view.data, count * sizeof(u16));
+        break;
+    default:
+        readAny(view, dst, dstComponents);
+        break;
+    }
+}
+
+void readAccessor(AccessorView const& view, u32* dst, u32 dstComponents)
+{
+    if (view.data == nullptr) {
+        readZero(view, dst, dstComponents);
+        return;
+    }
+
+    if (!view.isPacked() || view.componentCount != dstComponents) {
+        readAny(view, dst, dstComponents);
+        return;
+    }
+
+    auto count = view.count * view.componentCount;
+    switch (view.componentType) {
+    case ComponentType::UNSIGNED_BYTE: {
+        auto src = reinterpret_cast<u8 const*>(view.data);
+        auto converted = widenToU32(src, dst, count);
+        readPackedScalar(src, dst, converted, count, false);
+        break;
+    }
+    case ComponentType::UNSIGNED_SHORT: {
+        auto src = reinterpret_cast<u16 const*>(view.data);
+        auto converted = widenToU32(src, dst, count);
+        readPackedScalar(src, dst, converted, count, false);
+        break;
+    }
+    case ComponentType::UNSIGNED_INT:
+        memcpy(dst, view.data, count * sizeof(u32));
+        break;
+    default:
+        readAny(view, dst, dstComponents);
+        break;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Defines.h"
+
+// glTF component types, same values as in the specification
+enum class ComponentType : u32 {
+    BYTE = 5120,
+    UNSIGNED_BYTE = 5121,
+    SHORT = 5122,
+    UNSIGNED_SHORT = 5123,
+    UNSIGNED_INT = 5125,
+    FLOAT = 5126
+};
+
+u32 componentTypeSize(ComponentType componentType);
+
+// Non-owning, strided window over accessor data. Nothing is copied until the view is read into a destination array.
+// data is nullptr for accessors without a buffer view, which read as zero.
+struct AccessorView {
+    u8 const* data = nullptr;
+    u64 count = 0;
+    u32 stride = 0;
+    u32 componentCount = 0;
+    ComponentType componentType = ComponentType::FLOAT;
+    bool normalized = false;
+
+    u32 elementSize() const { return componentCount * componentTypeSize(componentType); }
+    bool isPacked() const { return stride == elementSize(); }
+};
+
+// Converts every element into dstComponents consecutive values per element.
+// Normalized integers are mapped to [0, 1] or [-1, 1]; missing components are 0, except the fourth which is 1.
+void readAccessor(AccessorView const& view, float* dst, u32 dstComponents);
+void readAccessor(AccessorView const& view, u16* dst, u32 dstComponents);
+void readAccessor(AccessorView const& view, u32* dst, u32 dstComponents);
+
+template<typename T>
+struct AccessorElement {
+    using Scalar = typename T::value_type;
+    static constexpr u32 components = T::length();
+};
+
+template<>
+struct AccessorElement<u32> {
+    using Scalar = u32;
+    static constexpr u32 components = 1;
+};
+
+// Reads view.count elements into dst, e.g. readAccessor(view, positions.data() + firstVertex)
+template<typename T>
+void readAccessor(AccessorView const& view, T* dst)
+{
+    using Element = AccessorElement<T>;
+    readAccessor(view, reinterpret_cast<typename Element::Scalar*>(dst), Element::components);
+}
@@ -0,0 +1,101 @@
+#include "Animation.h"
+
+#include <algorithm>
+
+u32 findKeyframe(float const* times, u32 keyCount, float time, u32 hint)
+{
+    if (keyCount == 0 || time <= times[0]) {
+        return 0;
+    }
+    if (time >= times[keyCount - 1]) {
+        return keyCount - 1;
+    }
+    if (hint + 1 < keyCount && times[hint] <= time) {
+        if (time < times[hint + 1]) {
+            return hint;
+        }
+        if (hint + 2 < keyCount && time < times[hint + 2]) {
+            return hint + 1;
+        }
+    }
+    return static_cast<u32>(std::upper_bound(times, times + keyCount, time) - times) - 1;
+}
+
+static glm::quat toQuat(glm::vec4 const& value)
+{
+    return glm::quat(value.w, value.x, value.y, value.z);
+}
+
+void sampleAnimation(AnimationSet const& set, u32 clip, float time, std::vector<u32>& cursors, NodePose* poses)
+{
+    auto const& animation = set.clips[clip];
+    cursors.resize(animation.trackCount, 0);
+    for (u32 t = 0; t < animation.trackCount; ++t) {
+        auto const& track = set.tracks[animation.firstTrack + t];
+        if (track.keyCount == 0) {
+            continue;
+        }
+
+        auto times = set.times.data() + track.firstKey;
+        auto values = set.values.data() + track.firstValue;
+        auto key = findKeyframe(times, track.keyCount, time, cursors[t]);
+        cursors[t] = key;
+        auto next = std::min(key + 1, track.keyCount - 1);
+        auto delta = times[next] - times[key];
+        auto factor = delta > 0.f ? glm::clamp((time - times[key]) / delta, 0.f, 1.f) : 0.f;
+
+        glm::vec4 value;
+        switch (track.interpolation) {
+        case AnimationInterpolation::STEP:
+            value = values[key];
+            break;
+        case AnimationInterpolation::LINEAR:
+            if (track.path == AnimationPath::ROTATION) {
+                auto rotation = glm::slerp(toQuat(values[key]), toQuat(values[next]), factor);
+                value = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+            } else {
+                value = glm::mix(values[key], values[next], factor);
+            }
+            break;
+        case AnimationInterpolation::CUBIC_SPLINE: {
+            auto f2 = factor * factor;
+            auto f3 = f2 * factor;
+            auto outTangent = values[key * 3 + 2] * delta;
+            auto inTangent = values[next * 3 + 0] * delta;
+            value =
+                (2.f * f3 - 3.f * f2 + 1.f) * values[key * 3 + 1] + (f3 - 2.f * f2 + factor) * outTangent +
+                (-2.f * f3 + 3.f * f2) * values[next * 3 + 1] + (f3 - f2) * inTangent;
+            if (track.path == AnimationPath::ROTATION) {
+                auto length = glm::length(value);
+                value = length > 0.f ? value / length : glm::vec4(0.f, 0.f, 0.f, 1.f);
+            }
+            break;
+        }
+        }
+
+        auto& pose = poses[track.node];
+        switch (track.path) {
+        case AnimationPath::TRANSLATION:
+            pose.translation = glm::vec3(value);
+            break;
+        case AnimationPath::ROTATION:
+            pose.rotation = toQuat(value);
+            break;
+        case AnimationPath::SCALE:
+            pose.scale = glm::vec3(value);
+            break;
+        }
+    }
+}
+
+glm::mat4 composeTransform(NodePose const& pose)
+{
+    // T * R * S without the two full matrix products
+    auto rotation = glm::mat3_cast(pose.rotation);
+    glm::mat4 result;
+    result[0] = glm::vec4(rotation[0] * pose.scale.x, 0.f);
+    result[1] = glm::vec4(rotation[1] * pose.scale.y, 0.f);
+    result[2] = glm::vec4(rotation[2] * pose.scale.z, 0.f);
+    result[3] = glm::vec4(pose.translation, 1.f);
+    return result;
+}
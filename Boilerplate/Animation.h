@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+enum class AnimationPath : u32 {
+    TRANSLATION,
+    ROTATION,
+    SCALE
+};
+
+enum class AnimationInterpolation : u32 {
+    STEP,
+    LINEAR,
+    // Hermite spline, every key stores in-tangent, value and out-tangent
+    CUBIC_SPLINE
+};
+
+// Keyframes of one animated node property. Times and values live in the flat arrays of AnimationSet,
+// translations and scales use xyz of the values, rotations are xyzw quaternions.
+struct AnimationTrack {
+    u32 node = 0;
+    AnimationPath path = AnimationPath::TRANSLATION;
+    AnimationInterpolation interpolation = AnimationInterpolation::LINEAR;
+    u32 firstKey = 0;
+    u32 keyCount = 0;
+    u32 firstValue = 0;
+};
+
+struct AnimationClip {
+    float duration = 0.f;
+    u32 firstTrack = 0;
+    u32 trackCount = 0;
+};
+
+// All clips of a model as structure of arrays: sampling a track walks one run of times and one run of values
+struct AnimationSet {
+    std::vector<AnimationClip> clips;
+    std::vector<AnimationTrack> tracks;
+    std::vector<float> times;
+    std::vector<glm::vec4> values;
+};
+
+// Local transform of a node
+struct NodePose {
+    glm::vec3 translation = glm::vec3(0.f);
+    glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+};
+
+// Key at or before time, clamped to the first and the last key. Starts at hint, the key found for the previous
+// sample of the track, and checks its neighbour before falling back to a binary search, so playback costs O(1).
+u32 findKeyframe(float const* times, u32 keyCount, float time, u32 hint);
+
+// Writes the clip's tracks at time into poses, indexed by node. cursors holds one hint per track of the clip,
+// nodes without a track keep their pose.
+void sampleAnimation(AnimationSet const& set, u32 clip, float time, std::vector<u32>& cursors, NodePose* poses);
+
+glm::mat4 composeTransform(NodePose const& pose);
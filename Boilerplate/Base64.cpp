@@ -0,0 +1,168 @@
+#include "Base64.h"
+
+#if defined(__AVX2__)
+#define BASE64_AVX2
+#include <immintrin.h>
+#elif defined(__SSSE3__) || defined(__AVX__)
+#define BASE64_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// 0xff marks characters outside the alphabet
+static constexpr struct DecodeTable {
+    u8 values[256] = {};
+
+    constexpr DecodeTable()
+    {
+        for (u32 i = 0; i < 256; ++i) {
+            values[i] = 0xff;
+        }
+        for (u32 i = 0; i < 26; ++i) {
+            values['A' + i] = i;
+            values['a' + i] = 26 + i;
+        }
+        for (u32 i = 0; i < 10; ++i) {
+            values['0' + i] = 52 + i;
+        }
+        values['+'] = 62;
+        values['/'] = 63;
+    }
+} decodeTable;
+
+u64 base64DecodedSize(char const* src, u64 length)
+{
+    while (length > 0 && src[length - 1] == '=') {
+        --length;
+    }
+    return length / 4 * 3 + (length % 4 == 0 ? 0 : length % 4 - 1);
+}
+
+static bool decodeScalar(char const* src, u64 length, u8* dst)
+{
+    while (length > 0 && src[length - 1] == '=') {
+        --length;
+    }
+    if (length % 4 == 1) {
+        return false;
+    }
+
+    auto values = decodeTable.values;
+    u64 i = 0;
+    for (; i + 4 <= length; i += 4) {
+        u32 a = values[static_cast<u8>(src[i])];
+        u32 b = values[static_cast<u8>(src[i + 1])];
+        u32 c = values[static_cast<u8>(src[i + 2])];
+        u32 d = values[static_cast<u8>(src[i + 3])];
+        if (a == 0xff || b == 0xff || c == 0xff || d == 0xff) {
+            return false;
+        }
+        u32 bits = a << 18 | b << 12 | c << 6 | d;
+        *dst++ = static_cast<u8>(bits >> 16);
+        *dst++ = static_cast<u8>(bits >> 8);
+        *dst++ = static_cast<u8>(bits);
+    }
+
+    u32 bits = 0;
+    for (u64 j = i; j < length; ++j) {
+        u32 value = values[static_cast<u8>(src[j])];
+        if (value == 0xff) {
+            return false;
+        }
+        bits = bits << 6 | value;
+    }
+    if (length - i == 3) {
+        *dst++ = static_cast<u8>(bits >> 10);
+        *dst++ = static_cast<u8>(bits >> 2);
+    } else if (length - i == 2) {
+        *dst++ = static_cast<u8>(bits >> 4);
+    }
+
+    return true;
+}
+
+// Vectorized translation after Muła and Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions":
+// two nibble lookups flag invalid characters, a third one gives the offset from ASCII to the 6 bit value,
+// and two multiply-adds pack four 6 bit values into three bytes.
+// Blocks with invalid characters or padding are left to the scalar path, which reports them.
+#if defined(BASE64_AVX2)
+static u64 decodeSimd(char const* src, u64 length, u8*& dst)
+{
+    auto const lutLo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    auto const lutHi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    auto const lutRoll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    auto const mask2f = _mm256_set1_epi8(0x2f);
+    auto const pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    auto const compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+    // Every store writes 32 bytes for 24 decoded ones, the margin keeps it inside dst
+    u64 i = 0;
+    for (; i + 48 <= length; i += 32) {
+        auto in = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask2f);
+        auto loNibbles = _mm256_and_si256(in, mask2f);
+        auto hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        auto lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+
+        auto roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask2f), hiNibbles));
+        auto values = _mm256_add_epi8(in, roll);
+        auto merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        auto packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(packed, pack), compact);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), packed);
+        dst += 24;
+    }
+    return i;
+}
+#elif defined(BASE64_SSSE3)
+static u64 decodeSimd(char const* src, u64 length, u8*& dst)
+{
+    auto const lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    auto const lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    auto const lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    auto const mask2f = _mm_set1_epi8(0x2f);
+    auto const pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    // Every store writes 16 bytes for 12 decoded ones, the margin keeps it inside dst
+    u64 i = 0;
+    for (; i + 24 <= length; i += 16) {
+        auto in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2f);
+        auto loNibbles = _mm_and_si128(in, mask2f);
+        auto hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        auto lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+            break;
+        }
+
+        auto roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask2f), hiNibbles));
+        auto values = _mm_add_epi8(in, roll);
+        auto merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        auto packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(packed, pack));
+        dst += 12;
+    }
+    return i;
+}
+#else
+static u64 decodeSimd(char const*, u64, u8*&)
+{
+    return 0;
+}
+#endif
+
+bool base64Decode(char const* src, u64 length, u8* dst)
+{
+    auto consumed = decodeSimd(src, length, dst);
+    return decodeScalar(src + consumed, length - consumed, dst);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Defines.h"
+
+// Decoded size of length base64 characters, trailing '=' padding excluded. Does not validate the input.
+u64 base64DecodedSize(char const* src, u64 length);
+
+// Decodes into dst, which has to hold base64DecodedSize(src, length) bytes.
+// Returns false on characters outside the standard alphabet, misplaced padding or a dangling character.
+bool base64Decode(char const* src, u64 length, u8* dst);
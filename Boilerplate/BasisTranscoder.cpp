@@ -0,0 +1,128 @@
+#include "BasisTranscoder.h"
+#include "BlockCompression.h"
+#include "Logger.h"
+
+#include <basisu_transcoder.h>
+
+namespace {
+
+// Khronos data format descriptor values
+constexpr u8 modelEtc1s = 163;
+constexpr u8 modelUastc = 166;
+constexpr u8 transferSrgb = 2;
+
+// Basic descriptor block after the total size: vendor and type, version and size, colour model, primaries, transfer
+u8 const* getBasicDescriptorBlock(Ktx2Texture const& texture)
+{
+    if (texture.dataFormatDescriptor.size < 16) {
+        return nullptr;
+    }
+    return texture.data + texture.dataFormatDescriptor.offset + 4;
+}
+
+// False for the formats the transcoder cannot write
+bool getTranscoderFormat(VkFormat format, basist::transcoder_texture_format& result)
+{
+    switch (format) {
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        result = basist::transcoder_texture_format::cTFBC7_RGBA;
+        return true;
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        result = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        result = basist::transcoder_texture_format::cTFETC2_RGBA;
+        return true;
+    // ETC1 blocks are valid ETC2 RGB blocks
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        result = basist::transcoder_texture_format::cTFETC1_RGB;
+        return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        result = basist::transcoder_texture_format::cTFRGBA32;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void initializeTranscoder()
+{
+    // Builds the transcoder's tables once; function local statics are initialized thread safely
+    static bool initialized = (basist::basisu_transcoder_init(), true);
+    (void)initialized;
+}
+
+}
+
+bool isBasisKtx2(Ktx2Texture const& texture)
+{
+    if (texture.format != VK_FORMAT_UNDEFINED) {
+        return false;
+    }
+    if (texture.supercompressionScheme == static_cast<u32>(Ktx2Supercompression::BASIS_LZ)) {
+        return true;
+    }
+    auto block = getBasicDescriptorBlock(texture);
+    return block != nullptr && (block[8] == modelUastc || block[8] == modelEtc1s);
+}
+
+bool transcodeBasisKtx2(Ktx2Texture const& texture, TranscodeFormatSelector const& selectFormat, MipChain& chain)
+{
+    if (!isBasisKtx2(texture)) {
+        LOG_ERROR("KTX2 texture holds no Basis Universal data");
+        return false;
+    }
+    if (texture.layerCount != 1 || texture.faceCount != 1) {
+        LOG_ERROR("Only 2D Basis Universal textures can be transcoded");
+        return false;
+    }
+
+    initializeTranscoder();
+    basist::ktx2_transcoder transcoder;
+    if (!transcoder.init(texture.data, static_cast<u32>(texture.size)) || !transcoder.start_transcoding()) {
+        LOG_ERROR("Failed to start transcoding a Basis Universal texture");
+        return false;
+    }
+
+    auto block = getBasicDescriptorBlock(texture);
+    bool srgb = block != nullptr && block[10] == transferSrgb;
+    chain.format = selectFormat(transcoder.get_has_alpha(), srgb);
+    chain.width = transcoder.get_width();
+    chain.height = transcoder.get_height();
+    basist::transcoder_texture_format target;
+    if (!getTranscoderFormat(chain.format, target)) {
+        LOG_ERROR("Basis Universal textures cannot be transcoded to format %d", chain.format);
+        return false;
+    }
+    auto blockSize = getBlockSize(chain.format);
+
+    // Block formats count their output in blocks, RGBA32 in pixels
+    u32 levelCount = transcoder.get_levels();
+    std::vector<u32> counts(levelCount);
+    chain.offsets.resize(levelCount);
+    u64 size = 0;
+    for (u32 i = 0; i < levelCount; ++i) {
+        basist::ktx2_image_level_info info;
+        if (!transcoder.get_image_level_info(info, i, 0, 0)) {
+            LOG_ERROR("Basis Universal level %u is missing", i);
+            return false;
+        }
+        counts[i] = blockSize != 0 ? info.m_total_blocks : info.m_orig_width * info.m_orig_height;
+        chain.offsets[i] = size;
+        size += static_cast<u64>(counts[i]) * (blockSize != 0 ? blockSize : 4);
+    }
+
+    chain.pixels.resize(size);
+    for (u32 i = 0; i < levelCount; ++i) {
+        if (!transcoder.transcode_image_level(i, 0, 0, chain.pixels.data() + chain.offsets[i], counts[i], target)) {
+            LOG_ERROR("Failed to transcode Basis Universal level %u", i);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Defines.h"
+#include "Ktx2.h"
+#include "MipChain.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+
+// KTX2 files of KHR_texture_basisu hold Basis Universal data, ETC1S with BasisLZ supercompression or UASTC with
+// optional Zstandard, and have VK_FORMAT_UNDEFINED. They are transcoded on load into the best block format the
+// device samples, so they stay small on disk and compressed in memory.
+bool isBasisKtx2(Ktx2Texture const& texture);
+
+// Picks the format to transcode into once the texture's alpha and transfer function are known, on a device
+// selectTranscodeFormat from Utils.h. BC7, ASTC 4x4, ETC2 RGB and RGBA and RGBA8 can be written
+using TranscodeFormatSelector = std::function<VkFormat(bool alpha, bool srgb)>;
+
+// Every level of a 2D texture into chain, levels[0] finest
+bool transcodeBasisKtx2(Ktx2Texture const& texture, TranscodeFormatSelector const& selectFormat, MipChain& chain);
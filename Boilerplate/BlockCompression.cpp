@@ -0,0 +1,522 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct BitWriter {
+    u8* data;
+    u32 position = 0;
+
+    void write(u32 value, u32 bitCount)
+    {
+        for (u32 i = 0; i < bitCount; ++i, ++position) {
+            data[position / 8] |= ((value >> i) & 1) << (position % 8);
+        }
+    }
+};
+
+void loadBlock(u8 const* pixels, u32 width, u32 height, u32 blockX, u32 blockY, u8 texels[16][4])
+{
+    for (u32 y = 0; y < 4; ++y) {
+        auto row = std::min(blockY * 4 + y, height - 1);
+        for (u32 x = 0; x < 4; ++x) {
+            auto column = std::min(blockX * 4 + x, width - 1);
+            memcpy(texels[y * 4 + x], pixels + (static_cast<size_t>(row) * width + column) * 4, 4);
+        }
+    }
+}
+
+// Principal axis of the texels' first channelCount channels by power iteration on their covariance
+void calculatePrincipalAxis(u8 const texels[16][4], u32 channelCount, float mean[4], float axis[4])
+{
+    for (u32 c = 0; c < 4; ++c) {
+        mean[c] = 0.f;
+        axis[c] = 0.f;
+    }
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < channelCount; ++c) {
+            mean[c] += texels[i][c] / 16.f;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 a = 0; a < channelCount; ++a) {
+            for (u32 b = 0; b < channelCount; ++b) {
+                covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+            }
+        }
+    }
+
+    for (u32 c = 0; c < channelCount; ++c) {
+        axis[c] = 1.f;
+    }
+    for (u32 iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.f;
+        for (u32 a = 0; a < channelCount; ++a) {
+            for (u32 b = 0; b < channelCount; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length == 0.f) {
+            return;
+        }
+        for (u32 c = 0; c < channelCount; ++c) {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+// Endpoints at the extreme projections of the texels onto the principal axis
+void calculateEndpoints(u8 const texels[16][4], u32 channelCount, float endpoints[2][4])
+{
+    float mean[4];
+    float axis[4];
+    calculatePrincipalAxis(texels, channelCount, mean, axis);
+
+    float minProjection = 0.f;
+    float maxProjection = 0.f;
+    for (u32 i = 0; i < 16; ++i) {
+        float projection = 0.f;
+        for (u32 c = 0; c < channelCount; ++c) {
+            projection += (texels[i][c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    float lengthSquared = 0.f;
+    for (u32 c = 0; c < channelCount; ++c) {
+        lengthSquared += axis[c] * axis[c];
+    }
+    lengthSquared = std::max(lengthSquared, 1e-8f);
+    for (u32 c = 0; c < 4; ++c) {
+        endpoints[0][c] = std::clamp(mean[c] + axis[c] * maxProjection / lengthSquared, 0.f, 255.f);
+        endpoints[1][c] = std::clamp(mean[c] + axis[c] * minProjection / lengthSquared, 0.f, 255.f);
+    }
+}
+
+// Least squares endpoints for fixed interpolation weights in [0, 1] towards endpoint 1, false when degenerate
+bool fitEndpoints(u8 const texels[16][4], u32 channelCount, float const weights[16], float endpoints[2][4])
+{
+    float aa = 0.f;
+    float ab = 0.f;
+    float bb = 0.f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        auto b = weights[i];
+        auto a = 1.f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (u32 c = 0; c < channelCount; ++c) {
+            ax[c] += a * texels[i][c];
+            bx[c] += b * texels[i][c];
+        }
+    }
+    auto determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (u32 c = 0; c < channelCount; ++c) {
+        endpoints[0][c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+        endpoints[1][c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+    }
+    return true;
+}
+
+u16 packRgb565(float const color[4])
+{
+    auto r = static_cast<u32>(color[0] * 31.f / 255.f + 0.5f);
+    auto g = static_cast<u32>(color[1] * 63.f / 255.f + 0.5f);
+    auto b = static_cast<u32>(color[2] * 31.f / 255.f + 0.5f);
+    return static_cast<u16>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(u16 packed, i32 color[3])
+{
+    auto r = (packed >> 11) & 31;
+    auto g = (packed >> 5) & 63;
+    auto b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+i32 distanceSquared(u8 const texel[4], i32 const color[], u32 channelCount)
+{
+    i32 distance = 0;
+    for (u32 c = 0; c < channelCount; ++c) {
+        auto d = texel[c] - color[c];
+        distance += d * d;
+    }
+    return distance;
+}
+
+// Four colour BC1 block for the given endpoints, returns the squared error
+u32 encodeColorEndpoints(u8 const texels[16][4], float const endpoints[2][4], u8* block, u8 indices[16])
+{
+    auto color0 = packRgb565(endpoints[0]);
+    auto color1 = packRgb565(endpoints[1]);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    i32 palette[4][3];
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (u32 c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    // Equal endpoints select the three colour mode, where index 0 still is color0
+    u32 paletteSize = color0 == color1 ? 1 : 4;
+    u32 error = 0;
+    u32 packedIndices = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 best = 0;
+        auto bestDistance = distanceSquared(texels[i], palette[0], 3);
+        for (u32 j = 1; j < paletteSize; ++j) {
+            auto distance = distanceSquared(texels[i], palette[j], 3);
+            if (distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+        indices[i] = best;
+        packedIndices |= best << (i * 2);
+        error += bestDistance;
+    }
+
+    block[0] = color0 & 0xff;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xff;
+    block[3] = color1 >> 8;
+    memcpy(block + 4, &packedIndices, 4);
+    return error;
+}
+
+void encodeColorBlock(u8 const texels[16][4], u8* block)
+{
+    float endpoints[2][4];
+    calculateEndpoints(texels, 3, endpoints);
+    u8 indices[16];
+    auto error = encodeColorEndpoints(texels, endpoints, block, indices);
+
+    // Refit to the chosen indices while that lowers the error
+    static float const indexWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+    for (u32 iteration = 0; iteration < 2 && error > 0; ++iteration) {
+        float weights[16];
+        for (u32 i = 0; i < 16; ++i) {
+            weights[i] = indexWeights[indices[i]];
+        }
+        // Indices refer to the possibly swapped packed endpoints, fit those
+        u16 color0;
+        u16 color1;
+        memcpy(&color0, block, 2);
+        memcpy(&color1, block + 2, 2);
+        if (color0 == color1 || !fitEndpoints(texels, 3, weights, endpoints)) {
+            break;
+        }
+        u8 candidate[8];
+        u8 candidateIndices[16];
+        auto candidateError = encodeColorEndpoints(texels, endpoints, candidate, candidateIndices);
+        if (candidateError >= error) {
+            break;
+        }
+        memcpy(block, candidate, 8);
+        memcpy(indices, candidateIndices, 16);
+        error = candidateError;
+    }
+}
+
+// BC4 block of one channel, 8 value mode between the extremes
+void encodeChannelBlock(u8 const texels[16][4], u32 channel, u8* block)
+{
+    u8 maxValue = 0;
+    u8 minValue = 255;
+    for (u32 i = 0; i < 16; ++i) {
+        maxValue = std::max(maxValue, texels[i][channel]);
+        minValue = std::min(minValue, texels[i][channel]);
+    }
+
+    memset(block, 0, 8);
+    block[0] = maxValue;
+    block[1] = minValue;
+    if (maxValue == minValue) {
+        return;
+    }
+
+    i32 palette[8];
+    palette[0] = maxValue;
+    palette[1] = minValue;
+    for (u32 i = 2; i < 8; ++i) {
+        palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+    }
+
+    u64 packedIndices = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 best = 0;
+        auto bestDistance = std::abs(texels[i][channel] - palette[0]);
+        for (u32 j = 1; j < 8; ++j) {
+            auto distance = std::abs(texels[i][channel] - palette[j]);
+            if (distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+        packedIndices |= static_cast<u64>(best) << (i * 3);
+    }
+    for (u32 i = 0; i < 6; ++i) {
+        block[2 + i] = (packedIndices >> (i * 8)) & 0xff;
+    }
+}
+
+u32 const bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7Endpoint {
+    u8 values[4];
+    u8 pBit;
+};
+
+// 7 bit channels with a shared p-bit, whichever p-bit lands closer to the endpoint
+Bc7Endpoint quantizeBc7Endpoint(float const endpoint[4])
+{
+    Bc7Endpoint best = {};
+    float bestError = -1.f;
+    for (u8 pBit = 0; pBit < 2; ++pBit) {
+        Bc7Endpoint candidate = {};
+        candidate.pBit = pBit;
+        float error = 0.f;
+        for (u32 c = 0; c < 4; ++c) {
+            auto value = std::clamp(static_cast<i32>(std::lround((endpoint[c] - pBit) / 2.f)), 0, 127);
+            candidate.values[c] = static_cast<u8>(value);
+            auto d = (value * 2 + pBit) - endpoint[c];
+            error += d * d;
+        }
+        if (bestError < 0.f || error < bestError) {
+            best = candidate;
+            bestError = error;
+        }
+    }
+    return best;
+}
+
+// Mode 6 block, one subset with RGBA endpoints and 4 bit indices; returns the squared error
+u32 encodeBc7Endpoints(u8 const texels[16][4], float const endpoints[2][4], u8* block, u8 indices[16])
+{
+    Bc7Endpoint quantized[2] = { quantizeBc7Endpoint(endpoints[0]), quantizeBc7Endpoint(endpoints[1]) };
+    i32 expanded[2][4];
+    for (u32 e = 0; e < 2; ++e) {
+        for (u32 c = 0; c < 4; ++c) {
+            expanded[e][c] = (quantized[e].values[c] << 1) | quantized[e].pBit;
+        }
+    }
+    i32 palette[16][4];
+    for (u32 j = 0; j < 16; ++j) {
+        for (u32 c = 0; c < 4; ++c) {
+            palette[j][c] = ((64 - bc7Weights[j]) * expanded[0][c] + bc7Weights[j] * expanded[1][c] + 32) >> 6;
+        }
+    }
+
+    u32 error = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 best = 0;
+        auto bestDistance = distanceSquared(texels[i], palette[0], 4);
+        for (u32 j = 1; j < 16; ++j) {
+            auto distance = distanceSquared(texels[i], palette[j], 4);
+            if (distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+        indices[i] = best;
+        error += bestDistance;
+    }
+
+    // The most significant bit of the first index is implied zero
+    if (indices[0] >= 8) {
+        std::swap(quantized[0], quantized[1]);
+        for (u32 i = 0; i < 16; ++i) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer = { block };
+    writer.write(1 << 6, 7);
+    for (u32 c = 0; c < 4; ++c) {
+        writer.write(quantized[0].values[c], 7);
+        writer.write(quantized[1].values[c], 7);
+    }
+    writer.write(quantized[0].pBit, 1);
+    writer.write(quantized[1].pBit, 1);
+    writer.write(indices[0], 3);
+    for (u32 i = 1; i < 16; ++i) {
+        writer.write(indices[i], 4);
+    }
+    return error;
+}
+
+void encodeBc7Block(u8 const texels[16][4], u8* block)
+{
+    float endpoints[2][4];
+    calculateEndpoints(texels, 4, endpoints);
+    u8 indices[16];
+    auto error = encodeBc7Endpoints(texels, endpoints, block, indices);
+
+    for (u32 iteration = 0; iteration < 2 && error > 0; ++iteration) {
+        // Indices may have been flipped with the endpoints, fit in the order they were written
+        float weights[16];
+        for (u32 i = 0; i < 16; ++i) {
+            weights[i] = bc7Weights[indices[i]] / 64.f;
+        }
+        if (!fitEndpoints(texels, 4, weights, endpoints)) {
+            break;
+        }
+        u8 candidate[16];
+        u8 candidateIndices[16];
+        auto candidateError = encodeBc7Endpoints(texels, endpoints, candidate, candidateIndices);
+        if (candidateError >= error) {
+            break;
+        }
+        memcpy(block, candidate, 16);
+        memcpy(indices, candidateIndices, 16);
+        error = candidateError;
+    }
+}
+
+}
+
+u32 getBlockSize(BlockFormat format)
+{
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+    case BlockFormat::BC7:
+        return 16;
+    }
+    return 0;
+}
+
+VkFormat getBlockVkFormat(BlockFormat format, bool srgb)
+{
+    switch (format) {
+    case BlockFormat::BC1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC4:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+    case BlockFormat::BC5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+u32 getBlockSize(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+void compressImage(BlockFormat format, u8 const* pixels, u32 width, u32 height, u8* blocks)
+{
+    auto blockSize = getBlockSize(format);
+    auto blocksX = (width + 3) / 4;
+    auto blocksY = (height + 3) / 4;
+    for (u32 y = 0; y < blocksY; ++y) {
+        for (u32 x = 0; x < blocksX; ++x) {
+            u8 texels[16][4];
+            loadBlock(pixels, width, height, x, y, texels);
+            auto block = blocks + (static_cast<size_t>(y) * blocksX + x) * blockSize;
+            switch (format) {
+            case BlockFormat::BC1:
+                encodeColorBlock(texels, block);
+                break;
+            case BlockFormat::BC3:
+                encodeChannelBlock(texels, 3, block);
+                encodeColorBlock(texels, block + 8);
+                break;
+            case BlockFormat::BC4:
+                encodeChannelBlock(texels, 0, block);
+                break;
+            case BlockFormat::BC5:
+                encodeChannelBlock(texels, 0, block);
+                encodeChannelBlock(texels, 1, block + 8);
+                break;
+            case BlockFormat::BC7:
+                encodeBc7Block(texels, block);
+                break;
+            }
+        }
+    }
+}
+
+void compressMipChain(BlockFormat format, bool srgb, MipChain& chain)
+{
+    auto blockSize = getBlockSize(format);
+    std::vector<VkDeviceSize> offsets(chain.offsets.size());
+    VkDeviceSize size = 0;
+    for (u32 level = 0; level < chain.offsets.size(); ++level) {
+        auto width = std::max(chain.width >> level, 1u);
+        auto height = std::max(chain.height >> level, 1u);
+        offsets[level] = size;
+        size += static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    }
+
+    std::vector<u8> blocks(size);
+    for (u32 level = 0; level < chain.offsets.size(); ++level) {
+        auto width = std::max(chain.width >> level, 1u);
+        auto height = std::max(chain.height >> level, 1u);
+        compressImage(format, chain.pixels.data() + chain.offsets[level], width, height, blocks.data() + offsets[level]);
+    }
+
+    chain.format = getBlockVkFormat(format, srgb);
+    chain.pixels = std::move(blocks);
+    chain.offsets = std::move(offsets);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Defines.h"
+#include "MipChain.h"
+
+#include <vulkan/vulkan.h>
+
+// Block compressed formats the texture cooker writes. BC1 for opaque colour, BC3 for colour with alpha,
+// BC4 for single channel data like occlusion, BC5 for two channel data like normal maps and BC7 for colour
+// with or without alpha at higher quality
+enum class BlockFormat {
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+    BC7
+};
+
+// Bytes per 4x4 block
+u32 getBlockSize(BlockFormat format);
+VkFormat getBlockVkFormat(BlockFormat format, bool srgb);
+// Bytes per 4x4 block of the BCn, ETC2/EAC and ASTC 4x4 formats, 0 for the others
+u32 getBlockSize(VkFormat format);
+
+// blocks receives ceil(width / 4) * ceil(height / 4) blocks in rows; partial edge blocks repeat the last row and column
+void compressImage(BlockFormat format, u8 const* pixels, u32 width, u32 height, u8* blocks);
+// Replaces the RGBA8 levels of the chain by their blocks
+void compressMipChain(BlockFormat format, bool srgb, MipChain& chain);
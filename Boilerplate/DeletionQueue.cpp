@@ -0,0 +1,59 @@
+#include "DeletionQueue.h"
+#include "Logger.h"
+#include "UploadQueue.h"
+#include "Utils.h"
+
+void DeletionQueue::destroy(Context const& globals)
+{
+    for (auto& entry : entries) {
+        entry.release(globals);
+    }
+    entries.clear();
+    LOG_DEBUG("Deletion queue destroyed");
+}
+
+void DeletionQueue::push(Release release, u64 uploadTicket)
+{
+    Entry entry;
+    entry.frame = submittedFrames;
+    entry.uploadTicket = uploadTicket;
+    entry.release = std::move(release);
+    entries.push_back(std::move(entry));
+}
+
+void DeletionQueue::destroyBuffer(Buffer& buffer, u64 uploadTicket)
+{
+    push([buffer](Context const& globals) mutable { ::destroyBuffer(globals, buffer); }, uploadTicket);
+    buffer.handle = VK_NULL_HANDLE;
+    buffer.allocation = {};
+    buffer.mapped = nullptr;
+}
+
+void DeletionQueue::destroyImage(Image& image, u64 uploadTicket)
+{
+    push([image](Context const& globals) {
+        vkDestroySampler(globals.device.handle, image.sampler.handle, globals.allocator);
+        vkDestroyImageView(globals.device.handle, image.view.handle, globals.allocator);
+        ::destroyImage(globals, image);
+    }, uploadTicket);
+    image.handle = VK_NULL_HANDLE;
+    image.allocation = {};
+    image.view.handle = VK_NULL_HANDLE;
+    image.sampler.handle = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::collect(Context const& globals)
+{
+    // The fence of the oldest frame in flight has signaled, so only the newer ones may still be running
+    u64 completedFrames = submittedFrames >= framesInFlight - 1 ? submittedFrames - (framesInFlight - 1) : 0;
+
+    // Entries are pushed in frame order, but upload tickets may complete out of order
+    for (auto it = entries.begin(); it != entries.end() && it->frame <= completedFrames;) {
+        if (it->uploadTicket != 0 && !globals.uploadQueue->isComplete(globals, it->uploadTicket)) {
+            ++it;
+            continue;
+        }
+        it->release(globals);
+        it = entries.erase(it);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Defines.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+
+// Defers releasing GPU objects until the frames that could still reference them have finished.
+// An entry is released once every frame submitted before it was pushed has completed,
+// and, when an upload ticket is given, once the upload queue timeline has reached it.
+class DeletionQueue {
+public:
+    using Release = std::function<void(Context const&)>;
+
+    // Releases everything immediately; the device has to be idle
+    void destroy(Context const& globals);
+
+    void push(Release release, u64 uploadTicket = 0);
+    void destroyBuffer(Buffer& buffer, u64 uploadTicket = 0);
+    void destroyImage(Image& image, u64 uploadTicket = 0);
+
+    // Call after every graphics submission
+    void nextFrame() { ++submittedFrames; }
+    // Call once the fence of the current frame has signaled
+    void collect(Context const& globals);
+
+private:
+    struct Entry {
+        u64 frame = 0;
+        u64 uploadTicket = 0;
+        Release release;
+    };
+
+    u64 submittedFrames = 0;
+    std::deque<Entry> entries;
+};
@@ -23,6 +23,7 @@ static void queryQueueFamilyIndices(VkPhysicalDevice physicalDevice, VkSurfaceKH
 static void querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface, SwapchainSupport& swapchainSupport);
 static void initRequiredDeviceExtensions(std::vector<char const*>& requiredDeviceExtensions);
 static void checkRequiredDeviceExtensionsSupport(VkPhysicalDevice physicalDevice, std::vector<char const*> const& requiredDeviceExtensions);
+static bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, char const* extension);
 static VkSurfaceFormatKHR selectSwapchainFormat(std::vector<VkSurfaceFormatKHR> const& formats);
 static VkPresentModeKHR selectSwapchainPresentMode(std::vector<VkPresentModeKHR> const& presentModes);
 static VkFormat selectDepthStencilBufferFormat(VkPhysicalDevice physicalDevice);
@@ -31,7 +32,7 @@ void Device::create(Context& globals)
 {
     findPhysicalDevice(globals);
 
-    std::set<u32> uniqueQueueFamilyIndices = { globals.device.queues.graphics.index, globals.device.queues.present.index };
+    std::set<u32> uniqueQueueFamilyIndices = { globals.device.queues.graphics.index, globals.device.queues.transfer.index, globals.device.queues.present.index };
     float queuePriority = 1.f;
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     for (auto index : uniqueQueueFamilyIndices)
@@ -51,13 +52,29 @@ void Device::create(Context& globals)
     initRequiredDeviceExtensions(requiredDeviceExtensions);
     checkRequiredDeviceExtensionsSupport(physicalDevice, requiredDeviceExtensions);
 
+    globals.device.support.memoryBudget = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (globals.device.support.memoryBudget) {
+        requiredDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    } else {
+        LOG_WARNING("%s is not supported, memory budgets fall back to heap sizes", VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
     VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
     physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
+    // Cooked textures fall back to uncompressed pixels without it, Basis textures transcode to whichever is enabled
+    physicalDeviceFeatures.textureCompressionBC = globals.device.support.features.textureCompressionBC;
+    physicalDeviceFeatures.textureCompressionETC2 = globals.device.support.features.textureCompressionETC2;
+    physicalDeviceFeatures.textureCompressionASTC_LDR = globals.device.support.features.textureCompressionASTC_LDR;
     // physicalDeviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
+    VkPhysicalDeviceTimelineSemaphoreFeatures physicalDeviceTimelineSemaphoreFeatures = {};
+    physicalDeviceTimelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    physicalDeviceTimelineSemaphoreFeatures.pNext = nullptr;
+    physicalDeviceTimelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
     VkPhysicalDeviceDescriptorIndexingFeatures physicalDeviceDescriptorIndexingFeatures = {};
     physicalDeviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
-    physicalDeviceDescriptorIndexingFeatures.pNext = nullptr;
+    physicalDeviceDescriptorIndexingFeatures.pNext = &physicalDeviceTimelineSemaphoreFeatures;
     physicalDeviceDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
     physicalDeviceDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
     physicalDeviceDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
@@ -81,6 +98,7 @@ void Device::create(Context& globals)
     LOG_INFO("Device successfully created");
 
     vkGetDeviceQueue(globals.device.handle, globals.device.queues.graphics.index, 0, &globals.device.queues.graphics.handle);
+    vkGetDeviceQueue(globals.device.handle, globals.device.queues.transfer.index, 0, &globals.device.queues.transfer.handle);
     vkGetDeviceQueue(globals.device.handle, globals.device.queues.present.index, 0, &globals.device.queues.present.handle);
 }
 
@@ -124,6 +142,7 @@ void Device::findPhysicalDevice(Context& globals)
         LOG_INFO("Suitable physical device found");
 
         physicalDevice = physicalDevices[i];
+        globals.device.physicalDevice = physicalDevice;
 
         vkGetPhysicalDeviceProperties(physicalDevice, &globals.device.support.properties);
         vkGetPhysicalDeviceFeatures(physicalDevice, &globals.device.support.features);
@@ -289,6 +308,24 @@ void checkRequiredDeviceExtensionsSupport(VkPhysicalDevice physicalDevice, std::
     }
 }
 
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, char const* extension)
+{
+    u32 availableExtensionCount;
+    THROW_IF_FAILED(
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &availableExtensionCount, nullptr),
+        __FILE__, __LINE__,
+        "Failed to enumerate device extension properties");
+    std::vector<VkExtensionProperties> availableExtensions(availableExtensionCount);
+    THROW_IF_FAILED(
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &availableExtensionCount, availableExtensions.data()),
+        __FILE__, __LINE__,
+        "Failed to enumerate device extension properties");
+
+    return std::find_if(availableExtensions.begin(), availableExtensions.end(), [&](const VkExtensionProperties& extensionProperties) {
+        return strcmp(extension, extensionProperties.extensionName) == 0;
+    }) != availableExtensions.end();
+}
+
 VkSurfaceFormatKHR selectSwapchainFormat(std::vector<VkSurfaceFormatKHR> const& formats)
 {
     for (auto& format : formats) {
@@ -0,0 +1,48 @@
+#include "FrameAllocator.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+void FrameAllocator::create(Context const& globals, VkDeviceSize capacity)
+{
+    auto const& limits = globals.device.support.properties.limits;
+    alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+
+    buffers.resize(framesInFlight);
+    for (auto& buffer : buffers) {
+        buffer.size = capacity;
+        buffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        buffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        createBuffer(globals, buffer);
+    }
+    LOG_DEBUG("Frame allocator successfully created");
+}
+
+void FrameAllocator::destroy(Context const& globals)
+{
+    for (auto& buffer : buffers) {
+        destroyBuffer(globals, buffer);
+    }
+    buffers.clear();
+    LOG_DEBUG("Frame allocator destroyed");
+}
+
+void FrameAllocator::reset(u32 frameIndex)
+{
+    this->frameIndex = frameIndex;
+    head = 0;
+}
+
+void* FrameAllocator::allocate(VkDeviceSize size, u32& offset)
+{
+    auto alignedHead = (head + alignment - 1) / alignment * alignment;
+    if (alignedHead + size > buffers[frameIndex].size) {
+        LOG_ERROR("Frame allocator out of memory: %llu bytes requested", static_cast<unsigned long long>(size));
+        throw std::runtime_error("Frame allocator out of memory");
+    }
+
+    head = alignedHead + size;
+    offset = static_cast<u32>(alignedHead);
+    return static_cast<u8*>(buffers[frameIndex].mapped) + alignedHead;
+}
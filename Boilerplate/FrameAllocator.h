@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Defines.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <cstring>
+#include <vector>
+
+// Bump allocator over one persistently mapped buffer per frame in flight.
+// Transient per-frame constants are written with push() and bound through dynamic descriptor offsets,
+// so the descriptor sets only ever point at getBuffer(frameIndex).
+class FrameAllocator {
+public:
+    void create(Context const& globals, VkDeviceSize capacity = 4ull * 1024 * 1024);
+    void destroy(Context const& globals);
+
+    // Call once the fence of the frame has signaled
+    void reset(u32 frameIndex);
+    void* allocate(VkDeviceSize size, u32& offset);
+
+    template<typename T>
+    u32 push(T const& data)
+    {
+        u32 offset;
+        memcpy(allocate(sizeof(T), offset), &data, sizeof(T));
+        return offset;
+    }
+
+    Buffer const& getBuffer(u32 frameIndex) const { return buffers[frameIndex]; }
+
+private:
+    std::vector<Buffer> buffers;
+    VkDeviceSize alignment = 0;
+    VkDeviceSize head = 0;
+    u32 frameIndex = 0;
+};
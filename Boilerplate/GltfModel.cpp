@@ -1,553 +1,1363 @@
 #include "GltfModel.h"
+#include "AccessorView.h"
+#include "BasisTranscoder.h"
+#include "BlockCompression.h"
+#include "FrameAllocator.h"
 #include "Initializer.h"
+#include "Ktx2.h"
 #include "Logger.h"
+#include "MatrixMath.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
 #include "Utils.h"
+#include "VertexQuantization.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <stb_image.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-void GltfModel::load(std::string filename)
+// Centre of the bounding box and the largest distance from it
+static glm::vec4 calculateBoundingSphere(glm::vec3 const* positions, u32 count)
+{
+    if (count == 0) {
+        return glm::vec4(0.f);
+    }
+
+    glm::vec3 min = positions[0];
+    glm::vec3 max = positions[0];
+    for (u32 i = 1; i < count; ++i) {
+        min = glm::min(min, positions[i]);
+        max = glm::max(max, positions[i]);
+    }
+    auto center = (min + max) * 0.5f;
+    float radius = 0.f;
+    for (u32 i = 0; i < count; ++i) {
+        radius = std::max(radius, glm::length(positions[i] - center));
+    }
+    return glm::vec4(center, radius);
+}
+
+template<typename T>
+static MeshCache::View viewOf(std::vector<T> const& array)
+{
+    MeshCache::View view;
+    view.data = reinterpret_cast<u8 const*>(array.data());
+    view.size = array.size() * sizeof(T);
+    return view;
+}
+
+// Decoded images are cooked to BC7 only where the device samples BC formats, a cache from another device may not load
+static u64 getCookSettings(Context const& globals)
+{
+    return globals.device.support.features.textureCompressionBC ? 1 : 0;
+}
+
+void GltfModel::load(Context const& globals, std::string filename)
+{
+    auto cacheFilename = filename + ".cooked";
+    if (cache.open(cacheFilename, filename, getCookSettings(globals))) {
+        if (loadCooked(globals)) {
+            return;
+        }
+        LOG_WARNING("Mesh cache %s is damaged and cooked again", cacheFilename.c_str());
+        cache.close();
+    }
+
+    parse(globals, filename);
+    cook(globals, cacheFilename, filename);
+}
+
+void GltfModel::parse(Context const& globals, std::string const& filename)
 {
-    tinygltf::TinyGLTF loader;
-    std::string errors;
-    std::string warnings;
-    if (!loader.LoadASCIIFromFile(&model, &errors, &warnings, filename)) {
-        LOG_ERROR("%s (%u): %s", __FILE__, __LINE__, errors.c_str());
-        throw std::runtime_error(errors);
+    readGltf(filename, model);
+
+    // Fallbacks of KHR_texture_basisu textures are never sampled, so they are neither decoded nor cooked
+    std::vector<bool> sampled(model.images.size(), model.textures.empty());
+    for (auto const& texture : model.textures) {
+        auto image = texture.basisuSource >= 0 ? texture.basisuSource : texture.source;
+        if (image >= 0) {
+            sampled[image] = true;
+        }
+    }
+
+    // Decoding overlaps with the mesh conversion, loadImages() waits for it
+    std::vector<MeshCache::View> imageSources(model.images.size());
+    for (u32 i = 0; i < model.images.size(); ++i) {
+        if (!sampled[i]) {
+            model.images[i].data.clear();
+        }
+        imageSources[i] = viewOf(model.images[i].data);
     }
+    decodeImages(globals, imageSources);
 
     scenes.resize(model.scenes.size());
     for (u32 i = 0; i < scenes.size(); ++i) {
     }
+
+    convertNodes();
+    convertMeshes(globals);
+    convertMaterials();
+    convertSkins();
+    convertAnimations();
+    sortNodes();
+    updateNodeTransforms();
+
+    streams.positions = viewOf(positions);
+    streams.normals = viewOf(normals);
+    streams.tangents = viewOf(tangents);
+    streams.texCoords = viewOf(texCoords);
+    streams.colors = viewOf(colors);
+    streams.joints = viewOf(joints);
+    streams.weights = viewOf(weights);
+    streams.indices = viewOf(indices);
+}
+
+void GltfModel::cook(Context const& globals, std::string const& cacheFilename, std::string const& sourceFilename)
+{
+    // Only files outside the .gltf take part in the hash, embedded data is covered by the .gltf itself
+    // They are hashed under the paths readGltf opened, with the percent escapes of the URIs decoded
+    std::vector<std::string> dependencies;
+    for (auto const& buffer : model.buffers) {
+        if (!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0) {
+            dependencies.push_back(decodeUriPath(buffer.uri));
+        }
+    }
+    for (auto const& image : model.images) {
+        if (!image.uri.empty() && image.uri.compare(0, 5, "data:") != 0) {
+            dependencies.push_back(decodeUriPath(image.uri));
+        }
+    }
+
+    std::vector<MeshRange> meshRanges(meshes.size());
+    std::vector<Mesh::Primitive> primitives;
+    for (u32 i = 0; i < meshes.size(); ++i) {
+        meshRanges[i].firstPrimitive = primitives.size();
+        meshRanges[i].primitiveCount = meshes[i].primitives.size();
+        primitives.insert(primitives.end(), meshes[i].primitives.begin(), meshes[i].primitives.end());
+    }
+
+    // Images compressed while cooking are stored as KTX2 so loading skips both the decode and the encode,
+    // KTX2 sources stay as they are since Basis ones are smaller than any transcoded format
+    globals.threadPool->wait(imageDecodes);
+    std::vector<u8> encoded;
+    std::vector<ByteRange> imageRanges(model.images.size());
+    for (u32 i = 0; i < model.images.size(); ++i) {
+        imageRanges[i].offset = encoded.size();
+        auto const& source = model.images[i].data;
+        if (getBlockSize(decodedImages[i].format) != 0 && !isKtx2(source.data(), source.size())) {
+            auto ktx2 = writeKtx2(decodedImages[i]);
+            imageRanges[i].size = ktx2.size();
+            encoded.insert(encoded.end(), ktx2.begin(), ktx2.end());
+        } else {
+            imageRanges[i].size = model.images[i].data.size();
+            encoded.insert(encoded.end(), model.images[i].data.begin(), model.images[i].data.end());
+        }
+    }
+
+    MeshCache writer;
+    writer.addArray(MeshCache::Chunk::NODES, nodes);
+    writer.addArray(MeshCache::Chunk::MESHES, meshRanges);
+    writer.addArray(MeshCache::Chunk::PRIMITIVES, primitives);
+    writer.addArray(MeshCache::Chunk::MATERIALS, materials);
+    writer.addArray(MeshCache::Chunk::POSITIONS, positions);
+    writer.addArray(MeshCache::Chunk::NORMALS, normals);
+    writer.addArray(MeshCache::Chunk::TANGENTS, tangents);
+    writer.addArray(MeshCache::Chunk::TEX_COORDS, texCoords);
+    writer.addArray(MeshCache::Chunk::COLORS, colors);
+    writer.addArray(MeshCache::Chunk::JOINTS, joints);
+    writer.addArray(MeshCache::Chunk::WEIGHTS, weights);
+    writer.addArray(MeshCache::Chunk::INDICES, indices);
+    writer.addArray(MeshCache::Chunk::IMAGES, encoded);
+    writer.addArray(MeshCache::Chunk::IMAGE_RANGES, imageRanges);
+    writer.addArray(MeshCache::Chunk::SKINS, skins);
+    writer.addArray(MeshCache::Chunk::SKIN_JOINTS, skinJoints);
+    writer.addArray(MeshCache::Chunk::INVERSE_BIND_MATRICES, inverseBindMatrices);
+    writer.addArray(MeshCache::Chunk::ANIMATION_CLIPS, animations.clips);
+    writer.addArray(MeshCache::Chunk::ANIMATION_TRACKS, animations.tracks);
+    writer.addArray(MeshCache::Chunk::ANIMATION_TIMES, animations.times);
+    writer.addArray(MeshCache::Chunk::ANIMATION_VALUES, animations.values);
+    if (!writer.write(cacheFilename, sourceFilename, dependencies, getCookSettings(globals))) {
+        LOG_WARNING("%s is loaded without a mesh cache", sourceFilename.c_str());
+    }
+}
+
+// Copies the elements of a cooked chunk, false when the chunk size is not a whole number of them
+template<typename T>
+static bool readCookedArray(MeshCache const& cache, MeshCache::Chunk chunk, std::vector<T>& array)
+{
+    u64 count = 0;
+    auto data = cache.getArray<T>(chunk, count);
+    if (data == nullptr && cache.getChunk(chunk).size != 0) {
+        return false;
+    }
+    array.assign(data, data + count);
+    return true;
+}
+
+bool GltfModel::loadCooked(Context const& globals)
+{
+    // Everything is validated before any of it is used, a damaged cache leaves the model as it was
+    std::vector<ByteRange> imageRanges;
+    std::vector<MeshRange> meshRanges;
+    std::vector<Mesh::Primitive> primitives;
+    std::vector<Node> cookedNodes;
+    std::vector<Material> cookedMaterials;
+    std::vector<Skin> cookedSkins;
+    std::vector<u32> cookedJoints;
+    std::vector<glm::mat4> cookedInverseBindMatrices;
+    AnimationSet cookedAnimations;
+    bool valid =
+        readCookedArray(cache, MeshCache::Chunk::IMAGE_RANGES, imageRanges) &&
+        readCookedArray(cache, MeshCache::Chunk::MESHES, meshRanges) &&
+        readCookedArray(cache, MeshCache::Chunk::PRIMITIVES, primitives) &&
+        readCookedArray(cache, MeshCache::Chunk::NODES, cookedNodes) &&
+        readCookedArray(cache, MeshCache::Chunk::MATERIALS, cookedMaterials) &&
+        readCookedArray(cache, MeshCache::Chunk::SKINS, cookedSkins) &&
+        readCookedArray(cache, MeshCache::Chunk::SKIN_JOINTS, cookedJoints) &&
+        readCookedArray(cache, MeshCache::Chunk::INVERSE_BIND_MATRICES, cookedInverseBindMatrices) &&
+        readCookedArray(cache, MeshCache::Chunk::ANIMATION_CLIPS, cookedAnimations.clips) &&
+        readCookedArray(cache, MeshCache::Chunk::ANIMATION_TRACKS, cookedAnimations.tracks) &&
+        readCookedArray(cache, MeshCache::Chunk::ANIMATION_TIMES, cookedAnimations.times) &&
+        readCookedArray(cache, MeshCache::Chunk::ANIMATION_VALUES, cookedAnimations.values);
+
+    auto cookedImages = cache.getChunk(MeshCache::Chunk::IMAGES);
+    for (auto const& range : imageRanges) {
+        valid = valid && range.offset <= cookedImages.size && range.size <= cookedImages.size - range.offset;
+    }
+    for (auto const& range : meshRanges) {
+        valid = valid && static_cast<u64>(range.firstPrimitive) + range.primitiveCount <= primitives.size();
+    }
+    if (!valid) {
+        return false;
+    }
+
+    std::vector<MeshCache::View> imageSources(imageRanges.size());
+    for (u32 i = 0; i < imageRanges.size(); ++i) {
+        imageSources[i].data = cookedImages.data + imageRanges[i].offset;
+        imageSources[i].size = imageRanges[i].size;
+    }
+    decodeImages(globals, imageSources);
+
+    meshes.resize(meshRanges.size());
+    for (u32 i = 0; i < meshRanges.size(); ++i) {
+        auto first = primitives.begin() + meshRanges[i].firstPrimitive;
+        meshes[i].primitives.assign(first, first + meshRanges[i].primitiveCount);
+    }
+    nodes = std::move(cookedNodes);
+    materials = std::move(cookedMaterials);
+    skins = std::move(cookedSkins);
+    skinJoints = std::move(cookedJoints);
+    inverseBindMatrices = std::move(cookedInverseBindMatrices);
+    animations = std::move(cookedAnimations);
+    sortNodes();
+
+    // Vertex and index data stay in the mapped file and are uploaded from there
+    streams.positions = cache.getChunk(MeshCache::Chunk::POSITIONS);
+    streams.normals = cache.getChunk(MeshCache::Chunk::NORMALS);
+    streams.tangents = cache.getChunk(MeshCache::Chunk::TANGENTS);
+    streams.texCoords = cache.getChunk(MeshCache::Chunk::TEX_COORDS);
+    streams.colors = cache.getChunk(MeshCache::Chunk::COLORS);
+    streams.joints = cache.getChunk(MeshCache::Chunk::JOINTS);
+    streams.weights = cache.getChunk(MeshCache::Chunk::WEIGHTS);
+    streams.indices = cache.getChunk(MeshCache::Chunk::INDICES);
+    return true;
+}
+
+void GltfModel::decodeImages(Context const& globals, std::vector<MeshCache::View> const& sources)
+{
+    decodedImages.resize(sources.size());
+    for (u32 i = 0; i < sources.size(); ++i) {
+        globals.threadPool->submit(imageDecodes, [this, i, source = sources[i], &globals]() {
+            // Images nothing samples keep their slot with a single white texel
+            if (source.size == 0) {
+                u8 const white[4] = { 255, 255, 255, 255 };
+                buildMipChain(white, 1, 1, decodedImages[i]);
+                return;
+            }
+
+            if (isKtx2(source.data, source.size)) {
+                Ktx2Texture texture;
+                if (!parseKtx2(source.data, source.size, texture)) {
+                    throw std::runtime_error("Failed to parse KTX2 image");
+                }
+                if (isBasisKtx2(texture)) {
+                    auto selectFormat = [&globals](bool alpha, bool srgb) { return selectTranscodeFormat(globals, alpha, srgb); };
+                    if (!transcodeBasisKtx2(texture, selectFormat, decodedImages[i])) {
+                        throw std::runtime_error("Failed to transcode KTX2 image");
+                    }
+                    return;
+                }
+                if (!readKtx2MipChain(texture, decodedImages[i])) {
+                    throw std::runtime_error("Failed to read KTX2 image");
+                }
+                if (!isFormatSampled(globals, texture.format)) {
+                    LOG_ERROR("Image %u is stored in format %d which this device cannot sample", i, texture.format);
+                    throw std::runtime_error("Unsupported KTX2 image format");
+                }
+                return;
+            }
+
+            int width, height, channels;
+            auto pixels = stbi_load_from_memory(source.data, static_cast<int>(source.size), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) {
+                LOG_ERROR("Failed to decode image %u: %s", i, stbi_failure_reason());
+                throw std::runtime_error("Failed to decode image");
+            }
+
+            buildMipChain(pixels, width, height, decodedImages[i]);
+            stbi_image_free(pixels);
+            if (globals.device.support.features.textureCompressionBC) {
+                compressMipChain(BlockFormat::BC7, decodedImages[i].format == VK_FORMAT_R8G8B8A8_SRGB, decodedImages[i]);
+            }
+        });
+    }
 }
 
-void GltfModel::loadNodes()
+void GltfModel::convertNodes()
 {
     nodes.resize(model.nodes.size());
     for (u32 i = 0; i < model.nodes.size(); ++i) {
-        if (!model.nodes[i].matrix.empty()) {
-            std::vector<float> matrix(model.nodes[i].matrix.size());
-            for (u32 i = 0; i < model.nodes[i].matrix.size(); ++i) {
-                matrix[i] = model.nodes[i].matrix[i];
-            }
-            nodes[i].localTransform = glm::make_mat4(matrix.data());
+        auto const& node = model.nodes[i];
+        nodes[i].meshIndex = node.mesh;
+        nodes[i].skinIndex = node.skin;
+        // Nodes with a matrix cannot be animated, their rest pose is never used
+        nodes[i].restPose.translation = glm::make_vec3(node.translation);
+        nodes[i].restPose.rotation = glm::make_quat(node.rotation);
+        nodes[i].restPose.scale = glm::make_vec3(node.scale);
+        if (node.hasMatrix) {
+            nodes[i].localTransform = glm::make_mat4(node.matrix);
         } else {
-            std::vector<float> scale(3, 1.f);
-            for (u32 i = 0; i < model.nodes[i].scale.size(); ++i) {
-                scale[i] = model.nodes[i].scale[i];
+            nodes[i].localTransform = composeTransform(nodes[i].restPose);
+        }
+        for (auto child : node.children) {
+            if (child < 0 || static_cast<u32>(child) >= model.nodes.size()) {
+                LOG_ERROR("Node %u has a missing child %d", i, child);
+                throw std::runtime_error("glTF node out of bounds");
             }
+            nodes[child].parentIndex = i;
+        }
+    }
+}
 
-            std::vector<float> rotation(4);
-            for (u32 i = 0; i < model.nodes[i].rotation.size(); ++i) {
-                rotation[i] = model.nodes[i].rotation[i];
-            }
+void GltfModel::sortNodes()
+{
+    // Children of every node as ranges of one array, in node order
+    std::vector<u32> firstChild(nodes.size() + 1, 0);
+    for (auto const& node : nodes) {
+        if (node.parentIndex != -1) {
+            ++firstChild[node.parentIndex + 1];
+        }
+    }
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        firstChild[i + 1] += firstChild[i];
+    }
+    std::vector<u32> children(firstChild.back());
+    auto childCursor = firstChild;
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].parentIndex != -1) {
+            children[childCursor[nodes[i].parentIndex]++] = i;
+        }
+    }
 
-            std::vector<float> translation(3);
-            for (u32 i = 0; i < model.nodes[i].translation.size(); ++i) {
-                translation[i] = model.nodes[i].translation[i];
+    // Depth-first from every root; the positions of ancestors still open on the stack grow with each visited node
+    nodeOrder.clear();
+    orderedParents.clear();
+    subtreeSizes.assign(nodes.size(), 1);
+    std::vector<u32> stack;
+    std::vector<u32> openPositions;
+    for (u32 root = 0; root < nodes.size(); ++root) {
+        if (nodes[root].parentIndex != -1) {
+            continue;
+        }
+        stack.push_back(root);
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            while (!openPositions.empty() && nodeOrder[openPositions.back()] != static_cast<u32>(nodes[node].parentIndex)) {
+                openPositions.pop_back();
+            }
+            for (auto position : openPositions) {
+                ++subtreeSizes[position];
+            }
+            openPositions.push_back(nodeOrder.size());
+            nodeOrder.push_back(node);
+            orderedParents.push_back(nodes[node].parentIndex);
+            for (auto c = firstChild[node + 1]; c > firstChild[node]; --c) {
+                stack.push_back(children[c - 1]);
             }
+        }
+        openPositions.clear();
+    }
+
+    // Nodes on a cycle have a parent but no root above them
+    if (nodeOrder.size() != nodes.size()) {
+        LOG_ERROR("%u nodes are their own ancestors", static_cast<u32>(nodes.size() - nodeOrder.size()));
+        throw std::runtime_error("Node hierarchy has a cycle");
+    }
+}
 
-            nodes[i].localTransform =
-                glm::translate(glm::mat4(1.0), glm::make_vec3(translation.data())) *
-                glm::mat4_cast(glm::make_quat(rotation.data())) *
-                glm::scale(glm::mat4(1.0), glm::make_vec3(scale.data()));
+void GltfModel::propagateTransforms(glm::mat4 const* locals, u8* dirty, glm::mat4* globals) const
+{
+    u32 i = 0;
+    while (i < nodeOrder.size()) {
+        if (!dirty[nodeOrder[i]]) {
+            ++i;
+            continue;
+        }
+        // Extends the run over directly following dirty subtrees, clean nodes inside a subtree are recomputed too
+        auto end = i + subtreeSizes[i];
+        while (end < nodeOrder.size() && dirty[nodeOrder[end]]) {
+            end += subtreeSizes[end];
+        }
+        multiplyHierarchy(locals, nodeOrder.data() + i, orderedParents.data() + i, end - i, globals);
+        for (; i < end; ++i) {
+            dirty[nodeOrder[i]] = 0;
         }
     }
+}
 
-    for (auto rootIndex : model.scenes[0].nodes) {
-        calculateGlobalTransform(rootIndex, glm::mat4(1.f));
+void GltfModel::updateNodeTransforms()
+{
+    std::vector<glm::mat4> locals(nodes.size());
+    std::vector<glm::mat4> globals(nodes.size());
+    std::vector<u8> dirty(nodes.size(), 1);
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        locals[i] = nodes[i].localTransform;
+    }
+    propagateTransforms(locals.data(), dirty.data(), globals.data());
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        nodes[i].globalTransform = globals[i];
     }
 }
 
-void GltfModel::calculateGlobalTransform(u32 nodeIndex, glm::mat4 const& parentGlobalTransform)
+void GltfModel::convertSkins()
 {
-    nodes[nodeIndex].globalTransform = parentGlobalTransform * nodes[nodeIndex].localTransform;
-    for (auto childIndex : model.nodes[nodeIndex].children) {
-        calculateGlobalTransform(childIndex, nodes[nodeIndex].globalTransform);
+    skins.resize(model.skins.size());
+    for (u32 i = 0; i < model.skins.size(); ++i) {
+        auto const& skin = model.skins[i];
+        skins[i].firstJoint = skinJoints.size();
+        skins[i].jointCount = skin.joints.size();
+        skinJoints.insert(skinJoints.end(), skin.joints.begin(), skin.joints.end());
+
+        // Without the accessor every inverse bind matrix is the identity
+        inverseBindMatrices.resize(skinJoints.size(), glm::mat4(1.f));
+        if (skin.inverseBindMatrices != -1) {
+            auto view = createAccessorView(skin.inverseBindMatrices);
+            if (view.count < skin.joints.size() || view.componentCount != 16) {
+                LOG_ERROR("Skin %u: %llu inverse bind matrices for %u joints", i, static_cast<unsigned long long>(view.count), skins[i].jointCount);
+                throw std::runtime_error("Invalid inverse bind matrices");
+            }
+            view.count = skin.joints.size();
+            readAccessor(view, &inverseBindMatrices[skins[i].firstJoint][0][0], 16);
+        }
     }
 }
 
-void GltfModel::loadMeshes(Context const& globals)
+void GltfModel::convertAnimations()
 {
-    meshes.resize(model.meshes.size());
-    
-    for (u32 i = 0; i < model.meshes.size(); ++i) {
-        meshes[i].primitives.resize(model.meshes[i].primitives.size());
-        for (u32 j = 0; j < model.meshes[i].primitives.size(); ++j) {
-            meshes[i].primitives[j].firstIndex = indices.size();
-            meshes[i].primitives[j].vertexOffset = positions.size();
-
-            if (model.meshes[i].primitives[j].attributes.count("POSITION") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["POSITION"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-                std::vector<glm::vec3> data(accessor.count);
-                memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                positions.insert(positions.end(), data.begin(), data.end());
-            };
-
-            if (model.meshes[i].primitives[j].attributes.count("NORMAL") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["NORMAL"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-                std::vector<glm::vec3> data(accessor.count);
-                memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                normals.insert(normals.end(), data.begin(), data.end());
+    for (u32 i = 0; i < model.animations.size(); ++i) {
+        auto const& animation = model.animations[i];
+        AnimationClip clip;
+        clip.firstTrack = animations.tracks.size();
+        for (auto const& channel : animation.channels) {
+            // Channels may leave the node out for extensions to fill in, there is nothing to animate without one
+            if (channel.node < 0) {
+                continue;
+            }
+            if (channel.sampler < 0 || static_cast<u32>(channel.sampler) >= animation.samplers.size()) {
+                LOG_WARNING("Animation %u: channel with the missing sampler %d is skipped", i, channel.sampler);
+                continue;
             }
 
-            if (model.meshes[i].primitives[j].attributes.count("TANGENT") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["TANGENT"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-                std::vector<glm::vec4> data(accessor.count);
-                memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                tangents.insert(tangents.end(), data.begin(), data.end());
+            AnimationTrack track;
+            track.node = channel.node;
+            if (channel.path == "translation") {
+                track.path = AnimationPath::TRANSLATION;
+            } else if (channel.path == "rotation") {
+                track.path = AnimationPath::ROTATION;
+            } else if (channel.path == "scale") {
+                track.path = AnimationPath::SCALE;
+            } else {
+                LOG_WARNING("Animation %u: %s channels are not supported and are skipped", i, channel.path.c_str());
+                continue;
             }
 
-            if (model.meshes[i].primitives[j].attributes.count("TEXCOORD_0") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["TEXCOORD_0"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-
-                switch (accessor.componentType) {
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                    std::vector<glm::u8vec2> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    texCoords.reserve(texCoords.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        texCoords.push_back(glm::vec2(static_cast<float>(data[i][0]) / 255.f, static_cast<float>(data[i][1]) / 255.f));
-                    }
-                    break;
-                }
+            auto const& sampler = animation.samplers[channel.sampler];
+            u32 valuesPerKey = 1;
+            if (sampler.interpolation == "STEP") {
+                track.interpolation = AnimationInterpolation::STEP;
+            } else if (sampler.interpolation == "CUBICSPLINE") {
+                track.interpolation = AnimationInterpolation::CUBIC_SPLINE;
+                valuesPerKey = 3;
+            } else {
+                track.interpolation = AnimationInterpolation::LINEAR;
+            }
 
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                    std::vector<glm::u16vec2> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    texCoords.reserve(texCoords.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        texCoords.push_back(glm::vec2(static_cast<float>(data[i][0]) / 65535.f, static_cast<float>(data[i][1]) / 65535.f));
-                    }
-                    break;
-                }
+            auto input = createAccessorView(sampler.input);
+            auto output = createAccessorView(sampler.output);
+            if (input.componentCount != 1 || output.count != input.count * valuesPerKey) {
+                LOG_WARNING("Animation %u: sampler with %llu keys and %llu values is skipped", i, static_cast<unsigned long long>(input.count), static_cast<unsigned long long>(output.count));
+                continue;
+            }
 
-                case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-                    std::vector<glm::vec2> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    texCoords.insert(texCoords.end(), data.begin(), data.end());
-                    break;
-                }
+            track.firstKey = animations.times.size();
+            track.keyCount = input.count;
+            track.firstValue = animations.values.size();
+            animations.times.resize(animations.times.size() + input.count);
+            readAccessor(input, animations.times.data() + track.firstKey, 1);
+            animations.values.resize(animations.values.size() + output.count);
+            readAccessor(output, animations.values.data() + track.firstValue);
+            if (track.keyCount != 0) {
+                clip.duration = std::max(clip.duration, animations.times[track.firstKey + track.keyCount - 1]);
+            }
+            animations.tracks.push_back(track);
+        }
+        clip.trackCount = animations.tracks.size() - clip.firstTrack;
 
-                default:
-                    break;
-                }
+        // Tracks of the same node next to each other, so every animated node is composed once per update
+        std::stable_sort(
+            animations.tracks.begin() + clip.firstTrack, animations.tracks.end(),
+            [](AnimationTrack const& a, AnimationTrack const& b) { return a.node < b.node; });
+        animations.clips.push_back(clip);
+    }
+}
+
+void GltfModel::createAnimationInstance(AnimationInstance& instance, u32 clip) const
+{
+    instance.clip = clip;
+    instance.time = 0.f;
+    instance.cursors.clear();
+    instance.poses.resize(nodes.size());
+    instance.localTransforms.resize(nodes.size());
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        instance.poses[i] = nodes[i].restPose;
+        instance.localTransforms[i] = nodes[i].localTransform;
+    }
+    instance.globalTransforms.resize(nodes.size());
+    instance.dirty.assign(nodes.size(), 1);
+    instance.jointMatrices.clear();
+    instance.jointMatrixOffsets.assign(skins.size(), 0);
+    ++instance.poseVersion;
+    updateAnimation(instance, 0.f);
+}
+
+void GltfModel::updateAnimation(AnimationInstance& instance, float deltaTime) const
+{
+    if (instance.clip < animations.clips.size()) {
+        auto const& clip = animations.clips[instance.clip];
+        instance.time += deltaTime;
+        if (clip.duration > 0.f) {
+            instance.time = std::fmod(instance.time, clip.duration);
+        }
+        sampleAnimation(animations, instance.clip, instance.time, instance.cursors, instance.poses.data());
+
+        i32 previousNode = -1;
+        for (u32 t = 0; t < clip.trackCount; ++t) {
+            auto node = animations.tracks[clip.firstTrack + t].node;
+            if (static_cast<i32>(node) != previousNode) {
+                instance.localTransforms[node] = composeTransform(instance.poses[node]);
+                instance.dirty[node] = 1;
+                previousNode = node;
             }
+        }
+    }
+    updateGlobalTransforms(instance);
 
-            if (model.meshes[i].primitives[j].attributes.count("COLOR_0") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["COLOR_0"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-
-                switch (accessor.type) {
-                case TINYGLTF_TYPE_VEC3: {
-                    switch (accessor.componentType) {
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                        std::vector<glm::u8vec3> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.reserve(colors.size() + accessor.count);
-                        for (u32 i = 0; i < accessor.count; ++i) {
-                            colors.push_back(glm::vec4(static_cast<float>(data[i][0]) / 255.f, static_cast<float>(data[i][1]) / 255.f, static_cast<float>(data[i][2]) / 255.f, 1.f));
-                        }
-                        break;
-                    }
+    // The glTF skinning matrix of a joint is its global transform times its inverse bind matrix
+    std::swap(instance.jointMatrices, instance.previousJointMatrices);
+    instance.jointMatrices.resize(skinJoints.size());
+    for (u32 i = 0; i < skinJoints.size(); ++i) {
+        instance.jointMatrices[i] = instance.globalTransforms[skinJoints[i]];
+    }
+    multiplyMatrices(instance.jointMatrices.data(), inverseBindMatrices.data(), instance.jointMatrices.data(), skinJoints.size());
 
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                        std::vector<glm::u16vec3> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.reserve(colors.size() + accessor.count);
-                        for (u32 i = 0; i < accessor.count; ++i) {
-                            colors.push_back(glm::vec4(static_cast<float>(data[i][0]) / 65535.f, static_cast<float>(data[i][1]) / 65535.f, static_cast<float>(data[i][2]) / 65535.f, 1.f));
-                        }
-                        break;
-                    }
+    if (instance.previousJointMatrices.size() != instance.jointMatrices.size() ||
+        memcmp(instance.previousJointMatrices.data(), instance.jointMatrices.data(), instance.jointMatrices.size() * sizeof(glm::mat4)) != 0) {
+        ++instance.poseVersion;
+    }
+}
 
-                    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-                        std::vector<glm::vec3> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.reserve(colors.size() + accessor.count);
-                        for (u32 i = 0; i < accessor.count; ++i) {
-                            colors.push_back(glm::vec4(data[i], 1.f));
-                        }
-                        break;
-                    }
+void GltfModel::setLocalTransform(AnimationInstance& instance, u32 node, glm::mat4 const& transform) const
+{
+    instance.localTransforms[node] = transform;
+    instance.dirty[node] = 1;
+}
 
-                    default:
-                        break;
-                    }
-                    break;
-                }
+void GltfModel::updateGlobalTransforms(AnimationInstance& instance) const
+{
+    propagateTransforms(instance.localTransforms.data(), instance.dirty.data(), instance.globalTransforms.data());
+}
 
-                case TINYGLTF_TYPE_VEC4: {
-                    switch (accessor.componentType) {
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                        std::vector<glm::u8vec4> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.reserve(colors.size() + accessor.count);
-                        for (u32 i = 0; i < accessor.count; ++i) {
-                            colors.push_back(glm::vec4(static_cast<float>(data[i][0]) / 255.f, static_cast<float>(data[i][1]) / 255.f, static_cast<float>(data[i][2]) / 255.f, static_cast<float>(data[i][3]) / 255.f));
-                        }
-                        break;
-                    }
+void GltfModel::uploadJointMatrices(Context const& globals, AnimationInstance& instance) const
+{
+    for (u32 i = 0; i < skins.size(); ++i) {
+        auto size = skins[i].jointCount * sizeof(glm::mat4);
+        if (size == 0) {
+            continue;
+        }
+        auto data = globals.frameAllocator->allocate(size, instance.jointMatrixOffsets[i]);
+        memcpy(data, instance.jointMatrices.data() + skins[i].firstJoint, size);
+    }
+}
 
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                        std::vector<glm::u16vec4> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.reserve(colors.size() + accessor.count);
-                        for (u32 i = 0; i < accessor.count; ++i) {
-                            colors.push_back(glm::vec4(static_cast<float>(data[i][0]) / 65535.f, static_cast<float>(data[i][1]) / 65535.f, static_cast<float>(data[i][2]) / 65535.f, static_cast<float>(data[i][3]) / 65535.f));
-                        }
-                        break;
-                    }
+AccessorView GltfModel::createAccessorView(u32 accessorIndex) const
+{
+    auto const& accessor = model.accessors[accessorIndex];
+    AccessorView view;
+    view.count = accessor.count;
+    view.componentCount = accessor.componentCount;
+    view.componentType = static_cast<ComponentType>(accessor.componentType);
+    view.normalized = accessor.normalized;
+    view.stride = view.elementSize();
+
+    if (accessor.sparse) {
+        LOG_WARNING("Accessor %u: sparse substitution is not supported, only the dense data is read", accessorIndex);
+    }
+    if (accessor.bufferView == -1) {
+        return view;
+    }
 
-                    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-                        std::vector<glm::vec4> data(accessor.count);
-                        memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                        colors.insert(colors.end(), data.begin(), data.end());
-                        break;
-                    }
+    auto const& bufferView = model.bufferViews[accessor.bufferView];
+    auto const& buffer = model.buffers[bufferView.buffer];
+    if (bufferView.byteStride != 0) {
+        if (bufferView.byteStride < view.elementSize()) {
+            LOG_ERROR("Accessor %u: invalid byte stride", accessorIndex);
+            throw std::runtime_error("Invalid accessor byte stride");
+        }
+        view.stride = bufferView.byteStride;
+    }
 
-                    default:
-                        break;
-                    }
-                    break;
-                }
+    auto end = accessor.byteOffset + (view.count ? (view.count - 1) * view.stride + view.elementSize() : 0);
+    if (end > bufferView.byteLength || bufferView.byteOffset + bufferView.byteLength > buffer.data.size()) {
+        LOG_ERROR("Accessor %u: reads past the end of its buffer view", accessorIndex);
+        throw std::runtime_error("Accessor out of bounds");
+    }
+    view.data = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
 
-                default:
-                    break;
-                }
+    return view;
+}
+
+template<typename T>
+void GltfModel::allocateAttribute(char const* name, size_t vertexCount, std::vector<T>& attribute, T const& fallback) const
+{
+    // Primitives without the attribute keep the fallback so all arrays stay indexed alike
+    for (auto const& mesh : model.meshes) {
+        for (auto const& primitive : mesh.primitives) {
+            if (primitive.attributes.count(name) != 0) {
+                attribute.assign(vertexCount, fallback);
+                return;
             }
+        }
+    }
+}
 
-            if (model.meshes[i].primitives[j].attributes.count("JOINTS_0") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["JOINTS_0"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-
-                switch (accessor.componentType) {
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                    std::vector<glm::u8vec4> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    joints.reserve(joints.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        joints.push_back(glm::u16vec4(data[i]));
-                    }
-                    break;
-                }
+template<typename T>
+void GltfModel::readAttribute(GltfDocument::Primitive const& primitive, char const* name, size_t vertexOffset, size_t vertexCount, std::vector<T>& attribute) const
+{
+    auto it = primitive.attributes.find(name);
+    if (it == primitive.attributes.end()) {
+        return;
+    }
 
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                    std::vector<glm::u16vec4> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    joints.insert(joints.begin(), data.begin(), data.end());
-                    break;
-                }
+    auto view = createAccessorView(it->second);
+    if (view.count != vertexCount) {
+        LOG_ERROR("Attribute %s: %llu elements for %llu vertices", name, static_cast<unsigned long long>(view.count), static_cast<unsigned long long>(vertexCount));
+        throw std::runtime_error("Attribute count does not match the vertex count");
+    }
+    readAccessor(view, attribute.data() + vertexOffset);
+}
 
-                default:
-                    break;
-                }
+// Square root of the ratio between texture coordinate area and surface area
+static float calculateUvDensity(u32 const* primitiveIndices, u32 indexCount, glm::vec3 const* primitivePositions, glm::vec2 const* primitiveTexCoords)
+{
+    double surfaceArea = 0.0;
+    double uvArea = 0.0;
+    for (u32 i = 0; i + 2 < indexCount; i += 3) {
+        auto a = primitiveIndices[i + 0];
+        auto b = primitiveIndices[i + 1];
+        auto c = primitiveIndices[i + 2];
+        surfaceArea += glm::length(glm::cross(primitivePositions[b] - primitivePositions[a], primitivePositions[c] - primitivePositions[a]));
+        auto uvB = primitiveTexCoords[b] - primitiveTexCoords[a];
+        auto uvC = primitiveTexCoords[c] - primitiveTexCoords[a];
+        uvArea += glm::abs(uvB.x * uvC.y - uvB.y * uvC.x);
+    }
+    return surfaceArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.f;
+}
+
+void GltfModel::convertMeshes(Context const& globals)
+{
+    struct PrimitiveRef {
+        u32 mesh = 0;
+        u32 primitive = 0;
+        u32 vertexCount = 0;
+    };
+
+    // Lay out every primitive first, so the conversion jobs write disjoint ranges of the final arrays
+    std::vector<PrimitiveRef> primitiveRefs;
+    u32 vertexCount = 0;
+    u32 indexCount = 0;
+    meshes.resize(model.meshes.size());
+    for (u32 i = 0; i < model.meshes.size(); ++i) {
+        meshes[i].primitives.resize(model.meshes[i].primitives.size());
+        for (u32 j = 0; j < model.meshes[i].primitives.size(); ++j) {
+            auto const& primitive = model.meshes[i].primitives[j];
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end()) {
+                LOG_WARNING("Mesh %u primitive %u has no positions and is skipped", i, j);
+                continue;
             }
 
-            if (model.meshes[i].primitives[j].attributes.count("WEIGHTS_0") != 0) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].attributes["WEIGHTS_0"]];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-
-                switch  (accessor.componentType) {
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                    std::vector<glm::u8vec2> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    weights.reserve(weights.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        weights.push_back(glm::vec4(static_cast<float>(data[i][0]) / 255.f, static_cast<float>(data[i][1]) / 255.f, static_cast<float>(data[i][2]) / 255.f, static_cast<float>(data[i][3]) / 255.f));
-                    }
-                    break;
-                }
+            PrimitiveRef ref;
+            ref.mesh = i;
+            ref.primitive = j;
+            ref.vertexCount = model.accessors[position->second].count;
+            primitiveRefs.push_back(ref);
+
+            meshes[i].primitives[j].firstIndex = indexCount;
+            meshes[i].primitives[j].vertexOffset = vertexCount;
+            meshes[i].primitives[j].indexCount = primitive.indices != -1 ? model.accessors[primitive.indices].count : 0;
+            meshes[i].primitives[j].materialIndex = primitive.material;
+            vertexCount += ref.vertexCount;
+            indexCount += meshes[i].primitives[j].indexCount;
+        }
+    }
 
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                    std::vector<glm::u16vec2> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    weights.reserve(weights.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        weights.push_back(glm::vec4(static_cast<float>(data[i][0]) / 65535.f, static_cast<float>(data[i][1]) / 65535.f, static_cast<float>(data[i][2]) / 65535.f, static_cast<float>(data[i][3]) / 65535.f));
-                    }
-                    break;
-                }
+    positions.assign(vertexCount, glm::vec3(0.f));
+    allocateAttribute("NORMAL", vertexCount, normals, glm::vec3(0.f));
+    allocateAttribute("TANGENT", vertexCount, tangents, glm::vec4(0.f));
+    allocateAttribute("TEXCOORD_0", vertexCount, texCoords, glm::vec2(0.f));
+    allocateAttribute("COLOR_0", vertexCount, colors, glm::vec4(1.f));
+    allocateAttribute("JOINTS_0", vertexCount, joints, glm::u16vec4(0));
+    allocateAttribute("WEIGHTS_0", vertexCount, weights, glm::vec4(0.f));
+    indices.resize(indexCount);
+
+    // Before and after the reordering, per primitive
+    std::vector<VertexCacheStatistics> statisticsBefore(primitiveRefs.size());
+    std::vector<VertexCacheStatistics> statisticsAfter(primitiveRefs.size());
+    std::vector<std::vector<LodLevel>> lodLevels(primitiveRefs.size());
+    globals.threadPool->parallelFor(primitiveRefs.size(), [&](u32 k) {
+        auto const& ref = primitiveRefs[k];
+        auto const& primitive = model.meshes[ref.mesh].primitives[ref.primitive];
+        auto& layout = meshes[ref.mesh].primitives[ref.primitive];
+
+        readAttribute(primitive, "POSITION", layout.vertexOffset, ref.vertexCount, positions);
+        readAttribute(primitive, "NORMAL", layout.vertexOffset, ref.vertexCount, normals);
+        readAttribute(primitive, "TANGENT", layout.vertexOffset, ref.vertexCount, tangents);
+        readAttribute(primitive, "TEXCOORD_0", layout.vertexOffset, ref.vertexCount, texCoords);
+        readAttribute(primitive, "COLOR_0", layout.vertexOffset, ref.vertexCount, colors);
+        readAttribute(primitive, "JOINTS_0", layout.vertexOffset, ref.vertexCount, joints);
+        readAttribute(primitive, "WEIGHTS_0", layout.vertexOffset, ref.vertexCount, weights);
+
+        if (primitive.indices != -1) {
+            readAccessor(createAccessorView(primitive.indices), indices.data() + layout.firstIndex);
+            optimizePrimitive(layout, ref.vertexCount, statisticsBefore[k], statisticsAfter[k]);
+            lodLevels[k] = buildLods(layout, ref.vertexCount);
+        }
+        layout.boundingSphere = calculateBoundingSphere(positions.data() + layout.vertexOffset, ref.vertexCount);
+        if (!texCoords.empty()) {
+            layout.uvDensity = calculateUvDensity(
+                indices.data() + layout.firstIndex, layout.indexCount,
+                positions.data() + layout.vertexOffset, texCoords.data() + layout.vertexOffset);
+        }
+    });
+
+    // LODs index the same vertices and follow all full detail indices in the index buffer
+    u64 lodTriangles[Mesh::Primitive::maxLodCount] = {};
+    for (u32 k = 0; k < primitiveRefs.size(); ++k) {
+        auto& layout = meshes[primitiveRefs[k].mesh].primitives[primitiveRefs[k].primitive];
+        layout.lods[0].firstIndex = layout.firstIndex;
+        layout.lods[0].indexCount = layout.indexCount;
+        layout.lods[0].error = 0.f;
+        layout.lodCount = 1;
+        lodTriangles[0] += layout.indexCount / 3;
+        for (auto const& level : lodLevels[k]) {
+            auto& lod = layout.lods[layout.lodCount];
+            lod.firstIndex = indices.size();
+            lod.indexCount = level.indices.size();
+            lod.error = level.error;
+            lodTriangles[layout.lodCount++] += lod.indexCount / 3;
+            indices.insert(indices.end(), level.indices.begin(), level.indices.end());
+        }
+    }
+    LOG_INFO(
+        "LOD triangles: %llu, %llu, %llu, %llu",
+        static_cast<unsigned long long>(lodTriangles[0]), static_cast<unsigned long long>(lodTriangles[1]),
+        static_cast<unsigned long long>(lodTriangles[2]), static_cast<unsigned long long>(lodTriangles[3]));
+
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+    for (u32 k = 0; k < primitiveRefs.size(); ++k) {
+        before.vertexTransforms += statisticsBefore[k].vertexTransforms;
+        before.triangleCount += statisticsBefore[k].triangleCount;
+        before.vertexCount += statisticsBefore[k].vertexCount;
+        after.vertexTransforms += statisticsAfter[k].vertexTransforms;
+        after.triangleCount += statisticsAfter[k].triangleCount;
+        after.vertexCount += statisticsAfter[k].vertexCount;
+    }
+    LOG_INFO("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", before.acmr(), after.acmr(), before.atvr(), after.atvr());
+}
 
-                case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-                    std::vector<glm::vec4> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    weights.insert(weights.begin(), data.begin(), data.end());
-                    break;
-                }
+std::vector<GltfModel::LodLevel> GltfModel::buildLods(Mesh::Primitive const& layout, u32 vertexCount) const
+{
+    constexpr u32 minLodTriangles = 64;
+
+    std::vector<LodLevel> levels;
+    auto source = indices.data() + layout.firstIndex;
+    u64 sourceCount = layout.indexCount;
+    auto primitivePositions = positions.data() + layout.vertexOffset;
+    float error = 0.f;
+    while (levels.size() + 1 < Mesh::Primitive::maxLodCount && sourceCount / 3 >= 2 * minLodTriangles) {
+        float levelError = 0.f;
+        auto simplified = simplifyMesh(source, sourceCount, primitivePositions, vertexCount, sourceCount / 2, levelError);
+        // Stops once the simplifier runs out of collapses that keep the shape
+        if (simplified.size() > sourceCount * 3 / 4) {
+            break;
+        }
+        optimizeVertexCache(simplified.data(), simplified.size(), vertexCount);
 
-                default:
-                    break;
-                }
-            }
+        // Each level is simplified from the previous one, so the bound of the chain is the sum of the levels' bounds
+        error += levelError;
+        levels.push_back({ std::move(simplified), error });
+        source = levels.back().indices.data();
+        sourceCount = levels.back().indices.size();
+    }
+    return levels;
+}
 
-            if (model.meshes[i].primitives[j].indices != -1) {
-                auto& accessor = model.accessors[model.meshes[i].primitives[j].indices];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-                meshes[i].primitives[j].indexCount = accessor.count;
-
-                switch (accessor.componentType) {
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                    std::vector<u8> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    indices.reserve(indices.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        indices.push_back(data[i]);
-                    }
-                    break;
-                }
+u32 GltfModel::selectLod(Mesh::Primitive const& primitive, glm::mat4 const& world, glm::vec3 const& cameraPosition, float lodScale, float maxPixelError) const
+{
+    auto scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+    auto center = glm::vec3(world * glm::vec4(glm::vec3(primitive.boundingSphere), 1.f));
+    // Distance to the closest point of the bounds, the error of a primitive the camera is inside of is never hidden
+    auto distance = glm::length(center - cameraPosition) - primitive.boundingSphere.w * scale;
+    if (distance <= 0.f) {
+        return 0;
+    }
 
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                    std::vector<u16> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    indices.reserve(indices.size() + accessor.count);
-                    for (u32 i = 0; i < accessor.count; ++i) {
-                        indices.push_back(data[i]);
-                    }
-                    break;
-                }
+    u32 lod = 0;
+    for (u32 i = 1; i < primitive.lodCount; ++i) {
+        if (primitive.lods[i].error * scale * lodScale / distance <= maxPixelError) {
+            lod = i;
+        }
+    }
+    return lod;
+}
 
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
-                    std::vector<u32> data(accessor.count);
-                    memcpy(data.data(), buffer.data.data() + accessor.byteOffset + bufferView.byteOffset, bufferView.byteLength);
-                    indices.insert(indices.begin(), data.begin(), data.end());
-                    break;
-                }
+void GltfModel::optimizePrimitive(Mesh::Primitive const& layout, u32 vertexCount, VertexCacheStatistics& before, VertexCacheStatistics& after)
+{
+    auto primitiveIndices = indices.data() + layout.firstIndex;
+    for (u32 i = 0; i < layout.indexCount; ++i) {
+        if (primitiveIndices[i] >= vertexCount) {
+            LOG_ERROR("Index %u is out of range for %u vertices", primitiveIndices[i], vertexCount);
+            throw std::runtime_error("Index out of range");
+        }
+    }
 
-                default:
-                    // Debugging
-                    assert(false);
-                }
+    before = analyzeVertexCache(primitiveIndices, layout.indexCount, vertexCount);
+    if (layout.indexCount % 3 != 0) {
+        LOG_WARNING("Primitive with %u indices is not a triangle list and is not optimized", layout.indexCount);
+        after = before;
+        return;
+    }
+
+    auto primitivePositions = positions.data() + layout.vertexOffset;
+    std::vector<VertexStream> streams;
+    streams.push_back({ primitivePositions, sizeof(positions[0]) });
+    if (!normals.empty()) {
+        streams.push_back({ normals.data() + layout.vertexOffset, sizeof(normals[0]) });
+    }
+    if (!tangents.empty()) {
+        streams.push_back({ tangents.data() + layout.vertexOffset, sizeof(tangents[0]) });
+    }
+    if (!texCoords.empty()) {
+        streams.push_back({ texCoords.data() + layout.vertexOffset, sizeof(texCoords[0]) });
+    }
+    if (!colors.empty()) {
+        streams.push_back({ colors.data() + layout.vertexOffset, sizeof(colors[0]) });
+    }
+    if (!joints.empty()) {
+        streams.push_back({ joints.data() + layout.vertexOffset, sizeof(joints[0]) });
+    }
+    if (!weights.empty()) {
+        streams.push_back({ weights.data() + layout.vertexOffset, sizeof(weights[0]) });
+    }
+    weldVertices(primitiveIndices, layout.indexCount, vertexCount, streams);
+    optimizeVertexCache(primitiveIndices, layout.indexCount, vertexCount);
+    optimizeOverdraw(primitiveIndices, layout.indexCount, primitivePositions, vertexCount);
+    after = analyzeVertexCache(primitiveIndices, layout.indexCount, vertexCount);
+
+    // Every attribute array follows the new vertex order, arrays the model does not have are empty.
+    // Welded duplicates are no longer referenced and end up behind the used vertices.
+    auto remap = optimizeVertexFetch(primitiveIndices, layout.indexCount, vertexCount);
+    remapVertices(remap, primitivePositions);
+    if (!normals.empty()) {
+        remapVertices(remap, normals.data() + layout.vertexOffset);
+    }
+    if (!tangents.empty()) {
+        remapVertices(remap, tangents.data() + layout.vertexOffset);
+    }
+    if (!texCoords.empty()) {
+        remapVertices(remap, texCoords.data() + layout.vertexOffset);
+    }
+    if (!colors.empty()) {
+        remapVertices(remap, colors.data() + layout.vertexOffset);
+    }
+    if (!joints.empty()) {
+        remapVertices(remap, joints.data() + layout.vertexOffset);
+    }
+    if (!weights.empty()) {
+        remapVertices(remap, weights.data() + layout.vertexOffset);
+    }
+}
+
+struct VertexAttributeFormat {
+    VkFormat format;
+    u32 size;
+};
+
+static VertexAttributeFormat getVertexAttributeFormat(VertexAttribute attribute, VertexFormat vertexFormat)
+{
+    if (vertexFormat == VertexFormat::QUANTIZED) {
+        switch (attribute) {
+        case VertexAttribute::POSITION:
+            return { VK_FORMAT_R16G16B16A16_UNORM, sizeof(glm::u16vec4) };
+        case VertexAttribute::NORMAL:
+        case VertexAttribute::TANGENT:
+            return { VK_FORMAT_R16G16_SNORM, sizeof(glm::i16vec2) };
+        case VertexAttribute::TEX_COORD:
+            return { VK_FORMAT_R16G16_SFLOAT, sizeof(glm::u16vec2) };
+        case VertexAttribute::COLOR:
+        case VertexAttribute::WEIGHTS:
+            return { VK_FORMAT_R8G8B8A8_UNORM, sizeof(glm::u8vec4) };
+        default:
+            break;
+        }
+    }
+
+    switch (attribute) {
+    case VertexAttribute::POSITION:
+    case VertexAttribute::NORMAL:
+        return { VK_FORMAT_R32G32B32_SFLOAT, sizeof(glm::vec3) };
+    case VertexAttribute::TEX_COORD:
+        return { VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2) };
+    case VertexAttribute::JOINTS:
+        return { VK_FORMAT_R16G16B16A16_UINT, sizeof(glm::u16vec4) };
+    case VertexAttribute::TANGENT:
+    case VertexAttribute::COLOR:
+    case VertexAttribute::WEIGHTS:
+        return { VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(glm::vec4) };
+    default:
+        throw std::runtime_error("Unknown vertex attribute");
+    }
+}
+
+// Converts vertexCount float elements of source into the quantized format of the attribute
+static void quantizeVertexStream(
+    VertexAttribute attribute,
+    MeshCache::View source,
+    MeshCache::View tangents,
+    QuantizationBounds const& bounds,
+    u64 vertexCount,
+    std::vector<u8>& quantized)
+{
+    quantized.resize(vertexCount * getVertexAttributeFormat(attribute, VertexFormat::QUANTIZED).size);
+    switch (attribute) {
+    case VertexAttribute::POSITION: {
+        auto src = reinterpret_cast<glm::vec3 const*>(source.data);
+        auto handedness = reinterpret_cast<glm::vec4 const*>(tangents.data);
+        auto dst = reinterpret_cast<glm::u16vec4*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            // The octahedral tangent loses its w, the sign rides along in the position instead
+            auto w = handedness && handedness[v].w < 0.f ? 0.f : 1.f;
+            dst[v] = quantizePosition(src[v], bounds, w);
+        }
+        break;
+    }
+    case VertexAttribute::NORMAL: {
+        auto src = reinterpret_cast<glm::vec3 const*>(source.data);
+        auto dst = reinterpret_cast<glm::i16vec2*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            dst[v] = encodeOctahedral(src[v]);
+        }
+        break;
+    }
+    case VertexAttribute::TANGENT: {
+        auto src = reinterpret_cast<glm::vec4 const*>(source.data);
+        auto dst = reinterpret_cast<glm::i16vec2*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            dst[v] = encodeOctahedral(glm::vec3(src[v]));
+        }
+        break;
+    }
+    case VertexAttribute::TEX_COORD: {
+        auto src = reinterpret_cast<glm::vec2 const*>(source.data);
+        auto dst = reinterpret_cast<glm::u16vec2*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            dst[v] = quantizeHalf(src[v]);
+        }
+        break;
+    }
+    case VertexAttribute::COLOR: {
+        auto src = reinterpret_cast<glm::vec4 const*>(source.data);
+        auto dst = reinterpret_cast<glm::u8vec4*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            dst[v] = quantizeUnorm8(src[v]);
+        }
+        break;
+    }
+    case VertexAttribute::WEIGHTS: {
+        auto src = reinterpret_cast<glm::vec4 const*>(source.data);
+        auto dst = reinterpret_cast<glm::u8vec4*>(quantized.data());
+        for (u64 v = 0; v < vertexCount; ++v) {
+            dst[v] = quantizeWeights(src[v]);
+        }
+        break;
+    }
+    default:
+        quantized.assign(source.data, source.data + source.size);
+        break;
+    }
+}
+
+void GltfModel::loadMeshes(Context const& globals, VertexLayout layout, std::vector<VertexAttribute> const& attributes, VertexFormat vertexFormat)
+{
+    auto vertexCount = streams.positions.size / sizeof(glm::vec3);
+    vertexInputBindings.clear();
+    vertexInputAttributes.clear();
+    vertexBindingBuffers.clear();
+    vertexBindingOffsets.clear();
+
+    // Attributes the model does not have are filled with their glTF defaults so every shader input reads data
+    std::vector<std::vector<u8>> defaults;
+    std::vector<MeshCache::View> sources(attributes.size());
+    for (u32 i = 0; i < attributes.size(); ++i) {
+        auto size = getVertexAttributeFormat(attributes[i], VertexFormat::FLOAT).size;
+        sources[i] = getVertexStream(attributes[i]);
+        if (sources[i].size != vertexCount * size) {
+            if (attributes[i] == VertexAttribute::COLOR) {
+                std::vector<glm::vec4> white(vertexCount, glm::vec4(1.f));
+                defaults.emplace_back(reinterpret_cast<u8 const*>(white.data()), reinterpret_cast<u8 const*>(white.data() + white.size()));
+            } else {
+                defaults.emplace_back(vertexCount * size, u8(0));
             }
+            sources[i] = viewOf(defaults.back());
+        }
+    }
 
-            meshes[i].primitives[j].materialIndex = model.meshes[i].primitives[j].material;
+    positionBounds = QuantizationBounds();
+    std::vector<std::vector<u8>> quantized(attributes.size());
+    if (vertexFormat == VertexFormat::QUANTIZED) {
+        positionBounds = calculateQuantizationBounds(reinterpret_cast<glm::vec3 const*>(streams.positions.data), vertexCount);
+        auto tangents = streams.tangents.size == vertexCount * sizeof(glm::vec4) ? streams.tangents : MeshCache::View();
+        globals.threadPool->parallelFor(attributes.size(), [&](u32 i) {
+            quantizeVertexStream(attributes[i], sources[i], tangents, positionBounds, vertexCount, quantized[i]);
+        });
+        for (u32 i = 0; i < attributes.size(); ++i) {
+            sources[i] = viewOf(quantized[i]);
         }
     }
 
-    if (!positions.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = positions.size() * sizeof(positions[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, positions.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+    auto usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    switch (layout) {
+    case VertexLayout::SEPARATE:
+        for (u32 i = 0; i < attributes.size(); ++i) {
+            auto format = getVertexAttributeFormat(attributes[i], vertexFormat);
+            auto& buffer = getSeparateVertexBuffer(attributes[i]);
+            uploadStream(globals, sources[i], usage, buffer);
+            vertexInputBindings.push_back(Initializer::vertexInputBindingDescription(i, format.size));
+            vertexInputAttributes.push_back(Initializer::vertexInputAttributeDescription(i, i, format.format, 0));
+            vertexBindingBuffers.push_back(buffer.handle);
+            vertexBindingOffsets.push_back(0);
+        }
+        break;
+    case VertexLayout::SUB_RANGES: {
+        std::vector<VkDeviceSize> offsets(attributes.size());
+        VkDeviceSize size = 0;
+        for (u32 i = 0; i < attributes.size(); ++i) {
+            offsets[i] = size;
+            size = (size + sources[i].size + 15) / 16 * 16;
+        }
 
-        vertexBuffers.positions.size = stagingBuffer.size;
-        vertexBuffers.positions.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.positions.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.positions);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.positions);
-        destroyBuffer(globals, stagingBuffer);
+        vertexBuffer.size = size;
+        vertexBuffer.usage = usage;
+        vertexBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        createBuffer(globals, vertexBuffer);
+        for (u32 i = 0; i < attributes.size(); ++i) {
+            auto format = getVertexAttributeFormat(attributes[i], vertexFormat);
+            globals.uploadQueue->uploadBuffer(globals, sources[i].data, sources[i].size, vertexBuffer, offsets[i]);
+            vertexInputBindings.push_back(Initializer::vertexInputBindingDescription(i, format.size));
+            vertexInputAttributes.push_back(Initializer::vertexInputAttributeDescription(i, i, format.format, 0));
+            vertexBindingBuffers.push_back(vertexBuffer.handle);
+            vertexBindingOffsets.push_back(offsets[i]);
+        }
+        break;
     }
+    case VertexLayout::INTERLEAVED: {
+        u32 stride = 0;
+        std::vector<u32> offsets(attributes.size());
+        for (u32 i = 0; i < attributes.size(); ++i) {
+            auto format = getVertexAttributeFormat(attributes[i], vertexFormat);
+            offsets[i] = stride;
+            stride += format.size;
+            vertexInputAttributes.push_back(Initializer::vertexInputAttributeDescription(i, 0, format.format, offsets[i]));
+        }
 
-    if (!normals.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = normals.size() * sizeof(normals[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, normals.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+        std::vector<u8> interleaved(vertexCount * stride);
+        globals.threadPool->parallelFor(attributes.size(), [&](u32 i) {
+            auto size = getVertexAttributeFormat(attributes[i], vertexFormat).size;
+            auto dst = interleaved.data() + offsets[i];
+            auto src = sources[i].data;
+            for (u64 v = 0; v < vertexCount; ++v) {
+                memcpy(dst + v * stride, src + v * size, size);
+            }
+        });
+
+        uploadStream(globals, viewOf(interleaved), usage, vertexBuffer);
+        vertexInputBindings.push_back(Initializer::vertexInputBindingDescription(0, stride));
+        vertexBindingBuffers.push_back(vertexBuffer.handle);
+        vertexBindingOffsets.push_back(0);
+        break;
+    }
+    }
 
-        vertexBuffers.normals.size = stagingBuffer.size;
-        vertexBuffers.normals.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.normals.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.normals);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.normals);
-        destroyBuffer(globals, stagingBuffer);
+    // Skinned positions are floats in model space, skinned normals keep the loaded format
+    auto skinnedPosition = getVertexAttributeFormat(VertexAttribute::POSITION, VertexFormat::FLOAT);
+    auto skinnedNormal = getVertexAttributeFormat(VertexAttribute::NORMAL, vertexFormat);
+    u32 positionBinding = vertexInputBindings.size();
+    u32 normalBinding = positionBinding + 1;
+    skinnedVertexInputBindings = vertexInputBindings;
+    skinnedVertexInputBindings.push_back(Initializer::vertexInputBindingDescription(positionBinding, skinnedPosition.size));
+    skinnedVertexInputBindings.push_back(Initializer::vertexInputBindingDescription(normalBinding, skinnedNormal.size));
+    skinnedVertexInputAttributes = vertexInputAttributes;
+    for (u32 i = 0; i < attributes.size(); ++i) {
+        if (attributes[i] == VertexAttribute::POSITION) {
+            skinnedVertexInputAttributes[i] = Initializer::vertexInputAttributeDescription(i, positionBinding, skinnedPosition.format, 0);
+        } else if (attributes[i] == VertexAttribute::NORMAL) {
+            skinnedVertexInputAttributes[i] = Initializer::vertexInputAttributeDescription(i, normalBinding, skinnedNormal.format, 0);
+        }
     }
+    this->vertexFormat = vertexFormat;
 
-    if (!tangents.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = tangents.size() * sizeof(tangents[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, tangents.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+    uploadStream(globals, streams.indices, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer);
 
-        vertexBuffers.tangents.size = stagingBuffer.size;
-        vertexBuffers.tangents.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.tangents.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.tangents);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.tangents);
-        destroyBuffer(globals, stagingBuffer);
+    uploadTicket = globals.uploadQueue->flush(globals);
+}
+
+void GltfModel::loadSkinning(Context const& globals)
+{
+    auto vertexCount = streams.positions.size / sizeof(glm::vec3);
+    skinnedRanges.clear();
+    skinnedVertexCount = 0;
+    if (skins.empty() || streams.joints.size != vertexCount * sizeof(glm::u16vec4) || streams.weights.size != vertexCount * sizeof(glm::vec4)) {
+        LOG_WARNING("Model has no skinned vertices");
+        return;
     }
 
-    if (!texCoords.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = texCoords.size() * sizeof(texCoords[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, texCoords.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+    auto allIndices = reinterpret_cast<u32 const*>(streams.indices.data);
+    for (auto const& node : nodes) {
+        if (node.skinIndex == -1 || node.meshIndex == -1) {
+            continue;
+        }
+        for (auto const& primitive : meshes[node.meshIndex].primitives) {
+            if (primitive.indexCount == 0) {
+                continue;
+            }
+            auto primitiveIndices = allIndices + primitive.firstIndex;
+            SkinnedRange range;
+            range.firstVertex = primitive.vertexOffset;
+            range.vertexCount = *std::max_element(primitiveIndices, primitiveIndices + primitive.indexCount) + 1;
+            range.skinIndex = node.skinIndex;
+            skinnedRanges.push_back(range);
+        }
+    }
 
-        vertexBuffers.texCoords.size = stagingBuffer.size;
-        vertexBuffers.texCoords.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.texCoords.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.texCoords);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.texCoords);
-        destroyBuffer(globals, stagingBuffer);
+    auto usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    std::vector<glm::vec3> defaultNormals;
+    auto normalStream = streams.normals;
+    if (normalStream.size != vertexCount * sizeof(glm::vec3)) {
+        defaultNormals.assign(vertexCount, glm::vec3(0.f));
+        normalStream = viewOf(defaultNormals);
     }
+    uploadStream(globals, streams.positions, usage, skinningBuffers.positions);
+    uploadStream(globals, normalStream, usage, skinningBuffers.normals);
+    uploadStream(globals, streams.joints, usage, skinningBuffers.joints);
+    uploadStream(globals, streams.weights, usage, skinningBuffers.weights);
+    skinnedVertexCount = vertexCount;
 
-    if (!colors.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = colors.size() * sizeof(colors[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, colors.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+    uploadTicket = globals.uploadQueue->flush(globals);
+}
 
-        vertexBuffers.colors.size = stagingBuffer.size;
-        vertexBuffers.colors.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.colors.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.colors);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.colors);
-        destroyBuffer(globals, stagingBuffer);
+void GltfModel::loadMeshlets(Context const& globals)
+{
+    std::vector<Mesh::Primitive*> primitives;
+    for (auto& mesh : meshes) {
+        for (auto& primitive : mesh.primitives) {
+            if (primitive.indexCount != 0) {
+                primitives.push_back(&primitive);
+            }
+        }
     }
 
-    if (!joints.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = joints.size() * sizeof(joints[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, joints.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+    // Clusters are built per primitive in parallel and concatenated in primitive order
+    auto allIndices = reinterpret_cast<u32 const*>(streams.indices.data);
+    auto allPositions = reinterpret_cast<glm::vec3 const*>(streams.positions.data);
+    std::vector<MeshletData> primitiveMeshlets(primitives.size());
+    globals.threadPool->parallelFor(primitives.size(), [&](u32 i) {
+        auto const& primitive = *primitives[i];
+        auto primitiveIndices = allIndices + primitive.firstIndex;
+        u32 vertexCount = *std::max_element(primitiveIndices, primitiveIndices + primitive.indexCount) + 1;
+        buildMeshlets(
+            primitiveMeshlets[i],
+            primitiveIndices, primitive.indexCount,
+            allPositions + primitive.vertexOffset, vertexCount,
+            primitive.vertexOffset);
+    });
+
+    meshletData = MeshletData();
+    for (u32 i = 0; i < primitives.size(); ++i) {
+        auto const& source = primitiveMeshlets[i];
+        primitives[i]->firstMeshlet = meshletData.meshlets.size();
+        primitives[i]->meshletCount = source.meshlets.size();
+        for (auto meshlet : source.meshlets) {
+            meshlet.vertexOffset += meshletData.vertices.size();
+            meshlet.triangleOffset += meshletData.triangles.size();
+            meshletData.meshlets.push_back(meshlet);
+        }
+        meshletData.vertices.insert(meshletData.vertices.end(), source.vertices.begin(), source.vertices.end());
+        meshletData.triangles.insert(meshletData.triangles.end(), source.triangles.begin(), source.triangles.end());
+    }
+    LOG_INFO("%llu meshlets", static_cast<unsigned long long>(meshletData.meshlets.size()));
+
+    uploadMeshlets(globals, meshletData, meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer);
+    uploadTicket = globals.uploadQueue->flush(globals);
+}
+
+void GltfModel::bindVertexBuffers(VkCommandBuffer commandBuffer) const
+{
+    vkCmdBindVertexBuffers(commandBuffer, 0, vertexBindingBuffers.size(), vertexBindingBuffers.data(), vertexBindingOffsets.data());
+}
+
+void GltfModel::bindSkinnedVertexBuffers(VkCommandBuffer commandBuffer, Buffer const& skinnedPositions, Buffer const& skinnedNormals) const
+{
+    auto buffers = vertexBindingBuffers;
+    auto offsets = vertexBindingOffsets;
+    buffers.push_back(skinnedPositions.handle);
+    buffers.push_back(skinnedNormals.handle);
+    offsets.resize(buffers.size(), 0);
+    vkCmdBindVertexBuffers(commandBuffer, 0, buffers.size(), buffers.data(), offsets.data());
+}
 
-        vertexBuffers.joints.size = stagingBuffer.size;
-        vertexBuffers.joints.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.joints.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.joints);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.joints);
-        destroyBuffer(globals, stagingBuffer);
+MeshCache::View GltfModel::getVertexStream(VertexAttribute attribute) const
+{
+    switch (attribute) {
+    case VertexAttribute::POSITION: return streams.positions;
+    case VertexAttribute::NORMAL: return streams.normals;
+    case VertexAttribute::TANGENT: return streams.tangents;
+    case VertexAttribute::TEX_COORD: return streams.texCoords;
+    case VertexAttribute::COLOR: return streams.colors;
+    case VertexAttribute::JOINTS: return streams.joints;
+    case VertexAttribute::WEIGHTS: return streams.weights;
+    default: return MeshCache::View();
     }
+}
 
-    if (!weights.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = weights.size() * sizeof(weights[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, weights.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-        vertexBuffers.weights.size = stagingBuffer.size;
-        vertexBuffers.weights.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        vertexBuffers.weights.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, vertexBuffers.weights);
-        copyBuffer(globals, stagingBuffer, vertexBuffers.weights);
-        destroyBuffer(globals, stagingBuffer);
-    }
-
-    if (!indices.empty()) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = indices.size() * sizeof(indices[0]);
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        THROW_IF_FAILED(
-            vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-            __FILE__, __LINE__,
-            "Failed to map memory");
-        memcpy(stagingBuffer.mapped, indices.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+Buffer& GltfModel::getSeparateVertexBuffer(VertexAttribute attribute)
+{
+    switch (attribute) {
+    case VertexAttribute::POSITION: return vertexBuffers.positions;
+    case VertexAttribute::NORMAL: return vertexBuffers.normals;
+    case VertexAttribute::TANGENT: return vertexBuffers.tangents;
+    case VertexAttribute::TEX_COORD: return vertexBuffers.texCoords;
+    case VertexAttribute::COLOR: return vertexBuffers.colors;
+    case VertexAttribute::JOINTS: return vertexBuffers.joints;
+    case VertexAttribute::WEIGHTS: return vertexBuffers.weights;
+    default: throw std::runtime_error("Unknown vertex attribute");
+    }
+}
 
-        indexBuffer.size = stagingBuffer.size;
-        indexBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-        indexBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createBuffer(globals, indexBuffer);
-        copyBuffer(globals, stagingBuffer, indexBuffer);
-        destroyBuffer(globals, stagingBuffer);
+void GltfModel::uploadStream(Context const& globals, MeshCache::View stream, VkBufferUsageFlags usage, Buffer& buffer)
+{
+    if (stream.size == 0) {
+        return;
     }
+
+    buffer.size = stream.size;
+    buffer.usage = usage;
+    buffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createBuffer(globals, buffer);
+    globals.uploadQueue->uploadBuffer(globals, stream.data, buffer.size, buffer);
 }
 
-void GltfModel::loadImages(Context const& globals)
+void GltfModel::loadImages(Context const& globals, VkDeviceSize textureBudget)
 {
-    images.resize(model.images.size());
-    for (u32 i = 0; i < model.images.size(); ++i) {
-        Buffer stagingBuffer;
-        stagingBuffer.size = model.images[i].width * model.images[i].height * 4;
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped);
-        memcpy(stagingBuffer.mapped, model.images[i].image.data(), stagingBuffer.size);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-        images[i].width = model.images[i].width;
-        images[i].height = model.images[i].height;
-        images[i].usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-        images[i].memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createImage(globals, images[i]);
-        transitionImageLayout(globals, images[i], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(globals, stagingBuffer, images[i]);
-        destroyBuffer(globals, stagingBuffer);
-        transitionImageLayout(globals, images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        createImageView(globals, images[i]);
+    globals.threadPool->wait(imageDecodes);
+
+    textures.create(globals, textureBudget);
+    for (u32 i = 0; i < decodedImages.size(); ++i) {
+        textures.addTexture(globals, std::move(decodedImages[i]));
+    }
+
+    uploadTicket = globals.uploadQueue->flush(globals);
+}
+
+void GltfModel::updateTextureStreaming(Context const& globals, u32 frameIndex, glm::vec3 const& cameraPosition, float lodScale)
+{
+    for (auto const& node : nodes) {
+        if (node.meshIndex == -1) {
+            continue;
+        }
+        auto const& world = node.globalTransform;
+        auto scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        for (auto const& primitive : meshes[node.meshIndex].primitives) {
+            if (primitive.materialIndex >= materials.size() || primitive.uvDensity <= 0.f) {
+                continue;
+            }
+            auto texture = materials[primitive.materialIndex].diffuseTexIndex;
+            if (texture >= textures.getTextureCount()) {
+                continue;
+            }
+
+            // Like selectLod: a pixel covers distance / lodScale world units at the closest point of the bounds
+            auto center = glm::vec3(world * glm::vec4(glm::vec3(primitive.boundingSphere), 1.f));
+            auto distance = std::max(glm::length(center - cameraPosition) - primitive.boundingSphere.w * scale, 0.f);
+            textures.request(texture, primitive.uvDensity * distance / (scale * lodScale));
+        }
+    }
+    textures.update(globals);
+
+    // The descriptor set of this frame is no longer in use, the other frames catch up once their fences signal
+    if (textureVersions[frameIndex] != textures.getVersion()) {
+        writeImageDescriptors(globals, frameIndex);
     }
 }
 
 void GltfModel::loadSamplers(Context const& globals)
 {
-    samplers.resize(model.images.size());
-    for (u32 i = 0; i < model.images.size(); ++i) {
+    samplers.resize(decodedImages.size());
+    for (u32 i = 0; i < decodedImages.size(); ++i) {
         createSampler(globals, samplers[i]);
     }
 }
 
-void GltfModel::loadMaterials()
+void GltfModel::convertMaterials()
 {
     materials.resize(model.materials.size());
     for (u32 i = 0; i < model.materials.size(); ++i) {
         materials[i].shininess = 32.f;
-        materials[i].diffuseTexIndex = model.materials[i].pbrMetallicRoughness.baseColorTexture.index;
+        // Textures name an image, the Basis Universal one when KHR_texture_basisu is present
+        auto image = model.materials[i].baseColorTexture;
+        if (image >= 0 && static_cast<u32>(image) < model.textures.size()) {
+            auto const& texture = model.textures[image];
+            image = texture.basisuSource >= 0 ? texture.basisuSource : texture.source;
+        }
+        materials[i].diffuseTexIndex = image;
     }
-
-
 }
 
 void GltfModel::createFrameResources(Context const& globals)
@@ -555,59 +1365,69 @@ void GltfModel::createFrameResources(Context const& globals)
     frameResources.resize(framesInFlight);
     for (u32 i = 0; i < framesInFlight; ++i) {
         {
-            Buffer stagingBuffer;
-            stagingBuffer.size = materials.size() * sizeof(materials[0]);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, materials.data(), stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-            frameResources[i].materialBuffer.size = stagingBuffer.size;
+            frameResources[i].materialBuffer.size = materials.size() * sizeof(materials[0]);
             frameResources[i].materialBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
             frameResources[i].materialBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].materialBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].materialBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, materials.data(), frameResources[i].materialBuffer.size, frameResources[i].materialBuffer);
         }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.alignment = calculateUniformBufferAlignment(globals, sizeof(nodes[0].globalTransform));
-            stagingBuffer.size = nodes.size() * stagingBuffer.alignment;
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
+            auto alignment = calculateUniformBufferAlignment(globals, sizeof(NodeConstants));
+            std::vector<u8> renderObjects(nodes.size() * alignment);
             for (u32 i = 0; i < nodes.size(); ++i) {
-                memcpy(reinterpret_cast<u8*>(stagingBuffer.mapped) + (i * stagingBuffer.alignment), &nodes[i].globalTransform, sizeof(nodes[0].globalTransform));
+                NodeConstants renderObject;
+                renderObject.world = nodes[i].globalTransform;
+                renderObject.positionOffset = glm::vec4(positionBounds.offset, 0.f);
+                renderObject.positionScale = glm::vec4(positionBounds.scale, 1.f);
+                memcpy(renderObjects.data() + (i * alignment), &renderObject, sizeof(renderObject));
             }
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
 
-            frameResources[i].renderObjectBuffer.alignment = stagingBuffer.alignment;
-            frameResources[i].renderObjectBuffer.size = stagingBuffer.size;
+            frameResources[i].renderObjectBuffer.alignment = alignment;
+            frameResources[i].renderObjectBuffer.size = renderObjects.size();
             frameResources[i].renderObjectBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
             frameResources[i].renderObjectBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].renderObjectBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].renderObjectBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, renderObjects.data(), renderObjects.size(), frameResources[i].renderObjectBuffer);
         }
     }
+
+    uploadTicket = globals.uploadQueue->flush(globals);
+}
+
+void GltfModel::writeImageDescriptors(Context const& globals, u32 frameIndex)
+{
+    if (textures.getTextureCount() == 0) {
+        return;
+    }
+
+    std::vector<VkDescriptorImageInfo> imageDescriptors(textures.getTextureCount());
+    for (u32 j = 0; j < imageDescriptors.size(); ++j) {
+        imageDescriptors[j].sampler = samplers[j].handle;
+        imageDescriptors[j].imageView = textures.getImage(j).view.handle;
+        imageDescriptors[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+    descriptorWrites[0] = Initializer::writeDescriptorSet(
+        resourceDescriptors[0].handles[frameIndex],
+        1, 0, imageDescriptors.size(),
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        imageDescriptors.data(), nullptr, nullptr);
+    vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    textureVersions[frameIndex] = textures.getVersion();
+}
+
+bool GltfModel::isResident(Context const& globals) const
+{
+    return globals.uploadQueue->isComplete(globals, uploadTicket);
 }
 
 void GltfModel::createDescriptors(Context const& globals)
 {
-    resourceDescriptors.resize(2);
+    resourceDescriptors.resize(3);
     {
         std::vector<VkDescriptorPoolSize> poolSizes(2);
         poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight);
-        poolSizes[1] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight * images.size());
+        poolSizes[1] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight * textures.getTextureCount());
         auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(framesInFlight, poolSizes);
         THROW_IF_FAILED(
             vkCreateDescriptorPool(globals.device.handle, &descriptorPoolCreateInfo, globals.allocator, &resourceDescriptors[0].pool),
@@ -616,7 +1436,7 @@ void GltfModel::createDescriptors(Context const& globals)
 
         std::vector<VkDescriptorSetLayoutBinding> bindings(2);
         bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
-        bindings[1] = Initializer::descriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, images.size(), VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[1] = Initializer::descriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.getTextureCount(), VK_SHADER_STAGE_FRAGMENT_BIT);
         std::vector<VkDescriptorBindingFlags> descriptorBindingFlags(2);
         descriptorBindingFlags[0] = 0;
         descriptorBindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
@@ -627,7 +1447,7 @@ void GltfModel::createDescriptors(Context const& globals)
             __FILE__, __LINE__,
             "Failed to create descriptor set layout");
 
-        std::vector<u32> descriptorCounts(framesInFlight, images.size());
+        std::vector<u32> descriptorCounts(framesInFlight, textures.getTextureCount());
         auto descriptorSetVariableDescriptorCountAllocateInfo = Initializer::descriptorSetVariableDescriptorCountAllocateInfo(descriptorCounts);
         std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, resourceDescriptors[0].setLayout);
         auto descriptorSetAllocateInfo = Initializer::descriptorSetAllocateInfo(
@@ -641,27 +1461,18 @@ void GltfModel::createDescriptors(Context const& globals)
             __FILE__, __LINE__,
             "Failed to allocate descriptor sets");
 
+        textureVersions.assign(framesInFlight, 0);
         for (u32 i = 0; i < framesInFlight; ++i) {
             std::vector<VkDescriptorBufferInfo> bufferDescriptors(1);
             bufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].materialBuffer.handle, 0);
-            std::vector<VkDescriptorImageInfo> imageDescriptors(images.size());
-            for (u32 j = 0; j < imageDescriptors.size(); ++j) {
-                imageDescriptors[j].sampler = samplers[j].handle;
-                imageDescriptors[j].imageView = images[j].view;
-                imageDescriptors[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            }
-            std::vector<VkWriteDescriptorSet> descriptorWrites(2);
+            std::vector<VkWriteDescriptorSet> descriptorWrites(1);
             descriptorWrites[0] = Initializer::writeDescriptorSet(
                 resourceDescriptors[0].handles[i],
                 0, 0, bufferDescriptors.size(),
                 VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 nullptr, bufferDescriptors.data(), nullptr);
-            descriptorWrites[1] = Initializer::writeDescriptorSet(
-                resourceDescriptors[0].handles[i],
-                1, 0, imageDescriptors.size(),
-                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                imageDescriptors.data(), nullptr, nullptr);
             vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+            writeImageDescriptors(globals, i);
         }
     }
     {
@@ -691,7 +1502,7 @@ void GltfModel::createDescriptors(Context const& globals)
 
         for (u32 i = 0; i < framesInFlight; ++i) {
             std::vector<VkDescriptorBufferInfo> bufferDescriptors(1);
-            bufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].renderObjectBuffer.handle, 0, sizeof(nodes[0].globalTransform));
+            bufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].renderObjectBuffer.handle, 0, sizeof(NodeConstants));
             std::vector<VkWriteDescriptorSet> descriptorWrites(1);
             descriptorWrites[0] = Initializer::writeDescriptorSet(
                 resourceDescriptors[1].handles[i],
@@ -701,4 +1512,47 @@ void GltfModel::createDescriptors(Context const& globals)
             vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
         }
     }
+    {
+        // Joint matrices are written to the frame allocator every frame, the range covers the largest skin
+        u32 maxJointCount = 1;
+        for (auto const& skin : skins) {
+            maxJointCount = std::max(maxJointCount, skin.jointCount);
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes(1);
+        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, framesInFlight);
+        auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(framesInFlight, poolSizes);
+        THROW_IF_FAILED(
+            vkCreateDescriptorPool(globals.device.handle, &descriptorPoolCreateInfo, globals.allocator, &resourceDescriptors[2].pool),
+            __FILE__, __LINE__,
+            "Failed to create descriptor pool");
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings(1);
+        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT);
+        auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
+        THROW_IF_FAILED(
+            vkCreateDescriptorSetLayout(globals.device.handle, &descriptorSetLayoutCreateInfo, globals.allocator, &resourceDescriptors[2].setLayout),
+            __FILE__, __LINE__,
+            "Failed to create descriptor set layout");
+
+        std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, resourceDescriptors[2].setLayout);
+        auto descriptorSetAllocateInfo = Initializer::descriptorSetAllocateInfo(resourceDescriptors[2].pool, framesInFlight, setLayouts);
+        resourceDescriptors[2].handles.resize(framesInFlight);
+        THROW_IF_FAILED(
+            vkAllocateDescriptorSets(globals.device.handle, &descriptorSetAllocateInfo, resourceDescriptors[2].handles.data()),
+            __FILE__, __LINE__,
+            "Failed to allocate descriptor sets");
+
+        for (u32 i = 0; i < framesInFlight; ++i) {
+            std::vector<VkDescriptorBufferInfo> bufferDescriptors(1);
+            bufferDescriptors[0] = Initializer::descriptorBufferInfo(globals.frameAllocator->getBuffer(i).handle, 0, maxJointCount * sizeof(glm::mat4));
+            std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+            descriptorWrites[0] = Initializer::writeDescriptorSet(
+                resourceDescriptors[2].handles[i],
+                0, 0, bufferDescriptors.size(),
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                nullptr, bufferDescriptors.data(), nullptr);
+            vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+        }
+    }
 }
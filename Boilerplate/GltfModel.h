@@ -1,31 +1,127 @@
 #pragma once
 
+#include "AccessorView.h"
+#include "Animation.h"
 #include "Defines.h"
+#include "GltfReader.h"
+#include "MeshCache.h"
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
 #include "Structures.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "VertexQuantization.h"
 
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
 
-#include <tiny_gltf.h>
+// Vertex attributes a pipeline can consume; the order they are passed in is their shader location
+enum class VertexAttribute {
+    POSITION,
+    NORMAL,
+    TANGENT,
+    TEX_COORD,
+    COLOR,
+    JOINTS,
+    WEIGHTS,
+    COUNT
+};
+
+enum class VertexLayout {
+    // One buffer and binding per attribute
+    SEPARATE,
+    // One buffer with a tightly packed range per attribute, still one binding per attribute
+    SUB_RANGES,
+    // One buffer and binding holding all attributes of a vertex next to each other
+    INTERLEAVED
+};
+
+enum class VertexFormat {
+    // 32-bit floats, JOINTS as u16
+    FLOAT,
+    // Positions as unorm16 inside positionBounds with the tangent sign in w, normals and tangents as octahedral snorm16,
+    // texture coordinates as halfs, colors and weights as unorm8; JOINTS stay u16
+    QUANTIZED
+};
 
 class GltfModel {
 public:
-    void load(std::string filename);
+    // Reads nodes, meshes, materials, skins and animations and starts decoding the images on the thread pool.
+    // Uses <filename>.cooked when it is up to date, otherwise parses the glTF file and writes the cache.
+    void load(Context const& globals, std::string filename);
 
-    void loadNodes();
-    void calculateGlobalTransform(u32 nodeIndex, glm::mat4 const& parentGlobalTransform);
-    void loadMeshes(Context const& globals);
-    void loadImages(Context const& globals);
+    // Uploads the attributes in the given layout; attributes the model does not have are filled with their defaults.
+    // The matching pipeline vertex input is in vertexInputBindings and vertexInputAttributes afterwards.
+    void loadMeshes(
+        Context const& globals,
+        VertexLayout layout = VertexLayout::SEPARATE,
+        std::vector<VertexAttribute> const& attributes = { VertexAttribute::POSITION, VertexAttribute::NORMAL, VertexAttribute::TEX_COORD },
+        VertexFormat vertexFormat = VertexFormat::FLOAT);
+    // Uploads the bind pose positions, normals, joints and weights as storage buffers for a SkinningPass and lists the
+    // vertex ranges it deforms. A mesh drawn by several skinned nodes is deformed by the skin of the last of them.
+    // Call after loadMeshes.
+    void loadSkinning(Context const& globals);
+    // Splits every primitive into clusters with culling bounds and uploads them, firstMeshlet and meshletCount
+    // of each primitive point into them. Works on the optimized index order of load().
+    void loadMeshlets(Context const& globals);
+    // Builds the mip chains of the decoded images and hands them to the texture streamer, which uploads only
+    // their coarse tails; updateTextureStreaming brings in the levels the view needs
+    void loadImages(Context const& globals, VkDeviceSize textureBudget = 256ull * 1024 * 1024);
     void loadSamplers(Context const& globals);
-    void loadMaterials();
 
     void createFrameResources(Context const& globals);
     void createDescriptors(Context const& globals);
+    // False while the uploads issued by the load functions are still in flight
+    bool isResident(Context const& globals) const;
+    void bindVertexBuffers(VkCommandBuffer commandBuffer) const;
+    // Requests the mip levels every drawn primitive needs at its distance, advances the streaming and rewrites the
+    // image descriptors of the frame when images were replaced. Call once the fence of the frame has signaled.
+    void updateTextureStreaming(Context const& globals, u32 frameIndex, glm::vec3 const& cameraPosition, float lodScale);
+    // Binds the vertex buffers of skinnedVertexInputBindings, with the positions and normals of a SkinningPass
+    void bindSkinnedVertexBuffers(VkCommandBuffer commandBuffer, Buffer const& skinnedPositions, Buffer const& skinnedNormals) const;
 
     struct Node {
         glm::mat4 localTransform;
         glm::mat4 globalTransform;
+        i32 meshIndex = -1;
+        i32 parentIndex = -1;
+        i32 skinIndex = -1;
+        // Translation, rotation and scale of localTransform, what animation tracks start from
+        NodePose restPose;
+    };
+
+    // Joints of a skin are skinJoints[firstJoint, firstJoint + jointCount), with their inverse bind matrices
+    // at the same positions in inverseBindMatrices
+    struct Skin {
+        u32 firstJoint = 0;
+        u32 jointCount = 0;
+    };
+
+    // Playback state of one animated copy of the model; any number of instances share the model's clips and skins
+    struct AnimationInstance {
+        u32 clip = 0;
+        float time = 0.f;
+        std::vector<u32> cursors;
+        std::vector<NodePose> poses;
+        std::vector<glm::mat4> localTransforms;
+        std::vector<glm::mat4> globalTransforms;
+        // Nodes whose local transform changed since the last updateGlobalTransforms, indexed by node
+        std::vector<u8> dirty;
+        // Skinning matrices of all skins, laid out like skinJoints; they map bind pose to model space
+        std::vector<glm::mat4> jointMatrices;
+        // Frame allocator offset of every skin's matrices, written by uploadJointMatrices for the current frame
+        std::vector<u32> jointMatrixOffsets;
+        // Changes whenever updateAnimation produces different joint matrices, a paused or finished clip keeps it
+        u64 poseVersion = 0;
+        std::vector<glm::mat4> previousJointMatrices;
+    };
+
+    // Vertices of a primitive drawn by a skinned node, deformed by that node's skin
+    struct SkinnedRange {
+        u32 firstVertex = 0;
+        u32 vertexCount = 0;
+        u32 skinIndex = 0;
     };
 
     struct Mesh {
@@ -34,10 +130,45 @@ public:
             u32 firstIndex = 0;
             i32 vertexOffset = 0;
             u32 materialIndex = 0;
+            u32 firstMeshlet = 0;
+            u32 meshletCount = 0;
+
+            // lods[0] is the full detail range above, every following LOD has about half the triangles.
+            // error is how far the LOD surface may deviate from the full detail one, in mesh units.
+            struct Lod {
+                u32 firstIndex = 0;
+                u32 indexCount = 0;
+                float error = 0.f;
+            };
+            static constexpr u32 maxLodCount = 4;
+            Lod lods[maxLodCount];
+            u32 lodCount = 0;
+            // Mesh space, xyz centre and w radius
+            glm::vec4 boundingSphere = glm::vec4(0.f);
+            // Texture coordinate units per mesh unit, averaged over the area of the primitive; 0 without coordinates
+            float uvDensity = 0.f;
         };
         std::vector<Primitive> primitives;
     };
 
+    // Coarsest LOD of the primitive whose error stays within maxPixelError pixels on screen.
+    // lodScale converts a mesh unit at distance 1 to pixels: viewport height * proj[1][1] / 2.
+    // Declared after Mesh, above it the name would refer to ::Mesh from Structures.h
+    u32 selectLod(Mesh::Primitive const& primitive, glm::mat4 const& world, glm::vec3 const& cameraPosition, float lodScale, float maxPixelError = 1.f) const;
+
+    // Starts the instance at the beginning of clip in the rest pose
+    void createAnimationInstance(AnimationInstance& instance, u32 clip = 0) const;
+    // Advances the instance's clip by deltaTime seconds, looping, and updates the subtrees below animated nodes
+    // and the joint matrices
+    void updateAnimation(AnimationInstance& instance, float deltaTime) const;
+    // Overrides a node's local transform, for nodes driven by game logic; applied by the next update
+    void setLocalTransform(AnimationInstance& instance, u32 node, glm::mat4 const& transform) const;
+    // Recomputes the global transforms below nodes changed since the last call
+    void updateGlobalTransforms(AnimationInstance& instance) const;
+    // Copies the joint matrices into the frame allocator, one range per skin, bound through the storage buffer of
+    // resourceDescriptors[2] at jointMatrixOffsets[skinIndex]
+    void uploadJointMatrices(Context const& globals, AnimationInstance& instance) const;
+
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> normals;
     std::vector<glm::vec4> tangents;
@@ -56,21 +187,135 @@ public:
         Buffer joints;
         Buffer weights;
     } vertexBuffers;
+    // SUB_RANGES and INTERLEAVED keep all attributes here instead of in vertexBuffers
+    Buffer vertexBuffer;
     Buffer indexBuffer;
 
+    MeshletData meshletData;
+    Buffer meshletBuffer;
+    Buffer meshletVertexBuffer;
+    Buffer meshletTriangleBuffer;
+
+    std::vector<VkVertexInputBindingDescription> vertexInputBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexInputAttributes;
+    // Like the above, except POSITION and NORMAL come from two extra bindings holding skinned vertices:
+    // float positions in model space and normals in the loaded format
+    std::vector<VkVertexInputBindingDescription> skinnedVertexInputBindings;
+    std::vector<VkVertexInputAttributeDescription> skinnedVertexInputAttributes;
+    VertexFormat vertexFormat = VertexFormat::FLOAT;
+
+    std::vector<SkinnedRange> skinnedRanges;
+    // Vertices in the streams a SkinningPass writes, all vertices of the model so primitives keep their vertex offsets
+    u32 skinnedVertexCount = 0;
+    struct {
+        Buffer positions;
+        Buffer normals;
+        Buffer joints;
+        Buffer weights;
+    } skinningBuffers;
+    // Identity unless the meshes were loaded QUANTIZED, also written next to each node's world matrix
+    QuantizationBounds positionBounds;
+
     struct Scene{
         std::vector<Node> rootNodes;
     };
 
-    tinygltf::Model model;
+    GltfDocument model;
     std::vector<Scene> scenes;
 
     std::vector<Node> nodes;
     std::vector<Mesh> meshes;
-    std::vector<Image> images;
+    TextureStreamer textures;
     std::vector<Sampler> samplers;
     std::vector<Material> materials;
 
+    AnimationSet animations;
+    std::vector<Skin> skins;
+    std::vector<u32> skinJoints;
+    std::vector<glm::mat4> inverseBindMatrices;
+
     std::vector<FrameResource> frameResources;
     std::vector<DescriptorSets> resourceDescriptors;
+
+    u64 uploadTicket = 0;
+
+private:
+    struct MeshRange {
+        u32 firstPrimitive = 0;
+        u32 primitiveCount = 0;
+    };
+
+    struct ByteRange {
+        u64 offset = 0;
+        u64 size = 0;
+    };
+
+    // Per node uniform data, set 2 binding 0 of the sample shaders
+    struct NodeConstants {
+        glm::mat4 world;
+        glm::vec4 positionOffset;
+        glm::vec4 positionScale;
+    };
+
+    struct LodLevel {
+        std::vector<u32> indices;
+        float error = 0.f;
+    };
+
+    void parse(Context const& globals, std::string const& filename);
+    void cook(Context const& globals, std::string const& cacheFilename, std::string const& sourceFilename);
+    // False when the cache is damaged, nothing of it is loaded then
+    bool loadCooked(Context const& globals);
+    void decodeImages(Context const& globals, std::vector<MeshCache::View> const& sources);
+    void convertNodes();
+    // Builds the flattened hierarchy from the parent indices
+    void sortNodes();
+    // Recomputes globals of the subtrees below dirty nodes, one batched multiply per run of dirty subtrees, and clears dirty
+    void propagateTransforms(glm::mat4 const* locals, u8* dirty, glm::mat4* globals) const;
+    // Global transforms of the nodes themselves, in the rest pose
+    void updateNodeTransforms();
+    void convertMeshes(Context const& globals);
+    // Vertex cache, overdraw and vertex fetch order of one indexed primitive
+    std::vector<LodLevel> buildLods(Mesh::Primitive const& layout, u32 vertexCount) const;
+    void optimizePrimitive(Mesh::Primitive const& layout, u32 vertexCount, VertexCacheStatistics& before, VertexCacheStatistics& after);
+    void convertMaterials();
+    void convertSkins();
+    void convertAnimations();
+    void uploadStream(Context const& globals, MeshCache::View stream, VkBufferUsageFlags usage, Buffer& buffer);
+    void writeImageDescriptors(Context const& globals, u32 frameIndex);
+    MeshCache::View getVertexStream(VertexAttribute attribute) const;
+    Buffer& getSeparateVertexBuffer(VertexAttribute attribute);
+
+    AccessorView createAccessorView(u32 accessorIndex) const;
+    template<typename T>
+    void allocateAttribute(char const* name, size_t vertexCount, std::vector<T>& attribute, T const& fallback) const;
+    template<typename T>
+    void readAttribute(GltfDocument::Primitive const& primitive, char const* name, size_t vertexOffset, size_t vertexCount, std::vector<T>& attribute) const;
+
+    MeshCache cache;
+    // Upload sources, either the arrays above or chunks of the mapped cache
+    struct {
+        MeshCache::View positions;
+        MeshCache::View normals;
+        MeshCache::View tangents;
+        MeshCache::View texCoords;
+        MeshCache::View colors;
+        MeshCache::View joints;
+        MeshCache::View weights;
+        MeshCache::View indices;
+    } streams;
+
+    // Filled by the decode tasks, moved into textures by loadImages
+    std::vector<MipChain> decodedImages;
+    // TextureStreamer version the image descriptors of every frame were written with
+    std::vector<u64> textureVersions;
+    // Flattened hierarchy: nodes in depth-first order, so parents come before children and every subtree is the
+    // contiguous run [i, i + subtreeSizes[i]). orderedParents[i] is the parent node of nodeOrder[i].
+    std::vector<u32> nodeOrder;
+    std::vector<i32> orderedParents;
+    std::vector<u32> subtreeSizes;
+
+    std::vector<VkBuffer> vertexBindingBuffers;
+    std::vector<VkDeviceSize> vertexBindingOffsets;
+    ThreadPool::TaskGroup imageDecodes;
 };
@@ -0,0 +1,494 @@
+#include "GltfReader.h"
+#include "Base64.h"
+#include "Logger.h"
+#include "MappedFile.h"
+
+#include "ThirdParty/nlohmann/json.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+using json = nlohmann::json;
+
+// Embedded base64 buffers are decoded before parsing and replaced by this name plus an index,
+// so the JSON parser never sees the megabytes of payload
+static constexpr char embeddedBufferName[] = "embedded-buffer-";
+
+template<typename T>
+static T& element(std::vector<T>& array, u32 index)
+{
+    if (array.size() <= index) {
+        array.resize(index + 1);
+    }
+    return array[index];
+}
+
+static u32 componentCountOf(std::string const& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    LOG_ERROR("Unknown accessor type %s", type.c_str());
+    throw std::runtime_error("Unknown accessor type");
+}
+
+// Tracks where in the document the parser is and stores the values GltfDocument has a field for.
+// frames[0] is the root object, a path like meshes[i].primitives[j].indices is five frames deep.
+class GltfSaxHandler : public nlohmann::json_sax<json> {
+public:
+    explicit GltfSaxHandler(GltfDocument& document) : document(document) {}
+
+    bool null() override { return advance(); }
+    bool binary(binary_t&) override { return advance(); }
+
+    bool boolean(bool value) override
+    {
+        if (depth() == 3 && isKey(0, "accessors") && isKey(2, "normalized")) {
+            element(document.accessors, index(1)).normalized = value;
+        }
+        return advance();
+    }
+
+    bool number_integer(number_integer_t value) override { return number(static_cast<double>(value)); }
+    bool number_unsigned(number_unsigned_t value) override { return number(static_cast<double>(value)); }
+    bool number_float(number_float_t value, string_t const&) override { return number(value); }
+
+    bool string(string_t& value) override
+    {
+        if (depth() == 3) {
+            if (isKey(0, "buffers") && isKey(2, "uri")) {
+                element(document.buffers, index(1)).uri = std::move(value);
+            } else if (isKey(0, "images") && isKey(2, "uri")) {
+                element(document.images, index(1)).uri = std::move(value);
+            } else if (isKey(0, "images") && isKey(2, "mimeType")) {
+                element(document.images, index(1)).mimeType = std::move(value);
+            } else if (isKey(0, "accessors") && isKey(2, "type")) {
+                element(document.accessors, index(1)).componentCount = componentCountOf(value);
+            } else if (isKey(0, "animations") && isKey(2, "name")) {
+                element(document.animations, index(1)).name = std::move(value);
+            }
+        } else if (depth() == 5 && isKey(0, "animations") && isKey(2, "samplers") && isKey(4, "interpolation")) {
+            element(element(document.animations, index(1)).samplers, index(3)).interpolation = std::move(value);
+        } else if (depth() == 6 && isKey(0, "animations") && isKey(2, "channels") && isKey(4, "target") && isKey(5, "path")) {
+            element(element(document.animations, index(1)).channels, index(3)).path = std::move(value);
+        }
+        return advance();
+    }
+
+    bool start_object(std::size_t) override
+    {
+        // Array elements are created when they open, so objects without any field we read keep their index
+        if (depth() == 2 && frames[1].array) {
+            auto i = index(1);
+            if (isKey(0, "buffers")) element(document.buffers, i);
+            else if (isKey(0, "bufferViews")) element(document.bufferViews, i);
+            else if (isKey(0, "accessors")) element(document.accessors, i);
+            else if (isKey(0, "meshes")) element(document.meshes, i);
+            else if (isKey(0, "nodes")) element(document.nodes, i);
+            else if (isKey(0, "scenes")) element(document.scenes, i);
+            else if (isKey(0, "materials")) element(document.materials, i);
+            else if (isKey(0, "textures")) element(document.textures, i);
+            else if (isKey(0, "images")) element(document.images, i);
+            else if (isKey(0, "skins")) element(document.skins, i);
+            else if (isKey(0, "animations")) element(document.animations, i);
+        } else if (depth() == 3 && isKey(0, "accessors") && isKey(2, "sparse")) {
+            element(document.accessors, index(1)).sparse = true;
+        } else if (depth() == 4 && isKey(0, "meshes") && isKey(2, "primitives")) {
+            element(element(document.meshes, index(1)).primitives, index(3));
+        } else if (depth() == 4 && isKey(0, "animations") && isKey(2, "channels")) {
+            element(element(document.animations, index(1)).channels, index(3));
+        } else if (depth() == 4 && isKey(0, "animations") && isKey(2, "samplers")) {
+            element(element(document.animations, index(1)).samplers, index(3));
+        }
+
+        Frame frame;
+        frame.array = false;
+        frames.push_back(frame);
+        return true;
+    }
+
+    bool key(string_t& value) override
+    {
+        frames.back().key = std::move(value);
+        return true;
+    }
+
+    bool end_object() override
+    {
+        frames.pop_back();
+        return advance();
+    }
+
+    bool start_array(std::size_t) override
+    {
+        Frame frame;
+        frame.array = true;
+        frames.push_back(frame);
+        return true;
+    }
+
+    bool end_array() override
+    {
+        frames.pop_back();
+        return advance();
+    }
+
+    bool parse_error(std::size_t position, std::string const&, nlohmann::detail::exception const& exception) override
+    {
+        LOG_ERROR("glTF parse error at byte %llu: %s", static_cast<unsigned long long>(position), exception.what());
+        return false;
+    }
+
+private:
+    struct Frame {
+        bool array = false;
+        u32 index = 0;
+        std::string key;
+    };
+
+    GltfDocument& document;
+    std::vector<Frame> frames;
+
+    u32 depth() const { return static_cast<u32>(frames.size()); }
+    u32 index(u32 frame) const { return frames[frame].index; }
+    bool isKey(u32 frame, char const* key) const { return !frames[frame].array && frames[frame].key == key; }
+
+    // Moves an enclosing array on to its next element once a value or a nested container is complete
+    bool advance()
+    {
+        if (!frames.empty() && frames.back().array) {
+            ++frames.back().index;
+        }
+        return true;
+    }
+
+    bool number(double value)
+    {
+        auto integer = static_cast<i32>(value);
+        auto size = static_cast<u64>(value);
+        switch (depth()) {
+        case 1:
+            if (isKey(0, "scene")) {
+                document.scene = integer;
+            }
+            break;
+        case 3:
+            if (isKey(0, "bufferViews")) {
+                auto& bufferView = element(document.bufferViews, index(1));
+                if (isKey(2, "buffer")) bufferView.buffer = integer;
+                else if (isKey(2, "byteOffset")) bufferView.byteOffset = size;
+                else if (isKey(2, "byteLength")) bufferView.byteLength = size;
+                else if (isKey(2, "byteStride")) bufferView.byteStride = static_cast<u32>(value);
+            } else if (isKey(0, "accessors")) {
+                auto& accessor = element(document.accessors, index(1));
+                if (isKey(2, "bufferView")) accessor.bufferView = integer;
+                else if (isKey(2, "byteOffset")) accessor.byteOffset = size;
+                else if (isKey(2, "count")) accessor.count = size;
+                else if (isKey(2, "componentType")) accessor.componentType = static_cast<u32>(value);
+            } else if (isKey(0, "buffers") && isKey(2, "byteLength")) {
+                element(document.buffers, index(1)).byteLength = size;
+            } else if (isKey(0, "nodes") && isKey(2, "mesh")) {
+                element(document.nodes, index(1)).mesh = integer;
+            } else if (isKey(0, "nodes") && isKey(2, "skin")) {
+                element(document.nodes, index(1)).skin = integer;
+            } else if (isKey(0, "skins") && isKey(2, "inverseBindMatrices")) {
+                element(document.skins, index(1)).inverseBindMatrices = integer;
+            } else if (isKey(0, "images") && isKey(2, "bufferView")) {
+                element(document.images, index(1)).bufferView = integer;
+            } else if (isKey(0, "textures") && isKey(2, "source")) {
+                element(document.textures, index(1)).source = integer;
+            }
+            break;
+        case 4:
+            if (isKey(0, "nodes")) {
+                auto& node = element(document.nodes, index(1));
+                auto i = index(3);
+                if (isKey(2, "children")) {
+                    node.children.push_back(integer);
+                } else if (isKey(2, "matrix") && i < 16) {
+                    node.matrix[i] = static_cast<float>(value);
+                    node.hasMatrix = true;
+                } else if (isKey(2, "translation") && i < 3) {
+                    node.translation[i] = static_cast<float>(value);
+                } else if (isKey(2, "rotation") && i < 4) {
+                    node.rotation[i] = static_cast<float>(value);
+                } else if (isKey(2, "scale") && i < 3) {
+                    node.scale[i] = static_cast<float>(value);
+                }
+            } else if (isKey(0, "scenes") && isKey(2, "nodes")) {
+                element(document.scenes, index(1)).nodes.push_back(integer);
+            } else if (isKey(0, "skins") && isKey(2, "joints")) {
+                element(document.skins, index(1)).joints.push_back(integer);
+            }
+            break;
+        case 5:
+            if (isKey(0, "meshes") && isKey(2, "primitives")) {
+                auto& primitive = element(element(document.meshes, index(1)).primitives, index(3));
+                if (isKey(4, "indices")) primitive.indices = integer;
+                else if (isKey(4, "material")) primitive.material = integer;
+            } else if (isKey(0, "materials") && isKey(2, "pbrMetallicRoughness") && isKey(3, "baseColorTexture") && isKey(4, "index")) {
+                element(document.materials, index(1)).baseColorTexture = integer;
+            } else if (isKey(0, "textures") && isKey(2, "extensions") && isKey(3, "KHR_texture_basisu") && isKey(4, "source")) {
+                element(document.textures, index(1)).basisuSource = integer;
+            } else if (isKey(0, "animations") && isKey(2, "channels") && isKey(4, "sampler")) {
+                element(element(document.animations, index(1)).channels, index(3)).sampler = integer;
+            } else if (isKey(0, "animations") && isKey(2, "samplers")) {
+                auto& sampler = element(element(document.animations, index(1)).samplers, index(3));
+                if (isKey(4, "input")) sampler.input = integer;
+                else if (isKey(4, "output")) sampler.output = integer;
+            }
+            break;
+        case 6:
+            if (isKey(0, "meshes") && isKey(2, "primitives") && isKey(4, "attributes")) {
+                element(element(document.meshes, index(1)).primitives, index(3)).attributes[frames[5].key] = integer;
+            } else if (isKey(0, "animations") && isKey(2, "channels") && isKey(4, "target") && isKey(5, "node")) {
+                element(element(document.animations, index(1)).channels, index(3)).node = integer;
+            }
+            break;
+        }
+        return advance();
+    }
+};
+
+// Copies the JSON without the payloads of embedded buffers, which are decoded into embeddedBuffers
+static std::string extractEmbeddedBuffers(char const* text, u64 size, std::vector<std::vector<u8>>& embeddedBuffers)
+{
+    static char const* const prefixes[] = {
+        "\"data:application/octet-stream;base64,",
+        "\"data:application/gltf-buffer;base64,"
+    };
+
+    std::string json;
+    std::string_view source(text, size);
+    u64 copied = 0;
+    for (auto prefix : prefixes) {
+        std::string_view needle(prefix);
+        for (auto begin = source.find(needle); begin != std::string_view::npos; begin = source.find(needle, begin + 1)) {
+            auto payload = begin + needle.size();
+            auto end = source.find('"', payload);
+            if (end == std::string_view::npos) {
+                break;
+            }
+
+            std::vector<u8> decoded(base64DecodedSize(text + payload, end - payload));
+            if (!base64Decode(text + payload, end - payload, decoded.data())) {
+                LOG_ERROR("Invalid base64 data in embedded buffer %u", static_cast<u32>(embeddedBuffers.size()));
+                throw std::runtime_error("Invalid base64 data");
+            }
+
+            json.append(text + copied, begin + 1 - copied);
+            json.append(embeddedBufferName);
+            json.append(std::to_string(embeddedBuffers.size()));
+            copied = end;
+            embeddedBuffers.push_back(std::move(decoded));
+        }
+        // A file uses the same media type for all of its buffers
+        if (!embeddedBuffers.empty()) {
+            break;
+        }
+    }
+    json.append(text + copied, size - copied);
+
+    return json;
+}
+
+// Data URIs of any media type, used for images and buffers the extraction above did not catch
+static bool decodeDataUri(std::string const& uri, std::vector<u8>& data)
+{
+    auto comma = uri.find(',');
+    if (uri.compare(0, 5, "data:") != 0 || comma == std::string::npos || comma < 12 || uri.compare(comma - 7, 7, ";base64") != 0) {
+        return false;
+    }
+
+    auto payload = uri.c_str() + comma + 1;
+    auto length = uri.size() - comma - 1;
+    data.resize(base64DecodedSize(payload, length));
+    return base64Decode(payload, length, data.data());
+}
+
+std::string decodeUriPath(std::string const& uri)
+{
+    std::string result;
+    result.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+            result.push_back(static_cast<char>(std::strtoul(hex, nullptr, 16)));
+            i += 2;
+        } else {
+            result.push_back(uri[i]);
+        }
+    }
+    return result;
+}
+
+static void readFile(std::string const& filename, std::vector<u8>& data)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        LOG_ERROR("Failed to open %s", filename.c_str());
+        throw std::runtime_error("Failed to open glTF resource");
+    }
+    data.assign(file.getData(), file.getData() + file.getSize());
+}
+
+static void loadResource(std::string const& directory, std::string const& uri, std::vector<std::vector<u8>>& embeddedBuffers, std::vector<u8>& data)
+{
+    if (uri.compare(0, sizeof(embeddedBufferName) - 1, embeddedBufferName) == 0) {
+        auto embedded = std::strtoul(uri.c_str() + sizeof(embeddedBufferName) - 1, nullptr, 10);
+        if (embedded >= embeddedBuffers.size()) {
+            throw std::runtime_error("Invalid embedded buffer reference");
+        }
+        data = std::move(embeddedBuffers[embedded]);
+        return;
+    }
+    if (uri.compare(0, 5, "data:") == 0) {
+        if (!decodeDataUri(uri, data)) {
+            LOG_ERROR("Invalid data URI %.64s", uri.c_str());
+            throw std::runtime_error("Invalid data URI");
+        }
+        return;
+    }
+    readFile(directory + decodeUriPath(uri), data);
+}
+
+void readGltf(std::string const& filename, GltfDocument& document)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        LOG_ERROR("Failed to open %s", filename.c_str());
+        throw std::runtime_error("Failed to open glTF file");
+    }
+    std::vector<std::vector<u8>> embeddedBuffers;
+    auto text = extractEmbeddedBuffers(reinterpret_cast<char const*>(file.getData()), file.getSize(), embeddedBuffers);
+    file.close();
+
+    document = GltfDocument();
+    GltfSaxHandler handler(document);
+    if (!json::sax_parse(text, &handler)) {
+        throw std::runtime_error("Failed to parse " + filename);
+    }
+
+    auto directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+    for (u32 i = 0; i < document.buffers.size(); ++i) {
+        auto& buffer = document.buffers[i];
+        loadResource(directory, buffer.uri, embeddedBuffers, buffer.data);
+        // Embedded data is part of the .gltf, only external files remain as URIs
+        if (buffer.uri.compare(0, sizeof(embeddedBufferName) - 1, embeddedBufferName) == 0) {
+            buffer.uri.clear();
+        }
+        if (buffer.data.size() < buffer.byteLength) {
+            LOG_ERROR("Buffer %u holds %llu of %llu bytes", i, static_cast<unsigned long long>(buffer.data.size()), static_cast<unsigned long long>(buffer.byteLength));
+            throw std::runtime_error("glTF buffer is too short");
+        }
+    }
+
+    for (u32 i = 0; i < document.bufferViews.size(); ++i) {
+        auto const& bufferView = document.bufferViews[i];
+        if (bufferView.buffer < 0 || static_cast<u32>(bufferView.buffer) >= document.buffers.size() ||
+            bufferView.byteOffset + bufferView.byteLength > document.buffers[bufferView.buffer].data.size()) {
+            LOG_ERROR("Buffer view %u is out of bounds", i);
+            throw std::runtime_error("glTF buffer view out of bounds");
+        }
+    }
+    for (u32 i = 0; i < document.accessors.size(); ++i) {
+        if (document.accessors[i].bufferView >= static_cast<i32>(document.bufferViews.size())) {
+            LOG_ERROR("Accessor %u references a missing buffer view", i);
+            throw std::runtime_error("glTF accessor out of bounds");
+        }
+    }
+
+    auto isIndex = [](i32 index, size_t count) { return index >= 0 && static_cast<size_t>(index) < count; };
+    for (u32 i = 0; i < document.meshes.size(); ++i) {
+        for (auto const& primitive : document.meshes[i].primitives) {
+            bool valid = (primitive.indices == -1 || isIndex(primitive.indices, document.accessors.size())) &&
+                (primitive.material == -1 || isIndex(primitive.material, document.materials.size()));
+            for (auto const& [name, accessor] : primitive.attributes) {
+                valid = valid && isIndex(accessor, document.accessors.size());
+            }
+            if (!valid) {
+                LOG_ERROR("Mesh %u has a primitive that references a missing accessor or material", i);
+                throw std::runtime_error("glTF primitive out of bounds");
+            }
+        }
+    }
+    for (u32 i = 0; i < document.nodes.size(); ++i) {
+        auto const& node = document.nodes[i];
+        if ((node.mesh != -1 && !isIndex(node.mesh, document.meshes.size())) ||
+            (node.skin != -1 && !isIndex(node.skin, document.skins.size()))) {
+            LOG_ERROR("Node %u references a missing mesh or skin", i);
+            throw std::runtime_error("glTF node out of bounds");
+        }
+    }
+    for (u32 i = 0; i < document.scenes.size(); ++i) {
+        for (auto node : document.scenes[i].nodes) {
+            if (!isIndex(node, document.nodes.size())) {
+                LOG_ERROR("Scene %u references a missing node %d", i, node);
+                throw std::runtime_error("glTF scene out of bounds");
+            }
+        }
+    }
+    for (u32 i = 0; i < document.materials.size(); ++i) {
+        auto texture = document.materials[i].baseColorTexture;
+        if (texture != -1 && !isIndex(texture, document.textures.size())) {
+            LOG_ERROR("Material %u references a missing texture", i);
+            throw std::runtime_error("glTF material out of bounds");
+        }
+    }
+    for (u32 i = 0; i < document.skins.size(); ++i) {
+        auto const& skin = document.skins[i];
+        bool valid = skin.inverseBindMatrices == -1 || isIndex(skin.inverseBindMatrices, document.accessors.size());
+        for (auto joint : skin.joints) {
+            valid = valid && isIndex(joint, document.nodes.size());
+        }
+        if (!valid) {
+            LOG_ERROR("Skin %u references a missing accessor or node", i);
+            throw std::runtime_error("glTF skin out of bounds");
+        }
+    }
+    for (u32 i = 0; i < document.textures.size(); ++i) {
+        auto const& texture = document.textures[i];
+        if ((texture.source != -1 && !isIndex(texture.source, document.images.size())) ||
+            (texture.basisuSource != -1 && !isIndex(texture.basisuSource, document.images.size()))) {
+            LOG_ERROR("Texture %u references a missing image", i);
+            throw std::runtime_error("glTF texture out of bounds");
+        }
+    }
+    for (u32 i = 0; i < document.animations.size(); ++i) {
+        auto const& animation = document.animations[i];
+        bool valid = true;
+        // Channels without a node or with a missing sampler are skipped by GltfModel, the spec allows the former
+        for (auto const& channel : animation.channels) {
+            valid = valid && (channel.node == -1 || isIndex(channel.node, document.nodes.size()));
+        }
+        for (auto const& sampler : animation.samplers) {
+            valid = valid && isIndex(sampler.input, document.accessors.size()) && isIndex(sampler.output, document.accessors.size());
+        }
+        if (!valid) {
+            LOG_ERROR("Animation %u references a missing node or accessor", i);
+            throw std::runtime_error("glTF animation out of bounds");
+        }
+    }
+
+    // Images stay encoded, GltfModel decodes them on the thread pool
+    for (auto& image : document.images) {
+        if (image.bufferView >= 0 && static_cast<u32>(image.bufferView) < document.bufferViews.size()) {
+            auto const& bufferView = document.bufferViews[image.bufferView];
+            auto begin = document.buffers[bufferView.buffer].data.data() + bufferView.byteOffset;
+            image.data.assign(begin, begin + bufferView.byteLength);
+        } else if (!image.uri.empty()) {
+            loadResource(directory, image.uri, embeddedBuffers, image.data);
+            if (image.uri.compare(0, sizeof(embeddedBufferName) - 1, embeddedBufferName) == 0) {
+                image.uri.clear();
+            }
+        }
+    }
+
+    LOG_DEBUG("%s read", filename.c_str());
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// The parts of a .gltf file GltfModel reads; everything else in the file is skipped while parsing.
+// Indices are -1 when the property is absent.
+struct GltfDocument {
+    struct Buffer {
+        std::string uri;
+        u64 byteLength = 0;
+        std::vector<u8> data;
+    };
+
+    struct BufferView {
+        i32 buffer = -1;
+        u64 byteOffset = 0;
+        u64 byteLength = 0;
+        u32 byteStride = 0;
+    };
+
+    struct Accessor {
+        i32 bufferView = -1;
+        u64 byteOffset = 0;
+        u64 count = 0;
+        u32 componentType = 0;
+        u32 componentCount = 0;
+        bool normalized = false;
+        bool sparse = false;
+    };
+
+    struct Primitive {
+        std::map<std::string, i32> attributes;
+        i32 indices = -1;
+        i32 material = -1;
+    };
+
+    struct Mesh {
+        std::vector<Primitive> primitives;
+    };
+
+    struct Node {
+        i32 mesh = -1;
+        i32 skin = -1;
+        std::vector<i32> children;
+        bool hasMatrix = false;
+        float matrix[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+        float translation[3] = { 0.f, 0.f, 0.f };
+        float rotation[4] = { 0.f, 0.f, 0.f, 1.f };
+        float scale[3] = { 1.f, 1.f, 1.f };
+    };
+
+    struct Scene {
+        std::vector<i32> nodes;
+    };
+
+    struct Material {
+        i32 baseColorTexture = -1;
+    };
+
+    // KHR_texture_basisu names a KTX2 image in its own source, source is then the fallback for viewers without it
+    struct Texture {
+        i32 source = -1;
+        i32 basisuSource = -1;
+    };
+
+    // data holds the encoded file (PNG, JPEG, KTX2, ...) whether it came from a file, a data URI or a buffer view
+    struct Image {
+        std::string uri;
+        std::string mimeType;
+        i32 bufferView = -1;
+        std::vector<u8> data;
+    };
+
+    struct Skin {
+        i32 inverseBindMatrices = -1;
+        std::vector<i32> joints;
+    };
+
+    struct Animation {
+        struct Channel {
+            i32 sampler = -1;
+            i32 node = -1;
+            // "translation", "rotation", "scale" or "weights"
+            std::string path;
+        };
+
+        struct Sampler {
+            i32 input = -1;
+            i32 output = -1;
+            std::string interpolation = "LINEAR";
+        };
+
+        std::string name;
+        std::vector<Channel> channels;
+        std::vector<Sampler> samplers;
+    };
+
+    i32 scene = 0;
+    std::vector<Buffer> buffers;
+    std::vector<BufferView> bufferViews;
+    std::vector<Accessor> accessors;
+    std::vector<Mesh> meshes;
+    std::vector<Node> nodes;
+    std::vector<Scene> scenes;
+    std::vector<Material> materials;
+    std::vector<Texture> textures;
+    std::vector<Image> images;
+    std::vector<Skin> skins;
+    std::vector<Animation> animations;
+};
+
+// Streams the JSON through SAX callbacks straight into the document, without building a DOM first.
+// Embedded base64 buffers are cut out of the text before parsing and decoded with the SIMD decoder,
+// external buffers and images are read relative to the file. Throws on malformed files.
+void readGltf(std::string const& filename, GltfDocument& document);
+// Relative file path of a URI, with its percent escapes decoded, e.g. "a%20b.bin" names "a b.bin"
+std::string decodeUriPath(std::string const& uri);
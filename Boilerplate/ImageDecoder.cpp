@@ -0,0 +1,74 @@
+#include "ImageDecoder.h"
+#include "Logger.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+namespace {
+
+DecodedImage takePixels(u8* pixels, i32 width, i32 height)
+{
+    DecodedImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<u64>(width) * height * STBI_rgb_alpha);
+    memcpy(image.pixels.data(), pixels, image.pixels.size());
+    stbi_image_free(pixels);
+    return image;
+}
+
+}
+
+void ImageDecoder::create(ThreadPool* threadPool)
+{
+    this->threadPool = threadPool;
+}
+
+void ImageDecoder::destroy()
+{
+    threadPool->wait(decodes);
+    threadPool = nullptr;
+}
+
+std::future<DecodedImage> ImageDecoder::decode(std::string filename)
+{
+    auto promise = std::make_shared<std::promise<DecodedImage>>();
+    auto future = promise->get_future();
+    threadPool->submit(decodes, [promise, filename = std::move(filename)]() {
+        try {
+            i32 width, height, channels;
+            auto pixels = stbi_load(filename.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) {
+                LOG_ERROR("Failed to decode %s: %s", filename.c_str(), stbi_failure_reason());
+                throw std::runtime_error("Failed to load texture image");
+            }
+            promise->set_value(takePixels(pixels, width, height));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+std::future<DecodedImage> ImageDecoder::decode(u8 const* data, u64 size)
+{
+    auto promise = std::make_shared<std::promise<DecodedImage>>();
+    auto future = promise->get_future();
+    threadPool->submit(decodes, [promise, data, size]() {
+        try {
+            i32 width, height, channels;
+            auto pixels = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) {
+                LOG_ERROR("Failed to decode image: %s", stbi_failure_reason());
+                throw std::runtime_error("Failed to load texture image");
+            }
+            promise->set_value(takePixels(pixels, width, height));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
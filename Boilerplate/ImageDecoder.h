@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Defines.h"
+#include "ThreadPool.h"
+
+#include <future>
+#include <string>
+#include <vector>
+
+// RGBA8 pixels of a decoded image file
+struct DecodedImage {
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<u8> pixels;
+};
+
+// Decode jobs shared by every texture loader, run on the thread pool's workers. Callers submit all their files first
+// and consume the futures as they become ready, so decodes run side by side and overlap with staging and uploads.
+// get() rethrows a failed decode. Futures must not be waited on from inside thread pool tasks, which could leave no
+// worker free to run the decode.
+class ImageDecoder {
+public:
+    void create(ThreadPool* threadPool);
+    // Waits for the decodes still running
+    void destroy();
+
+    std::future<DecodedImage> decode(std::string filename);
+    // data has to stay valid until the future is ready
+    std::future<DecodedImage> decode(u8 const* data, u64 size);
+
+private:
+    ThreadPool* threadPool = nullptr;
+    ThreadPool::TaskGroup decodes;
+};
@@ -0,0 +1,304 @@
+#include "Ktx2.h"
+#include "BlockCompression.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+u8 const identifier[12] = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+
+struct Header {
+    u8 identifier[12];
+    u32 vkFormat;
+    u32 typeSize;
+    u32 pixelWidth;
+    u32 pixelHeight;
+    u32 pixelDepth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    u64 sgdByteOffset;
+    u64 sgdByteLength;
+};
+static_assert(sizeof(Header) == 80, "KTX2 header is 80 bytes");
+
+// Khronos data format descriptor values
+constexpr u8 modelRgbsda = 1;
+constexpr u8 modelBc1a = 128;
+constexpr u8 modelBc3 = 130;
+constexpr u8 modelBc4 = 131;
+constexpr u8 modelBc5 = 132;
+constexpr u8 modelBc7 = 134;
+constexpr u8 primariesBt709 = 1;
+constexpr u8 transferLinear = 1;
+constexpr u8 transferSrgb = 2;
+constexpr u8 channelAlpha = 15;
+constexpr u8 sampleLinear = 0x10;
+
+struct Sample {
+    u16 bitOffset;
+    u8 bitLength;
+    u8 channelType;
+    u32 upper;
+};
+
+bool isSrgb(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Basic descriptor block of the formats writeKtx2 supports, empty for the others
+std::vector<u8> createDataFormatDescriptor(VkFormat format)
+{
+    u8 model = 0;
+    u32 blockSize = getBlockSize(format);
+    std::vector<Sample> samples;
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        model = modelRgbsda;
+        blockSize = 4;
+        samples = { { 0, 7, 0, 255 }, { 8, 7, 1, 255 }, { 16, 7, 2, 255 }, { 24, 7, static_cast<u8>(channelAlpha | (isSrgb(format) ? sampleLinear : 0)), 255 } };
+        break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        model = modelBc1a;
+        samples = { { 0, 63, 0, ~0u } };
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        model = modelBc3;
+        samples = { { 0, 63, channelAlpha, ~0u }, { 64, 63, 0, ~0u } };
+        break;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        model = modelBc4;
+        samples = { { 0, 63, 0, ~0u } };
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        model = modelBc5;
+        samples = { { 0, 63, 0, ~0u }, { 64, 63, 1, ~0u } };
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        model = modelBc7;
+        samples = { { 0, 127, 0, ~0u } };
+        break;
+    default:
+        return {};
+    }
+
+    u32 blockByteLength = 24 + 16 * static_cast<u32>(samples.size());
+    u32 totalSize = 4 + blockByteLength;
+    std::vector<u8> descriptor(totalSize, 0);
+    auto out = descriptor.data();
+    memcpy(out, &totalSize, 4);
+    // Khronos vendor and basic descriptor type are both 0
+    u32 versionAndSize = 2 | (blockByteLength << 16);
+    memcpy(out + 8, &versionAndSize, 4);
+    out[12] = model;
+    out[13] = primariesBt709;
+    out[14] = isSrgb(format) ? transferSrgb : transferLinear;
+    out[15] = 0;
+    // Texel block dimensions minus one
+    if (getBlockSize(format) != 0) {
+        out[16] = 3;
+        out[17] = 3;
+    }
+    out[20] = static_cast<u8>(blockSize);
+    for (u32 i = 0; i < samples.size(); ++i) {
+        auto sample = out + 28 + 16 * i;
+        memcpy(sample, &samples[i].bitOffset, 2);
+        sample[2] = samples[i].bitLength;
+        sample[3] = samples[i].channelType;
+        memcpy(sample + 12, &samples[i].upper, 4);
+    }
+    return descriptor;
+}
+
+template<typename T>
+void append(std::vector<u8>& data, T const& value)
+{
+    auto bytes = reinterpret_cast<u8 const*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+void alignTo(std::vector<u8>& data, u64 alignment)
+{
+    data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+bool isInside(u64 offset, u64 size, u64 total)
+{
+    return offset <= total && size <= total - offset;
+}
+
+}
+
+bool isKtx2(u8 const* data, u64 size)
+{
+    return size >= sizeof(identifier) && memcmp(data, identifier, sizeof(identifier)) == 0;
+}
+
+bool parseKtx2(u8 const* data, u64 size, Ktx2Texture& texture)
+{
+    if (size < sizeof(Header) || !isKtx2(data, size)) {
+        LOG_ERROR("Not a KTX2 file");
+        return false;
+    }
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+
+    u32 levelCount = std::max(header.levelCount, 1u);
+    if (header.pixelWidth == 0 || header.pixelDepth > 1 || (header.faceCount != 1 && header.faceCount != 6) ||
+        !isInside(sizeof(Header), static_cast<u64>(levelCount) * 24, size) ||
+        !isInside(header.dfdByteOffset, header.dfdByteLength, size) ||
+        !isInside(header.kvdByteOffset, header.kvdByteLength, size) ||
+        !isInside(header.sgdByteOffset, header.sgdByteLength, size)) {
+        LOG_ERROR("Malformed KTX2 header");
+        return false;
+    }
+
+    texture.data = data;
+    texture.size = size;
+    texture.format = static_cast<VkFormat>(header.vkFormat);
+    texture.typeSize = header.typeSize;
+    texture.width = header.pixelWidth;
+    texture.height = std::max(header.pixelHeight, 1u);
+    texture.layerCount = std::max(header.layerCount, 1u);
+    texture.faceCount = header.faceCount;
+    texture.supercompressionScheme = header.supercompressionScheme;
+    texture.dataFormatDescriptor = { header.dfdByteOffset, header.dfdByteLength };
+    texture.keyValueData = { header.kvdByteOffset, header.kvdByteLength };
+    texture.supercompressionGlobalData = { header.sgdByteOffset, header.sgdByteLength };
+
+    texture.levels.resize(levelCount);
+    for (u32 i = 0; i < levelCount; ++i) {
+        memcpy(&texture.levels[i], data + sizeof(Header) + i * 24, 24);
+        if (!isInside(texture.levels[i].offset, texture.levels[i].size, size)) {
+            LOG_ERROR("KTX2 level %u out of bounds", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string getKtx2Value(Ktx2Texture const& texture, std::string const& key)
+{
+    auto begin = texture.data + texture.keyValueData.offset;
+    u64 position = 0;
+    while (position + 4 <= texture.keyValueData.size) {
+        u32 length;
+        memcpy(&length, begin + position, 4);
+        position += 4;
+        if (length > texture.keyValueData.size - position) {
+            break;
+        }
+        auto entry = reinterpret_cast<char const*>(begin + position);
+        auto keyLength = strnlen(entry, length);
+        if (keyLength < length && key.compare(0, std::string::npos, entry, keyLength) == 0) {
+            std::string value(entry + keyLength + 1, length - keyLength - 1);
+            if (!value.empty() && value.back() == '\0') {
+                value.pop_back();
+            }
+            return value;
+        }
+        position += (length + 3) & ~3u;
+    }
+    return {};
+}
+
+bool readKtx2MipChain(Ktx2Texture const& texture, MipChain& chain)
+{
+    if (texture.supercompressionScheme != static_cast<u32>(Ktx2Supercompression::NONE) || texture.layerCount != 1 || texture.faceCount != 1) {
+        LOG_ERROR("Only uncompressed 2D KTX2 textures can be read into a mip chain");
+        return false;
+    }
+
+    chain.format = texture.format;
+    chain.width = texture.width;
+    chain.height = texture.height;
+    chain.offsets.resize(texture.levels.size());
+    u64 size = 0;
+    for (u32 i = 0; i < texture.levels.size(); ++i) {
+        chain.offsets[i] = size;
+        size += texture.levels[i].size;
+    }
+    chain.pixels.resize(size);
+    for (u32 i = 0; i < texture.levels.size(); ++i) {
+        memcpy(chain.pixels.data() + chain.offsets[i], texture.data + texture.levels[i].offset, texture.levels[i].size);
+    }
+    return true;
+}
+
+std::vector<u8> writeKtx2(MipChain const& chain, std::vector<std::pair<std::string, std::string>> keyValues)
+{
+    auto descriptor = createDataFormatDescriptor(chain.format);
+    if (descriptor.empty()) {
+        LOG_ERROR("No KTX2 data format descriptor for format %d", chain.format);
+        return {};
+    }
+
+    keyValues.emplace_back("KTXwriter", "LearningVulkan");
+    std::sort(keyValues.begin(), keyValues.end());
+
+    u32 levelCount = static_cast<u32>(chain.offsets.size());
+    Header header = {};
+    memcpy(header.identifier, identifier, sizeof(identifier));
+    header.vkFormat = chain.format;
+    header.typeSize = 1;
+    header.pixelWidth = chain.width;
+    header.pixelHeight = chain.height;
+    header.pixelDepth = 0;
+    header.layerCount = 0;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.supercompressionScheme = static_cast<u32>(Ktx2Supercompression::NONE);
+
+    std::vector<u8> file(sizeof(Header) + levelCount * 24, 0);
+    header.dfdByteOffset = static_cast<u32>(file.size());
+    header.dfdByteLength = static_cast<u32>(descriptor.size());
+    file.insert(file.end(), descriptor.begin(), descriptor.end());
+
+    header.kvdByteOffset = static_cast<u32>(file.size());
+    for (auto const& [key, value] : keyValues) {
+        append(file, static_cast<u32>(key.size() + 1 + value.size() + 1));
+        file.insert(file.end(), key.begin(), key.end());
+        file.push_back(0);
+        file.insert(file.end(), value.begin(), value.end());
+        file.push_back(0);
+        alignTo(file, 4);
+    }
+    header.kvdByteLength = static_cast<u32>(file.size() - header.kvdByteOffset);
+
+    // Levels from the smallest up, each aligned to the least common multiple of the texel block size and 4
+    auto blockSize = getBlockSize(chain.format);
+    u64 alignment = blockSize != 0 ? blockSize : 4;
+    std::vector<Ktx2Texture::Level> levels(levelCount);
+    for (u32 i = levelCount; i-- > 0;) {
+        auto end = i + 1 < levelCount ? chain.offsets[i + 1] : chain.pixels.size();
+        alignTo(file, alignment);
+        levels[i].offset = file.size();
+        levels[i].size = end - chain.offsets[i];
+        levels[i].uncompressedSize = levels[i].size;
+        file.insert(file.end(), chain.pixels.begin() + chain.offsets[i], chain.pixels.begin() + end);
+    }
+
+    memcpy(file.data(), &header, sizeof(Header));
+    memcpy(file.data() + sizeof(Header), levels.data(), levelCount * 24);
+    return file;
+}
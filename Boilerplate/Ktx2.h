@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Defines.h"
+#include "MipChain.h"
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// KTX 2.0 texture container: header, level index, data format descriptor, key/value data, optional
+// supercompression global data, then the levels from the smallest to the largest.
+// Parsing only references the file's memory, which has to outlive the Ktx2Texture.
+struct Ktx2Texture {
+    struct Range {
+        u64 offset = 0;
+        u64 size = 0;
+    };
+
+    struct Level {
+        u64 offset = 0;
+        u64 size = 0;
+        u64 uncompressedSize = 0;
+    };
+
+    u8 const* data = nullptr;
+    u64 size = 0;
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    u32 typeSize = 0;
+    u32 width = 0;
+    u32 height = 0;
+    u32 layerCount = 0;
+    u32 faceCount = 0;
+    u32 supercompressionScheme = 0;
+    // levels[0] is the finest
+    std::vector<Level> levels;
+    Range dataFormatDescriptor;
+    Range keyValueData;
+    Range supercompressionGlobalData;
+};
+
+enum class Ktx2Supercompression : u32 {
+    NONE = 0,
+    BASIS_LZ = 1,
+    ZSTANDARD = 2,
+    ZLIB = 3
+};
+
+bool isKtx2(u8 const* data, u64 size);
+// Validates the header and that every range lies within the data
+bool parseKtx2(u8 const* data, u64 size, Ktx2Texture& texture);
+// Value of a key/value entry without its terminating zero, empty when the key is missing
+std::string getKtx2Value(Ktx2Texture const& texture, std::string const& key);
+// Copies the levels of a 2D texture without supercompression into chain
+bool readKtx2MipChain(Ktx2Texture const& texture, MipChain& chain);
+
+// 2D texture of the chain's levels with a data format descriptor for RGBA8 and the BCn formats the cooker writes
+std::vector<u8> writeKtx2(MipChain const& chain, std::vector<std::pair<std::string, std::string>> keyValues = {});
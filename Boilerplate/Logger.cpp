@@ -1,6 +1,7 @@
 #include "Logger.h"
 
 #include <cstdarg>
+#include <cstring>
 #include <iostream>
 #include <string>
 
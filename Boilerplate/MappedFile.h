@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <string>
+
+// Read-only view of a whole file mapped into the address space
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile() { close(); }
+
+    // Returns false if the file does not exist or cannot be mapped
+    bool open(std::string const& filename);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    u8 const* getData() const { return data; }
+    u64 getSize() const { return size; }
+
+private:
+    void* file = nullptr;
+    void* mapping = nullptr;
+    u8 const* data = nullptr;
+    u64 size = 0;
+};
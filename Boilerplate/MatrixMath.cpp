@@ -0,0 +1,65 @@
+#include "MatrixMath.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(MATRIX_SSE)
+// Every result column is a linear combination of the columns of a, weighted by the matching column of b
+static inline void multiplySimd(float const* a, float const* b, float* result)
+{
+    auto a0 = _mm_loadu_ps(a + 0);
+    auto a1 = _mm_loadu_ps(a + 4);
+    auto a2 = _mm_loadu_ps(a + 8);
+    auto a3 = _mm_loadu_ps(a + 12);
+    __m128 columns[4];
+    for (u32 j = 0; j < 4; ++j) {
+        auto column = _mm_mul_ps(a0, _mm_set1_ps(b[j * 4 + 0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[j * 4 + 1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[j * 4 + 2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[j * 4 + 3])));
+        columns[j] = column;
+    }
+    // Stores only after all loads, so result can be a or b
+    for (u32 j = 0; j < 4; ++j) {
+        _mm_storeu_ps(result + j * 4, columns[j]);
+    }
+}
+#endif
+
+void multiplyMatrix(glm::mat4 const& a, glm::mat4 const& b, glm::mat4& result)
+{
+#if defined(MATRIX_SSE)
+    multiplySimd(&a[0][0], &b[0][0], &result[0][0]);
+#else
+    result = a * b;
+#endif
+}
+
+void multiplyMatrices(glm::mat4 const* a, glm::mat4 const* b, glm::mat4* result, u64 count)
+{
+    for (u64 i = 0; i < count; ++i) {
+#if defined(MATRIX_SSE)
+        multiplySimd(&a[i][0][0], &b[i][0][0], &result[i][0][0]);
+#else
+        result[i] = a[i] * b[i];
+#endif
+    }
+}
+
+void multiplyHierarchy(glm::mat4 const* locals, u32 const* nodes, i32 const* parents, u64 count, glm::mat4* globals)
+{
+    for (u64 i = 0; i < count; ++i) {
+        auto node = nodes[i];
+        if (parents[i] == -1) {
+            globals[node] = locals[node];
+            continue;
+        }
+#if defined(MATRIX_SSE)
+        multiplySimd(&globals[parents[i]][0][0], &locals[node][0][0], &globals[node][0][0]);
+#else
+        globals[node] = globals[parents[i]] * locals[node];
+#endif
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+
+// Column-major 4x4 products with SSE where the compiler targets it, scalar glm otherwise.
+// result may alias either operand.
+void multiplyMatrix(glm::mat4 const& a, glm::mat4 const& b, glm::mat4& result);
+
+// result[i] = a[i] * b[i]
+void multiplyMatrices(glm::mat4 const* a, glm::mat4 const* b, glm::mat4* result, u64 count);
+
+// Global transforms of a run of nodes in parent before child order: globals[nodes[i]] = globals[parents[i]] * locals[nodes[i]],
+// nodes with parent -1 take their local transform
+void multiplyHierarchy(glm::mat4 const* locals, u32 const* nodes, i32 const* parents, u64 count, glm::mat4* globals);
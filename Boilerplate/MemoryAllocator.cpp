@@ -0,0 +1,321 @@
+#include "MemoryAllocator.h"
+#include "Logger.h"
+#include "Utils.h"
+#include "ThirdParty/nlohmann/json.hpp"
+
+#include <algorithm>
+
+char const* memoryCategoryToString(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::VERTEX:
+        return "vertex";
+    case MemoryCategory::INDEX:
+        return "index";
+    case MemoryCategory::UNIFORM:
+        return "uniform";
+    case MemoryCategory::STORAGE:
+        return "storage";
+    case MemoryCategory::STAGING:
+        return "staging";
+    case MemoryCategory::TEXTURE:
+        return "texture";
+    case MemoryCategory::ATTACHMENT:
+        return "attachment";
+    default:
+        return "other";
+    }
+}
+
+void MemoryAllocator::create(Context const& globals, VkDeviceSize preferredBlockSize)
+{
+    this->preferredBlockSize = preferredBlockSize;
+    bufferImageGranularity = globals.device.support.properties.limits.bufferImageGranularity;
+    pools.resize(globals.device.support.memoryProperties.memoryTypeCount);
+
+    typeStats.resize(globals.device.support.memoryProperties.memoryTypeCount);
+    for (u32 i = 0; i < typeStats.size(); ++i) {
+        typeStats[i].heapIndex = globals.device.support.memoryProperties.memoryTypes[i].heapIndex;
+        typeStats[i].propertyFlags = globals.device.support.memoryProperties.memoryTypes[i].propertyFlags;
+    }
+    LOG_DEBUG("Memory allocator successfully created");
+}
+
+void MemoryAllocator::destroy(Context const& globals)
+{
+    for (u32 i = 0; i < pools.size(); ++i) {
+        for (auto& block : pools[i]) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            if (!block.tlsf.isEmpty()) {
+                LOG_WARNING("Memory type %u: %u allocations still alive", i, block.tlsf.getAllocationCount());
+            }
+            freeDeviceMemory(globals, block.size, i, block.memory, block.mapped);
+        }
+    }
+    pools.clear();
+    typeStats.clear();
+    categoryStats = {};
+    LOG_DEBUG("Memory allocator destroyed");
+}
+
+void MemoryAllocator::allocate(Context const& globals, VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, Allocation& allocation)
+{
+    auto memoryTypeIndex = findMemoryTypeIndex(globals, requirements, properties);
+    if (memoryTypeIndex == ~0u) {
+        throw std::runtime_error("Failed to find suitable memory type");
+    }
+
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.size = requirements.size;
+    allocation.category = category;
+
+    auto blockSize = calculateBlockSize(globals, memoryTypeIndex);
+    if (requirements.size > blockSize / 2) {
+        allocation.offset = 0;
+        allocation.block = ~0u;
+        allocation.node = ~0u;
+        allocateDeviceMemory(globals, requirements.size, memoryTypeIndex, allocation.memory, allocation.mapped);
+        track(allocation, true);
+        return;
+    }
+
+    // Buffers and optimal images may end up next to each other inside a block
+    auto alignment = std::max(requirements.alignment, bufferImageGranularity);
+
+    auto& pool = pools[memoryTypeIndex];
+    for (u32 i = 0; i < pool.size(); ++i) {
+        if (pool[i].memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        u64 offset;
+        auto node = pool[i].tlsf.allocate(requirements.size, alignment, offset);
+        if (node != TlsfAllocator::invalidNode) {
+            allocation.memory = pool[i].memory;
+            allocation.offset = offset;
+            allocation.block = i;
+            allocation.node = node;
+            allocation.mapped = pool[i].mapped ? static_cast<u8*>(pool[i].mapped) + offset : nullptr;
+            track(allocation, true);
+            return;
+        }
+    }
+
+    u32 blockIndex = 0;
+    while (blockIndex < pool.size() && pool[blockIndex].memory != VK_NULL_HANDLE) {
+        ++blockIndex;
+    }
+    if (blockIndex == pool.size()) {
+        pool.emplace_back();
+    }
+
+    auto& block = pool[blockIndex];
+    allocateDeviceMemory(globals, blockSize, memoryTypeIndex, block.memory, block.mapped);
+    block.size = blockSize;
+    block.tlsf.init(blockSize);
+    LOG_DEBUG("Memory type %u: block %u allocated (%llu bytes)", memoryTypeIndex, blockIndex, static_cast<unsigned long long>(blockSize));
+
+    u64 offset;
+    auto node = block.tlsf.allocate(requirements.size, alignment, offset);
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.block = blockIndex;
+    allocation.node = node;
+    allocation.mapped = block.mapped ? static_cast<u8*>(block.mapped) + offset : nullptr;
+    track(allocation, true);
+}
+
+void MemoryAllocator::free(Context const& globals, Allocation const& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    track(allocation, false);
+
+    if (allocation.block == ~0u) {
+        freeDeviceMemory(globals, allocation.size, allocation.memoryTypeIndex, allocation.memory, allocation.mapped);
+        return;
+    }
+
+    auto& pool = pools[allocation.memoryTypeIndex];
+    auto& block = pool[allocation.block];
+    block.tlsf.free(allocation.node);
+    if (!block.tlsf.isEmpty()) {
+        return;
+    }
+
+    // One empty block per memory type stays, so a resource that is created and destroyed over and over in an
+    // otherwise unused type does not allocate and free a whole block every time
+    bool keep = true;
+    for (u32 i = 0; i < pool.size(); ++i) {
+        if (i != allocation.block && pool[i].memory != VK_NULL_HANDLE && pool[i].tlsf.isEmpty()) {
+            keep = false;
+            break;
+        }
+    }
+    if (!keep) {
+        freeDeviceMemory(globals, block.size, allocation.memoryTypeIndex, block.memory, block.mapped);
+        block.memory = VK_NULL_HANDLE;
+        block.mapped = nullptr;
+        LOG_DEBUG("Memory type %u: block %u released", allocation.memoryTypeIndex, allocation.block);
+    }
+}
+
+MemoryStats MemoryAllocator::getStats(Context const& globals) const
+{
+    MemoryStats stats;
+    stats.types = typeStats;
+    stats.categories = categoryStats;
+
+    stats.heaps.resize(globals.device.support.memoryProperties.memoryHeapCount);
+    for (auto const& type : typeStats) {
+        auto& heap = stats.heaps[type.heapIndex];
+        heap.blockBytes += type.blockBytes;
+        heap.usage.allocationCount += type.usage.allocationCount;
+        heap.usage.allocationBytes += type.usage.allocationBytes;
+    }
+    queryBudget(globals, stats.heaps);
+
+    return stats;
+}
+
+std::string MemoryAllocator::dumpStats(Context const& globals) const
+{
+    auto stats = getStats(globals);
+
+    nlohmann::json json;
+    json["heaps"] = nlohmann::json::array();
+    for (auto const& heap : stats.heaps) {
+        json["heaps"].push_back({
+            { "size", heap.size },
+            { "budget", heap.budget },
+            { "processUsage", heap.processUsage },
+            { "blockBytes", heap.blockBytes },
+            { "allocationCount", heap.usage.allocationCount },
+            { "allocationBytes", heap.usage.allocationBytes } });
+    }
+    json["types"] = nlohmann::json::array();
+    for (auto const& type : stats.types) {
+        json["types"].push_back({
+            { "heapIndex", type.heapIndex },
+            { "propertyFlags", type.propertyFlags },
+            { "blockCount", type.blockCount },
+            { "blockBytes", type.blockBytes },
+            { "allocationCount", type.usage.allocationCount },
+            { "allocationBytes", type.usage.allocationBytes } });
+    }
+    json["categories"] = nlohmann::json::object();
+    for (u32 i = 0; i < stats.categories.size(); ++i) {
+        json["categories"][memoryCategoryToString(static_cast<MemoryCategory>(i))] = {
+            { "allocationCount", stats.categories[i].allocationCount },
+            { "allocationBytes", stats.categories[i].allocationBytes } };
+    }
+
+    return json.dump(4);
+}
+
+void MemoryAllocator::queryBudget(Context const& globals, std::vector<MemoryStats::Heap>& heaps) const
+{
+    auto const& memoryProperties = globals.device.support.memoryProperties;
+    for (u32 i = 0; i < heaps.size(); ++i) {
+        heaps[i].size = memoryProperties.memoryHeaps[i].size;
+        heaps[i].budget = memoryProperties.memoryHeaps[i].size;
+        heaps[i].processUsage = heaps[i].blockBytes;
+    }
+
+    if (!globals.device.support.memoryBudget) {
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    budgetProperties.pNext = nullptr;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(globals.device.physicalDevice, &memoryProperties2);
+
+    for (u32 i = 0; i < heaps.size(); ++i) {
+        heaps[i].budget = budgetProperties.heapBudget[i];
+        heaps[i].processUsage = budgetProperties.heapUsage[i];
+    }
+}
+
+void MemoryAllocator::track(Allocation const& allocation, bool allocated)
+{
+    auto& type = typeStats[allocation.memoryTypeIndex].usage;
+    auto& category = categoryStats[static_cast<size_t>(allocation.category)];
+    if (allocated) {
+        ++type.allocationCount;
+        type.allocationBytes += allocation.size;
+        ++category.allocationCount;
+        category.allocationBytes += allocation.size;
+    } else {
+        --type.allocationCount;
+        type.allocationBytes -= allocation.size;
+        --category.allocationCount;
+        category.allocationBytes -= allocation.size;
+    }
+}
+
+VkDeviceSize MemoryAllocator::calculateBlockSize(Context const& globals, u32 memoryTypeIndex) const
+{
+    auto heapIndex = globals.device.support.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    auto heapSize = globals.device.support.memoryProperties.memoryHeaps[heapIndex].size;
+
+    // Small heaps (e.g. the 256 MiB BAR window) should not be eaten by a couple of blocks
+    return std::min(preferredBlockSize, heapSize / 8);
+}
+
+void MemoryAllocator::allocateDeviceMemory(Context const& globals, VkDeviceSize size, u32 memoryTypeIndex, VkDeviceMemory& memory, void*& mapped)
+{
+    // Catch over-subscription here rather than when the driver starts paging
+    auto heapIndex = typeStats[memoryTypeIndex].heapIndex;
+    std::vector<MemoryStats::Heap> heaps(globals.device.support.memoryProperties.memoryHeapCount);
+    for (auto const& type : typeStats) {
+        heaps[type.heapIndex].blockBytes += type.blockBytes;
+    }
+    queryBudget(globals, heaps);
+    if (heaps[heapIndex].processUsage + size > heaps[heapIndex].budget) {
+        LOG_WARNING("Memory heap %u: allocating %llu bytes exceeds the budget (%llu of %llu bytes used)",
+            heapIndex,
+            static_cast<unsigned long long>(size),
+            static_cast<unsigned long long>(heaps[heapIndex].processUsage),
+            static_cast<unsigned long long>(heaps[heapIndex].budget));
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext = nullptr;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+    THROW_IF_FAILED(
+        vkAllocateMemory(globals.device.handle, &allocateInfo, globals.allocator, &memory),
+        __FILE__, __LINE__,
+        "Failed to allocate memory");
+
+    mapped = nullptr;
+    if (globals.device.support.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        THROW_IF_FAILED(
+            vkMapMemory(globals.device.handle, memory, 0, VK_WHOLE_SIZE, 0, &mapped),
+            __FILE__, __LINE__,
+            "Failed to map memory");
+    }
+
+    ++typeStats[memoryTypeIndex].blockCount;
+    typeStats[memoryTypeIndex].blockBytes += size;
+}
+
+void MemoryAllocator::freeDeviceMemory(Context const& globals, VkDeviceSize size, u32 memoryTypeIndex, VkDeviceMemory memory, void* mapped)
+{
+    --typeStats[memoryTypeIndex].blockCount;
+    typeStats[memoryTypeIndex].blockBytes -= size;
+
+    if (mapped) {
+        vkUnmapMemory(globals.device.handle, memory);
+    }
+    vkFreeMemory(globals.device.handle, memory, globals.allocator);
+}
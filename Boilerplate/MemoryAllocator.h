@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Defines.h"
+#include "Structures.h"
+#include "TlsfAllocator.h"
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <string>
+#include <vector>
+
+struct MemoryStats {
+    struct Usage {
+        u32 allocationCount = 0;
+        VkDeviceSize allocationBytes = 0;
+    };
+
+    struct Type {
+        u32 heapIndex = 0;
+        VkMemoryPropertyFlags propertyFlags = 0;
+        // Device memory owned by the allocator, including dedicated allocations
+        u32 blockCount = 0;
+        VkDeviceSize blockBytes = 0;
+        Usage usage;
+    };
+
+    struct Heap {
+        VkDeviceSize size = 0;
+        // Reported by VK_EXT_memory_budget for the whole process, falls back to size and blockBytes
+        VkDeviceSize budget = 0;
+        VkDeviceSize processUsage = 0;
+        VkDeviceSize blockBytes = 0;
+        Usage usage;
+    };
+
+    std::vector<Type> types;
+    std::vector<Heap> heaps;
+    std::array<Usage, static_cast<size_t>(MemoryCategory::COUNT)> categories = {};
+};
+
+char const* memoryCategoryToString(MemoryCategory category);
+
+// Suballocates buffers and images from large VkDeviceMemory blocks, one pool per memory type.
+// Host visible blocks stay mapped for their whole lifetime. Emptied blocks are released, except one per memory type.
+class MemoryAllocator {
+public:
+    void create(Context const& globals, VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024);
+    void destroy(Context const& globals);
+
+    void allocate(Context const& globals, VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, Allocation& allocation);
+    void free(Context const& globals, Allocation const& allocation);
+
+    // Queries the budget of every heap, so keep it out of per allocation paths
+    MemoryStats getStats(Context const& globals) const;
+    // JSON with the same content as getStats()
+    std::string dumpStats(Context const& globals) const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        TlsfAllocator tlsf;
+    };
+
+    VkDeviceSize preferredBlockSize = 0;
+    VkDeviceSize bufferImageGranularity = 1;
+    std::vector<std::vector<Block>> pools;
+
+    std::vector<MemoryStats::Type> typeStats;
+    std::array<MemoryStats::Usage, static_cast<size_t>(MemoryCategory::COUNT)> categoryStats = {};
+
+    VkDeviceSize calculateBlockSize(Context const& globals, u32 memoryTypeIndex) const;
+    void queryBudget(Context const& globals, std::vector<MemoryStats::Heap>& heaps) const;
+    void track(Allocation const& allocation, bool allocated);
+    void allocateDeviceMemory(Context const& globals, VkDeviceSize size, u32 memoryTypeIndex, VkDeviceMemory& memory, void*& mapped);
+    void freeDeviceMemory(Context const& globals, VkDeviceSize size, u32 memoryTypeIndex, VkDeviceMemory memory, void* mapped);
+};
@@ -0,0 +1,186 @@
+#include "MeshCache.h"
+#include "Logger.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+bool MeshCache::open(std::string const& filename, std::string const& sourceFilename, u64 settings)
+{
+    close();
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    auto data = file.getData();
+    auto size = file.getSize();
+    Header header;
+    if (size < sizeof(header)) {
+        LOG_WARNING("Mesh cache %s is truncated", filename.c_str());
+        close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != magic || header.version != version) {
+        LOG_INFO("Mesh cache %s was written by another version", filename.c_str());
+        close();
+        return false;
+    }
+    if (header.settings != settings) {
+        LOG_INFO("Mesh cache %s was cooked with other settings", filename.c_str());
+        close();
+        return false;
+    }
+    if (sizeof(header) + static_cast<u64>(header.chunkCount) * sizeof(ChunkEntry) > size) {
+        LOG_WARNING("Mesh cache %s is truncated", filename.c_str());
+        close();
+        return false;
+    }
+
+    for (u32 i = 0; i < header.chunkCount; ++i) {
+        ChunkEntry entry;
+        memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        if (entry.id >= static_cast<u32>(Chunk::COUNT) || entry.offset % alignment != 0 || entry.offset > size || entry.size > size - entry.offset) {
+            LOG_WARNING("Mesh cache %s has an invalid chunk table", filename.c_str());
+            close();
+            return false;
+        }
+        chunks[entry.id].data = data + entry.offset;
+        chunks[entry.id].size = entry.size;
+    }
+
+    // The SOURCES chunk is a list of zero terminated paths
+    std::vector<std::string> dependencies;
+    auto sources = getChunk(Chunk::SOURCES);
+    for (u64 begin = 0; begin < sources.size;) {
+        auto name = reinterpret_cast<char const*>(sources.data) + begin;
+        auto length = strnlen(name, sources.size - begin);
+        dependencies.emplace_back(name, length);
+        begin += length + 1;
+    }
+
+    u64 sourceHash = 0;
+    if (!hashSources(sourceFilename, dependencies, sourceHash) || sourceHash != header.sourceHash) {
+        LOG_INFO("Mesh cache %s is out of date", filename.c_str());
+        close();
+        return false;
+    }
+
+    LOG_DEBUG("Mesh cache %s opened", filename.c_str());
+    return true;
+}
+
+void MeshCache::close()
+{
+    file.close();
+    for (auto& chunk : chunks) {
+        chunk = View();
+    }
+}
+
+MeshCache::View MeshCache::getChunk(Chunk chunk) const
+{
+    return chunks[static_cast<u32>(chunk)];
+}
+
+void MeshCache::addChunk(Chunk chunk, void const* data, u64 size)
+{
+    View view;
+    view.data = static_cast<u8 const*>(data);
+    view.size = size;
+    pendingChunks.emplace_back(chunk, view);
+}
+
+bool MeshCache::write(std::string const& filename, std::string const& sourceFilename, std::vector<std::string> const& dependencies, u64 settings)
+{
+    std::vector<char> sources;
+    for (auto const& dependency : dependencies) {
+        sources.insert(sources.end(), dependency.begin(), dependency.end());
+        sources.push_back('\0');
+    }
+    addChunk(Chunk::SOURCES, sources.data(), sources.size());
+
+    Header header;
+    header.magic = magic;
+    header.version = version;
+    header.settings = settings;
+    header.chunkCount = static_cast<u32>(pendingChunks.size());
+    if (!hashSources(sourceFilename, dependencies, header.sourceHash)) {
+        pendingChunks.clear();
+        return false;
+    }
+
+    std::vector<ChunkEntry> entries(pendingChunks.size());
+    u64 offset = sizeof(header) + entries.size() * sizeof(ChunkEntry);
+    for (u32 i = 0; i < pendingChunks.size(); ++i) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        entries[i].id = static_cast<u32>(pendingChunks[i].first);
+        entries[i].offset = offset;
+        entries[i].size = pendingChunks[i].second.size;
+        offset += entries[i].size;
+    }
+
+    // Written next to the destination and renamed, so a cache is never seen half written
+    auto temporaryFilename = filename + ".tmp";
+    {
+        std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+        char const zeros[alignment] = {};
+        u64 position = sizeof(header) + entries.size() * sizeof(ChunkEntry);
+        for (u32 i = 0; i < pendingChunks.size(); ++i) {
+            stream.write(zeros, entries[i].offset - position);
+            stream.write(reinterpret_cast<char const*>(pendingChunks[i].second.data), entries[i].size);
+            position = entries[i].offset + entries[i].size;
+        }
+        if (!stream) {
+            LOG_WARNING("Failed to write mesh cache %s", temporaryFilename.c_str());
+            pendingChunks.clear();
+            return false;
+        }
+    }
+    pendingChunks.clear();
+
+    std::remove(filename.c_str());
+    if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0) {
+        LOG_WARNING("Failed to replace mesh cache %s", filename.c_str());
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    LOG_DEBUG("Mesh cache %s written", filename.c_str());
+    return true;
+}
+
+u64 MeshCache::hash(void const* data, u64 size, u64 seed)
+{
+    auto bytes = static_cast<u8 const*>(data);
+    auto result = seed;
+    for (u64 i = 0; i < size; ++i) {
+        result = (result ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return result;
+}
+
+bool MeshCache::hashSources(std::string const& sourceFilename, std::vector<std::string> const& dependencies, u64& result)
+{
+    MappedFile source;
+    if (!source.open(sourceFilename)) {
+        LOG_WARNING("Failed to open %s", sourceFilename.c_str());
+        return false;
+    }
+    result = hash(source.getData(), source.getSize());
+
+    auto directory = sourceFilename.substr(0, sourceFilename.find_last_of("/\\") + 1);
+    for (auto const& dependency : dependencies) {
+        MappedFile file;
+        if (!file.open(directory + dependency)) {
+            LOG_WARNING("Failed to open %s", (directory + dependency).c_str());
+            return false;
+        }
+        result = hash(dependency.data(), dependency.size(), result);
+        result = hash(file.getData(), file.getSize(), result);
+    }
+
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Defines.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+
+// Cooked model file: a header, a chunk table and 64 byte aligned chunks that are used in place from the mapped file.
+// The header stores a hash of the source file and of every file it references (listed in the SOURCES chunk),
+// a cache whose sources changed, that was written by another version or cooked with other settings fails to open
+// and has to be cooked again.
+class MeshCache {
+public:
+    enum class Chunk : u32 {
+        SOURCES,
+        NODES,
+        MESHES,
+        PRIMITIVES,
+        MATERIALS,
+        POSITIONS,
+        NORMALS,
+        TANGENTS,
+        TEX_COORDS,
+        COLORS,
+        JOINTS,
+        WEIGHTS,
+        INDICES,
+        IMAGES,
+        IMAGE_RANGES,
+        SKINS,
+        SKIN_JOINTS,
+        INVERSE_BIND_MATRICES,
+        ANIMATION_CLIPS,
+        ANIMATION_TRACKS,
+        ANIMATION_TIMES,
+        ANIMATION_VALUES,
+        COUNT
+    };
+
+    struct View {
+        u8 const* data = nullptr;
+        u64 size = 0;
+    };
+
+    static constexpr u32 magic = 0x434d564c; // "LVMC"
+    static constexpr u32 version = 9;
+    static constexpr u32 alignment = 64;
+
+    // sourceFilename is the file the cache was cooked from; dependencies are resolved relative to its directory.
+    // settings are whatever else the cooked data depends on, e.g. the texture formats of the device it was cooked on
+    bool open(std::string const& filename, std::string const& sourceFilename, u64 settings);
+    void close();
+
+    View getChunk(Chunk chunk) const;
+    // Elements of a chunk written with addArray, nullptr if the chunk is missing or its size does not fit T
+    template<typename T>
+    T const* getArray(Chunk chunk, u64& count) const
+    {
+        auto view = getChunk(chunk);
+        count = view.size / sizeof(T);
+        return view.size % sizeof(T) == 0 ? reinterpret_cast<T const*>(view.data) : nullptr;
+    }
+
+    // Chunks are referenced, not copied, the data has to stay alive until write returns
+    void addChunk(Chunk chunk, void const* data, u64 size);
+    template<typename T>
+    void addArray(Chunk chunk, std::vector<T> const& array)
+    {
+        addChunk(chunk, array.data(), array.size() * sizeof(T));
+    }
+    // dependencies are paths relative to the source file, e.g. external buffers and images
+    bool write(std::string const& filename, std::string const& sourceFilename, std::vector<std::string> const& dependencies, u64 settings);
+
+    // 64 bit FNV-1a
+    static u64 hash(void const* data, u64 size, u64 seed = 0xcbf29ce484222325ull);
+
+private:
+    struct Header {
+        u32 magic = 0;
+        u32 version = 0;
+        u64 sourceHash = 0;
+        u64 settings = 0;
+        u32 chunkCount = 0;
+        u32 padding = 0;
+    };
+
+    struct ChunkEntry {
+        u32 id = 0;
+        u32 padding = 0;
+        u64 offset = 0;
+        u64 size = 0;
+    };
+
+    MappedFile file;
+    View chunks[static_cast<u32>(Chunk::COUNT)];
+    std::vector<std::pair<Chunk, View>> pendingChunks;
+
+    static bool hashSources(std::string const& sourceFilename, std::vector<std::string> const& dependencies, u64& result);
+};
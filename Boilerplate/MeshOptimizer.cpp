@@ -0,0 +1,353 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Triangles around each vertex in one array, the triangles of vertex v are triangles[offsets[v], offsets[v + 1])
+struct VertexTriangles {
+    std::vector<u32> offsets;
+    std::vector<u32> triangles;
+};
+
+template<typename T>
+static VertexTriangles buildVertexTriangles(T const* indices, u64 indexCount, u32 vertexCount)
+{
+    VertexTriangles adjacency;
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (u64 i = 0; i < indexCount; ++i) {
+        ++adjacency.offsets[indices[i] + 1];
+    }
+    for (u32 v = 0; v < vertexCount; ++v) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    adjacency.triangles.resize(indexCount);
+    std::vector<u32> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (u64 i = 0; i < indexCount; ++i) {
+        adjacency.triangles[cursors[indices[i]]++] = u32(i / 3);
+    }
+    return adjacency;
+}
+
+// A FIFO cache of size k holds exactly the vertices transformed during the last k misses,
+// so a timestamp per vertex replaces the queue
+struct FifoCache {
+    std::vector<u32> timestamps;
+    u32 time;
+    u32 size;
+
+    FifoCache(u32 vertexCount, u32 cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    bool contains(u32 vertex) const { return time - timestamps[vertex] < size; }
+
+    // Returns true on a miss
+    bool access(u32 vertex)
+    {
+        if (contains(vertex)) {
+            return false;
+        }
+        timestamps[vertex] = ++time;
+        return true;
+    }
+};
+
+template<typename T>
+static VertexCacheStatistics analyzeVertexCacheImpl(T const* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    VertexCacheStatistics statistics;
+    statistics.triangleCount = u32(indexCount / 3);
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    for (u64 i = 0; i < indexCount; ++i) {
+        if (cache.access(indices[i])) {
+            ++statistics.vertexTransforms;
+        }
+        if (!referenced[indices[i]]) {
+            referenced[indices[i]] = true;
+            ++statistics.vertexCount;
+        }
+    }
+    return statistics;
+}
+
+template<typename T>
+static u32 weldVerticesImpl(T* indices, u64 indexCount, u32 vertexCount, std::vector<VertexStream> const& streams)
+{
+    auto hashVertex = [&](u32 vertex) {
+        u64 hash = 14695981039346656037ull;
+        for (auto const& stream : streams) {
+            auto bytes = static_cast<u8 const*>(stream.data) + u64(vertex) * stream.size;
+            for (u32 i = 0; i < stream.size; ++i) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+        return hash;
+    };
+    auto equalVertices = [&](u32 a, u32 b) {
+        for (auto const& stream : streams) {
+            auto bytes = static_cast<u8 const*>(stream.data);
+            if (memcmp(bytes + u64(a) * stream.size, bytes + u64(b) * stream.size, stream.size) != 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Open addressing over vertex ids, at most half full
+    constexpr u32 empty = ~0u;
+    u64 tableSize = 1;
+    while (tableSize < u64(vertexCount) * 2) {
+        tableSize *= 2;
+    }
+    std::vector<u32> table(tableSize, empty);
+    std::vector<u32> canonical(vertexCount);
+    u32 uniqueCount = 0;
+    for (u32 vertex = 0; vertex < vertexCount; ++vertex) {
+        auto slot = hashVertex(vertex) & (tableSize - 1);
+        while (table[slot] != empty && !equalVertices(table[slot], vertex)) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == empty) {
+            table[slot] = vertex;
+            ++uniqueCount;
+        }
+        canonical[vertex] = table[slot];
+    }
+
+    for (u64 i = 0; i < indexCount; ++i) {
+        indices[i] = T(canonical[indices[i]]);
+    }
+    return uniqueCount;
+}
+
+template<typename T>
+static void optimizeVertexCacheImpl(T* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    auto triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) {
+        return;
+    }
+
+    auto adjacency = buildVertexTriangles(indices, indexCount, vertexCount);
+    std::vector<u32> liveTriangles(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v) {
+        liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    std::vector<T> output;
+    output.reserve(triangleCount * 3);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> deadEnds;
+    std::vector<u32> candidates;
+    FifoCache cache(vertexCount, cacheSize);
+    u32 cursor = 0;
+    constexpr u32 none = ~0u;
+
+    auto skipDeadEnd = [&]() -> u32 {
+        while (!deadEnds.empty()) {
+            auto vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0) {
+                return vertex;
+            }
+        }
+        for (; cursor < vertexCount; ++cursor) {
+            if (liveTriangles[cursor] > 0) {
+                return cursor;
+            }
+        }
+        return none;
+    };
+
+    auto fanningVertex = skipDeadEnd();
+    while (fanningVertex != none) {
+        candidates.clear();
+        for (auto k = adjacency.offsets[fanningVertex]; k < adjacency.offsets[fanningVertex + 1]; ++k) {
+            auto triangle = adjacency.triangles[k];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (u32 corner = 0; corner < 3; ++corner) {
+                auto vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+                cache.access(vertex);
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that entered the cache earliest, as long as its remaining fan still fits in the cache
+        auto next = none;
+        i32 bestPriority = -1;
+        for (auto vertex : candidates) {
+            if (liveTriangles[vertex] == 0) {
+                continue;
+            }
+            i32 priority = 0;
+            if (cache.contains(vertex) && cache.time - cache.timestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+                priority = cache.time - cache.timestamps[vertex];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+        fanningVertex = next != none ? next : skipDeadEnd();
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+template<typename T>
+static void optimizeOverdrawImpl(T* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount, u32 positionStride, u32 cacheSize)
+{
+    auto triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) {
+        return;
+    }
+
+    auto position = [&](u32 vertex) -> glm::vec3 const& {
+        return *reinterpret_cast<glm::vec3 const*>(reinterpret_cast<u8 const*>(positions) + u64(vertex) * positionStride);
+    };
+
+    // A triangle whose three vertices all miss starts a cluster, reordering clusters keeps the misses inside them
+    std::vector<u64> clusterStarts;
+    FifoCache cache(vertexCount, cacheSize);
+    for (u64 t = 0; t < triangleCount; ++t) {
+        u32 misses = 0;
+        for (u32 corner = 0; corner < 3; ++corner) {
+            misses += cache.access(indices[t * 3 + corner]) ? 1 : 0;
+        }
+        if (misses == 3) {
+            clusterStarts.push_back(t);
+        }
+    }
+    if (clusterStarts.size() < 2) {
+        return;
+    }
+    clusterStarts.push_back(triangleCount);
+
+    struct Cluster {
+        u64 firstTriangle;
+        u64 triangleCount;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size() - 1);
+    std::vector<glm::vec3> centroids(clusters.size());
+    std::vector<glm::vec3> normals(clusters.size());
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+    for (u32 c = 0; c < clusters.size(); ++c) {
+        clusters[c].firstTriangle = clusterStarts[c];
+        clusters[c].triangleCount = clusterStarts[c + 1] - clusterStarts[c];
+
+        glm::vec3 centroid(0.f);
+        glm::vec3 normal(0.f);
+        float area = 0.f;
+        for (auto t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            auto const& p0 = position(indices[t * 3 + 0]);
+            auto const& p1 = position(indices[t * 3 + 1]);
+            auto const& p2 = position(indices[t * 3 + 2]);
+            // The cross product is the area weighted normal
+            auto cross = glm::cross(p1 - p0, p2 - p0);
+            auto triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.f ? centroid / area : position(indices[clusterStarts[c] * 3]);
+        auto normalLength = glm::length(normal);
+        normals[c] = normalLength > 0.f ? normal / normalLength : glm::vec3(0.f);
+    }
+    meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : glm::vec3(0.f);
+
+    // Clusters facing away from the mesh centre are the ones likely in front, they are drawn first
+    for (u32 c = 0; c < clusters.size(); ++c) {
+        clusters[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const& a, Cluster const& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<T> output;
+    output.reserve(triangleCount * 3);
+    for (auto const& cluster : clusters) {
+        auto first = indices + cluster.firstTriangle * 3;
+        output.insert(output.end(), first, first + cluster.triangleCount * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+template<typename T>
+static std::vector<u32> optimizeVertexFetchImpl(T* indices, u64 indexCount, u32 vertexCount)
+{
+    constexpr u32 unused = ~0u;
+    std::vector<u32> remap(vertexCount, unused);
+    u32 nextVertex = 0;
+    for (u64 i = 0; i < indexCount; ++i) {
+        auto& newIndex = remap[indices[i]];
+        if (newIndex == unused) {
+            newIndex = nextVertex++;
+        }
+        indices[i] = T(newIndex);
+    }
+    for (auto& newIndex : remap) {
+        if (newIndex == unused) {
+            newIndex = nextVertex++;
+        }
+    }
+    return remap;
+}
+
+u32 weldVertices(u32* indices, u64 indexCount, u32 vertexCount, std::vector<VertexStream> const& streams)
+{
+    return weldVerticesImpl(indices, indexCount, vertexCount, streams);
+}
+
+u32 weldVertices(u16* indices, u64 indexCount, u32 vertexCount, std::vector<VertexStream> const& streams)
+{
+    return weldVerticesImpl(indices, indexCount, vertexCount, streams);
+}
+
+VertexCacheStatistics analyzeVertexCache(u32 const* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    return analyzeVertexCacheImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+VertexCacheStatistics analyzeVertexCache(u16 const* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    return analyzeVertexCacheImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+void optimizeVertexCache(u32* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    optimizeVertexCacheImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+void optimizeVertexCache(u16* indices, u64 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    optimizeVertexCacheImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+void optimizeOverdraw(u32* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount, u32 positionStride, u32 cacheSize)
+{
+    optimizeOverdrawImpl(indices, indexCount, positions, vertexCount, positionStride, cacheSize);
+}
+
+void optimizeOverdraw(u16* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount, u32 positionStride, u32 cacheSize)
+{
+    optimizeOverdrawImpl(indices, indexCount, positions, vertexCount, positionStride, cacheSize);
+}
+
+std::vector<u32> optimizeVertexFetch(u32* indices, u64 indexCount, u32 vertexCount)
+{
+    return optimizeVertexFetchImpl(indices, indexCount, vertexCount);
+}
+
+std::vector<u32> optimizeVertexFetch(u16* indices, u64 indexCount, u32 vertexCount)
+{
+    return optimizeVertexFetchImpl(indices, indexCount, vertexCount);
+}
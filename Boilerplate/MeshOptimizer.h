@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Triangle list reordering for the post-transform vertex cache, overdraw and vertex fetch.
+// All functions take the indices of one primitive, relative to its first vertex; u16 and u32 indices are supported.
+
+// FIFO cache simulation of an index buffer
+struct VertexCacheStatistics {
+    u32 vertexTransforms = 0;
+    u32 triangleCount = 0;
+    u32 vertexCount = 0;
+
+    // Average cache miss ratio, transforms per triangle: 3 at worst, about 0.5 for a good order of a regular mesh
+    float acmr() const { return triangleCount ? float(vertexTransforms) / triangleCount : 0.f; }
+    // Average transform to vertex ratio, transforms per referenced vertex: 1 is optimal
+    float atvr() const { return vertexCount ? float(vertexTransforms) / vertexCount : 0.f; }
+};
+
+constexpr u32 defaultVertexCacheSize = 16;
+
+VertexCacheStatistics analyzeVertexCache(u32 const* indices, u64 indexCount, u32 vertexCount, u32 cacheSize = defaultVertexCacheSize);
+VertexCacheStatistics analyzeVertexCache(u16 const* indices, u64 indexCount, u32 vertexCount, u32 cacheSize = defaultVertexCacheSize);
+
+// One attribute array, size bytes per vertex
+struct VertexStream {
+    void const* data = nullptr;
+    u32 size = 0;
+};
+
+// Points the indices of vertices that are bitwise identical in all streams at the first of them,
+// so exporters that split every triangle off get shared vertices back. Returns the number of distinct vertices.
+u32 weldVertices(u32* indices, u64 indexCount, u32 vertexCount, std::vector<VertexStream> const& streams);
+u32 weldVertices(u16* indices, u64 indexCount, u32 vertexCount, std::vector<VertexStream> const& streams);
+
+// Tipsify (Sander et al. 2007): fans around recently used vertices, linear in the triangle count
+void optimizeVertexCache(u32* indices, u64 indexCount, u32 vertexCount, u32 cacheSize = defaultVertexCacheSize);
+void optimizeVertexCache(u16* indices, u64 indexCount, u32 vertexCount, u32 cacheSize = defaultVertexCacheSize);
+
+// Splits a cache optimized order at the points where the cache runs empty anyway and sorts those clusters
+// front to back as seen from outside the mesh, so the early depth test rejects more fragments at few extra misses.
+void optimizeOverdraw(
+    u32* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 positionStride = sizeof(glm::vec3), u32 cacheSize = defaultVertexCacheSize);
+void optimizeOverdraw(
+    u16* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 positionStride = sizeof(glm::vec3), u32 cacheSize = defaultVertexCacheSize);
+
+// Renumbers the vertices in the order the indices first use them and rewrites the indices.
+// Returns the old to new vertex mapping for remapVertices; unreferenced vertices move to the end.
+std::vector<u32> optimizeVertexFetch(u32* indices, u64 indexCount, u32 vertexCount);
+std::vector<u32> optimizeVertexFetch(u16* indices, u64 indexCount, u32 vertexCount);
+
+// Applies the mapping of optimizeVertexFetch to one vertex stream of remap.size() elements
+template<typename T>
+void remapVertices(std::vector<u32> const& remap, T* vertices)
+{
+    std::vector<T> source(vertices, vertices + remap.size());
+    for (u32 i = 0; i < remap.size(); ++i) {
+        vertices[remap[i]] = source[i];
+    }
+}
@@ -0,0 +1,402 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
+
+// Sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void addPlane(glm::vec3 const& normal, float distance, float planeWeight)
+    {
+        double x = normal.x, y = normal.y, z = normal.z, d = distance, w = planeWeight;
+        a00 += w * x * x; a01 += w * x * y; a02 += w * x * z;
+        a11 += w * y * y; a12 += w * y * z; a22 += w * z * z;
+        b0 += w * x * d; b1 += w * y * d; b2 += w * z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(Quadric const& other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02;
+        a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    double evaluate(glm::vec3 const& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        auto error =
+            a00 * x * x + a11 * y * y + a22 * z * z +
+            2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+            2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(error, 0.0);
+    }
+};
+
+struct Collapse {
+    u32 from;
+    u32 to;
+    float cost;
+};
+
+// Lowest vertex index at every position, hashed by the position's bytes
+static std::vector<u32> weldPositions(glm::vec3 const* positions, u32 vertexCount)
+{
+    constexpr u32 empty = ~0u;
+    u64 tableSize = 1;
+    while (tableSize < u64(vertexCount) * 2) {
+        tableSize *= 2;
+    }
+    std::vector<u32> table(tableSize, empty);
+    std::vector<u32> welded(vertexCount);
+    for (u32 vertex = 0; vertex < vertexCount; ++vertex) {
+        u64 hash = 14695981039346656037ull;
+        auto bytes = reinterpret_cast<u8 const*>(&positions[vertex]);
+        for (u32 i = 0; i < sizeof(glm::vec3); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        auto slot = hash & (tableSize - 1);
+        while (table[slot] != empty && memcmp(&positions[table[slot]], &positions[vertex], sizeof(glm::vec3)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == empty) {
+            table[slot] = vertex;
+        }
+        welded[vertex] = table[slot];
+    }
+    return welded;
+}
+
+// Closest point of the triangle abc to p (Ericson, Real-Time Collision Detection, 5.1.5)
+static glm::vec3 closestPointOnTriangle(glm::vec3 const& p, glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c)
+{
+    auto ab = b - a;
+    auto ac = c - a;
+    auto ap = p - a;
+    auto d1 = glm::dot(ab, ap);
+    auto d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) {
+        return a;
+    }
+    auto bp = p - b;
+    auto d3 = glm::dot(ab, bp);
+    auto d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) {
+        return b;
+    }
+    auto vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    auto cp = p - c;
+    auto d5 = glm::dot(ab, cp);
+    auto d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) {
+        return c;
+    }
+    auto vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    auto va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    auto denominator = 1.f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Largest distance from points spread over the source triangles to the simplified ones.
+// Each point is measured against the triangles around the positions its corners collapsed into and their neighbours;
+// the closest triangle of the whole mesh can only be closer, so the result never underestimates the distance there.
+static float measureDeviation(
+    std::vector<u32> const& source, std::vector<u32> const& simplified, glm::vec3 const* positions,
+    std::vector<u32> const& positionOf, std::vector<u32> const& collapsedInto)
+{
+    auto vertexCount = static_cast<u32>(positionOf.size());
+    auto representative = [&](u32 vertex) {
+        auto position = positionOf[vertex];
+        while (collapsedInto[position] != position) {
+            position = collapsedInto[position];
+        }
+        return position;
+    };
+
+    std::vector<u32> offsets(vertexCount + 1, 0);
+    for (auto vertex : simplified) {
+        ++offsets[positionOf[vertex] + 1];
+    }
+    for (u32 v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<u32> adjacent(simplified.size());
+    {
+        std::vector<u32> cursors(offsets.begin(), offsets.end() - 1);
+        for (u64 i = 0; i < simplified.size(); ++i) {
+            adjacent[cursors[positionOf[simplified[i]]]++] = u32(i / 3);
+        }
+    }
+
+    // Barycentric grid in quarters of the triangle: the corners, three points along each edge and three inside
+    constexpr u32 subdivisions = 4;
+    constexpr u32 sampleCount = (subdivisions + 1) * (subdivisions + 2) / 2;
+    float samples[sampleCount][2];
+    for (u32 i = 0, n = 0; i <= subdivisions; ++i) {
+        for (u32 j = 0; i + j <= subdivisions; ++j, ++n) {
+            samples[n][0] = float(i) / subdivisions;
+            samples[n][1] = float(j) / subdivisions;
+        }
+    }
+
+    std::vector<u32> nearby;
+    std::vector<u32> candidates;
+    float maxDistance = 0.f;
+    for (u64 t = 0; t < source.size(); t += 3) {
+        // The positions the corners collapsed into and their neighbours, the closest triangle is almost always
+        // around one of them
+        u32 const targets[] = { representative(source[t + 0]), representative(source[t + 1]), representative(source[t + 2]) };
+        nearby.assign(std::begin(targets), std::end(targets));
+        for (auto target : targets) {
+            for (auto k = offsets[target]; k < offsets[target + 1]; ++k) {
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    nearby.push_back(positionOf[simplified[adjacent[k] * 3 + corner]]);
+                }
+            }
+        }
+        std::sort(nearby.begin(), nearby.end());
+        nearby.erase(std::unique(nearby.begin(), nearby.end()), nearby.end());
+        candidates.clear();
+        for (auto position : nearby) {
+            candidates.insert(candidates.end(), adjacent.begin() + offsets[position], adjacent.begin() + offsets[position + 1]);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        auto const& p0 = positions[source[t + 0]];
+        auto const& p1 = positions[source[t + 1]];
+        auto const& p2 = positions[source[t + 2]];
+        for (u32 sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex) {
+            auto sample = p0 + (p1 - p0) * samples[sampleIndex][0] + (p2 - p0) * samples[sampleIndex][1];
+            // A position left without triangles is still a point of the simplified surface
+            auto closest = std::numeric_limits<float>::max();
+            for (auto target : targets) {
+                closest = std::min(closest, glm::length(sample - positions[target]));
+            }
+            for (auto triangleIndex : candidates) {
+                auto triangle = simplified.data() + triangleIndex * 3;
+                auto point = closestPointOnTriangle(sample, positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+                closest = std::min(closest, glm::length(sample - point));
+            }
+            maxDistance = std::max(maxDistance, closest);
+        }
+    }
+    return maxDistance;
+}
+
+std::vector<u32> simplifyMesh(
+    u32 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u64 targetIndexCount, float& error)
+{
+    error = 0.f;
+    std::vector<u32> triangles(indices, indices + indexCount / 3 * 3);
+    if (triangles.size() <= targetIndexCount || vertexCount == 0) {
+        return triangles;
+    }
+
+    // Collapses work on positions, each identified by its lowest vertex index
+    auto positionOf = weldPositions(positions, vertexCount);
+    auto source = triangles;
+    std::vector<u32> collapsedInto(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v) {
+        collapsedInto[v] = v;
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_set<u64> edges;
+        edges.reserve(triangles.size());
+        for (u64 t = 0; t < triangles.size(); t += 3) {
+            for (u32 k = 0; k < 3; ++k) {
+                edges.insert(u64(positionOf[triangles[t + k]]) << 32 | positionOf[triangles[t + (k + 1) % 3]]);
+            }
+        }
+        // An edge without its opposite half is on an open border
+        for (u64 t = 0; t < triangles.size(); t += 3) {
+            for (u32 k = 0; k < 3; ++k) {
+                auto a = positionOf[triangles[t + k]];
+                auto b = positionOf[triangles[t + (k + 1) % 3]];
+                if (edges.count(u64(b) << 32 | a) == 0) {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (u64 t = 0; t < triangles.size(); t += 3) {
+        auto const& p0 = positions[triangles[t + 0]];
+        auto const& p1 = positions[triangles[t + 1]];
+        auto const& p2 = positions[triangles[t + 2]];
+        auto normal = glm::cross(p1 - p0, p2 - p0);
+        auto length = glm::length(normal);
+        if (length == 0.f) {
+            continue;
+        }
+        normal /= length;
+        for (u32 k = 0; k < 3; ++k) {
+            quadrics[positionOf[triangles[t + k]]].addPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+        }
+    }
+
+    auto faceNormal = [&](glm::vec3 const& p0, glm::vec3 const& p1, glm::vec3 const& p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    };
+
+    std::vector<u32> offsets(vertexCount + 1);
+    std::vector<u32> adjacent;
+    std::vector<bool> touched(vertexCount);
+    std::vector<bool> removed;
+    std::vector<Collapse> collapses;
+    while (triangles.size() > targetIndexCount) {
+        // Triangles around each position
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (auto vertex : triangles) {
+            ++offsets[positionOf[vertex] + 1];
+        }
+        for (u32 v = 0; v < vertexCount; ++v) {
+            offsets[v + 1] += offsets[v];
+        }
+        adjacent.resize(triangles.size());
+        {
+            std::vector<u32> cursors(offsets.begin(), offsets.end() - 1);
+            for (u64 i = 0; i < triangles.size(); ++i) {
+                adjacent[cursors[positionOf[triangles[i]]]++] = u32(i / 3);
+            }
+        }
+
+        collapses.clear();
+        for (u64 t = 0; t < triangles.size(); t += 3) {
+            for (u32 k = 0; k < 3; ++k) {
+                auto a = positionOf[triangles[t + k]];
+                auto b = positionOf[triangles[t + (k + 1) % 3]];
+                for (u32 direction = 0; direction < 2; ++direction) {
+                    auto from = direction == 0 ? a : b;
+                    auto to = direction == 0 ? b : a;
+                    if (locked[from]) {
+                        continue;
+                    }
+                    Quadric merged = quadrics[from];
+                    merged.add(quadrics[to]);
+                    auto cost = merged.weight > 0.0 ? merged.evaluate(positions[to]) / merged.weight : 0.0;
+                    collapses.push_back({ from, to, float(cost) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](Collapse const& a, Collapse const& b) { return a.cost < b.cost; });
+
+        // Collapses of one pass must not share triangles, so everything around a collapsed position is touched
+        std::fill(touched.begin(), touched.end(), false);
+        removed.assign(triangles.size() / 3, false);
+        auto triangleCount = triangles.size() / 3;
+        auto targetTriangles = targetIndexCount / 3;
+        u32 applied = 0;
+        for (auto const& collapse : collapses) {
+            if (triangleCount <= targetTriangles) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            // Rejects collapses that flip a remaining triangle
+            bool flips = false;
+            u32 degenerate = 0;
+            for (auto k = offsets[collapse.from]; k < offsets[collapse.from + 1] && !flips; ++k) {
+                auto triangle = triangles.data() + adjacent[k] * 3;
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                bool containsTarget = false;
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    auto position = positionOf[triangle[corner]];
+                    containsTarget |= position == collapse.to;
+                    before[corner] = positions[triangle[corner]];
+                    after[corner] = position == collapse.from ? positions[collapse.to] : before[corner];
+                }
+                if (containsTarget) {
+                    ++degenerate;
+                    continue;
+                }
+                auto normalBefore = faceNormal(before[0], before[1], before[2]);
+                auto normalAfter = faceNormal(after[0], after[1], after[2]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            for (auto k = offsets[collapse.from]; k < offsets[collapse.from + 1]; ++k) {
+                auto triangle = triangles.data() + adjacent[k] * 3;
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    touched[positionOf[triangle[corner]]] = true;
+                }
+            }
+
+            for (auto k = offsets[collapse.from]; k < offsets[collapse.from + 1]; ++k) {
+                auto triangleIndex = adjacent[k];
+                auto triangle = triangles.data() + triangleIndex * 3;
+                // Takes the attributes of the kept vertex across the collapsed edge when the triangle has one,
+                // otherwise those of the first vertex at the kept position
+                u32 replacement = collapse.to;
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    if (positionOf[triangle[corner]] == collapse.to) {
+                        replacement = triangle[corner];
+                    }
+                }
+                for (u32 corner = 0; corner < 3; ++corner) {
+                    if (positionOf[triangle[corner]] == collapse.from) {
+                        triangle[corner] = replacement;
+                    }
+                }
+                auto p0 = positionOf[triangle[0]];
+                auto p1 = positionOf[triangle[1]];
+                auto p2 = positionOf[triangle[2]];
+                if (p0 == p1 || p1 == p2 || p0 == p2) {
+                    removed[triangleIndex] = true;
+                }
+            }
+
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            collapsedInto[collapse.from] = collapse.to;
+            triangleCount -= degenerate;
+            ++applied;
+        }
+
+        if (applied == 0) {
+            break;
+        }
+
+        u64 kept = 0;
+        for (u64 t = 0; t < removed.size(); ++t) {
+            if (!removed[t]) {
+                std::copy(triangles.begin() + t * 3, triangles.begin() + t * 3 + 3, triangles.begin() + kept * 3);
+                ++kept;
+            }
+        }
+        triangles.resize(kept * 3);
+    }
+
+    error = measureDeviation(source, triangles, positions, positionOf, collapsedInto);
+    return triangles;
+}
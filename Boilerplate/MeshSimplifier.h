@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Quadric error metric edge collapse (Garland and Heckbert 1997). Vertices only ever collapse onto other existing
+// vertices, so the result indexes the original vertex buffer and LODs can share it. Vertices at the same position
+// collapse together, taking the attributes of a vertex at the kept position; open borders are never moved.
+// Simplifies until the triangle list has at most targetIndexCount indices or no collapse is left that keeps every
+// triangle facing the same way. Returns the new index list; error receives the largest distance from points spread
+// over the source triangles to the simplified surface, in mesh units, never underestimated at those points. Since it
+// bounds the distance from the source rather than averaging it, the errors of repeated simplifications add up.
+std::vector<u32> simplifyMesh(
+    u32 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u64 targetIndexCount, float& error);
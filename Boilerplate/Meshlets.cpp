@@ -0,0 +1,175 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Ritter's approximate bounding sphere: starts from two far apart points and grows over the outliers
+static glm::vec4 calculateBoundingSphere(std::vector<glm::vec3> const& points)
+{
+    auto farthestFrom = [&](glm::vec3 const& origin) {
+        u32 farthest = 0;
+        float maxDistance = -1.f;
+        for (u32 i = 0; i < points.size(); ++i) {
+            auto distance = glm::dot(points[i] - origin, points[i] - origin);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = i;
+            }
+        }
+        return points[farthest];
+    };
+
+    auto a = farthestFrom(points[0]);
+    auto b = farthestFrom(a);
+    auto center = (a + b) * 0.5f;
+    auto radius = glm::length(b - a) * 0.5f;
+    for (auto const& point : points) {
+        auto distance = glm::length(point - center);
+        if (distance > radius) {
+            auto grownRadius = (radius + distance) * 0.5f;
+            center += (point - center) * ((grownRadius - radius) / distance);
+            radius = grownRadius;
+        }
+    }
+    return glm::vec4(center, radius);
+}
+
+static void calculateBounds(Meshlet& meshlet, MeshletData const& data, glm::vec3 const* positions, u32 baseVertex, u32 positionStride)
+{
+    auto position = [&](u32 localVertex) -> glm::vec3 const& {
+        auto vertex = data.vertices[meshlet.vertexOffset + localVertex] - baseVertex;
+        return *reinterpret_cast<glm::vec3 const*>(reinterpret_cast<u8 const*>(positions) + u64(vertex) * positionStride);
+    };
+
+    std::vector<glm::vec3> points(meshlet.vertexCount);
+    for (u32 i = 0; i < meshlet.vertexCount; ++i) {
+        points[i] = position(i);
+    }
+    meshlet.boundingSphere = calculateBoundingSphere(points);
+    glm::vec3 center(meshlet.boundingSphere);
+
+    std::vector<glm::vec3> corners;
+    std::vector<glm::vec3> normals;
+    auto triangles = data.triangles.data() + meshlet.triangleOffset;
+    for (u32 t = 0; t < meshlet.triangleCount; ++t) {
+        auto const& p0 = position(triangles[t * 3 + 0]);
+        auto const& p1 = position(triangles[t * 3 + 1]);
+        auto const& p2 = position(triangles[t * 3 + 2]);
+        auto normal = glm::cross(p1 - p0, p2 - p0);
+        auto length = glm::length(normal);
+        // Degenerate triangles are invisible and do not constrain the cone
+        if (length > 0.f) {
+            corners.push_back(p0);
+            normals.push_back(normal / length);
+        }
+    }
+
+    glm::vec3 axis(0.f);
+    for (auto const& normal : normals) {
+        axis += normal;
+    }
+    auto axisLength = glm::length(axis);
+    if (normals.empty() || axisLength == 0.f) {
+        meshlet.coneApex = glm::vec4(center, 0.f);
+        meshlet.coneAxisCutoff = glm::vec4(0.f, 0.f, 0.f, 1.f);
+        return;
+    }
+    axis /= axisLength;
+
+    auto minDot = 1.f;
+    for (auto const& normal : normals) {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    // Normals spread over more than a hemisphere can never all face away
+    if (minDot <= 0.f) {
+        meshlet.coneApex = glm::vec4(center, 0.f);
+        meshlet.coneAxisCutoff = glm::vec4(axis, 1.f);
+        return;
+    }
+
+    // The apex sits on the axis behind every triangle plane, so a camera in front of any triangle sees it from the front too
+    auto t = 0.f;
+    for (u32 i = 0; i < normals.size(); ++i) {
+        t = std::min(t, glm::dot(corners[i] - center, normals[i]) / glm::dot(axis, normals[i]));
+    }
+    meshlet.coneApex = glm::vec4(center + axis * t, 0.f);
+    meshlet.coneAxisCutoff = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+}
+
+template<typename T>
+static u32 buildMeshletsImpl(
+    MeshletData& data, T const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 baseVertex, u32 positionStride)
+{
+    constexpr u8 unused = 0xff;
+    // Local index of every vertex in the open cluster
+    std::vector<u8> localVertices(vertexCount, unused);
+    auto firstMeshlet = data.meshlets.size();
+
+    Meshlet meshlet;
+    auto finish = [&]() {
+        if (meshlet.triangleCount == 0) {
+            return;
+        }
+        for (u32 i = 0; i < meshlet.vertexCount; ++i) {
+            localVertices[data.vertices[meshlet.vertexOffset + i] - baseVertex] = unused;
+        }
+        // Keeps the next cluster's triangles 4-byte aligned for u32 loads in shaders
+        data.triangles.resize((data.triangles.size() + 3) / 4 * 4, 0);
+        calculateBounds(meshlet, data, positions, baseVertex, positionStride);
+        data.meshlets.push_back(meshlet);
+
+        meshlet = Meshlet();
+        meshlet.vertexOffset = data.vertices.size();
+        meshlet.triangleOffset = data.triangles.size();
+    };
+    meshlet.vertexOffset = data.vertices.size();
+    meshlet.triangleOffset = data.triangles.size();
+
+    for (u64 i = 0; i + 2 < indexCount; i += 3) {
+        u32 newVertices = 0;
+        for (u32 corner = 0; corner < 3; ++corner) {
+            newVertices += localVertices[indices[i + corner]] == unused ? 1 : 0;
+        }
+        if (meshlet.vertexCount + newVertices > maxMeshletVertices || meshlet.triangleCount == maxMeshletTriangles) {
+            finish();
+        }
+
+        for (u32 corner = 0; corner < 3; ++corner) {
+            auto vertex = indices[i + corner];
+            if (localVertices[vertex] == unused) {
+                localVertices[vertex] = u8(meshlet.vertexCount++);
+                data.vertices.push_back(baseVertex + vertex);
+            }
+            data.triangles.push_back(localVertices[vertex]);
+        }
+        ++meshlet.triangleCount;
+    }
+    finish();
+
+    return u32(data.meshlets.size() - firstMeshlet);
+}
+
+u32 buildMeshlets(
+    MeshletData& data, u32 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 baseVertex, u32 positionStride)
+{
+    return buildMeshletsImpl(data, indices, indexCount, positions, vertexCount, baseVertex, positionStride);
+}
+
+u32 buildMeshlets(
+    MeshletData& data, u16 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 baseVertex, u32 positionStride)
+{
+    return buildMeshletsImpl(data, indices, indexCount, positions, vertexCount, baseVertex, positionStride);
+}
+
+bool isMeshletBackfacing(Meshlet const& meshlet, glm::vec3 const& cameraPosition)
+{
+    auto direction = glm::vec3(meshlet.coneApex) - cameraPosition;
+    auto length = glm::length(direction);
+    if (length == 0.f) {
+        return false;
+    }
+    return glm::dot(direction / length, glm::vec3(meshlet.coneAxisCutoff)) > meshlet.coneAxisCutoff.w;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+constexpr u32 maxMeshletVertices = 64;
+constexpr u32 maxMeshletTriangles = 124;
+
+// std430 layout of one cluster in the meshlet storage buffer. Bounds are in mesh space.
+struct Meshlet {
+    // First entry in the meshlet vertex buffer, which holds vertex buffer indices
+    u32 vertexOffset = 0;
+    // First byte in the meshlet triangle buffer, three local vertex indices per triangle, 4-byte aligned
+    u32 triangleOffset = 0;
+    u32 vertexCount = 0;
+    u32 triangleCount = 0;
+    // xyz centre, w radius
+    glm::vec4 boundingSphere = glm::vec4(0.f);
+    // xyz apex, w unused
+    glm::vec4 coneApex = glm::vec4(0.f);
+    // xyz axis, w cutoff; the cluster faces away from a camera at c when dot(normalize(apex - c), axis) > cutoff
+    glm::vec4 coneAxisCutoff = glm::vec4(0.f, 0.f, 0.f, 1.f);
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet has to match the std430 layout");
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<u32> vertices;
+    std::vector<u8> triangles;
+};
+
+// Appends the clusters of one triangle list, greedily in index order, so a cache optimized order gives compact clusters.
+// Indices are relative to positions, baseVertex is added to the stored vertex indices. Returns the number of clusters added.
+u32 buildMeshlets(
+    MeshletData& data, u32 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 baseVertex = 0, u32 positionStride = sizeof(glm::vec3));
+u32 buildMeshlets(
+    MeshletData& data, u16 const* indices, u64 indexCount, glm::vec3 const* positions, u32 vertexCount,
+    u32 baseVertex = 0, u32 positionStride = sizeof(glm::vec3));
+
+// CPU reference of the normal cone test, with the camera in mesh space
+bool isMeshletBackfacing(Meshlet const& meshlet, glm::vec3 const& cameraPosition);
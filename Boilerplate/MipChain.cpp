@@ -0,0 +1,87 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct SrgbTables {
+    float toLinear[256];
+    // Indexed by round(linear * 4095)
+    u8 fromLinear[4096];
+
+    SrgbTables()
+    {
+        for (u32 i = 0; i < 256; ++i) {
+            auto c = i / 255.f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (u32 i = 0; i < 4096; ++i) {
+            auto l = i / 4095.f;
+            auto c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+            fromLinear[i] = static_cast<u8>(std::min(255.f, c * 255.f + 0.5f));
+        }
+    }
+};
+
+SrgbTables const& getSrgbTables()
+{
+    static SrgbTables const tables;
+    return tables;
+}
+
+}
+
+void buildMipChain(u8 const* pixels, u32 width, u32 height, MipChain& chain, bool srgb)
+{
+    chain.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    chain.width = width;
+    chain.height = height;
+    chain.offsets.clear();
+
+    VkDeviceSize size = 0;
+    for (u32 w = width, h = height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+        chain.offsets.push_back(size);
+        size += static_cast<VkDeviceSize>(w) * h * 4;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    chain.pixels.resize(size);
+    memcpy(chain.pixels.data(), pixels, static_cast<size_t>(width) * height * 4);
+
+    auto const& tables = getSrgbTables();
+    u32 srcWidth = width;
+    u32 srcHeight = height;
+    for (u32 level = 1; level < chain.offsets.size(); ++level) {
+        auto src = chain.pixels.data() + chain.offsets[level - 1];
+        auto dst = chain.pixels.data() + chain.offsets[level];
+        auto dstWidth = std::max(srcWidth / 2, 1u);
+        auto dstHeight = std::max(srcHeight / 2, 1u);
+        for (u32 y = 0; y < dstHeight; ++y) {
+            // Odd sizes drop the last row or column, 1 texel wide sources repeat it
+            u32 rows[2] = { std::min(y * 2, srcHeight - 1), std::min(y * 2 + 1, srcHeight - 1) };
+            for (u32 x = 0; x < dstWidth; ++x) {
+                u32 columns[2] = { std::min(x * 2, srcWidth - 1), std::min(x * 2 + 1, srcWidth - 1) };
+                float sum[4] = {};
+                for (auto row : rows) {
+                    for (auto column : columns) {
+                        auto texel = src + (static_cast<size_t>(row) * srcWidth + column) * 4;
+                        for (u32 c = 0; c < 3; ++c) {
+                            sum[c] += srgb ? tables.toLinear[texel[c]] : texel[c];
+                        }
+                        sum[3] += texel[3];
+                    }
+                }
+                auto out = dst + (static_cast<size_t>(y) * dstWidth + x) * 4;
+                for (u32 c = 0; c < 3; ++c) {
+                    out[c] = srgb ? tables.fromLinear[static_cast<u32>(sum[c] * 0.25f * 4095.f + 0.5f)] : static_cast<u8>(sum[c] * 0.25f + 0.5f);
+                }
+                out[3] = static_cast<u8>(sum[3] * 0.25f + 0.5f);
+            }
+        }
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// Mip chain of an image in system memory, levels tightly packed from the finest down.
+// RGBA8 as built by buildMipChain, or blocks after compressMipChain or transcodeBasisKtx2, which keeps the file's levels
+struct MipChain {
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<u8> pixels;
+    std::vector<VkDeviceSize> offsets;
+};
+
+// Box filters the pixels down to 1x1, sRGB ones in linear space
+void buildMipChain(u8 const* pixels, u32 width, u32 height, MipChain& chain, bool srgb = true);
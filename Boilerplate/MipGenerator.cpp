@@ -0,0 +1,354 @@
+#include "MipGenerator.h"
+#include "Initializer.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr u32 mipGroupSize = 8;
+static VkPipelineStageFlags const consumerStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+// Format of the storage views the compute path writes through, VK_FORMAT_UNDEFINED when it cannot handle the format
+static VkFormat getStorageFormat(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static VkImageMemoryBarrier imageBarrier(
+    Image const& image, u32 baseLevel, u32 levelCount,
+    VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = srcAccessMask;
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.handle;
+    barrier.subresourceRange.aspectMask = image.view.aspectMask;
+    barrier.subresourceRange.baseMipLevel = baseLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = image.arrayLayers;
+    return barrier;
+}
+
+u32 calculateMipLevels(u32 width, u32 height)
+{
+    u32 levels = 1;
+    while ((width | height) >> levels) {
+        ++levels;
+    }
+    return levels;
+}
+
+MipGenerationPath selectMipGenerationPath(Context const& globals, VkFormat format)
+{
+    VkFormatFeatureFlags const blitFeatures =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(globals.device.physicalDevice, format, &properties);
+    if ((properties.optimalTilingFeatures & blitFeatures) == blitFeatures) {
+        return MipGenerationPath::BLIT;
+    }
+
+    auto storageFormat = getStorageFormat(format);
+    if (storageFormat != VK_FORMAT_UNDEFINED) {
+        vkGetPhysicalDeviceFormatProperties(globals.device.physicalDevice, storageFormat, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) {
+            return MipGenerationPath::COMPUTE;
+        }
+    }
+    return MipGenerationPath::NONE;
+}
+
+void MipGenerator::create(Context const& globals)
+{
+    pending.clear();
+    inFlight.clear();
+    LOG_DEBUG("Mip generator successfully created");
+}
+
+void MipGenerator::destroy(Context const& globals)
+{
+    // The owner waited for every submission
+    collect(globals, ~0ull);
+    for (auto& retired : pending) {
+        for (auto view : retired.views) {
+            vkDestroyImageView(globals.device.handle, view, globals.allocator);
+        }
+        vkDestroyDescriptorPool(globals.device.handle, retired.descriptorPool, globals.allocator);
+    }
+    pending.clear();
+
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(globals.device.handle, pipeline, globals.allocator);
+        vkDestroyPipelineLayout(globals.device.handle, pipelineLayout, globals.allocator);
+        vkDestroyDescriptorSetLayout(globals.device.handle, setLayout, globals.allocator);
+        pipeline = VK_NULL_HANDLE;
+        pipelineLayout = VK_NULL_HANDLE;
+        setLayout = VK_NULL_HANDLE;
+    }
+    LOG_DEBUG("Mip generator destroyed");
+}
+
+void MipGenerator::record(Context const& globals, VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel)
+{
+    switch (selectMipGenerationPath(globals, image.format)) {
+    case MipGenerationPath::BLIT:
+        recordBlit(commandBuffer, image, sourceLevel);
+        break;
+    case MipGenerationPath::COMPUTE:
+        recordCompute(globals, commandBuffer, image, sourceLevel);
+        break;
+    case MipGenerationPath::NONE:
+        throw std::runtime_error("Mip levels of the image format cannot be generated");
+    }
+}
+
+void MipGenerator::submit(u64 value)
+{
+    for (auto& retired : pending) {
+        retired.value = value;
+        inFlight.push_back(std::move(retired));
+    }
+    pending.clear();
+}
+
+void MipGenerator::collect(Context const& globals, u64 completedValue)
+{
+    while (!inFlight.empty() && inFlight.front().value <= completedValue) {
+        for (auto view : inFlight.front().views) {
+            vkDestroyImageView(globals.device.handle, view, globals.allocator);
+        }
+        vkDestroyDescriptorPool(globals.device.handle, inFlight.front().descriptorPool, globals.allocator);
+        inFlight.pop_front();
+    }
+}
+
+void MipGenerator::createComputePipeline(Context const& globals)
+{
+    {
+        // Source and destination level
+        std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        bindings[1] = Initializer::descriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
+        THROW_IF_FAILED(
+            vkCreateDescriptorSetLayout(globals.device.handle, &descriptorSetLayoutCreateInfo, globals.allocator, &setLayout),
+            __FILE__, __LINE__,
+            "Failed to create descriptor set layout");
+    }
+    {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts(1);
+        descriptorSetLayouts[0] = setLayout;
+        std::vector<VkPushConstantRange> pushConstantRanges(1);
+        pushConstantRanges[0].offset = 0;
+        pushConstantRanges[0].size = sizeof(PushConstants);
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        auto pipelineLayoutCreateInfo = Initializer::pipelineLayoutCreateInfo(descriptorSetLayouts, pushConstantRanges);
+        THROW_IF_FAILED(
+            vkCreatePipelineLayout(globals.device.handle, &pipelineLayoutCreateInfo, globals.allocator, &pipelineLayout),
+            __FILE__, __LINE__,
+            "Failed to create pipeline layout");
+
+        VkShaderModule shaderModule;
+        auto code = loadShaderCode("Boilerplate/GenerateMips.spv");
+        auto shaderModuleCreateInfo = Initializer::shaderModuleCreateInfo(code);
+        THROW_IF_FAILED(
+            vkCreateShaderModule(globals.device.handle, &shaderModuleCreateInfo, globals.allocator, &shaderModule),
+            __FILE__, __LINE__,
+            "Failed to create shader module");
+
+        VkComputePipelineCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.flags = 0;
+        createInfo.stage = Initializer::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+        createInfo.layout = pipelineLayout;
+        createInfo.basePipelineHandle = VK_NULL_HANDLE;
+        createInfo.basePipelineIndex = -1;
+        THROW_IF_FAILED(
+            vkCreateComputePipelines(globals.device.handle, VK_NULL_HANDLE, 1, &createInfo, globals.allocator, &pipeline),
+            __FILE__, __LINE__,
+            "Failed to create compute pipeline");
+
+        vkDestroyShaderModule(globals.device.handle, shaderModule, globals.allocator);
+    }
+    LOG_DEBUG("Mip generator compute pipeline created");
+}
+
+void MipGenerator::recordBlit(VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel)
+{
+    for (u32 level = sourceLevel + 1; level < image.mipLevels; ++level) {
+        auto barrier = imageBarrier(
+            image, level - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask = image.view.aspectMask;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = image.arrayLayers;
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { static_cast<i32>(std::max(image.width >> (level - 1), 1u)), static_cast<i32>(std::max(image.height >> (level - 1), 1u)), 1 };
+        blit.dstSubresource.aspectMask = image.view.aspectMask;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = image.arrayLayers;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { static_cast<i32>(std::max(image.width >> level, 1u)), static_cast<i32>(std::max(image.height >> level, 1u)), 1 };
+        vkCmdBlitImage(
+            commandBuffer,
+            image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+    }
+
+    // Levels below the source and the last one are still transfer destinations, the ones in between blit sources
+    auto lastLevel = image.mipLevels - 1;
+    std::vector<VkImageMemoryBarrier> barriers;
+    if (sourceLevel > 0) {
+        barriers.push_back(imageBarrier(
+            image, 0, sourceLevel,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+    }
+    if (lastLevel > sourceLevel) {
+        barriers.push_back(imageBarrier(
+            image, sourceLevel, lastLevel - sourceLevel,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+    }
+    barriers.push_back(imageBarrier(
+        image, lastLevel, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+}
+
+void MipGenerator::recordCompute(Context const& globals, VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel)
+{
+    auto dispatchCount = image.mipLevels - 1 - sourceLevel;
+    if (dispatchCount == 0) {
+        // Only the layout transitions
+        recordBlit(commandBuffer, image, sourceLevel);
+        return;
+    }
+    if (pipeline == VK_NULL_HANDLE) {
+        createComputePipeline(globals);
+    }
+
+    Retired retired;
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes(1);
+        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, dispatchCount * 2);
+        auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(dispatchCount, poolSizes);
+        THROW_IF_FAILED(
+            vkCreateDescriptorPool(globals.device.handle, &descriptorPoolCreateInfo, globals.allocator, &retired.descriptorPool),
+            __FILE__, __LINE__,
+            "Failed to create descriptor pool");
+    }
+
+    // One rgba8 view per level from the source on, aliasing sRGB formats so the shader converts by itself
+    retired.views.resize(dispatchCount + 1);
+    for (u32 i = 0; i < retired.views.size(); ++i) {
+        VkImageViewCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.flags = 0;
+        createInfo.image = image.handle;
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        createInfo.format = getStorageFormat(image.format);
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = image.view.aspectMask;
+        createInfo.subresourceRange.baseMipLevel = sourceLevel + i;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = image.arrayLayers;
+        THROW_IF_FAILED(
+            vkCreateImageView(globals.device.handle, &createInfo, globals.allocator, &retired.views[i]),
+            __FILE__, __LINE__,
+            "Failed to create image view");
+    }
+
+    std::vector<VkDescriptorSet> descriptorSets(dispatchCount);
+    {
+        std::vector<VkDescriptorSetLayout> setLayouts(dispatchCount, setLayout);
+        auto descriptorSetAllocateInfo = Initializer::descriptorSetAllocateInfo(retired.descriptorPool, dispatchCount, setLayouts);
+        THROW_IF_FAILED(
+            vkAllocateDescriptorSets(globals.device.handle, &descriptorSetAllocateInfo, descriptorSets.data()),
+            __FILE__, __LINE__,
+            "Failed to allocate descriptor sets");
+    }
+    for (u32 i = 0; i < dispatchCount; ++i) {
+        std::vector<VkDescriptorImageInfo> imageDescriptors(2);
+        imageDescriptors[0] = Initializer::descriptorImageInfo(VK_NULL_HANDLE, retired.views[i], VK_IMAGE_LAYOUT_GENERAL);
+        imageDescriptors[1] = Initializer::descriptorImageInfo(VK_NULL_HANDLE, retired.views[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+        std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+        descriptorWrites[0] = Initializer::writeDescriptorSet(
+            descriptorSets[i],
+            0, 0, imageDescriptors.size(),
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            imageDescriptors.data(), nullptr, nullptr);
+        vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    }
+
+    {
+        auto barrier = imageBarrier(
+            image, 0, image.mipLevels,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    PushConstants pushConstants = {};
+    pushConstants.srgb = image.format != getStorageFormat(image.format);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+    for (u32 i = 0; i < dispatchCount; ++i) {
+        auto level = sourceLevel + 1 + i;
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+        vkCmdDispatch(
+            commandBuffer,
+            (std::max(image.width >> level, 1u) + mipGroupSize - 1) / mipGroupSize,
+            (std::max(image.height >> level, 1u) + mipGroupSize - 1) / mipGroupSize,
+            image.arrayLayers);
+
+        // The next dispatch reads this level
+        if (i + 1 < dispatchCount) {
+            auto barrier = imageBarrier(
+                image, level, 1,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+    }
+
+    {
+        auto barrier = imageBarrier(
+            image, 0, image.mipLevels,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, consumerStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    pending.push_back(std::move(retired));
+}
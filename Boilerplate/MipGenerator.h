@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Defines.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+
+enum class MipGenerationPath {
+    BLIT,
+    COMPUTE,
+    NONE
+};
+
+// Number of levels down to 1x1
+u32 calculateMipLevels(u32 width, u32 height);
+// BLIT when the format can be linearly filtered by vkCmdBlitImage, COMPUTE when an rgba8 storage view can alias it
+MipGenerationPath selectMipGenerationPath(Context const& globals, VkFormat format);
+
+// Fills the levels of an image below an already written one on a graphics queue, by a vkCmdBlitImage cascade or,
+// for formats that cannot be blitted, by a box filter compute shader writing one level per dispatch.
+// The compute pipeline is only created when the first such image shows up.
+class MipGenerator {
+public:
+    void create(Context const& globals);
+    void destroy(Context const& globals);
+
+    // Expects every level in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL and levels up to sourceLevel written; leaves every
+    // level in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. The command buffer must belong to a graphics queue family.
+    void record(Context const& globals, VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel = 0);
+
+    // Views and descriptor sets recorded since the previous call are freed once the timeline reaches value
+    void submit(u64 value);
+    void collect(Context const& globals, u64 completedValue);
+
+private:
+    struct Retired {
+        u64 value = 0;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        std::vector<VkImageView> views;
+    };
+
+    struct PushConstants {
+        u32 srgb;
+    };
+
+    void createComputePipeline(Context const& globals);
+    void recordBlit(VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel);
+    void recordCompute(Context const& globals, VkCommandBuffer commandBuffer, Image const& image, u32 sourceLevel);
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    std::vector<Retired> pending;
+    std::deque<Retired> inFlight;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Boilerplate/VertexQuantization.h"
+
 #include <glm/glm.hpp>
 
 struct Vertex {
@@ -7,3 +9,20 @@ struct Vertex {
     glm::vec3 normal;
     glm::vec2 texCoord;
 };
+
+// Half the size of Vertex: R16G16B16A16_UNORM position inside the mesh bounds,
+// R16G16_SNORM octahedral normal and R16G16_SFLOAT texture coordinates
+struct QuantizedVertex {
+    glm::u16vec4 pos;
+    glm::i16vec2 normal;
+    glm::u16vec2 texCoord;
+};
+
+inline QuantizedVertex quantizeVertex(Vertex const& vertex, QuantizationBounds const& bounds)
+{
+    QuantizedVertex quantized;
+    quantized.pos = quantizePosition(vertex.pos, bounds);
+    quantized.normal = encodeOctahedral(vertex.normal);
+    quantized.texCoord = quantizeHalf(vertex.texCoord);
+    return quantized;
+}
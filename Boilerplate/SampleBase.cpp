@@ -2,7 +2,9 @@
 #include "SampleBase.h"
 #include "Logger.h"
 
+#include <array>
 #include <chrono>
+#include <fstream>
 #include <stdio.h>
 #include <vector>
 
@@ -13,6 +15,7 @@ static void checkRequiredInstanceExtensionsSupport(std::vector<char const*> cons
 
 static VkDescriptorPool g_DescriptorPool = VK_NULL_HANDLE;
 static bool show_demo_window = true;
+static bool show_memory_window = true;
 static ImDrawData* draw_data;
 
 SampleBase::SampleBase(u32 width, u32 height, std::string const& name) :
@@ -26,12 +29,23 @@ SampleBase::SampleBase(u32 width, u32 height, std::string const& name) :
 
 void SampleBase::onInit(HINSTANCE hInstance, HWND hWnd)
 {
+    threadPool.create();
+    globals.threadPool = &threadPool;
+    imageDecoder.create(&threadPool);
+    globals.imageDecoder = &imageDecoder;
     createInstance();
 #ifdef _DEBUG
     debugMessenger.create(globals);
 #endif
     createSurface(hInstance, hWnd);
     device.create(globals);
+    memoryAllocator.create(globals);
+    globals.memoryAllocator = &memoryAllocator;
+    uploadQueue.create(globals);
+    globals.uploadQueue = &uploadQueue;
+    frameAllocator.create(globals);
+    globals.frameAllocator = &frameAllocator;
+    globals.deletionQueue = &deletionQueue;
     createRenderPass();
     swapchain.create(globals);
     createGraphicsCommandBuffers();
@@ -42,6 +56,7 @@ void SampleBase::onInit(HINSTANCE hInstance, HWND hWnd)
     createRenderObjects();
     createLights();
     createFrameResources();
+    initialUploads = uploadQueue.flush(globals);
     createResourceDescriptors();
     createPushConstantRanges();
     createPipelines();
@@ -90,6 +105,9 @@ void SampleBase::onUpdate()
     if (show_demo_window)
         ImGui::ShowDemoWindow(&show_demo_window);
 
+    if (show_memory_window)
+        drawMemoryStatistics();
+
     ImGui::Render();
     draw_data = ImGui::GetDrawData();
 
@@ -99,6 +117,7 @@ void SampleBase::onUpdate()
 void SampleBase::onDestroy()
 {
     vkDeviceWaitIdle(globals.device.handle);
+    deletionQueue.destroy(globals);
 
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -114,12 +133,17 @@ void SampleBase::onDestroy()
     destroyGraphicsCommandBuffers();
     swapchain.destroy(globals);
     destroyRenderPass();
+    frameAllocator.destroy(globals);
+    uploadQueue.destroy(globals);
+    memoryAllocator.destroy(globals);
     device.destroy(globals);
     destroySurface();
 #ifdef _DEBUG
     debugMessenger.destroy(globals);
 #endif
     destroyInstance();
+    imageDecoder.destroy();
+    threadPool.destroy();
 }
 
 void SampleBase::onNotify(EventType type, EventContext context)
@@ -127,15 +151,10 @@ void SampleBase::onNotify(EventType type, EventContext context)
     switch (type) {
     case EventType::WINDOW_RESIZE:
         if (globals.device.handle != VK_NULL_HANDLE) {
-            vkDeviceWaitIdle(globals.device.handle);
+            // The surface format is unchanged and viewport and scissor are dynamic,
+            // so the render pass and the pipelines stay valid and only the swapchain is replaced
             globals.swapchain.extent = { (u16)context.i16[0], (u16)context.i16[1] };
-            destroyRenderPass();
-            createRenderPass();
-            swapchain.destroy(globals);
-            swapchain.create(globals);
-            destroyPipelines();
-            createPipelines();
-            LOG_DEBUG("Swapchain recreated");
+            swapchain.recreate(globals, deletionQueue);
         }
         return;
 
@@ -340,13 +359,17 @@ void SampleBase::createSynchronizationObjects()
 void SampleBase::drawFrame()
 {
     static u32 frameIndex = 0;
-    updateFrameResources(frameIndex);
 
     THROW_IF_FAILED(
         vkWaitForFences(globals.device.handle, 1, &globals.synchronization.fences.previousFrameFinished[frameIndex], VK_TRUE, UINT64_MAX),
         __FILE__, __LINE__,
         "Failed to wait for fences");
 
+    // The GPU is done with this frame's allocations once its fence has signaled
+    frameAllocator.reset(frameIndex);
+    deletionQueue.collect(globals);
+    updateFrameResources(frameIndex);
+
     u32 imageIndex;
     auto result = vkAcquireNextImageKHR(
         globals.device.handle, globals.swapchain.handle,
@@ -367,13 +390,29 @@ void SampleBase::drawFrame()
     vkResetCommandBuffer(globals.graphicsCommandBuffer.buffers[frameIndex], 0);
     recordCommandBuffer(globals.graphicsCommandBuffer.buffers[frameIndex], imageIndex, frameIndex, draw_data);
 
-    VkPipelineStageFlags waitPipelineStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Anything streamed in at runtime is checked for completion by its owner before it is drawn,
+    // only the uploads made during initialization gate every frame
+    uploadQueue.flush(globals);
+    std::array<VkSemaphore, 2> waitSemaphores = { globals.synchronization.semaphores.imageAcquired[frameIndex], uploadQueue.getTimeline() };
+    std::array<u64, 2> waitValues = { 0, initialUploads };
+    std::array<VkPipelineStageFlags, 2> waitPipelineStages = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.pNext = nullptr;
+    timelineSubmitInfo.waitSemaphoreValueCount = waitValues.size();
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = 0;
+    timelineSubmitInfo.pSignalSemaphoreValues = nullptr;
+
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &globals.synchronization.semaphores.imageAcquired[frameIndex];
-    submitInfo.pWaitDstStageMask = &waitPipelineStage;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = waitSemaphores.size();
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitPipelineStages.data();
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &globals.graphicsCommandBuffer.buffers[frameIndex];
     submitInfo.signalSemaphoreCount = 1;
@@ -383,6 +422,7 @@ void SampleBase::drawFrame()
         vkQueueSubmit(globals.device.queues.graphics.handle, 1, &submitInfo, globals.synchronization.fences.previousFrameFinished[frameIndex]),
         __FILE__, __LINE__,
         "Failed to queue submit");
+    deletionQueue.nextFrame();
 
     VkPresentInfoKHR presentInfo;
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -399,6 +439,61 @@ void SampleBase::drawFrame()
     result = vkQueuePresentKHR(globals.device.queues.present.handle, &presentInfo);
 }
 
+void SampleBase::drawMemoryStatistics()
+{
+    static auto const toMiB = [](VkDeviceSize bytes) { return static_cast<float>(bytes) / (1024.f * 1024.f); };
+
+    if (!ImGui::Begin("Memory", &show_memory_window)) {
+        ImGui::End();
+        return;
+    }
+
+    auto stats = memoryAllocator.getStats(globals);
+    if (!globals.device.support.memoryBudget) {
+        ImGui::TextUnformatted("VK_EXT_memory_budget unavailable, budgets are heap sizes");
+    }
+
+    if (ImGui::CollapsingHeader("Heaps", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (u32 i = 0; i < stats.heaps.size(); ++i) {
+            auto const& heap = stats.heaps[i];
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", toMiB(heap.processUsage), toMiB(heap.budget));
+            ImGui::Text("Heap %u (%.0f MiB)", i, toMiB(heap.size));
+            ImGui::ProgressBar(heap.budget ? static_cast<float>(heap.processUsage) / heap.budget : 0.f, ImVec2(-1.f, 0.f), overlay);
+            ImGui::Text("Blocks %.1f MiB, %u allocations %.1f MiB", toMiB(heap.blockBytes), heap.usage.allocationCount, toMiB(heap.usage.allocationBytes));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Memory types")) {
+        for (u32 i = 0; i < stats.types.size(); ++i) {
+            auto const& type = stats.types[i];
+            if (type.blockCount == 0) {
+                continue;
+            }
+            ImGui::Text("Type %u (heap %u, flags 0x%x): %u blocks %.1f MiB, %u allocations %.1f MiB",
+                i, type.heapIndex, type.propertyFlags,
+                type.blockCount, toMiB(type.blockBytes),
+                type.usage.allocationCount, toMiB(type.usage.allocationBytes));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Categories", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (u32 i = 0; i < stats.categories.size(); ++i) {
+            ImGui::Text("%-10s %5u allocations %8.1f MiB",
+                memoryCategoryToString(static_cast<MemoryCategory>(i)),
+                stats.categories[i].allocationCount, toMiB(stats.categories[i].allocationBytes));
+        }
+    }
+
+    if (ImGui::Button("Dump to memory_stats.json")) {
+        std::ofstream file("memory_stats.json");
+        file << memoryAllocator.dumpStats(globals);
+        LOG_INFO("Memory statistics written to memory_stats.json");
+    }
+
+    ImGui::End();
+}
+
 void SampleBase::destroySynchronizationObjects()
 {
     for (u32 i = 0; i < framesInFlight; ++i) {
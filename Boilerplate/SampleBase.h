@@ -3,9 +3,15 @@
 #include "Defines.h"
 #include "Camera.h"
 #include "DebugMessenger.h"
+#include "DeletionQueue.h"
 #include "Device.h"
 #include "EventManager.h"
+#include "FrameAllocator.h"
+#include "ImageDecoder.h"
+#include "MemoryAllocator.h"
 #include "Swapchain.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
 
 #include <windows.h>
 #include <string>
@@ -35,6 +41,13 @@ protected:
 private:
     DebugMessenger debugMessenger;
     Device device;
+    MemoryAllocator memoryAllocator;
+    UploadQueue uploadQueue;
+    u64 initialUploads = 0;
+    FrameAllocator frameAllocator;
+    DeletionQueue deletionQueue;
+    ThreadPool threadPool;
+    ImageDecoder imageDecoder;
     Swapchain swapchain;
 
     void createInstance();
@@ -53,6 +66,7 @@ private:
     virtual void createPipelines() = 0;
 
     void drawFrame();
+    void drawMemoryStatistics();
     virtual void updateFrameResources(u32 frameIndex) = 0;
     virtual void recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex, u32 frameIndex, ImDrawData* draw_data) = 0;
 
@@ -0,0 +1,2 @@
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe GenerateMips.comp -o GenerateMips.spv
+pause
@@ -0,0 +1,243 @@
+#include "SkinningPass.h"
+#include "FrameAllocator.h"
+#include "Initializer.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <stdexcept>
+
+static constexpr u32 skinningGroupSize = 64;
+
+void SkinningPass::create(Context const& globals, std::string const& shaderFilename, u32 maxInstances)
+{
+    this->maxInstances = maxInstances;
+
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes(2);
+        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxInstances * framesInFlight * 6);
+        poolSizes[1] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, framesInFlight);
+        auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(maxInstances * framesInFlight + framesInFlight, poolSizes);
+        THROW_IF_FAILED(
+            vkCreateDescriptorPool(globals.device.handle, &descriptorPoolCreateInfo, globals.allocator, &descriptorPool),
+            __FILE__, __LINE__,
+            "Failed to create descriptor pool");
+    }
+    {
+        // Bind pose positions, normals, joints and weights, then skinned positions and normals
+        std::vector<VkDescriptorSetLayoutBinding> bindings(6);
+        for (u32 i = 0; i < bindings.size(); ++i) {
+            bindings[i] = Initializer::descriptorSetLayoutBinding(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        }
+        auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
+        THROW_IF_FAILED(
+            vkCreateDescriptorSetLayout(globals.device.handle, &descriptorSetLayoutCreateInfo, globals.allocator, &instanceSetLayout),
+            __FILE__, __LINE__,
+            "Failed to create descriptor set layout");
+    }
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(1);
+        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
+        THROW_IF_FAILED(
+            vkCreateDescriptorSetLayout(globals.device.handle, &descriptorSetLayoutCreateInfo, globals.allocator, &jointSetLayout),
+            __FILE__, __LINE__,
+            "Failed to create descriptor set layout");
+
+        std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, jointSetLayout);
+        auto descriptorSetAllocateInfo = Initializer::descriptorSetAllocateInfo(descriptorPool, framesInFlight, setLayouts);
+        jointDescriptorSets.resize(framesInFlight);
+        THROW_IF_FAILED(
+            vkAllocateDescriptorSets(globals.device.handle, &descriptorSetAllocateInfo, jointDescriptorSets.data()),
+            __FILE__, __LINE__,
+            "Failed to allocate descriptor sets");
+
+        for (u32 i = 0; i < framesInFlight; ++i) {
+            // The range runs to the end of the buffer, the dynamic offset picks the skin
+            std::vector<VkDescriptorBufferInfo> bufferDescriptors(1);
+            bufferDescriptors[0] = Initializer::descriptorBufferInfo(globals.frameAllocator->getBuffer(i).handle, 0);
+            std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+            descriptorWrites[0] = Initializer::writeDescriptorSet(
+                jointDescriptorSets[i],
+                0, 0, bufferDescriptors.size(),
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                nullptr, bufferDescriptors.data(), nullptr);
+            vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+    {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts(2);
+        descriptorSetLayouts[0] = instanceSetLayout;
+        descriptorSetLayouts[1] = jointSetLayout;
+        std::vector<VkPushConstantRange> pushConstantRanges(1);
+        pushConstantRanges[0].offset = 0;
+        pushConstantRanges[0].size = sizeof(PushConstants);
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        auto pipelineLayoutCreateInfo = Initializer::pipelineLayoutCreateInfo(descriptorSetLayouts, pushConstantRanges);
+        THROW_IF_FAILED(
+            vkCreatePipelineLayout(globals.device.handle, &pipelineLayoutCreateInfo, globals.allocator, &pipelineLayout),
+            __FILE__, __LINE__,
+            "Failed to create pipeline layout");
+
+        VkShaderModule shaderModule;
+        auto code = loadShaderCode(shaderFilename);
+        auto shaderModuleCreateInfo = Initializer::shaderModuleCreateInfo(code);
+        THROW_IF_FAILED(
+            vkCreateShaderModule(globals.device.handle, &shaderModuleCreateInfo, globals.allocator, &shaderModule),
+            __FILE__, __LINE__,
+            "Failed to create shader module");
+
+        VkComputePipelineCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.flags = 0;
+        createInfo.stage = Initializer::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+        createInfo.layout = pipelineLayout;
+        createInfo.basePipelineHandle = VK_NULL_HANDLE;
+        createInfo.basePipelineIndex = -1;
+        THROW_IF_FAILED(
+            vkCreateComputePipelines(globals.device.handle, VK_NULL_HANDLE, 1, &createInfo, globals.allocator, &pipeline),
+            __FILE__, __LINE__,
+            "Failed to create compute pipeline");
+
+        vkDestroyShaderModule(globals.device.handle, shaderModule, globals.allocator);
+    }
+    LOG_DEBUG("Skinning pass successfully created");
+}
+
+void SkinningPass::destroy(Context const& globals)
+{
+    for (auto& instance : instances) {
+        for (u32 i = 0; i < framesInFlight; ++i) {
+            destroyBuffer(globals, instance.positions[i]);
+            destroyBuffer(globals, instance.normals[i]);
+        }
+    }
+    instances.clear();
+    jointDescriptorSets.clear();
+
+    vkDestroyPipeline(globals.device.handle, pipeline, globals.allocator);
+    vkDestroyPipelineLayout(globals.device.handle, pipelineLayout, globals.allocator);
+    vkDestroyDescriptorSetLayout(globals.device.handle, jointSetLayout, globals.allocator);
+    vkDestroyDescriptorSetLayout(globals.device.handle, instanceSetLayout, globals.allocator);
+    vkDestroyDescriptorPool(globals.device.handle, descriptorPool, globals.allocator);
+    LOG_DEBUG("Skinning pass destroyed");
+}
+
+u32 SkinningPass::addInstance(Context const& globals, GltfModel const& model, GltfModel::AnimationInstance const& animation)
+{
+    if (instances.size() == maxInstances) {
+        throw std::runtime_error("Too many skinning pass instances");
+    }
+    if (model.skinnedVertexCount == 0) {
+        throw std::runtime_error("Model has no skinned vertices");
+    }
+
+    Instance instance;
+    instance.model = &model;
+    instance.animation = &animation;
+
+    auto vertexCount = model.skinnedVertexCount;
+    auto normalSize = model.vertexFormat == VertexFormat::QUANTIZED ? sizeof(glm::i16vec2) : sizeof(glm::vec3);
+    instance.positions.resize(framesInFlight);
+    instance.normals.resize(framesInFlight);
+    for (u32 i = 0; i < framesInFlight; ++i) {
+        instance.positions[i].size = vertexCount * sizeof(glm::vec3);
+        instance.positions[i].usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        instance.positions[i].memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        createBuffer(globals, instance.positions[i]);
+
+        instance.normals[i].size = vertexCount * normalSize;
+        instance.normals[i].usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        instance.normals[i].memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        createBuffer(globals, instance.normals[i]);
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, instanceSetLayout);
+    auto descriptorSetAllocateInfo = Initializer::descriptorSetAllocateInfo(descriptorPool, framesInFlight, setLayouts);
+    instance.descriptorSets.resize(framesInFlight);
+    THROW_IF_FAILED(
+        vkAllocateDescriptorSets(globals.device.handle, &descriptorSetAllocateInfo, instance.descriptorSets.data()),
+        __FILE__, __LINE__,
+        "Failed to allocate descriptor sets");
+
+    for (u32 i = 0; i < framesInFlight; ++i) {
+        std::vector<VkDescriptorBufferInfo> bufferDescriptors(6);
+        bufferDescriptors[0] = Initializer::descriptorBufferInfo(model.skinningBuffers.positions.handle, 0);
+        bufferDescriptors[1] = Initializer::descriptorBufferInfo(model.skinningBuffers.normals.handle, 0);
+        bufferDescriptors[2] = Initializer::descriptorBufferInfo(model.skinningBuffers.joints.handle, 0);
+        bufferDescriptors[3] = Initializer::descriptorBufferInfo(model.skinningBuffers.weights.handle, 0);
+        bufferDescriptors[4] = Initializer::descriptorBufferInfo(instance.positions[i].handle, 0);
+        bufferDescriptors[5] = Initializer::descriptorBufferInfo(instance.normals[i].handle, 0);
+        std::vector<VkWriteDescriptorSet> descriptorWrites(bufferDescriptors.size());
+        for (u32 j = 0; j < descriptorWrites.size(); ++j) {
+            descriptorWrites[j] = Initializer::writeDescriptorSet(
+                instance.descriptorSets[i],
+                j, 0, 1,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                nullptr, &bufferDescriptors[j], nullptr);
+        }
+        vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    }
+
+    instances.push_back(instance);
+    return instances.size() - 1;
+}
+
+void SkinningPass::record(VkCommandBuffer commandBuffer, u32 frameIndex)
+{
+    bool dispatched = false;
+    for (auto& instance : instances) {
+        if (instance.model->skinnedRanges.empty() || instance.skinnedPoseVersion == instance.animation->poseVersion) {
+            continue;
+        }
+
+        if (!dispatched) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            dispatched = true;
+        }
+
+        // The copy after the drawn one was last drawn before the previous write, by a frame that has finished
+        instance.current = (instance.current + 1) % framesInFlight;
+        instance.skinnedPoseVersion = instance.animation->poseVersion;
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            pipelineLayout,
+            0, 1, &instance.descriptorSets[instance.current],
+            0, nullptr);
+
+        for (auto const& range : instance.model->skinnedRanges) {
+            u32 jointOffset = instance.animation->jointMatrixOffsets[range.skinIndex];
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                1, 1, &jointDescriptorSets[frameIndex],
+                1, &jointOffset);
+
+            PushConstants pushConstants;
+            pushConstants.firstVertex = range.firstVertex;
+            pushConstants.vertexCount = range.vertexCount;
+            pushConstants.quantizedNormals = instance.model->vertexFormat == VertexFormat::QUANTIZED ? 1 : 0;
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+            vkCmdDispatch(commandBuffer, (range.vertexCount + skinningGroupSize - 1) / skinningGroupSize, 1, 1);
+        }
+    }
+
+    if (!dispatched) {
+        return;
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
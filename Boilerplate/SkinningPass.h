@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Defines.h"
+#include "GltfModel.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+// Deforms the skinned vertices of GltfModel instances in a compute pre-pass, once per frame and instance.
+// Every later pass draws the skinned positions and normals with GltfModel::bindSkinnedVertexBuffers instead of
+// skinning in its own vertex shader, and instances whose pose did not change since their last dispatch are skipped.
+class SkinningPass {
+public:
+    void create(Context const& globals, std::string const& shaderFilename, u32 maxInstances = 64);
+    void destroy(Context const& globals);
+
+    // The model must have called loadSkinning, both must outlive the pass
+    u32 addInstance(Context const& globals, GltfModel const& model, GltfModel::AnimationInstance const& animation);
+
+    // Call outside of a render pass, after GltfModel::uploadJointMatrices of the frame
+    void record(VkCommandBuffer commandBuffer, u32 frameIndex);
+
+    Buffer const& getPositions(u32 instance) const { return instances[instance].positions[instances[instance].current]; }
+    Buffer const& getNormals(u32 instance) const { return instances[instance].normals[instances[instance].current]; }
+
+private:
+    struct Instance {
+        GltfModel const* model = nullptr;
+        GltfModel::AnimationInstance const* animation = nullptr;
+        // framesInFlight copies written round robin, so a copy is only overwritten once no frame in flight draws it
+        std::vector<Buffer> positions;
+        std::vector<Buffer> normals;
+        std::vector<VkDescriptorSet> descriptorSets;
+        u32 current = 0;
+        u64 skinnedPoseVersion = ~0ull;
+    };
+
+    struct PushConstants {
+        u32 firstVertex;
+        u32 vertexCount;
+        u32 quantizedNormals;
+    };
+
+    std::vector<Instance> instances;
+    u32 maxInstances = 0;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    // Set 0: bind pose streams and the outputs of one copy, set 1: joint matrices in the frame allocator
+    VkDescriptorSetLayout instanceSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout jointSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> jointDescriptorSets;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
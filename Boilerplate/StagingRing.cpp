@@ -0,0 +1,115 @@
+#include "StagingRing.h"
+#include "Logger.h"
+#include "Utils.h"
+
+void StagingRing::create(Context const& globals, VkSemaphore timeline, VkDeviceSize capacity)
+{
+    this->timeline = timeline;
+
+    buffer.size = capacity;
+    buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    createBuffer(globals, buffer);
+    LOG_DEBUG("Staging ring successfully created");
+}
+
+void StagingRing::destroy(Context const& globals)
+{
+    inFlight.clear();
+    destroyBuffer(globals, buffer);
+    LOG_DEBUG("Staging ring destroyed");
+}
+
+void* StagingRing::allocate(Context const& globals, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (size > buffer.size) {
+        LOG_ERROR("Staging request of %llu bytes exceeds ring capacity", static_cast<unsigned long long>(size));
+        throw std::runtime_error("Staging request exceeds ring capacity");
+    }
+
+    retire(globals, false);
+    while (!tryAllocate(size, alignment, offset)) {
+        if (inFlight.empty()) {
+            return nullptr;
+        }
+        retire(globals, true);
+    }
+
+    pending = true;
+    return static_cast<u8*>(buffer.mapped) + offset;
+}
+
+void StagingRing::submit(u64 value)
+{
+    if (!pending) {
+        return;
+    }
+
+    Region region;
+    region.value = value;
+    region.end = head;
+    inFlight.push_back(region);
+    pending = false;
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (inFlight.empty() && !pending) {
+        head = 0;
+        tail = 0;
+    }
+
+    auto alignedHead = (head + alignment - 1) / alignment * alignment;
+    bool empty = inFlight.empty() && !pending;
+    if (head >= tail && (empty || head != tail)) {
+        // Free space is [head, capacity) followed by [0, tail)
+        if (alignedHead + size <= buffer.size) {
+            offset = alignedHead;
+        } else if (size <= tail) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (head < tail && alignedHead + size <= tail) {
+        offset = alignedHead;
+    } else {
+        return false;
+    }
+
+    head = offset + size;
+    return true;
+}
+
+void StagingRing::retire(Context const& globals, bool wait)
+{
+    if (inFlight.empty()) {
+        return;
+    }
+
+    u64 completedValue;
+    THROW_IF_FAILED(
+        vkGetSemaphoreCounterValue(globals.device.handle, timeline, &completedValue),
+        __FILE__, __LINE__,
+        "Failed to get semaphore counter value");
+
+    if (wait && inFlight.front().value > completedValue) {
+        completedValue = inFlight.front().value;
+
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.pNext = nullptr;
+        waitInfo.flags = 0;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline;
+        waitInfo.pValues = &completedValue;
+        THROW_IF_FAILED(
+            vkWaitSemaphores(globals.device.handle, &waitInfo, UINT64_MAX),
+            __FILE__, __LINE__,
+            "Failed to wait for semaphores");
+    }
+
+    while (!inFlight.empty() && inFlight.front().value <= completedValue) {
+        tail = inFlight.front().end;
+        inFlight.pop_front();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Defines.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <deque>
+
+// Persistently mapped upload buffer shared by every staging copy.
+// Space is handed out front to back and wraps around; regions are recycled once the timeline semaphore
+// reaches the value of the submission that read them, and allocate() blocks on the oldest one when the ring is full.
+class StagingRing {
+public:
+    void create(Context const& globals, VkSemaphore timeline, VkDeviceSize capacity = 32ull * 1024 * 1024);
+    void destroy(Context const& globals);
+
+    // Returns nullptr when the only way to make room is to submit what has been allocated so far
+    void* allocate(Context const& globals, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    // Everything allocated since the previous call is reusable once the timeline reaches value
+    void submit(u64 value);
+
+    Buffer buffer;
+
+private:
+    struct Region {
+        u64 value = 0;
+        VkDeviceSize end = 0;
+    };
+
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    bool pending = false;
+
+    std::deque<Region> inFlight;
+
+    bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void retire(Context const& globals, bool wait);
+};
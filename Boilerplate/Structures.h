@@ -7,6 +7,13 @@
 #include <optional>
 #include <vector>
 
+class MemoryAllocator;
+class UploadQueue;
+class FrameAllocator;
+class DeletionQueue;
+class ThreadPool;
+class ImageDecoder;
+
 enum class PhysicalDeviceType {
     DISCRETE,
     INTEGRATED,
@@ -18,9 +25,33 @@ struct ContextConfig {
     PhysicalDeviceType physicalDeviceType = PhysicalDeviceType::DISCRETE;
 };
 
+// What an allocation is used for, only for memory statistics
+enum class MemoryCategory {
+    VERTEX,
+    INDEX,
+    UNIFORM,
+    STORAGE,
+    STAGING,
+    TEXTURE,
+    ATTACHMENT,
+    OTHER,
+    COUNT
+};
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    u32 memoryTypeIndex = ~0u;
+    u32 block = ~0u; // ~0u for dedicated allocations
+    u32 node = ~0u;
+    void* mapped = nullptr;
+    MemoryCategory category = MemoryCategory::OTHER;
+};
+
 struct Buffer {
     VkBuffer handle = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     VkDeviceSize size = 0;
     VkBufferUsageFlags usage = 0;
     VkMemoryPropertyFlags memoryProperties = 0;
@@ -30,7 +61,7 @@ struct Buffer {
 
 struct Image {
     VkImage handle = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     VkImageCreateFlags flags = 0;
     VkImageType imageType = VK_IMAGE_TYPE_2D;
     VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
@@ -79,6 +110,12 @@ struct Texture {
 
 struct Context {
     VkAllocationCallbacks* allocator;
+    MemoryAllocator* memoryAllocator = nullptr;
+    UploadQueue* uploadQueue = nullptr;
+    FrameAllocator* frameAllocator = nullptr;
+    DeletionQueue* deletionQueue = nullptr;
+    ThreadPool* threadPool = nullptr;
+    ImageDecoder* imageDecoder = nullptr;
 
 #ifdef _DEBUG
     VkDebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo = {};
@@ -88,11 +125,13 @@ struct Context {
 
     struct {
         VkDevice handle = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 
         struct {
             VkPhysicalDeviceProperties properties;
             VkPhysicalDeviceFeatures features;
             VkPhysicalDeviceMemoryProperties memoryProperties;
+            bool memoryBudget = false; // VK_EXT_memory_budget
         } support;
 
         struct {
@@ -163,11 +202,17 @@ struct Mesh {
         u32 indexCount = 0;
         u32 firstIndex = 0;
         i32 vertexOffset = 0;
+        u32 firstMeshlet = 0;
+        u32 meshletCount = 0;
     };
     std::vector<DrawArgs> submeshes;
 
     Buffer vertexBuffer;
     Buffer indexBuffer;
+    // Clusters from buildMeshlets, storage buffers for cluster culling
+    Buffer meshletBuffer;
+    Buffer meshletVertexBuffer;
+    Buffer meshletTriangleBuffer;
 };
 
 struct DirLight {
@@ -243,9 +288,10 @@ struct RenderObject {
 };
 
 struct FrameResource {
-    Buffer passBuffer;
+    // Offsets into the frame allocator buffer of the frame, refreshed every frame
+    u32 passOffset = 0;
+    u32 spotLightOffset = 0;
     Buffer dirLightBuffer;
-    Buffer spotLightBuffer;
     Buffer pointLightBuffer;
     Buffer materialBuffer;
     Buffer renderObjectBuffer;
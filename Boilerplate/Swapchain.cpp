@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include "DeletionQueue.h"
 #include "Swapchain.h"
 
 #include <set>
@@ -31,7 +32,7 @@ void Swapchain::create(Context& globals)
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = globals.swapchain.presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = globals.swapchain.handle;
 
     THROW_IF_FAILED(
         vkCreateSwapchainKHR(globals.device.handle, &createInfo, globals.allocator, &globals.swapchain.handle),
@@ -86,7 +87,7 @@ void Swapchain::create(Context& globals)
     globals.swapchain.framebuffers.resize(globals.swapchain.imageViews.size());
 
     for (u32 i = 0; i < globals.swapchain.imageViews.size(); ++i) {
-        std::vector<VkImageView> attachments = { globals.swapchain.imageViews[i], globals.swapchain.depthStencilBuffer.view };
+        std::vector<VkImageView> attachments = { globals.swapchain.imageViews[i], globals.swapchain.depthStencilBuffer.view.handle };
         VkFramebufferCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         createInfo.pNext = nullptr;
@@ -108,17 +109,30 @@ void Swapchain::create(Context& globals)
 
 void Swapchain::destroy(Context const& globals)
 {
-    for (auto framebuffer : globals.swapchain.framebuffers) {
+    destroyResources(globals, globals.swapchain);
+}
+
+void Swapchain::recreate(Context& globals, DeletionQueue& deletionQueue)
+{
+    Resources retired = globals.swapchain;
+    create(globals);
+    deletionQueue.push([retired](Context const& globals) { destroyResources(globals, retired); });
+    LOG_DEBUG("Swapchain recreated");
+}
+
+void Swapchain::destroyResources(Context const& globals, Resources const& resources)
+{
+    for (auto framebuffer : resources.framebuffers) {
         vkDestroyFramebuffer(globals.device.handle, framebuffer, globals.allocator);
     }
     LOG_DEBUG("Framebuffer destroyed");
-    destroyImage(globals, globals.swapchain.depthStencilBuffer);
-    vkDestroyImageView(globals.device.handle, globals.swapchain.depthStencilBuffer.view, globals.allocator);
+    destroyImage(globals, resources.depthStencilBuffer);
+    vkDestroyImageView(globals.device.handle, resources.depthStencilBuffer.view.handle, globals.allocator);
     LOG_DEBUG("Depth buffer destroyed");
-    for (auto imageView : globals.swapchain.imageViews) {
+    for (auto imageView : resources.imageViews) {
         vkDestroyImageView(globals.device.handle, imageView, globals.allocator);
     }
     LOG_DEBUG("Swapchain image views destroyed");
-    vkDestroySwapchainKHR(globals.device.handle, globals.swapchain.handle, globals.allocator);
+    vkDestroySwapchainKHR(globals.device.handle, resources.handle, globals.allocator);
     LOG_DEBUG("Swapchain destroyed");
 }
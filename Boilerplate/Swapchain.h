@@ -3,8 +3,18 @@
 #include "Defines.h"
 #include "Structures.h"
 
+class DeletionQueue;
+
 class Swapchain {
 public:
     void create(Context& globals);
     void destroy(Context const& globals);
+    // Creates the new swapchain from the current one and hands the old objects to the deletion queue,
+    // so a resize does not have to wait for the device to go idle
+    void recreate(Context& globals, DeletionQueue& deletionQueue);
+
+private:
+    using Resources = decltype(Context::swapchain);
+
+    static void destroyResources(Context const& globals, Resources const& resources);
 };
@@ -0,0 +1,170 @@
+#include "TextureStreamer.h"
+#include "BlockCompression.h"
+#include "DeletionQueue.h"
+#include "Logger.h"
+#include "UploadQueue.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+void releaseImage(Context const& globals, Image const& image)
+{
+    vkDestroySampler(globals.device.handle, image.sampler.handle, globals.allocator);
+    vkDestroyImageView(globals.device.handle, image.view.handle, globals.allocator);
+    destroyImage(globals, image);
+}
+
+}
+
+void TextureStreamer::create(Context const& globals, VkDeviceSize budget, u32 tailSize, u32 maxUploadsPerFrame)
+{
+    this->budget = budget;
+    this->tailSize = tailSize;
+    this->maxUploadsPerFrame = maxUploadsPerFrame;
+    residentBytes = 0;
+    LOG_DEBUG("Texture streamer successfully created with a budget of %llu bytes", static_cast<unsigned long long>(budget));
+}
+
+void TextureStreamer::destroy(Context const& globals)
+{
+    for (auto& texture : textures) {
+        releaseImage(globals, texture.image);
+        if (texture.pending) {
+            releaseImage(globals, texture.pendingImage);
+        }
+    }
+    textures.clear();
+    residentBytes = 0;
+    LOG_DEBUG("Texture streamer destroyed");
+}
+
+u32 TextureStreamer::addTexture(Context const& globals, MipChain chain)
+{
+    Texture texture;
+    texture.mipCount = chain.offsets.size();
+    while (texture.tailMip + 1 < texture.mipCount &&
+        std::max(chain.width >> texture.tailMip, chain.height >> texture.tailMip) > tailSize) {
+        ++texture.tailMip;
+    }
+    texture.chain = std::move(chain);
+    texture.residentMip = texture.tailMip;
+    texture.requestedMip = texture.mipCount;
+
+    createResidentImage(globals, texture, texture.tailMip, texture.image);
+    residentBytes += getLevelsSize(texture, texture.tailMip);
+
+    textures.push_back(std::move(texture));
+    return textures.size() - 1;
+}
+
+void TextureStreamer::request(u32 texture, float uvPerPixel)
+{
+    auto& t = textures[texture];
+    auto texelsPerPixel = uvPerPixel * std::max(t.chain.width, t.chain.height);
+    u32 mip = 0;
+    if (texelsPerPixel > 1.f) {
+        mip = std::min(static_cast<u32>(std::log2(texelsPerPixel)), t.mipCount - 1);
+    }
+    t.requestedMip = std::min(t.requestedMip, mip);
+}
+
+void TextureStreamer::update(Context const& globals)
+{
+    for (auto& texture : textures) {
+        if (texture.pending && globals.uploadQueue->isComplete(globals, texture.pendingTicket)) {
+            residentBytes -= getLevelsSize(texture, texture.residentMip);
+            globals.deletionQueue->destroyImage(texture.image);
+            texture.image = texture.pendingImage;
+            texture.pendingImage = Image();
+            texture.residentMip = texture.pendingMip;
+            texture.pending = false;
+            ++version;
+        }
+    }
+
+    // Evictions first, their memory comes back once the smaller images are swapped in
+    std::vector<u32> started;
+    // Missing levels and texture index
+    std::vector<std::pair<u32, u32>> candidates;
+    for (u32 i = 0; i < textures.size(); ++i) {
+        auto& texture = textures[i];
+        auto wanted = std::min(texture.requestedMip, texture.tailMip);
+        texture.requestedMip = texture.mipCount;
+        if (texture.pending) {
+            continue;
+        }
+        if (texture.residentMip < wanted && started.size() < maxUploadsPerFrame) {
+            startUpload(globals, texture, wanted);
+            started.push_back(i);
+        } else if (wanted < texture.residentMip) {
+            candidates.emplace_back(texture.residentMip - wanted, i);
+        }
+    }
+
+    // One level finer per upload, the texture that misses the most levels first
+    std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<u32, u32>>());
+    for (auto const& [gap, i] : candidates) {
+        if (started.size() == maxUploadsPerFrame) {
+            break;
+        }
+        auto& texture = textures[i];
+        auto mip = texture.residentMip - 1;
+        if (residentBytes + getLevelsSize(texture, mip) > budget) {
+            continue;
+        }
+        startUpload(globals, texture, mip);
+        started.push_back(i);
+    }
+
+    if (!started.empty()) {
+        auto ticket = globals.uploadQueue->flush(globals);
+        for (auto i : started) {
+            textures[i].pendingTicket = ticket;
+        }
+    }
+}
+
+VkDeviceSize TextureStreamer::getLevelsSize(Texture const& texture, u32 firstMip) const
+{
+    return texture.chain.pixels.size() - texture.chain.offsets[firstMip];
+}
+
+void TextureStreamer::createResidentImage(Context const& globals, Texture& texture, u32 firstMip, Image& image) const
+{
+    image = Image();
+    image.width = std::max(texture.chain.width >> firstMip, 1u);
+    image.height = std::max(texture.chain.height >> firstMip, 1u);
+    image.format = texture.chain.format;
+    image.mipLevels = texture.mipCount - firstMip;
+    image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createImage(globals, image);
+
+    auto base = texture.chain.offsets[firstMip];
+    if (getBlockSize(texture.chain.format) != 0) {
+        // Blocks cannot be blitted, every resident level is uploaded
+        std::vector<VkDeviceSize> mipOffsets(image.mipLevels);
+        for (u32 i = 0; i < mipOffsets.size(); ++i) {
+            mipOffsets[i] = texture.chain.offsets[firstMip + i] - base;
+        }
+        globals.uploadQueue->uploadImage(globals, texture.chain.pixels.data() + base, getLevelsSize(texture, firstMip), image, mipOffsets);
+        return;
+    }
+
+    // Only the finest level goes through staging, the upload queue generates the coarser ones
+    auto size = static_cast<VkDeviceSize>(image.width) * image.height * 4;
+    globals.uploadQueue->uploadImage(globals, texture.chain.pixels.data() + base, size, image);
+}
+
+void TextureStreamer::startUpload(Context const& globals, Texture& texture, u32 firstMip)
+{
+    createResidentImage(globals, texture, firstMip, texture.pendingImage);
+    texture.pendingMip = firstMip;
+    texture.pending = true;
+    residentBytes += getLevelsSize(texture, firstMip);
+}
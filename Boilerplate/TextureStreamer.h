@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Defines.h"
+#include "MipChain.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// Streams the mip levels of textures between their system memory chains and VRAM. Every texture keeps its coarse
+// tail of levels no larger than tailSize resident; finer levels come in as requests ask for them and leave again
+// once nothing needs them, while the resident bytes stay inside the budget.
+// The image of a texture only holds its resident levels and is replaced when they change, so the views handed out
+// by getImage change too; getVersion tells when descriptors have to be rewritten.
+class TextureStreamer {
+public:
+    void create(Context const& globals, VkDeviceSize budget = 256ull * 1024 * 1024, u32 tailSize = 64, u32 maxUploadsPerFrame = 4);
+    void destroy(Context const& globals);
+
+    // Uploads the tail of the chain and returns the texture index
+    u32 addTexture(Context const& globals, MipChain chain);
+
+    // Texture coordinate units one screen pixel covers where the texture is drawn, which selects the finest level
+    // the frame samples. Call for every use of the texture before update.
+    void request(u32 texture, float uvPerPixel);
+    // Retires finished uploads, evicts levels no request needs and starts uploads of finer levels, coarsest gaps
+    // first. Call once per frame, after the frame's fence has signaled.
+    void update(Context const& globals);
+
+    u32 getTextureCount() const { return textures.size(); }
+    Image const& getImage(u32 texture) const { return textures[texture].image; }
+    u32 getResidentMip(u32 texture) const { return textures[texture].residentMip; }
+    VkDeviceSize getResidentBytes() const { return residentBytes; }
+    // Changes whenever the image of a texture was replaced
+    u64 getVersion() const { return version; }
+
+private:
+    struct Texture {
+        MipChain chain;
+        u32 mipCount = 0;
+        u32 tailMip = 0;
+        // First level held by image
+        u32 residentMip = 0;
+        // Finest level requested since the last update, mipCount when none was
+        u32 requestedMip = 0;
+
+        // Image with pendingMip as its first level, swapped in once pendingTicket completes
+        Image pendingImage;
+        u32 pendingMip = 0;
+        u64 pendingTicket = 0;
+        bool pending = false;
+
+        Image image;
+    };
+
+    VkDeviceSize getLevelsSize(Texture const& texture, u32 firstMip) const;
+    void createResidentImage(Context const& globals, Texture& texture, u32 firstMip, Image& image) const;
+    void startUpload(Context const& globals, Texture& texture, u32 firstMip);
+
+    std::vector<Texture> textures;
+    VkDeviceSize budget = 0;
+    // Includes the images of uploads in flight, which coexist with the images they replace
+    VkDeviceSize residentBytes = 0;
+    u32 tailSize = 0;
+    u32 maxUploadsPerFrame = 0;
+    u64 version = 0;
+};
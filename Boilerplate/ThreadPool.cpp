@@ -0,0 +1,127 @@
+#include "ThreadPool.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+void ThreadPool::create(u32 threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    stopping = false;
+    workers.reserve(threadCount);
+    for (u32 i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+    LOG_DEBUG("Thread pool successfully created (%u workers)", threadCount);
+}
+
+void ThreadPool::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    tasks.clear();
+    LOG_DEBUG("Thread pool destroyed");
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task)
+{
+    group.pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Task entry;
+        entry.group = &group;
+        entry.function = std::move(task);
+        tasks.push_back(std::move(entry));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (group.pending.load() != 0) {
+        if (!tasks.empty()) {
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            run(task);
+            lock.lock();
+            continue;
+        }
+        taskFinished.wait(lock);
+    }
+    lock.unlock();
+
+    if (group.exception) {
+        auto exception = group.exception;
+        group.exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void ThreadPool::parallelFor(u32 count, std::function<void(u32)> const& body)
+{
+    // A few batches per thread balance uneven items without paying for a task per item
+    u32 batchCount = std::min(count, (getThreadCount() + 1) * 4);
+    if (batchCount <= 1) {
+        for (u32 i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    TaskGroup group;
+    for (u32 batch = 0; batch < batchCount; ++batch) {
+        u32 begin = static_cast<u32>(static_cast<u64>(count) * batch / batchCount);
+        u32 end = static_cast<u32>(static_cast<u64>(count) * (batch + 1) / batchCount);
+        submit(group, [&body, begin, end]() {
+            for (u32 i = begin; i < end; ++i) {
+                body(i);
+            }
+        });
+    }
+    wait(group);
+}
+
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+        if (stopping) {
+            return;
+        }
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        run(task);
+        lock.lock();
+    }
+}
+
+void ThreadPool::run(Task& task)
+{
+    try {
+        task.function();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!task.group->exception) {
+            task.group->exception = std::current_exception();
+        }
+    }
+
+    // Notify under the lock so a waiter cannot miss the wakeup between its check and its wait
+    std::lock_guard<std::mutex> lock(mutex);
+    task.group->pending.fetch_sub(1);
+    taskFinished.notify_all();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU side loading work.
+// Tasks are submitted into a TaskGroup and waited on through it; a waiting thread runs queued tasks itself,
+// so waiting from inside a task cannot deadlock the pool.
+class ThreadPool {
+public:
+    struct TaskGroup {
+        std::atomic<u32> pending = 0;
+        std::exception_ptr exception;
+    };
+
+    // threadCount 0 uses one worker per hardware thread except the calling one
+    void create(u32 threadCount = 0);
+    void destroy();
+
+    void submit(TaskGroup& group, std::function<void()> task);
+    // Rethrows the first exception thrown by a task of the group
+    void wait(TaskGroup& group);
+    void parallelFor(u32 count, std::function<void(u32)> const& body);
+
+    u32 getThreadCount() const { return static_cast<u32>(workers.size()); }
+
+private:
+    struct Task {
+        TaskGroup* group = nullptr;
+        std::function<void()> function;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable taskFinished;
+    bool stopping = false;
+
+    void workerLoop();
+    void run(Task& task);
+};
@@ -0,0 +1,248 @@
+#include "TlsfAllocator.h"
+
+static u32 findMostSignificantBit(u64 value)
+{
+    u32 bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+static u32 findLeastSignificantBit(u64 value)
+{
+    u32 bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+}
+
+void TlsfAllocator::init(u64 capacity)
+{
+    this->capacity = capacity;
+    usedSize = 0;
+    allocationCount = 0;
+
+    nodes.clear();
+    unusedNodes.clear();
+
+    flBitmap = 0;
+    for (u32 i = 0; i < flCount; ++i) {
+        slBitmaps[i] = 0;
+        for (u32 j = 0; j < slCount; ++j) {
+            freeLists[i][j] = invalidNode;
+        }
+    }
+
+    auto node = createNode();
+    nodes[node].offset = 0;
+    nodes[node].size = capacity;
+    insertFree(node);
+}
+
+u32 TlsfAllocator::allocate(u64 size, u64 alignment, u64& offset)
+{
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment == 0) {
+        alignment = 1;
+    }
+
+    // Worst case the block start is one byte past an aligned address
+    auto node = findFree(size + alignment - 1);
+    if (node == invalidNode) {
+        return invalidNode;
+    }
+    removeFree(node);
+
+    auto alignedOffset = (nodes[node].offset + alignment - 1) / alignment * alignment;
+    auto padding = alignedOffset - nodes[node].offset;
+    if (padding > 0) {
+        auto paddingNode = createNode();
+        nodes[paddingNode].offset = nodes[node].offset;
+        nodes[paddingNode].size = padding;
+        nodes[paddingNode].prevPhysical = nodes[node].prevPhysical;
+        nodes[paddingNode].nextPhysical = node;
+        if (nodes[node].prevPhysical != invalidNode) {
+            nodes[nodes[node].prevPhysical].nextPhysical = paddingNode;
+        }
+        nodes[node].prevPhysical = paddingNode;
+        nodes[node].offset = alignedOffset;
+        nodes[node].size -= padding;
+        insertFree(paddingNode);
+    }
+
+    split(node, size);
+
+    nodes[node].used = true;
+    usedSize += nodes[node].size;
+    ++allocationCount;
+
+    offset = nodes[node].offset;
+    return node;
+}
+
+void TlsfAllocator::free(u32 node)
+{
+    nodes[node].used = false;
+    usedSize -= nodes[node].size;
+    --allocationCount;
+
+    auto prev = nodes[node].prevPhysical;
+    if (prev != invalidNode && !nodes[prev].used) {
+        removeFree(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[node].nextPhysical != invalidNode) {
+            nodes[nodes[node].nextPhysical].prevPhysical = prev;
+        }
+        releaseNode(node);
+        node = prev;
+    }
+
+    auto next = nodes[node].nextPhysical;
+    if (next != invalidNode && !nodes[next].used) {
+        removeFree(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[next].nextPhysical != invalidNode) {
+            nodes[nodes[next].nextPhysical].prevPhysical = node;
+        }
+        releaseNode(next);
+    }
+
+    insertFree(node);
+}
+
+u32 TlsfAllocator::createNode()
+{
+    if (!unusedNodes.empty()) {
+        auto node = unusedNodes.back();
+        unusedNodes.pop_back();
+        nodes[node] = Node();
+        return node;
+    }
+
+    nodes.emplace_back();
+    return static_cast<u32>(nodes.size() - 1);
+}
+
+void TlsfAllocator::releaseNode(u32 node)
+{
+    unusedNodes.push_back(node);
+}
+
+void TlsfAllocator::insertFree(u32 node)
+{
+    u32 fl;
+    u32 sl;
+    mapping(nodes[node].size, fl, sl);
+
+    auto head = freeLists[fl][sl];
+    nodes[node].prevFree = invalidNode;
+    nodes[node].nextFree = head;
+    if (head != invalidNode) {
+        nodes[head].prevFree = node;
+    }
+    freeLists[fl][sl] = node;
+
+    flBitmap |= 1ull << fl;
+    slBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(u32 node)
+{
+    u32 fl;
+    u32 sl;
+    mapping(nodes[node].size, fl, sl);
+
+    auto prev = nodes[node].prevFree;
+    auto next = nodes[node].nextFree;
+    if (prev != invalidNode) {
+        nodes[prev].nextFree = next;
+    }
+    if (next != invalidNode) {
+        nodes[next].prevFree = prev;
+    }
+
+    if (freeLists[fl][sl] == node) {
+        freeLists[fl][sl] = next;
+        if (next == invalidNode) {
+            slBitmaps[fl] &= ~(1u << sl);
+            if (slBitmaps[fl] == 0) {
+                flBitmap &= ~(1ull << fl);
+            }
+        }
+    }
+
+    nodes[node].prevFree = invalidNode;
+    nodes[node].nextFree = invalidNode;
+}
+
+u32 TlsfAllocator::findFree(u64 size)
+{
+    if (size > capacity - usedSize) {
+        return invalidNode;
+    }
+
+    // Round up to the next class so that any block found there is large enough
+    if (size < (1ull << minFlBits)) {
+        size += (1ull << (minFlBits - slBits)) - 1;
+    } else {
+        size += (1ull << (findMostSignificantBit(size) - slBits)) - 1;
+    }
+
+    u32 fl;
+    u32 sl;
+    mapping(size, fl, sl);
+    if (fl >= flCount) {
+        return invalidNode;
+    }
+
+    auto slMap = slBitmaps[fl] & (~0u << sl);
+    if (slMap == 0) {
+        auto flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0) {
+            return invalidNode;
+        }
+        fl = findLeastSignificantBit(flMap);
+        slMap = slBitmaps[fl];
+    }
+    sl = findLeastSignificantBit(slMap);
+
+    return freeLists[fl][sl];
+}
+
+void TlsfAllocator::split(u32 node, u64 size)
+{
+    if (nodes[node].size == size) {
+        return;
+    }
+
+    auto rest = createNode();
+    nodes[rest].offset = nodes[node].offset + size;
+    nodes[rest].size = nodes[node].size - size;
+    nodes[rest].prevPhysical = node;
+    nodes[rest].nextPhysical = nodes[node].nextPhysical;
+    if (nodes[node].nextPhysical != invalidNode) {
+        nodes[nodes[node].nextPhysical].prevPhysical = rest;
+    }
+    nodes[node].nextPhysical = rest;
+    nodes[node].size = size;
+    insertFree(rest);
+}
+
+void TlsfAllocator::mapping(u64 size, u32& fl, u32& sl)
+{
+    if (size < (1ull << minFlBits)) {
+        fl = 0;
+        sl = static_cast<u32>(size >> (minFlBits - slBits));
+    } else {
+        auto msb = findMostSignificantBit(size);
+        fl = msb - minFlBits + 1;
+        sl = static_cast<u32>(size >> (msb - slBits)) ^ slCount;
+    }
+}
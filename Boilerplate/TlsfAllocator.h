@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <vector>
+
+// Two-level segregated fit allocator over an abstract [0, capacity) range.
+// It only hands out offsets, so it does not depend on Vulkan and can be driven from plain CPU code.
+class TlsfAllocator {
+public:
+    static constexpr u32 invalidNode = ~0u;
+
+    void init(u64 capacity);
+
+    // Returns the node that owns the allocation or invalidNode if the range is exhausted.
+    u32 allocate(u64 size, u64 alignment, u64& offset);
+    void free(u32 node);
+
+    u64 getCapacity() const { return capacity; }
+    u64 getUsedSize() const { return usedSize; }
+    u32 getAllocationCount() const { return allocationCount; }
+    bool isEmpty() const { return allocationCount == 0; }
+
+private:
+    static constexpr u32 slBits = 5;
+    static constexpr u32 slCount = 1 << slBits;
+    static constexpr u32 minFlBits = 8;
+    static constexpr u32 flCount = 64 - minFlBits + 1;
+
+    struct Node {
+        u64 offset = 0;
+        u64 size = 0;
+        u32 prevPhysical = invalidNode;
+        u32 nextPhysical = invalidNode;
+        u32 prevFree = invalidNode;
+        u32 nextFree = invalidNode;
+        bool used = false;
+    };
+
+    u64 capacity = 0;
+    u64 usedSize = 0;
+    u32 allocationCount = 0;
+
+    std::vector<Node> nodes;
+    std::vector<u32> unusedNodes;
+
+    u64 flBitmap = 0;
+    u32 slBitmaps[flCount] = {};
+    u32 freeLists[flCount][slCount];
+
+    u32 createNode();
+    void releaseNode(u32 node);
+
+    void insertFree(u32 node);
+    void removeFree(u32 node);
+    u32 findFree(u64 size);
+    void split(u32 node, u64 size);
+
+    static void mapping(u64 size, u32& fl, u32& sl);
+};
@@ -0,0 +1,456 @@
+#include "UploadQueue.h"
+#include "BlockCompression.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+// Everything an upload can be consumed by in the graphics queue
+static VkPipelineStageFlags const consumerStages =
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+static VkAccessFlags calculateReadAccess(VkBufferUsageFlags usage)
+{
+    VkAccessFlags access = 0;
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+        access |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+        access |= VK_ACCESS_INDEX_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        access |= VK_ACCESS_UNIFORM_READ_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        access |= VK_ACCESS_SHADER_READ_BIT;
+    }
+    return access;
+}
+
+void UploadQueue::create(Context const& globals)
+{
+    ownershipTransfer = globals.device.queues.transfer.index != globals.device.queues.graphics.index;
+
+    VkCommandPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.pNext = nullptr;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolCreateInfo.queueFamilyIndex = globals.device.queues.transfer.index;
+    THROW_IF_FAILED(
+        vkCreateCommandPool(globals.device.handle, &poolCreateInfo, globals.allocator, &pool),
+        __FILE__, __LINE__,
+        "Failed to create command pool");
+
+    if (ownershipTransfer) {
+        poolCreateInfo.queueFamilyIndex = globals.device.queues.graphics.index;
+        THROW_IF_FAILED(
+            vkCreateCommandPool(globals.device.handle, &poolCreateInfo, globals.allocator, &acquirePool),
+            __FILE__, __LINE__,
+            "Failed to create command pool");
+    }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.pNext = nullptr;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+    semaphoreCreateInfo.flags = 0;
+    THROW_IF_FAILED(
+        vkCreateSemaphore(globals.device.handle, &semaphoreCreateInfo, globals.allocator, &timeline),
+        __FILE__, __LINE__,
+        "Failed to create semaphore");
+    if (ownershipTransfer) {
+        THROW_IF_FAILED(
+            vkCreateSemaphore(globals.device.handle, &semaphoreCreateInfo, globals.allocator, &transferTimeline),
+            __FILE__, __LINE__,
+            "Failed to create semaphore");
+    }
+
+    stagingRing.create(globals, timeline);
+    mipGenerator.create(globals);
+    LOG_DEBUG("Upload queue successfully created");
+}
+
+void UploadQueue::destroy(Context const& globals)
+{
+    if (recording != VK_NULL_HANDLE) {
+        LOG_WARNING("Upload queue destroyed with unsubmitted uploads");
+    }
+    wait(globals, submittedValue);
+
+    mipGenerator.destroy(globals);
+    stagingRing.destroy(globals);
+    vkDestroySemaphore(globals.device.handle, timeline, globals.allocator);
+    if (transferTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(globals.device.handle, transferTimeline, globals.allocator);
+        transferTimeline = VK_NULL_HANDLE;
+    }
+    if (acquirePool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(globals.device.handle, acquirePool, globals.allocator);
+    }
+    vkDestroyCommandPool(globals.device.handle, pool, globals.allocator);
+
+    recording = VK_NULL_HANDLE;
+    bufferAcquires.clear();
+    imageAcquires.clear();
+    mipGenerations.clear();
+    inFlight.clear();
+    freeCommandBuffers.clear();
+    freeAcquireCommandBuffers.clear();
+    LOG_DEBUG("Upload queue destroyed");
+}
+
+void UploadQueue::uploadBuffer(Context const& globals, void const* data, VkDeviceSize size, Buffer& dstBuffer, VkDeviceSize dstOffset)
+{
+    // Ranges larger than a piece are copied one piece at a time, so no upload depends on the ring capacity
+    auto pieceSize = getPieceSize();
+    for (VkDeviceSize copied = 0; copied < size; copied += pieceSize) {
+        auto copySize = std::min(size - copied, pieceSize);
+        VkDeviceSize srcOffset;
+        memcpy(stage(globals, copySize, 16, srcOffset), static_cast<u8 const*>(data) + copied, copySize);
+
+        VkBufferCopy bufferCopy = {};
+        bufferCopy.srcOffset = srcOffset;
+        bufferCopy.dstOffset = dstOffset + copied;
+        bufferCopy.size = copySize;
+        vkCmdCopyBuffer(getCommandBuffer(globals), getStagingBuffer(), dstBuffer.handle, 1, &bufferCopy);
+
+        releaseBuffer(globals, dstBuffer, dstOffset + copied, copySize);
+    }
+}
+
+void UploadQueue::uploadImage(Context const& globals, void const* data, VkDeviceSize size, Image& image, std::vector<VkDeviceSize> const& mipOffsets)
+{
+    if (size > getPieceSize()) {
+        uploadImagePieces(globals, static_cast<u8 const*>(data), image, mipOffsets);
+        releaseImage(globals, image, mipOffsets.size());
+        return;
+    }
+
+    VkDeviceSize srcOffset;
+    memcpy(stage(globals, size, 16, srcOffset), data, size);
+
+    auto commandBuffer = getCommandBuffer(globals);
+    recordTransitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    for (u32 mip = 0; mip < mipOffsets.size(); ++mip) {
+        recordCopyBufferToImage(commandBuffer, getStagingBuffer(), srcOffset + mipOffsets[mip], image, mip);
+    }
+
+    releaseImage(globals, image, mipOffsets.size());
+}
+
+void* UploadQueue::stage(Context const& globals, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    auto mapped = stagingRing.allocate(globals, size, alignment, offset);
+    if (!mapped) {
+        // The ring is full of data this batch has not submitted yet
+        flush(globals);
+        mapped = stagingRing.allocate(globals, size, alignment, offset);
+    }
+    return mapped;
+}
+
+void UploadQueue::uploadImagePieces(Context const& globals, u8 const* data, Image& image, std::vector<VkDeviceSize> const& mipOffsets)
+{
+    // The transition lands in whichever batch is recording, the copies follow it in submission order
+    recordTransitionImageLayout(getCommandBuffer(globals), image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // Levels hold their layers one after another, each layer is copied in bands of whole texel or block rows
+    auto blockSize = getBlockSize(image.format);
+    u32 blockDimension = blockSize != 0 ? 4 : 1;
+    VkDeviceSize bytesPerBlock = blockSize != 0 ? blockSize : 4;
+    auto pieceSize = getPieceSize();
+    for (u32 mip = 0; mip < mipOffsets.size(); ++mip) {
+        auto width = std::max(image.width >> mip, 1u);
+        auto height = std::max(image.height >> mip, 1u);
+        auto rowSize = (width + blockDimension - 1) / blockDimension * bytesPerBlock;
+        auto rowCount = (height + blockDimension - 1) / blockDimension;
+        auto bandRows = static_cast<u32>(std::max<VkDeviceSize>(pieceSize / rowSize, 1));
+        for (u32 layer = 0; layer < image.arrayLayers; ++layer) {
+            auto layerData = data + mipOffsets[mip] + rowSize * rowCount * layer;
+            for (u32 row = 0; row < rowCount; row += bandRows) {
+                auto rows = std::min(bandRows, rowCount - row);
+                VkDeviceSize srcOffset;
+                memcpy(stage(globals, rowSize * rows, 16, srcOffset), layerData + rowSize * row, rowSize * rows);
+
+                VkBufferImageCopy copy = {};
+                copy.bufferOffset = srcOffset;
+                copy.bufferRowLength = 0;
+                copy.bufferImageHeight = 0;
+                copy.imageSubresource.aspectMask = image.view.aspectMask;
+                copy.imageSubresource.mipLevel = mip;
+                copy.imageSubresource.baseArrayLayer = layer;
+                copy.imageSubresource.layerCount = 1;
+                copy.imageOffset = { 0, static_cast<i32>(row * blockDimension), 0 };
+                copy.imageExtent = { width, std::min((row + rows) * blockDimension, height) - row * blockDimension, 1 };
+                vkCmdCopyBufferToImage(getCommandBuffer(globals), getStagingBuffer(), image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+            }
+        }
+    }
+}
+
+VkCommandBuffer UploadQueue::getCommandBuffer(Context const& globals)
+{
+    if (recording == VK_NULL_HANDLE) {
+        recycleCommandBuffers(globals);
+        recording = beginCommandBuffer(globals, pool, freeCommandBuffers);
+    }
+    return recording;
+}
+
+void UploadQueue::releaseBuffer(Context const& globals, Buffer& buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!ownershipTransfer) {
+        // Covered by the memory barrier recorded at flush
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = globals.device.queues.transfer.index;
+    barrier.dstQueueFamilyIndex = globals.device.queues.graphics.index;
+    barrier.buffer = buffer.handle;
+    barrier.offset = offset;
+    barrier.size = size;
+    vkCmdPipelineBarrier(
+        getCommandBuffer(globals),
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = calculateReadAccess(buffer.usage);
+    bufferAcquires.push_back(barrier);
+}
+
+void UploadQueue::releaseImage(Context const& globals, Image& image, u32 writtenLevels)
+{
+    bool generateMips = writtenLevels < image.mipLevels;
+    if (!ownershipTransfer) {
+        // The transfer queue is of the graphics family
+        if (generateMips) {
+            mipGenerator.record(globals, getCommandBuffer(globals), image, writtenLevels - 1);
+        } else {
+            recordTransitionImageLayout(getCommandBuffer(globals), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+        return;
+    }
+
+    // Both halves of the transfer perform the same layout transition, images that get their levels generated stay
+    // transfer destinations for the generator
+    auto newLayout = generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = globals.device.queues.transfer.index;
+    barrier.dstQueueFamilyIndex = globals.device.queues.graphics.index;
+    barrier.image = image.handle;
+    barrier.subresourceRange.aspectMask = image.view.aspectMask;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = image.mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = image.arrayLayers;
+    vkCmdPipelineBarrier(
+        getCommandBuffer(globals),
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    if (generateMips) {
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        MipGeneration generation;
+        generation.image = image;
+        generation.sourceLevel = writtenLevels - 1;
+        mipGenerations.push_back(generation);
+    }
+    imageAcquires.push_back(barrier);
+}
+
+u64 UploadQueue::flush(Context const& globals)
+{
+    if (recording == VK_NULL_HANDLE) {
+        return submittedValue;
+    }
+
+    if (!ownershipTransfer) {
+        // Later submissions on the same queue read the data without waiting on the timeline
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(recording, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    THROW_IF_FAILED(
+        vkEndCommandBuffer(recording),
+        __FILE__, __LINE__,
+        "Failed to end command buffer");
+
+    Batch batch;
+    batch.commandBuffer = recording;
+    recording = VK_NULL_HANDLE;
+    if (!ownershipTransfer) {
+        submit(globals, globals.device.queues.transfer.handle, batch.commandBuffer, VK_NULL_HANDLE, 0, timeline, submittedValue + 1);
+        ++submittedValue;
+    } else {
+        // Only the graphics queue signals the ticket timeline, so tickets complete in the order they were handed out.
+        // The transfer half signals a timeline of its own, which the acquire half waits on
+        submit(globals, globals.device.queues.transfer.handle, batch.commandBuffer, VK_NULL_HANDLE, 0, transferTimeline, transferValue + 1);
+        ++transferValue;
+
+        // Batches without anything to acquire still pass through the graphics queue, with no commands
+        if (!bufferAcquires.empty() || !imageAcquires.empty()) {
+            batch.acquireCommandBuffer = beginCommandBuffer(globals, acquirePool, freeAcquireCommandBuffers);
+            vkCmdPipelineBarrier(
+                batch.acquireCommandBuffer,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, consumerStages | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr,
+                bufferAcquires.size(), bufferAcquires.data(),
+                imageAcquires.size(), imageAcquires.data());
+            for (auto const& generation : mipGenerations) {
+                mipGenerator.record(globals, batch.acquireCommandBuffer, generation.image, generation.sourceLevel);
+            }
+            THROW_IF_FAILED(
+                vkEndCommandBuffer(batch.acquireCommandBuffer),
+                __FILE__, __LINE__,
+                "Failed to end command buffer");
+        }
+
+        submit(globals, globals.device.queues.graphics.handle, batch.acquireCommandBuffer, transferTimeline, transferValue, timeline, submittedValue + 1);
+        ++submittedValue;
+        bufferAcquires.clear();
+        imageAcquires.clear();
+        mipGenerations.clear();
+    }
+    stagingRing.submit(submittedValue);
+    mipGenerator.submit(submittedValue);
+
+    batch.value = submittedValue;
+    inFlight.push_back(batch);
+
+    return submittedValue;
+}
+
+void UploadQueue::wait(Context const& globals, u64 ticket)
+{
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.flags = 0;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &ticket;
+    THROW_IF_FAILED(
+        vkWaitSemaphores(globals.device.handle, &waitInfo, UINT64_MAX),
+        __FILE__, __LINE__,
+        "Failed to wait for semaphores");
+}
+
+bool UploadQueue::isComplete(Context const& globals, u64 ticket) const
+{
+    u64 completedValue;
+    THROW_IF_FAILED(
+        vkGetSemaphoreCounterValue(globals.device.handle, timeline, &completedValue),
+        __FILE__, __LINE__,
+        "Failed to get semaphore counter value");
+    return completedValue >= ticket;
+}
+
+VkCommandBuffer UploadQueue::beginCommandBuffer(Context const& globals, VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeList)
+{
+    VkCommandBuffer commandBuffer;
+    if (!freeList.empty()) {
+        commandBuffer = freeList.back();
+        freeList.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.pNext = nullptr;
+        allocateInfo.commandPool = commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        THROW_IF_FAILED(
+            vkAllocateCommandBuffers(globals.device.handle, &allocateInfo, &commandBuffer),
+            __FILE__, __LINE__,
+            "Failed to allocate command buffers");
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    THROW_IF_FAILED(
+        vkBeginCommandBuffer(commandBuffer, &beginInfo),
+        __FILE__, __LINE__,
+        "Failed to begin command buffer");
+
+    return commandBuffer;
+}
+
+void UploadQueue::submit(
+    Context const& globals, VkQueue queue, VkCommandBuffer commandBuffer,
+    VkSemaphore waitSemaphore, u64 waitValue, VkSemaphore signalSemaphore, u64 signalValue)
+{
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    bool waits = waitSemaphore != VK_NULL_HANDLE;
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.pNext = nullptr;
+    timelineSubmitInfo.waitSemaphoreValueCount = waits ? 1 : 0;
+    timelineSubmitInfo.pWaitSemaphoreValues = waits ? &waitValue : nullptr;
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = waits ? 1 : 0;
+    submitInfo.pWaitSemaphores = waits ? &waitSemaphore : nullptr;
+    submitInfo.pWaitDstStageMask = waits ? &waitStage : nullptr;
+    submitInfo.commandBufferCount = commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+    submitInfo.pCommandBuffers = commandBuffer != VK_NULL_HANDLE ? &commandBuffer : nullptr;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+    THROW_IF_FAILED(
+        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE),
+        __FILE__, __LINE__,
+        "Failed to submit command buffers");
+}
+
+void UploadQueue::recycleCommandBuffers(Context const& globals)
+{
+    if (inFlight.empty()) {
+        return;
+    }
+
+    u64 completedValue;
+    THROW_IF_FAILED(
+        vkGetSemaphoreCounterValue(globals.device.handle, timeline, &completedValue),
+        __FILE__, __LINE__,
+        "Failed to get semaphore counter value");
+
+    while (!inFlight.empty() && inFlight.front().value <= completedValue) {
+        vkResetCommandBuffer(inFlight.front().commandBuffer, 0);
+        freeCommandBuffers.push_back(inFlight.front().commandBuffer);
+        if (inFlight.front().acquireCommandBuffer != VK_NULL_HANDLE) {
+            vkResetCommandBuffer(inFlight.front().acquireCommandBuffer, 0);
+            freeAcquireCommandBuffers.push_back(inFlight.front().acquireCommandBuffer);
+        }
+        inFlight.pop_front();
+    }
+    mipGenerator.collect(globals, completedValue);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Defines.h"
+#include "MipGenerator.h"
+#include "StagingRing.h"
+#include "Structures.h"
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+
+// Records staging copies into one command buffer on the transfer queue and submits them together.
+// Every flush signals a timeline semaphore; the signalled value is the ticket callers wait on.
+// When the transfer queue belongs to its own family, ownership of the written ranges is released there
+// and acquired by a small graphics queue submission that the ticket also covers. The transfer half then signals
+// a second timeline, so that the ticket timeline is signalled by one queue only and never out of order.
+// Images with more levels than were uploaded get the rest generated on the graphics queue within the same batch.
+class UploadQueue {
+public:
+    void create(Context const& globals);
+    void destroy(Context const& globals);
+
+    // Uploads larger than a quarter of the staging ring are split into pieces, which may land in several batches
+    void uploadBuffer(Context const& globals, void const* data, VkDeviceSize size, Buffer& dstBuffer, VkDeviceSize dstOffset = 0);
+    // Leaves the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. data holds one level per entry of mipOffsets,
+    // each at its offset from data; the levels after them are generated from the last one
+    void uploadImage(Context const& globals, void const* data, VkDeviceSize size, Image& image, std::vector<VkDeviceSize> const& mipOffsets = { 0 });
+
+    // For custom copies: stage the data first, at most the ring capacity at a time, then record into getCommandBuffer(),
+    // because staging may flush the batch that is being recorded.
+    // The command buffer runs on the transfer queue, so only transfer stages are allowed in it;
+    // hand resources over to the graphics queue with releaseBuffer() and releaseImage()
+    void* stage(Context const& globals, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    VkCommandBuffer getCommandBuffer(Context const& globals);
+    VkBuffer getStagingBuffer() const { return stagingRing.buffer.handle; }
+    void releaseBuffer(Context const& globals, Buffer& buffer, VkDeviceSize offset, VkDeviceSize size);
+    // Expects VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL and leaves VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+    // When fewer than image.mipLevels levels were written, the others are generated from the last written one
+    void releaseImage(Context const& globals, Image& image, u32 writtenLevels = ~0u);
+
+    // Submits everything recorded so far; returns the last submitted ticket when nothing was recorded
+    u64 flush(Context const& globals);
+    void wait(Context const& globals, u64 ticket);
+    bool isComplete(Context const& globals, u64 ticket) const;
+
+    VkSemaphore getTimeline() const { return timeline; }
+
+private:
+    struct MipGeneration {
+        Image image;
+        u32 sourceLevel = 0;
+    };
+
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+        u64 value = 0;
+    };
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandPool acquirePool = VK_NULL_HANDLE;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    u64 submittedValue = 0;
+    VkSemaphore transferTimeline = VK_NULL_HANDLE;
+    u64 transferValue = 0;
+    bool ownershipTransfer = false;
+
+    VkCommandBuffer recording = VK_NULL_HANDLE;
+    std::vector<VkBufferMemoryBarrier> bufferAcquires;
+    std::vector<VkImageMemoryBarrier> imageAcquires;
+    // Recorded after the acquires, transfer queues need not support blits or dispatches
+    std::vector<MipGeneration> mipGenerations;
+
+    std::deque<Batch> inFlight;
+    std::vector<VkCommandBuffer> freeCommandBuffers;
+    std::vector<VkCommandBuffer> freeAcquireCommandBuffers;
+
+    StagingRing stagingRing;
+    MipGenerator mipGenerator;
+
+    VkDeviceSize getPieceSize() const { return stagingRing.buffer.size / 4; }
+    void uploadImagePieces(Context const& globals, u8 const* data, Image& image, std::vector<VkDeviceSize> const& mipOffsets);
+    VkCommandBuffer beginCommandBuffer(Context const& globals, VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeList);
+    // commandBuffer may be VK_NULL_HANDLE for a submission that only orders the semaphores
+    void submit(
+        Context const& globals, VkQueue queue, VkCommandBuffer commandBuffer,
+        VkSemaphore waitSemaphore, u64 waitValue, VkSemaphore signalSemaphore, u64 signalValue);
+    void recycleCommandBuffers(Context const& globals);
+};
@@ -1,7 +1,17 @@
 #include "Utils.h"
+#include "BasisTranscoder.h"
+#include "BlockCompression.h"
+#include "ImageDecoder.h"
 #include "Initializer.h"
-
-#include <stb_image.h>
+#include "Ktx2.h"
+#include "MappedFile.h"
+#include "MemoryAllocator.h"
+#include "MeshCache.h"
+#include "MipGenerator.h"
+#include "UploadQueue.h"
+
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 
 std::vector<char> loadShaderCode(std::string const& filename)
@@ -21,6 +31,37 @@ std::vector<char> loadShaderCode(std::string const& filename)
     return buffer;
 }
 
+static MemoryCategory categorizeBuffer(VkBufferUsageFlags usage)
+{
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+        return MemoryCategory::VERTEX;
+    }
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+        return MemoryCategory::INDEX;
+    }
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        return MemoryCategory::UNIFORM;
+    }
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        return MemoryCategory::STORAGE;
+    }
+    if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+        return MemoryCategory::STAGING;
+    }
+    return MemoryCategory::OTHER;
+}
+
+static MemoryCategory categorizeImage(VkImageUsageFlags usage)
+{
+    if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+        return MemoryCategory::ATTACHMENT;
+    }
+    if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+        return MemoryCategory::TEXTURE;
+    }
+    return MemoryCategory::OTHER;
+}
+
 void createBuffer(Context const& context, Buffer& buffer)
 {
     VkBufferCreateInfo createInfo = {};
@@ -36,17 +77,28 @@ void createBuffer(Context const& context, Buffer& buffer)
 
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(context.device.handle, buffer.handle, &memoryRequirements);
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext = nullptr;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = findMemoryTypeIndex(context, memoryRequirements, buffer.memoryProperties);
-    THROW_IF_FAILED(vkAllocateMemory(context.device.handle, &allocateInfo, context.allocator, &buffer.memory));
-    THROW_IF_FAILED(vkBindBufferMemory(context.device.handle, buffer.handle, buffer.memory, 0));
+    context.memoryAllocator->allocate(context, memoryRequirements, buffer.memoryProperties, categorizeBuffer(buffer.usage), buffer.allocation);
+    THROW_IF_FAILED(vkBindBufferMemory(context.device.handle, buffer.handle, buffer.allocation.memory, buffer.allocation.offset));
+    buffer.mapped = buffer.allocation.mapped;
 }
 
 void createImage(Context const& context, Image& image)
 {
+    if (image.mipLevels > 1 && (image.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && getBlockSize(image.format) == 0) {
+        // Uploads may write only the first levels and leave the rest to the upload queue's mip generator
+        switch (selectMipGenerationPath(context, image.format)) {
+        case MipGenerationPath::BLIT:
+            image.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            break;
+        case MipGenerationPath::COMPUTE:
+            image.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+            image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            break;
+        case MipGenerationPath::NONE:
+            LOG_WARNING("Mip levels of format %d cannot be generated, they have to be uploaded", image.format);
+            break;
+        }
+    }
     {
         VkImageCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -68,13 +120,8 @@ void createImage(Context const& context, Image& image)
     
         VkMemoryRequirements memoryRequirements;
         vkGetImageMemoryRequirements(context.device.handle, image.handle, &memoryRequirements);
-        VkMemoryAllocateInfo allocateInfo = {};
-        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocateInfo.pNext = nullptr;
-        allocateInfo.allocationSize = memoryRequirements.size;
-        allocateInfo.memoryTypeIndex = findMemoryTypeIndex(context, memoryRequirements, image.memoryProperties);
-        THROW_IF_FAILED(vkAllocateMemory(context.device.handle, &allocateInfo, context.allocator, &image.memory));
-        THROW_IF_FAILED(vkBindImageMemory(context.device.handle, image.handle, image.memory, 0));
+        context.memoryAllocator->allocate(context, memoryRequirements, image.memoryProperties, categorizeImage(image.usage), image.allocation);
+        THROW_IF_FAILED(vkBindImageMemory(context.device.handle, image.handle, image.allocation.memory, image.allocation.offset));
     }
     {
         VkImageViewCreateInfo createInfo = {};
@@ -112,55 +159,66 @@ void createImage(Context const& context, Image& image)
         createInfo.compareEnable = VK_FALSE;
         createInfo.compareOp = VK_COMPARE_OP_NEVER;
         createInfo.minLod = 0.f;
-        createInfo.maxLod = 0.f;
+        createInfo.maxLod = VK_LOD_CLAMP_NONE;
         createInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
         createInfo.unnormalizedCoordinates = VK_FALSE;
         THROW_IF_FAILED(vkCreateSampler(context.device.handle, &createInfo, context.allocator, &image.sampler.handle));
     }
 }
 
+void uploadMeshlets(Context const& globals, MeshletData const& data, Buffer& meshletBuffer, Buffer& vertexBuffer, Buffer& triangleBuffer)
+{
+    if (data.meshlets.empty()) {
+        return;
+    }
+
+    auto usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    meshletBuffer.size = data.meshlets.size() * sizeof(data.meshlets[0]);
+    meshletBuffer.usage = usage;
+    meshletBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createBuffer(globals, meshletBuffer);
+    globals.uploadQueue->uploadBuffer(globals, data.meshlets.data(), meshletBuffer.size, meshletBuffer);
+
+    vertexBuffer.size = data.vertices.size() * sizeof(data.vertices[0]);
+    vertexBuffer.usage = usage;
+    vertexBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createBuffer(globals, vertexBuffer);
+    globals.uploadQueue->uploadBuffer(globals, data.vertices.data(), vertexBuffer.size, vertexBuffer);
+
+    triangleBuffer.size = data.triangles.size();
+    triangleBuffer.usage = usage;
+    triangleBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createBuffer(globals, triangleBuffer);
+    globals.uploadQueue->uploadBuffer(globals, data.triangles.data(), triangleBuffer.size, triangleBuffer);
+}
+
 void destroyBuffer(Context const& context, Buffer& buffer)
 {
     vkDestroyBuffer(context.device.handle, buffer.handle, context.allocator);
-    vkFreeMemory(context.device.handle, buffer.memory, context.allocator);
+    context.memoryAllocator->free(context, buffer.allocation);
+    buffer.mapped = nullptr;
 }
 
 void destroyImage(Context const& context, Image const& image)
 {
     vkDestroyImage(context.device.handle, image.handle, context.allocator);
-    vkFreeMemory(context.device.handle, image.memory, context.allocator);
+    context.memoryAllocator->free(context, image.allocation);
 }
 
-void copyBuffer(Context const& globals, Buffer& srcBuffer, Buffer& dstBuffer)
-{
-    auto commandBuffer = beginCommandBufferOneTimeSubmit(globals);
-
-    VkBufferCopy bufferCopy = {};
-    bufferCopy.srcOffset = 0;
-    bufferCopy.dstOffset = 0;
-    bufferCopy.size = srcBuffer.size;
-
-    vkCmdCopyBuffer(commandBuffer, srcBuffer.handle, dstBuffer.handle, 1, &bufferCopy);
-
-    endCommandBufferOneTimeSubmit(globals, commandBuffer);
-}
-
-void copyBufferToImage(Context const& context, Buffer& buffer, Image& image)
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, Image& image, u32 mipLevel)
 {
     VkBufferImageCopy copy = {};
-    copy.bufferOffset = 0;
+    copy.bufferOffset = bufferOffset;
     copy.bufferRowLength = 0;
     copy.bufferImageHeight = 0;
     copy.imageSubresource.aspectMask = image.view.aspectMask;
-    copy.imageSubresource.mipLevel = 0;
+    copy.imageSubresource.mipLevel = mipLevel;
     copy.imageSubresource.baseArrayLayer = 0;
     copy.imageSubresource.layerCount = image.arrayLayers;
     copy.imageOffset = { 0, 0, 0 };
-    copy.imageExtent = { image.width, image.height, 1};
+    copy.imageExtent = { std::max(image.width >> mipLevel, 1u), std::max(image.height >> mipLevel, 1u), 1 };
 
-    auto commandBuffer = beginCommandBufferOneTimeSubmit(context);
-    vkCmdCopyBufferToImage(commandBuffer, buffer.handle, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-    endCommandBufferOneTimeSubmit(context, commandBuffer);
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
 }
 
 VkDeviceSize calculateUniformBufferAlignment(Context const& globals, VkDeviceSize size)
@@ -192,7 +250,7 @@ void createImageView(Context const& globals, Image& image)
     THROW_IF_FAILED(vkCreateImageView(globals.device.handle, &createInfo, globals.allocator, &image.view.handle));
 }
 
-void transitionImageLayout(Context const& globals, Image& image, VkImageLayout oldLayout, VkImageLayout newLayout)
+void recordTransitionImageLayout(VkCommandBuffer commandBuffer, Image& image, VkImageLayout oldLayout, VkImageLayout newLayout)
 {
     VkAccessFlags srcAccessMask;
     VkAccessFlags dstAccessMask;
@@ -228,9 +286,7 @@ void transitionImageLayout(Context const& globals, Image& image, VkImageLayout o
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = image.arrayLayers;
 
-    auto commandBuffer = beginCommandBufferOneTimeSubmit(globals);
     vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    endCommandBufferOneTimeSubmit(globals, commandBuffer);
 }
 
 u32 findMemoryTypeIndex(Context const& globals, VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties)
@@ -244,6 +300,29 @@ u32 findMemoryTypeIndex(Context const& globals, VkMemoryRequirements const& requ
     return -1;
 }
 
+bool isFormatSampled(Context const& globals, VkFormat format)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(globals.device.physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+VkFormat selectTranscodeFormat(Context const& globals, bool alpha, bool srgb)
+{
+    VkFormat const candidates[] = {
+        srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK,
+        srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK,
+        alpha ? (srgb ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK)
+              : (srgb ? VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK)
+    };
+    for (auto format : candidates) {
+        if (isFormatSampled(globals, format)) {
+            return format;
+        }
+    }
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
 VkCommandBuffer beginCommandBufferOneTimeSubmit(Context const& globals)
 {
     VkCommandBuffer commandBuffer;
@@ -473,66 +552,200 @@ void createCubeTexture(
     char const* up, char const* down,
     Image& image)
 {
-    i32 width;
-    i32 height;
-    i32 channels;
-    uc* pixels[6];
-    pixels[0] = stbi_load(front, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[0]) {
-        throw std::runtime_error("Failed to load texture image");
+    // The faces decode side by side, each one is copied out as soon as it is ready
+    std::future<DecodedImage> faces[6] = {
+        context.imageDecoder->decode(front), context.imageDecoder->decode(back),
+        context.imageDecoder->decode(left), context.imageDecoder->decode(right),
+        context.imageDecoder->decode(up), context.imageDecoder->decode(down)
+    };
+
+    auto face = faces[0].get();
+    u32 width = face.width;
+    u32 height = face.height;
+    VkDeviceSize layerSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+    // The layers are uploaded together, in pieces when the six faces outgrow the staging ring
+    std::vector<u8> pixels(layerSize * 6);
+    for (u32 i = 0; i < 6; ++i) {
+        if (i > 0) {
+            face = faces[i].get();
+        }
+        if (face.width != width || face.height != height) {
+            throw std::runtime_error("Cube faces differ in size");
+        }
+        memcpy(pixels.data() + layerSize * i, face.pixels.data(), layerSize);
     }
 
-    pixels[1] = stbi_load(back, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[1]) {
-        throw std::runtime_error("Failed to load texture image");
+    image.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+    image.width = width;
+    image.height = height;
+    image.mipLevels = calculateMipLevels(width, height);
+    image.arrayLayers = 6;
+    image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    image.view.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+    createImage(context, image);
+    context.uploadQueue->uploadImage(context, pixels.data(), pixels.size(), image);
+}
+
+// Uploads levels stored anywhere within data, offsets are relative to it
+static void createTextureFromLevels(
+    Context const& globals,
+    VkFormat format, u32 width, u32 height,
+    u8 const* data, std::vector<VkDeviceSize> const& offsets, std::vector<VkDeviceSize> const& sizes,
+    Image& image)
+{
+    VkDeviceSize begin = offsets[0];
+    VkDeviceSize end = 0;
+    for (u32 i = 0; i < offsets.size(); ++i) {
+        begin = std::min(begin, offsets[i]);
+        end = std::max(end, offsets[i] + sizes[i]);
     }
+    std::vector<VkDeviceSize> mipOffsets(offsets.size());
+    for (u32 i = 0; i < offsets.size(); ++i) {
+        mipOffsets[i] = offsets[i] - begin;
+    }
+
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.mipLevels = offsets.size();
+    image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    createImage(globals, image);
+    globals.uploadQueue->uploadImage(globals, data + begin, end - begin, image, mipOffsets);
+}
+
+static void createTextureFromMipChain(Context const& globals, MipChain const& chain, Image& image);
 
-    pixels[2] = stbi_load(left, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[2]) {
-        throw std::runtime_error("Failed to load texture image");
+static void createTextureFromKtx2(Context const& globals, Ktx2Texture const& texture, Image& image)
+{
+    if (isBasisKtx2(texture)) {
+        MipChain chain;
+        auto selectFormat = [&globals](bool alpha, bool srgb) { return selectTranscodeFormat(globals, alpha, srgb); };
+        if (!transcodeBasisKtx2(texture, selectFormat, chain)) {
+            throw std::runtime_error("Failed to transcode KTX2 texture");
+        }
+        createTextureFromMipChain(globals, chain, image);
+        return;
+    }
+    if (texture.supercompressionScheme != static_cast<u32>(Ktx2Supercompression::NONE) || texture.layerCount != 1 || texture.faceCount != 1) {
+        throw std::runtime_error("Only uncompressed 2D KTX2 textures are supported");
+    }
+    if (!isFormatSampled(globals, texture.format)) {
+        throw std::runtime_error("KTX2 texture format cannot be sampled by the device");
     }
 
-    pixels[3] = stbi_load(right, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[3]) {
-        throw std::runtime_error("Failed to load texture image");
+    std::vector<VkDeviceSize> offsets(texture.levels.size());
+    std::vector<VkDeviceSize> sizes(texture.levels.size());
+    for (u32 i = 0; i < texture.levels.size(); ++i) {
+        offsets[i] = texture.levels[i].offset;
+        sizes[i] = texture.levels[i].size;
     }
+    createTextureFromLevels(globals, texture.format, texture.width, texture.height, texture.data, offsets, sizes, image);
+}
 
-    pixels[4] = stbi_load(up, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[4]) {
-        throw std::runtime_error("Failed to load texture image");
+static void createTextureFromMipChain(Context const& globals, MipChain const& chain, Image& image)
+{
+    std::vector<VkDeviceSize> sizes(chain.offsets.size());
+    for (u32 i = 0; i < chain.offsets.size(); ++i) {
+        sizes[i] = (i + 1 < chain.offsets.size() ? chain.offsets[i + 1] : chain.pixels.size()) - chain.offsets[i];
     }
+    createTextureFromLevels(globals, chain.format, chain.width, chain.height, chain.pixels.data(), chain.offsets, sizes, image);
+}
+
+void createKtx2Texture(Context const& globals, std::string const& filename, Image& image)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        LOG_ERROR("Failed to open %s", filename.c_str());
+        throw std::runtime_error("Failed to open KTX2 texture");
+    }
+    Ktx2Texture texture;
+    if (!parseKtx2(file.getData(), file.getSize(), texture)) {
+        throw std::runtime_error("Failed to parse KTX2 texture");
+    }
+    createTextureFromKtx2(globals, texture, image);
+}
 
-    pixels[5] = stbi_load(down, &width, &height, &channels, STBI_rgb_alpha);
-    if (!pixels[5]) {
-        throw std::runtime_error("Failed to load texture image");
+void createCompressedTexture(Context const& globals, std::string const& filename, BlockFormat format, bool srgb, Image& image)
+{
+    CompressedTextureLoad load;
+    beginCompressedTexture(globals, filename, format, srgb, load, image);
+    finishCompressedTexture(globals, load, image);
+}
+
+void beginCompressedTexture(
+    Context const& globals, std::string const& filename, BlockFormat format, bool srgb, CompressedTextureLoad& load, Image& image)
+{
+    load.filename = filename;
+    load.format = format;
+    load.srgb = srgb;
+    if (!load.source.open(filename)) {
+        LOG_ERROR("Failed to open %s", filename.c_str());
+        throw std::runtime_error("Failed to open texture image");
+    }
+    load.sourceHash = std::to_string(MeshCache::hash(load.source.getData(), load.source.getSize()));
+
+    if (globals.device.support.features.textureCompressionBC) {
+        MappedFile cooked;
+        Ktx2Texture texture;
+        if (cooked.open(filename + ".ktx2") && parseKtx2(cooked.getData(), cooked.getSize(), texture) &&
+            texture.format == getBlockVkFormat(format, srgb) && getKtx2Value(texture, "LVSourceHash") == load.sourceHash) {
+            createTextureFromKtx2(globals, texture, image);
+            return;
+        }
     }
 
-    u32 layerSize = width * height * STBI_rgb_alpha;
-    u32 imageSize = layerSize * 6;
+    load.decoded = globals.imageDecoder->decode(load.source.getData(), load.source.getSize());
+}
 
-    Buffer stagingBuffer;
-    stagingBuffer.size = imageSize;
-    stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    createBuffer(context, stagingBuffer);
-    vkMapMemory(context.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped);
-    for (u32 i = 0; i < 6; ++i) {
-        memcpy(static_cast<u8*>(stagingBuffer.mapped) + layerSize * i, pixels[i], layerSize);
+void finishCompressedTexture(Context const& globals, CompressedTextureLoad& load, Image& image)
+{
+    if (!load.decoded.valid()) {
+        return;
+    }
+    auto const& filename = load.filename;
+    auto format = load.format;
+    auto srgb = load.srgb;
+    auto decoded = load.decoded.get();
+    load.source.close();
+
+    if (!globals.device.support.features.textureCompressionBC) {
+        LOG_WARNING("BC textures are not supported, %s is uploaded uncompressed", filename.c_str());
+        image.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        image.width = decoded.width;
+        image.height = decoded.height;
+        image.mipLevels = calculateMipLevels(decoded.width, decoded.height);
+        image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        createImage(globals, image);
+        globals.uploadQueue->uploadImage(globals, decoded.pixels.data(), decoded.pixels.size(), image);
+        return;
     }
 
-    vkUnmapMemory(context.device.handle, stagingBuffer.memory);
-    stbi_image_free(pixels);
+    // BC4 and BC5 hold data like occlusion and normals, whose levels are filtered without the sRGB curve
+    MipChain chain;
+    auto linear = format == BlockFormat::BC4 || format == BlockFormat::BC5;
+    buildMipChain(decoded.pixels.data(), decoded.width, decoded.height, chain, srgb && !linear);
+    compressMipChain(format, srgb, chain);
 
-    image.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-    image.width = width;
-    image.height = height;
-    image.arrayLayers = 6;
-    image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    image.view.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-    createImage(context, image);
-    transitionImageLayout(context, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(context, stagingBuffer, image);
-    destroyBuffer(context, stagingBuffer);
-    transitionImageLayout(context, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    auto file = writeKtx2(chain, { { "LVSourceHash", load.sourceHash } });
+    auto cookedFilename = filename + ".ktx2";
+    auto temporaryFilename = cookedFilename + ".tmp";
+    bool written = false;
+    {
+        std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<char const*>(file.data()), file.size());
+        written = static_cast<bool>(stream);
+    }
+    std::remove(cookedFilename.c_str());
+    if (!written || std::rename(temporaryFilename.c_str(), cookedFilename.c_str()) != 0) {
+        LOG_WARNING("Failed to write %s", cookedFilename.c_str());
+        std::remove(temporaryFilename.c_str());
+    } else {
+        LOG_DEBUG("%s cooked", cookedFilename.c_str());
+    }
+
+    createTextureFromMipChain(globals, chain, image);
 }
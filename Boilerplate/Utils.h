@@ -1,10 +1,15 @@
 #pragma once
 
+#include "BlockCompression.h"
 #include "Defines.h"
+#include "ImageDecoder.h"
 #include "Logger.h"
+#include "MappedFile.h"
+#include "Meshlets.h"
 #include "Structures.h"
 
 #include <vulkan/vulkan.h>
+#include <future>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -20,20 +25,27 @@
 void createBuffer(Context const& globals, Buffer& buffer);
 void createImage(Context const& globals, Image& image);
 
+// Uploads the three arrays of buildMeshlets as storage buffers
+void uploadMeshlets(Context const& globals, MeshletData const& data, Buffer& meshletBuffer, Buffer& vertexBuffer, Buffer& triangleBuffer);
+
 void destroyBuffer(Context const& globals, Buffer& buffer);
 void destroyImage(Context const& globals, Image const& image);
 
-void copyBuffer(Context const& globals, Buffer& srcBuffer, Buffer& dstBuffer);
-void copyBufferToImage(Context const& globals, Buffer& buffer, Image& image);
 VkDeviceSize calculateUniformBufferAlignment(Context const& globals, VkDeviceSize size);
 
 std::vector<char> loadShaderCode(std::string const& filename);
 
 void createImageView(Context const& globals, Image& image);
-void transitionImageLayout(Context const& globals, Image& image, VkImageLayout oldLayout, VkImageLayout newLayout);
+void recordTransitionImageLayout(VkCommandBuffer commandBuffer, Image& image, VkImageLayout oldLayout, VkImageLayout newLayout);
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, Image& image, u32 mipLevel = 0);
 
 
 u32 findMemoryTypeIndex(Context const& context, VkMemoryRequirements const& requirements, VkMemoryPropertyFlags properties);
+// Whether optimally tiled images of the format can be sampled
+bool isFormatSampled(Context const& globals, VkFormat format);
+// Target of transcodeBasisKtx2: BC7, ASTC 4x4, ETC2 (RGB for opaque textures, RGBA otherwise) and finally RGBA8,
+// the first the device samples
+VkFormat selectTranscodeFormat(Context const& globals, bool alpha, bool srgb);
 
 VkCommandBuffer beginCommandBufferOneTimeSubmit(Context const& globals);
 void endCommandBufferOneTimeSubmit(Context const& globals, VkCommandBuffer commandBuffer);
@@ -58,3 +70,35 @@ void createCubeTexture(
     char const* left, char const* right,
     char const* up, char const* down,
     Image& image);
+
+// Sampled image with the levels of a KTX2 file uploaded as stored, block compressed ones included.
+// Basis Universal files are transcoded to the best format the device samples first.
+void createKtx2Texture(Context const& globals, std::string const& filename, Image& image);
+// Loads filename + ".ktx2", cooking it from the image file first when it is missing or was cooked from other contents.
+// Devices that cannot sample BCn get the decoded pixels with generated mips instead.
+void createCompressedTexture(Context const& globals, std::string const& filename, BlockFormat format, bool srgb, Image& image);
+
+// createCompressedTexture in two steps, so the decodes of several textures run side by side:
+// begin every texture first, then finish them in any order.
+struct CompressedTextureLoad {
+    std::string filename;
+    BlockFormat format = BlockFormat::BC7;
+    bool srgb = false;
+    // Stays mapped while the decoder reads it
+    MappedFile source;
+    std::string sourceHash;
+    // Not valid when the cooked file was up to date and the image has already been created
+    std::future<DecodedImage> decoded;
+
+    // A load dropped without finishing, by an exception for one, must not unmap the file under a running decode
+    ~CompressedTextureLoad()
+    {
+        if (decoded.valid()) {
+            decoded.wait();
+        }
+    }
+};
+
+void beginCompressedTexture(
+    Context const& globals, std::string const& filename, BlockFormat format, bool srgb, CompressedTextureLoad& load, Image& image);
+void finishCompressedTexture(Context const& globals, CompressedTextureLoad& load, Image& image);
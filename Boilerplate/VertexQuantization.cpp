@@ -0,0 +1,93 @@
+#include "VertexQuantization.h"
+
+#include <glm/gtc/packing.hpp>
+
+QuantizationBounds calculateQuantizationBounds(glm::vec3 const* positions, u64 count)
+{
+    QuantizationBounds bounds;
+    if (count == 0) {
+        return bounds;
+    }
+
+    glm::vec3 min = positions[0];
+    glm::vec3 max = positions[0];
+    for (u64 i = 1; i < count; ++i) {
+        min = glm::min(min, positions[i]);
+        max = glm::max(max, positions[i]);
+    }
+
+    bounds.offset = min;
+    bounds.scale = max - min;
+    // Flat axes still need a scale the encoder can divide by
+    for (u32 i = 0; i < 3; ++i) {
+        if (bounds.scale[i] <= 0.f) {
+            bounds.scale[i] = 1.f;
+        }
+    }
+    return bounds;
+}
+
+glm::u16vec4 quantizePosition(glm::vec3 const& position, QuantizationBounds const& bounds, float w)
+{
+    auto normalized = glm::clamp((position - bounds.offset) / bounds.scale, 0.f, 1.f);
+    return glm::u16vec4(glm::round(glm::vec4(normalized, glm::clamp(w, 0.f, 1.f)) * 65535.f));
+}
+
+glm::i16vec2 encodeOctahedral(glm::vec3 const& direction)
+{
+    auto sum = glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z);
+    if (sum == 0.f) {
+        return glm::i16vec2(0, 0);
+    }
+
+    auto n = direction / sum;
+    glm::vec2 encoded(n.x, n.y);
+    if (n.z < 0.f) {
+        // Folds the lower hemisphere over the diagonals of the square
+        encoded.x = (1.f - glm::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+        encoded.y = (1.f - glm::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+    }
+    return glm::i16vec2(glm::round(glm::clamp(encoded, -1.f, 1.f) * 32767.f));
+}
+
+glm::vec3 decodeOctahedral(glm::i16vec2 const& encoded)
+{
+    auto e = glm::max(glm::vec2(encoded) / 32767.f, -1.f);
+    glm::vec3 n(e.x, e.y, 1.f - glm::abs(e.x) - glm::abs(e.y));
+    auto t = glm::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+glm::u16vec2 quantizeHalf(glm::vec2 const& value)
+{
+    auto packed = glm::packHalf2x16(value);
+    return glm::u16vec2(packed & 0xffff, packed >> 16);
+}
+
+glm::u8vec4 quantizeUnorm8(glm::vec4 const& value)
+{
+    return glm::u8vec4(glm::round(glm::clamp(value, 0.f, 1.f) * 255.f));
+}
+
+glm::u8vec4 quantizeWeights(glm::vec4 const& weights)
+{
+    auto sum = weights.x + weights.y + weights.z + weights.w;
+    if (sum <= 0.f) {
+        return glm::u8vec4(255, 0, 0, 0);
+    }
+
+    auto quantized = quantizeUnorm8(weights / sum);
+    // The rounding error goes to the largest weight, where it is relatively the smallest
+    u32 largest = 0;
+    i32 total = 0;
+    for (u32 i = 0; i < 4; ++i) {
+        total += quantized[i];
+        if (quantized[i] > quantized[largest]) {
+            largest = i;
+        }
+    }
+    quantized[largest] = u8(quantized[largest] + 255 - total);
+    return quantized;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <glm/glm.hpp>
+
+// Quantized positions are unorm16 inside the bounding box, the shader restores them with offset + scale * position
+struct QuantizationBounds {
+    glm::vec3 offset = glm::vec3(0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+};
+
+QuantizationBounds calculateQuantizationBounds(glm::vec3 const* positions, u64 count);
+
+// w is stored in the fourth component, e.g. the tangent handedness as 0 or 1
+glm::u16vec4 quantizePosition(glm::vec3 const& position, QuantizationBounds const& bounds, float w = 1.f);
+// Octahedral mapping of a unit vector, two snorm16 values for a R16G16_SNORM input
+glm::i16vec2 encodeOctahedral(glm::vec3 const& direction);
+glm::vec3 decodeOctahedral(glm::i16vec2 const& encoded);
+// Two halfs for a R16G16_SFLOAT input
+glm::u16vec2 quantizeHalf(glm::vec2 const& value);
+glm::u8vec4 quantizeUnorm8(glm::vec4 const& value);
+// Rounds the skin weights so they still sum up to exactly 255
+glm::u8vec4 quantizeWeights(glm::vec4 const& weights);
@@ -2,13 +2,14 @@
 #include "Boilerplate/Entry.h"
 #include "Boilerplate/EventManager.h"
 #include "Boilerplate/Initializer.h"
+#include "Boilerplate/MeshOptimizer.h"
+#include "Boilerplate/Meshlets.h"
 #include "Boilerplate/ProceduralMeshes/Box.h"
 #include "Boilerplate/ProceduralMeshes/Sphere.h"
 #include "Boilerplate/SampleBase.h"
 #include "Boilerplate/Structures.h"
 #include "Boilerplate/Utils.h"
 
-#include <stb_image.h>
 #include <glm/gtc/matrix_transform.hpp>
 
 class Boxes : public SampleBase {
@@ -17,6 +18,7 @@ public:
 
 private:
     std::vector<Mesh> meshes;
+    QuantizationBounds meshBounds;
     std::vector<Texture> textures;
     std::vector<Material> materials;
     std::vector<RenderObject> renderObjects;
@@ -100,45 +102,59 @@ void Boxes::createMeshes()
             vertices.insert(vertices.end(), Sphere::vertices.begin(), Sphere::vertices.end());
             indices.insert(indices.end(), Sphere::indices.begin(), Sphere::indices.end());
         }
+        for (u32 i = 0; i < meshes[0].submeshes.size(); ++i) {
+            // Submesh vertex ranges are contiguous, each one ends where the next one starts
+            auto const& submesh = meshes[0].submeshes[i];
+            u32 vertexEnd = i + 1 < meshes[0].submeshes.size() ? meshes[0].submeshes[i + 1].vertexOffset : vertices.size();
+            u32 vertexCount = vertexEnd - submesh.vertexOffset;
+            auto submeshIndices = indices.data() + submesh.firstIndex;
+            auto submeshVertices = vertices.data() + submesh.vertexOffset;
+
+            auto before = analyzeVertexCache(submeshIndices, submesh.indexCount, vertexCount);
+            weldVertices(submeshIndices, submesh.indexCount, vertexCount, { { submeshVertices, sizeof(Vertex) } });
+            optimizeVertexCache(submeshIndices, submesh.indexCount, vertexCount);
+            optimizeOverdraw(submeshIndices, submesh.indexCount, &submeshVertices[0].pos, vertexCount, sizeof(Vertex));
+            auto after = analyzeVertexCache(submeshIndices, submesh.indexCount, vertexCount);
+            remapVertices(optimizeVertexFetch(submeshIndices, submesh.indexCount, vertexCount), submeshVertices);
+            LOG_INFO("Submesh %u vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", i, before.acmr(), after.acmr(), before.atvr(), after.atvr());
+        }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.size = vertices.size() * sizeof(vertices[0]);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, vertices.data(), stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
+            MeshletData meshletData;
+            for (u32 i = 0; i < meshes[0].submeshes.size(); ++i) {
+                auto& submesh = meshes[0].submeshes[i];
+                u32 vertexEnd = i + 1 < meshes[0].submeshes.size() ? meshes[0].submeshes[i + 1].vertexOffset : vertices.size();
+                submesh.firstMeshlet = meshletData.meshlets.size();
+                submesh.meshletCount = buildMeshlets(
+                    meshletData,
+                    indices.data() + submesh.firstIndex, submesh.indexCount,
+                    &vertices[submesh.vertexOffset].pos, vertexEnd - submesh.vertexOffset,
+                    submesh.vertexOffset, sizeof(Vertex));
+            }
+            uploadMeshlets(globals, meshletData, meshes[0].meshletBuffer, meshes[0].meshletVertexBuffer, meshes[0].meshletTriangleBuffer);
+        }
+        {
+            std::vector<glm::vec3> positions(vertices.size());
+            for (u32 i = 0; i < vertices.size(); ++i) {
+                positions[i] = vertices[i].pos;
+            }
+            meshBounds = calculateQuantizationBounds(positions.data(), positions.size());
+            std::vector<QuantizedVertex> quantizedVertices(vertices.size());
+            for (u32 i = 0; i < vertices.size(); ++i) {
+                quantizedVertices[i] = quantizeVertex(vertices[i], meshBounds);
+            }
 
-            meshes[0].vertexBuffer.size = stagingBuffer.size;
+            meshes[0].vertexBuffer.size = quantizedVertices.size() * sizeof(quantizedVertices[0]);
             meshes[0].vertexBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
             meshes[0].vertexBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, meshes[0].vertexBuffer);
-            copyBuffer(globals, stagingBuffer, meshes[0].vertexBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, quantizedVertices.data(), meshes[0].vertexBuffer.size, meshes[0].vertexBuffer);
         }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.size = indices.size() * sizeof(indices[0]);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, indices.data(), stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-            meshes[0].indexBuffer.size = stagingBuffer.size;
+            meshes[0].indexBuffer.size = indices.size() * sizeof(indices[0]);
             meshes[0].indexBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
             meshes[0].indexBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, meshes[0].indexBuffer);
-            copyBuffer(globals, stagingBuffer, meshes[0].indexBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, indices.data(), meshes[0].indexBuffer.size, meshes[0].indexBuffer);
         }
     }
 }
@@ -146,69 +162,13 @@ void Boxes::createMeshes()
 void Boxes::createTextures()
 {
     textures.resize(2);
-    {
-        int width;
-        int height;
-        int channels;
-        stbi_uc* pixels = stbi_load("Textures/container2.png", &width, &height, &channels, STBI_rgb_alpha);
-        if (!pixels) {
-            throw std::runtime_error("Failed to load texture image");
-        }
-        VkDeviceSize imageSize = width * height * 4;
-
-        Buffer stagingBuffer;
-        stagingBuffer.size = imageSize;
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped);
-        memcpy(stagingBuffer.mapped, pixels, imageSize);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-        stbi_image_free(pixels);
-
-        textures[0].image.width = width;
-        textures[0].image.height = height;
-        textures[0].image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-        textures[0].image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createImage(globals, textures[0].image);
-        transitionImageLayout(globals, textures[0].image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(globals, stagingBuffer, textures[0].image);
-        destroyBuffer(globals, stagingBuffer);
-        transitionImageLayout(globals, textures[0].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        createImageView(globals, textures[0].image);
-        createSampler(globals, textures[0].sampler);
-    }
-    {
-        int width;
-        int height;
-        int channels;
-        stbi_uc* pixels = stbi_load("Textures/container2_specular.png", &width, &height, &channels, STBI_rgb_alpha);
-        if (!pixels) {
-            throw std::runtime_error("Failed to load texture image");
-        }
-        VkDeviceSize imageSize = width * height * 4;
-
-        Buffer stagingBuffer;
-        stagingBuffer.size = imageSize;
-        stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        createBuffer(globals, stagingBuffer);
-        vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped);
-        memcpy(stagingBuffer.mapped, pixels, imageSize);
-        vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-        stbi_image_free(pixels);
-
-        textures[1].image.width = width;
-        textures[1].image.height = height;
-        textures[1].image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-        textures[1].image.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        createImage(globals, textures[1].image);
-        transitionImageLayout(globals, textures[1].image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(globals, stagingBuffer, textures[1].image);
-        destroyBuffer(globals, stagingBuffer);
-        transitionImageLayout(globals, textures[1].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        createImageView(globals, textures[1].image);
-        createSampler(globals, textures[1].sampler);
+    // Both decodes are started before either is consumed, so they run side by side
+    CompressedTextureLoad loads[2];
+    beginCompressedTexture(globals, "Textures/container2.png", BlockFormat::BC7, true, loads[0], textures[0].image);
+    beginCompressedTexture(globals, "Textures/container2_specular.png", BlockFormat::BC1, true, loads[1], textures[1].image);
+    for (u32 i = 0; i < 2; ++i) {
+        finishCompressedTexture(globals, loads[i], textures[i].image);
+        createSampler(globals, textures[i].sampler);
     }
 }
 
@@ -403,108 +363,39 @@ void Boxes::createFrameResources()
     frameResources.resize(framesInFlight);
     for (u32 i = 0; i < frameResources.size(); ++i) {
         {
-            frameResources[i].passBuffer.size = sizeof(Pass);
-            frameResources[i].passBuffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-            frameResources[i].passBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, frameResources[i].passBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, frameResources[i].passBuffer.memory, 0, frameResources[i].passBuffer.size, 0, &frameResources[i].passBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-        }
-        {
-            Buffer stagingBuffer;
-            stagingBuffer.size = sizeof(lights.direct);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, &lights.direct, stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-            frameResources[i].dirLightBuffer.size = stagingBuffer.size;
+            frameResources[i].dirLightBuffer.size = sizeof(lights.direct);
             frameResources[i].dirLightBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
             frameResources[i].dirLightBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].dirLightBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].dirLightBuffer);
-            destroyBuffer(globals, stagingBuffer);
-        }
-        {
-            frameResources[i].spotLightBuffer.size = sizeof(lights.spot);
-            frameResources[i].spotLightBuffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-            frameResources[i].spotLightBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, frameResources[i].spotLightBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, frameResources[i].spotLightBuffer.memory, 0, frameResources[i].spotLightBuffer.size, 0, &frameResources[i].spotLightBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
+            globals.uploadQueue->uploadBuffer(globals, &lights.direct, frameResources[i].dirLightBuffer.size, frameResources[i].dirLightBuffer);
         }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.size = lights.points.size() * sizeof(lights.points[0]);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, lights.points.data(), stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-            frameResources[i].pointLightBuffer.size = stagingBuffer.size;
+            frameResources[i].pointLightBuffer.size = lights.points.size() * sizeof(lights.points[0]);
             frameResources[i].pointLightBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
             frameResources[i].pointLightBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].pointLightBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].pointLightBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, lights.points.data(), frameResources[i].pointLightBuffer.size, frameResources[i].pointLightBuffer);
         }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.size = materials.size() * sizeof(materials[0]);
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-            memcpy(stagingBuffer.mapped, materials.data(), stagingBuffer.size);
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
-
-            frameResources[i].materialBuffer.size = stagingBuffer.size;
+            frameResources[i].materialBuffer.size = materials.size() * sizeof(materials[0]);
             frameResources[i].materialBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
             frameResources[i].materialBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].materialBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].materialBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, materials.data(), frameResources[i].materialBuffer.size, frameResources[i].materialBuffer);
         }
         {
-            Buffer stagingBuffer;
-            stagingBuffer.alignment = calculateUniformBufferAlignment(globals, sizeof(renderObjects[0]));
-            stagingBuffer.size = renderObjects.size() * stagingBuffer.alignment;
-            stagingBuffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            stagingBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, stagingBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, stagingBuffer.memory, 0, stagingBuffer.size, 0, &stagingBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
+            auto alignment = calculateUniformBufferAlignment(globals, sizeof(renderObjects[0]));
+            std::vector<u8> renderObjectData(renderObjects.size() * alignment);
             for (u32 i = 0; i < renderObjects.size(); ++i) {
-                memcpy(reinterpret_cast<u8*>(stagingBuffer.mapped) + (i * stagingBuffer.alignment), &renderObjects[i], sizeof(renderObjects[0]));
+                memcpy(renderObjectData.data() + (i * alignment), &renderObjects[i], sizeof(renderObjects[0]));
             }
-            vkUnmapMemory(globals.device.handle, stagingBuffer.memory);
 
-            frameResources[i].renderObjectBuffer.alignment = stagingBuffer.alignment;
-            frameResources[i].renderObjectBuffer.size = stagingBuffer.size;
+            frameResources[i].renderObjectBuffer.alignment = alignment;
+            frameResources[i].renderObjectBuffer.size = renderObjectData.size();
             frameResources[i].renderObjectBuffer.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
             frameResources[i].renderObjectBuffer.memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
             createBuffer(globals, frameResources[i].renderObjectBuffer);
-            copyBuffer(globals, stagingBuffer, frameResources[i].renderObjectBuffer);
-            destroyBuffer(globals, stagingBuffer);
+            globals.uploadQueue->uploadBuffer(globals, renderObjectData.data(), renderObjectData.size(), frameResources[i].renderObjectBuffer);
         }
     }
 }
@@ -514,9 +405,9 @@ void Boxes::createResourceDescriptors()
     resourceDescriptors.resize(3);
     {
         std::vector<VkDescriptorPoolSize> poolSizes(4);
-        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight);
+        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, framesInFlight);
         poolSizes[1] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight);
-        poolSizes[2] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight);
+        poolSizes[2] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, framesInFlight);
         poolSizes[3] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight);
         auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(framesInFlight, poolSizes);
         THROW_IF_FAILED(
@@ -525,9 +416,9 @@ void Boxes::createResourceDescriptors()
             "Failed to create descriptor pool");
 
         std::vector<VkDescriptorSetLayoutBinding> bindings(4);
-        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
         bindings[1] = Initializer::descriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-        bindings[2] = Initializer::descriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[2] = Initializer::descriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
         bindings[3] = Initializer::descriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
         auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
         THROW_IF_FAILED(
@@ -544,19 +435,31 @@ void Boxes::createResourceDescriptors()
             "Failed to allocate descriptor sets");
 
         for (u32 i = 0; i < framesInFlight; ++i) {
-            std::vector<VkDescriptorBufferInfo> uniformBufferDescriptors(3);
-            uniformBufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].passBuffer.handle, 0);
-            uniformBufferDescriptors[1] = Initializer::descriptorBufferInfo(frameResources[i].dirLightBuffer.handle, 0);
-            uniformBufferDescriptors[2] = Initializer::descriptorBufferInfo(frameResources[i].spotLightBuffer.handle, 0);
+            // Pass and spot light live in the frame allocator and are bound with dynamic offsets
+            std::vector<VkDescriptorBufferInfo> dynamicBufferDescriptors(2);
+            dynamicBufferDescriptors[0] = Initializer::descriptorBufferInfo(globals.frameAllocator->getBuffer(i).handle, 0, sizeof(Pass));
+            dynamicBufferDescriptors[1] = Initializer::descriptorBufferInfo(globals.frameAllocator->getBuffer(i).handle, 0, sizeof(SpotLight));
+            std::vector<VkDescriptorBufferInfo> uniformBufferDescriptors(1);
+            uniformBufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].dirLightBuffer.handle, 0);
             std::vector<VkDescriptorBufferInfo> storageBufferDescriptors(1);
             storageBufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].pointLightBuffer.handle, 0);
-            std::vector<VkWriteDescriptorSet> descriptorWrites(2);
+            std::vector<VkWriteDescriptorSet> descriptorWrites(4);
             descriptorWrites[0] = Initializer::writeDescriptorSet(
                 resourceDescriptors[0].handles[i],
-                0, 0, uniformBufferDescriptors.size(),
+                0, 0, 1,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                nullptr, &dynamicBufferDescriptors[0], nullptr);
+            descriptorWrites[1] = Initializer::writeDescriptorSet(
+                resourceDescriptors[0].handles[i],
+                1, 0, uniformBufferDescriptors.size(),
                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                 nullptr, uniformBufferDescriptors.data(), nullptr);
-            descriptorWrites[1] = Initializer::writeDescriptorSet(
+            descriptorWrites[2] = Initializer::writeDescriptorSet(
+                resourceDescriptors[0].handles[i],
+                2, 0, 1,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                nullptr, &dynamicBufferDescriptors[1], nullptr);
+            descriptorWrites[3] = Initializer::writeDescriptorSet(
                 resourceDescriptors[0].handles[i],
                 3, 0, storageBufferDescriptors.size(),
                 VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
@@ -665,6 +568,11 @@ void Boxes::createResourceDescriptors()
 
 void Boxes::createPushConstantRanges()
 {
+    // Position offset and scale that undo the vertex quantization
+    pushConstantRanges.resize(1);
+    pushConstantRanges[0].offset = 0;
+    pushConstantRanges[0].size = 2 * sizeof(glm::vec4);
+    pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 }
 
 void Boxes::createPipelines()
@@ -694,11 +602,11 @@ void Boxes::createPipelines()
         }
 
         std::vector<VkVertexInputBindingDescription> vertexBindingDescriptions(1);
-        vertexBindingDescriptions[0] = Initializer::vertexInputBindingDescription(0, sizeof(Vertex));
+        vertexBindingDescriptions[0] = Initializer::vertexInputBindingDescription(0, sizeof(QuantizedVertex));
         std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions(3);
-        vertexAttributeDescriptions[0] = Initializer::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos));
-        vertexAttributeDescriptions[1] = Initializer::vertexInputAttributeDescription(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal));
-        vertexAttributeDescriptions[2] = Initializer::vertexInputAttributeDescription(2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord));
+        vertexAttributeDescriptions[0] = Initializer::vertexInputAttributeDescription(0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, pos));
+        vertexAttributeDescriptions[1] = Initializer::vertexInputAttributeDescription(1, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal));
+        vertexAttributeDescriptions[2] = Initializer::vertexInputAttributeDescription(2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, texCoord));
         auto vertexInputState = Initializer::pipelineVertexInputStateCreateInfo(vertexBindingDescriptions, vertexAttributeDescriptions);
 
         auto inputAssemblyState = Initializer::pipelineInputAssemblyStateCreateInfo();
@@ -777,11 +685,11 @@ void Boxes::createPipelines()
         }
 
         std::vector<VkVertexInputBindingDescription> vertexBindingDescriptions(1);
-        vertexBindingDescriptions[0] = Initializer::vertexInputBindingDescription(0, sizeof(Vertex));
+        vertexBindingDescriptions[0] = Initializer::vertexInputBindingDescription(0, sizeof(QuantizedVertex));
         std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions(3);
-        vertexAttributeDescriptions[0] = Initializer::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos));
-        vertexAttributeDescriptions[1] = Initializer::vertexInputAttributeDescription(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal));
-        vertexAttributeDescriptions[2] = Initializer::vertexInputAttributeDescription(2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord));
+        vertexAttributeDescriptions[0] = Initializer::vertexInputAttributeDescription(0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, pos));
+        vertexAttributeDescriptions[1] = Initializer::vertexInputAttributeDescription(1, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal));
+        vertexAttributeDescriptions[2] = Initializer::vertexInputAttributeDescription(2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, texCoord));
         auto vertexInputState = Initializer::pipelineVertexInputStateCreateInfo(vertexBindingDescriptions, vertexAttributeDescriptions);
 
         auto inputAssemblyState = Initializer::pipelineInputAssemblyStateCreateInfo();
@@ -873,12 +781,24 @@ void Boxes::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex, u
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, &meshes[0].vertexBuffer.handle, offsets.data());
     vkCmdBindIndexBuffer(commandBuffer, meshes[0].indexBuffer.handle, 0, VK_INDEX_TYPE_UINT16);
 
+    // Both pipeline layouts share the push constant range, so this stays valid across the pipeline switch
+    glm::vec4 dequantization[2] = { glm::vec4(meshBounds.offset, 0.f), glm::vec4(meshBounds.scale, 1.f) };
+    vkCmdPushConstants(
+        commandBuffer,
+        pipelineLayouts[0],
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(dequantization),
+        dequantization);
+
+    std::vector<u32> passOffsets(2);
+    passOffsets[0] = frameResources[frameIndex].passOffset;
+    passOffsets[1] = frameResources[frameIndex].spotLightOffset;
     vkCmdBindDescriptorSets(
         commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayouts[0],
         0, 1, &resourceDescriptors[0].handles[frameIndex],
-        0, nullptr);
+        passOffsets.size(), passOffsets.data());
 
     vkCmdBindDescriptorSets(
         commandBuffer,
@@ -955,7 +875,7 @@ void Boxes::updateFrameResources(u32 frameIndex)
         pass.view = camera.matrices.view;
         pass.proj = camera.matrices.proj;
         pass.viewPos = camera.pos;
-        memcpy(frameResources[frameIndex].passBuffer.mapped, &pass, sizeof(pass));
+        frameResources[frameIndex].passOffset = globals.frameAllocator->push(pass);
 
         SpotLight spotLight = {};
         spotLight.pos = camera.pos;
@@ -968,7 +888,7 @@ void Boxes::updateFrameResources(u32 frameIndex)
         spotLight.constAtt = 1.f;
         spotLight.linearAtt = 0.09f;
         spotLight.quadAtt = 0.032f;
-        memcpy(frameResources[frameIndex].spotLightBuffer.mapped, &spotLight, sizeof(spotLight));
+        frameResources[frameIndex].spotLightOffset = globals.frameAllocator->push(spotLight);
     }
     {
         // materials
@@ -991,6 +911,7 @@ void Boxes::destroyPipelines()
 
 void Boxes::destroyPushConstantRanges()
 {
+    pushConstantRanges.clear();
 }
 
 void Boxes::destroyResourceDescriptors()
@@ -1007,11 +928,7 @@ void Boxes::destroyResourceDescriptors()
 void Boxes::destroyFrameResources()
 {
     for (u32 i = 0; i < frameResources.size(); ++i) {
-        vkUnmapMemory(globals.device.handle, frameResources[i].passBuffer.memory);
-        destroyBuffer(globals, frameResources[i].passBuffer);
         destroyBuffer(globals, frameResources[i].dirLightBuffer);
-        vkUnmapMemory(globals.device.handle, frameResources[i].spotLightBuffer.memory);
-        destroyBuffer(globals, frameResources[i].spotLightBuffer);
         destroyBuffer(globals, frameResources[i].pointLightBuffer);
         destroyBuffer(globals, frameResources[i].materialBuffer);
         destroyBuffer(globals, frameResources[i].renderObjectBuffer);
@@ -1032,6 +949,9 @@ void Boxes::destroyMeshes()
     for (u32 i = 0; i < meshes.size(); ++i) {
         destroyBuffer(globals, meshes[i].indexBuffer);
         destroyBuffer(globals, meshes[i].vertexBuffer);
+        destroyBuffer(globals, meshes[i].meshletBuffer);
+        destroyBuffer(globals, meshes[i].meshletVertexBuffer);
+        destroyBuffer(globals, meshes[i].meshletTriangleBuffer);
     }
 }
 
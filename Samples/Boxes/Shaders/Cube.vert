@@ -1,7 +1,8 @@
 #version 460
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inNormal;
+// Quantized vertex: unorm16 position inside the mesh bounds, octahedral normal, half texture coordinates
+layout(location = 0) in vec4 inPos;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
 struct DirectionalLight {
@@ -29,14 +30,30 @@ layout(std140, set = 2, binding = 0) uniform RenderObjectBuffer {
     RenderObject renderObject;
 };
 
+layout(push_constant) uniform PushConstants
+{
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
 layout(location = 0) out vec3 outPosW;
 layout(location = 1) out vec3 outNormalW;
 layout(location = 2) out vec2 outTexCoord;
 
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    outPosW = vec3(renderObject.world * vec4(inPos, 1.f));
-    outNormalW = mat3(transpose(inverse(renderObject.world))) * inNormal;
+    vec3 pos = positionOffset.xyz + positionScale.xyz * inPos.xyz;
+    outPosW = vec3(renderObject.world * vec4(pos, 1.f));
+    outNormalW = mat3(transpose(inverse(renderObject.world))) * decodeOctahedral(inNormal);
     outTexCoord = inTexCoord;
-    gl_Position = proj * view * renderObject.world * vec4(inPos, 1.f);
+    gl_Position = proj * view * renderObject.world * vec4(pos, 1.f);
 }
@@ -1,7 +1,8 @@
 #version 460
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inNormal;
+// Quantized vertex: unorm16 position inside the mesh bounds, octahedral normal, half texture coordinates
+layout(location = 0) in vec4 inPos;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(std140, set = 0, binding = 0) uniform PassBuffer {
@@ -22,7 +23,14 @@ layout(std140, set = 2, binding = 0) uniform RenderObjectBuffer {
     RenderObject renderObject;
 };
 
+layout(push_constant) uniform PushConstants
+{
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
 void main()
 {
-    gl_Position = proj * view * renderObject.world * vec4(inPos, 1.f);
+    vec3 pos = positionOffset.xyz + positionScale.xyz * inPos.xyz;
+    gl_Position = proj * view * renderObject.world * vec4(pos, 1.f);
 }
@@ -5,11 +5,13 @@
 #include "Boilerplate/ProceduralMeshes/Box.h"
 #include "Boilerplate/ProceduralMeshes/Sphere.h"
 #include "Boilerplate/SampleBase.h"
+#include "Boilerplate/SkinningPass.h"
 #include "Boilerplate/Structures.h"
 #include "Boilerplate/Utils.h"
 #include "Boilerplate/GltfModel.h"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
 
 class GltfTest : public SampleBase {
 public:
@@ -40,6 +42,16 @@ private:
     glm::vec3 ambientColor;
 
     GltfModel gltfModel;
+    GltfModel::AnimationInstance animation;
+    std::chrono::steady_clock::time_point lastUpdate;
+    SkinningPass skinningPass;
+    u32 skinningInstance = ~0u;
+
+    struct PushConstants {
+        u32 materialIndex;
+        // Non-zero for nodes with a skin, whose vertices come from the skinning pass already in model space
+        u32 skinned;
+    };
 
     void createMeshes() override;
     void createTextures() override;
@@ -83,9 +95,16 @@ GltfTest::GltfTest(u32 width, u32 height, std::string const& name) :
 
 void GltfTest::createMeshes()
 {
-    gltfModel.load("Assets/Cube/glTF/Cube.gltf");
-    gltfModel.loadNodes();
-    gltfModel.loadMeshes(globals);
+    gltfModel.load(globals, "Assets/Cube/glTF/Cube.gltf");
+    gltfModel.loadMeshes(
+        globals,
+        VertexLayout::INTERLEAVED,
+        { VertexAttribute::POSITION, VertexAttribute::NORMAL, VertexAttribute::TEX_COORD },
+        VertexFormat::QUANTIZED);
+    gltfModel.loadSkinning(globals);
+    gltfModel.loadMeshlets(globals);
+    gltfModel.createAnimationInstance(animation);
+    lastUpdate = std::chrono::steady_clock::now();
 }
 
 void GltfTest::createTextures()
@@ -96,7 +115,6 @@ void GltfTest::createTextures()
 
 void GltfTest::createMaterials()
 {
-    gltfModel.loadMaterials();
 }
 
 void GltfTest::createRenderObjects()
@@ -109,19 +127,8 @@ void GltfTest::createLights()
 
 void GltfTest::createFrameResources()
 {
+    // The pass itself is written into the frame allocator every frame
     frameResources.resize(framesInFlight);
-    for (u32 i = 0; i < frameResources.size(); ++i) {
-        {
-            frameResources[i].passBuffer.size = sizeof(Pass);
-            frameResources[i].passBuffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-            frameResources[i].passBuffer.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            createBuffer(globals, frameResources[i].passBuffer);
-            THROW_IF_FAILED(
-                vkMapMemory(globals.device.handle, frameResources[i].passBuffer.memory, 0, frameResources[i].passBuffer.size, 0, &frameResources[i].passBuffer.mapped),
-                __FILE__, __LINE__,
-                "Failed to map memory");
-        }
-    }
 
     gltfModel.createFrameResources(globals);
 }
@@ -131,7 +138,7 @@ void GltfTest::createResourceDescriptors()
     resourceDescriptors.resize(1);
     {
         std::vector<VkDescriptorPoolSize> poolSizes(1);
-        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight);
+        poolSizes[0] = Initializer::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, framesInFlight);
         auto descriptorPoolCreateInfo = Initializer::descriptorPoolCreateInfo(framesInFlight, poolSizes);
         THROW_IF_FAILED(
             vkCreateDescriptorPool(globals.device.handle, &descriptorPoolCreateInfo, globals.allocator, &resourceDescriptors[0].pool),
@@ -139,7 +146,7 @@ void GltfTest::createResourceDescriptors()
             "Failed to create descriptor pool");
 
         std::vector<VkDescriptorSetLayoutBinding> bindings(1);
-        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        bindings[0] = Initializer::descriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
         auto descriptorSetLayoutCreateInfo = Initializer::descriptorSetLayoutCreateInfo(bindings);
         THROW_IF_FAILED(
             vkCreateDescriptorSetLayout(globals.device.handle, &descriptorSetLayoutCreateInfo, globals.allocator, &resourceDescriptors[0].setLayout),
@@ -156,12 +163,12 @@ void GltfTest::createResourceDescriptors()
 
         for (u32 i = 0; i < framesInFlight; ++i) {
             std::vector<VkDescriptorBufferInfo> uniformBufferDescriptors(1);
-            uniformBufferDescriptors[0] = Initializer::descriptorBufferInfo(frameResources[i].passBuffer.handle, 0);
+            uniformBufferDescriptors[0] = Initializer::descriptorBufferInfo(globals.frameAllocator->getBuffer(i).handle, 0, sizeof(Pass));
             std::vector<VkWriteDescriptorSet> descriptorWrites(1);
             descriptorWrites[0] = Initializer::writeDescriptorSet(
                 resourceDescriptors[0].handles[i],
                 0, 0, uniformBufferDescriptors.size(),
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 nullptr, uniformBufferDescriptors.data(), nullptr);
             vkUpdateDescriptorSets(globals.device.handle, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
         }
@@ -174,13 +181,14 @@ void GltfTest::createPushConstantRanges()
 {
     pushConstantRanges.resize(1);
     pushConstantRanges[0].offset = 0;
-    pushConstantRanges[0].size = sizeof(u32);
+    pushConstantRanges[0].size = sizeof(PushConstants);
     pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 }
 
 void GltfTest::createPipelines()
 {
-    pipelines.resize(1);
+    // The second pipeline draws skinned nodes from the output of the skinning pass
+    pipelines.resize(2);
     pipelineLayouts.resize(1);
     {
         std::vector<VkPipelineShaderStageCreateInfo> stages(2);
@@ -204,15 +212,7 @@ void GltfTest::createPipelines()
             stages[1] = Initializer::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, shaderModule[1]);
         }
 
-        std::vector<VkVertexInputBindingDescription> vertexBindingDescriptions(3);
-        vertexBindingDescriptions[0] = Initializer::vertexInputBindingDescription(0, sizeof(glm::vec3));
-        vertexBindingDescriptions[1] = Initializer::vertexInputBindingDescription(1, sizeof(glm::vec3));
-        vertexBindingDescriptions[2] = Initializer::vertexInputBindingDescription(2, sizeof(glm::vec2));
-        std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions(3);
-        vertexAttributeDescriptions[0] = Initializer::vertexInputAttributeDescription(0, vertexBindingDescriptions[0].binding, VK_FORMAT_R32G32B32_SFLOAT, 0);
-        vertexAttributeDescriptions[1] = Initializer::vertexInputAttributeDescription(1, vertexBindingDescriptions[1].binding, VK_FORMAT_R32G32B32_SFLOAT, 0);
-        vertexAttributeDescriptions[2] = Initializer::vertexInputAttributeDescription(2, vertexBindingDescriptions[2].binding, VK_FORMAT_R32G32_SFLOAT, 0);
-        auto vertexInputState = Initializer::pipelineVertexInputStateCreateInfo(vertexBindingDescriptions, vertexAttributeDescriptions);
+        auto vertexInputState = Initializer::pipelineVertexInputStateCreateInfo(gltfModel.vertexInputBindings, gltfModel.vertexInputAttributes);
 
         auto inputAssemblyState = Initializer::pipelineInputAssemblyStateCreateInfo();
         auto tessellationState = Initializer::pipelineTessellationStateCreateInfo();
@@ -264,9 +264,21 @@ void GltfTest::createPipelines()
             __FILE__, __LINE__,
             "Failed to create graphics pipeline");
 
+        auto skinnedVertexInputState = Initializer::pipelineVertexInputStateCreateInfo(gltfModel.skinnedVertexInputBindings, gltfModel.skinnedVertexInputAttributes);
+        createInfo.pVertexInputState = &skinnedVertexInputState;
+        THROW_IF_FAILED(
+            vkCreateGraphicsPipelines(globals.device.handle, VK_NULL_HANDLE, 1, &createInfo, globals.allocator, &pipelines[1]),
+            __FILE__, __LINE__,
+            "Failed to create graphics pipeline");
+
         vkDestroyShaderModule(globals.device.handle, shaderModule[0], globals.allocator);
         vkDestroyShaderModule(globals.device.handle, shaderModule[1], globals.allocator);
     }
+
+    if (!gltfModel.skinnedRanges.empty()) {
+        skinningPass.create(globals, "GltfTest/Skinning.spv");
+        skinningInstance = skinningPass.addInstance(globals, gltfModel, animation);
+    }
 }
 
 void GltfTest::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex, u32 frameIndex, ImDrawData* draw_data)
@@ -277,6 +289,10 @@ void GltfTest::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex
         __FILE__, __LINE__,
         "Failed to begin command buffer");
 
+    if (skinningInstance != ~0u && gltfModel.isResident(globals)) {
+        skinningPass.record(commandBuffer, frameIndex);
+    }
+
     VkClearValue clearColor = {};
     clearColor.color = {{ 0.f, 0.f, 0.f, 1.f }};
     VkClearValue clearDepth = {};
@@ -298,57 +314,73 @@ void GltfTest::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex
     auto scissor = Initializer::scissor(globals.swapchain.extent.width, globals.swapchain.extent.height);
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    std::vector<VkBuffer> vertexBuffers(3);
-    vertexBuffers[0] = gltfModel.vertexBuffers.positions.handle;
-    vertexBuffers[1] = gltfModel.vertexBuffers.normals.handle;
-    vertexBuffers[2] = gltfModel.vertexBuffers.texCoords.handle;
-    std::vector<VkDeviceSize> offsets(3, 0);
-    //offsets[0] = 0;
-    //offsets[1] = gltfModel.positions.size() * sizeof(gltfModel.positions[0]);
-    //offsets[2] = gltfModel.positions.size() * sizeof(gltfModel.positions[0]) + gltfModel.normals.size() * sizeof(gltfModel.normals[0]);
-    vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
-    vkCmdBindIndexBuffer(commandBuffer, gltfModel.indexBuffer.handle, 0, VK_INDEX_TYPE_UINT32);
-
-    vkCmdBindDescriptorSets(
-        commandBuffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipelineLayouts[0],
-        0, 1, &resourceDescriptors[0].handles[frameIndex],
-        0, nullptr);
-
-    vkCmdBindDescriptorSets(
-        commandBuffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipelineLayouts[0],
-        1, 1, &gltfModel.resourceDescriptors[0].handles[frameIndex],
-        0, nullptr);
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);
-
-    for (u32 i = 0; i < gltfModel.model.nodes.size(); ++i) {
-        u32 dynamicOffset = i * gltfModel.frameResources[frameIndex].renderObjectBuffer.alignment;
+    if (gltfModel.isResident(globals)) {
+        // Pixels per mesh unit at distance 1, for the LOD selection
+        auto lodScale = globals.swapchain.extent.height * 0.5f * glm::abs(camera.matrices.proj[1][1]);
+
+        gltfModel.bindVertexBuffers(commandBuffer);
+        vkCmdBindIndexBuffer(commandBuffer, gltfModel.indexBuffer.handle, 0, VK_INDEX_TYPE_UINT32);
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipelineLayouts[0],
+            0, 1, &resourceDescriptors[0].handles[frameIndex],
+            1, &frameResources[frameIndex].passOffset);
 
         vkCmdBindDescriptorSets(
             commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             pipelineLayouts[0],
-            2, 1, &gltfModel.resourceDescriptors[1].handles[frameIndex],
-            1, &dynamicOffset);
+            1, 1, &gltfModel.resourceDescriptors[0].handles[frameIndex],
+            0, nullptr);
 
-        auto& mesh = gltfModel.model.meshes[gltfModel.model.nodes[i].mesh];
-        for (u32 j = 0; j < mesh.primitives.size(); ++j) {
-            u32 materialIndex = gltfModel.meshes[gltfModel.model.nodes[i].mesh].primitives[j].materialIndex;
-            vkCmdPushConstants(
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);
+        bool skinnedBound = false;
+
+        for (u32 i = 0; i < gltfModel.nodes.size(); ++i) {
+            if (gltfModel.nodes[i].meshIndex == -1) {
+                continue;
+            }
+            u32 dynamicOffset = i * gltfModel.frameResources[frameIndex].renderObjectBuffer.alignment;
+
+            vkCmdBindDescriptorSets(
                 commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
                 pipelineLayouts[0],
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0, sizeof(materialIndex), &materialIndex);
-
-            vkCmdDrawIndexed(
-            commandBuffer,
-            gltfModel.meshes[gltfModel.model.nodes[i].mesh].primitives[j].indexCount, 1,
-            gltfModel.meshes[gltfModel.model.nodes[i].mesh].primitives[j].firstIndex,
-            gltfModel.meshes[gltfModel.model.nodes[i].mesh].primitives[j].vertexOffset, 0);
+                2, 1, &gltfModel.resourceDescriptors[1].handles[frameIndex],
+                1, &dynamicOffset);
+
+            bool skinned = gltfModel.nodes[i].skinIndex != -1 && skinningInstance != ~0u;
+            if (skinned != skinnedBound) {
+                if (skinned) {
+                    gltfModel.bindSkinnedVertexBuffers(commandBuffer, skinningPass.getPositions(skinningInstance), skinningPass.getNormals(skinningInstance));
+                } else {
+                    gltfModel.bindVertexBuffers(commandBuffer);
+                }
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[skinned ? 1 : 0]);
+                skinnedBound = skinned;
+            }
+
+            auto& mesh = gltfModel.meshes[gltfModel.nodes[i].meshIndex];
+            for (u32 j = 0; j < mesh.primitives.size(); ++j) {
+                PushConstants pushConstants;
+                pushConstants.materialIndex = mesh.primitives[j].materialIndex;
+                pushConstants.skinned = skinned ? 1 : 0;
+                vkCmdPushConstants(
+                    commandBuffer,
+                    pipelineLayouts[0],
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                    0, sizeof(pushConstants), &pushConstants);
+
+                auto lodIndex = gltfModel.selectLod(mesh.primitives[j], gltfModel.nodes[i].globalTransform, camera.pos, lodScale);
+                auto const& lod = mesh.primitives[j].lods[lodIndex];
+                vkCmdDrawIndexed(
+                commandBuffer,
+                lod.indexCount, 1,
+                lod.firstIndex,
+                mesh.primitives[j].vertexOffset, 0);
+            }
         }
     }
 
@@ -366,7 +398,17 @@ void GltfTest::updateFrameResources(u32 frameIndex)
         pass.view = camera.matrices.view;
         pass.proj = camera.matrices.proj;
         pass.viewPos = camera.pos;
-        memcpy(frameResources[frameIndex].passBuffer.mapped, &pass, sizeof(pass));
+        frameResources[frameIndex].passOffset = globals.frameAllocator->push(pass);
+    }
+    {
+        auto now = std::chrono::steady_clock::now();
+        gltfModel.updateAnimation(animation, std::chrono::duration<float>(now - lastUpdate).count());
+        gltfModel.uploadJointMatrices(globals, animation);
+        lastUpdate = now;
+    }
+    {
+        auto lodScale = globals.swapchain.extent.height * 0.5f * glm::abs(camera.matrices.proj[1][1]);
+        gltfModel.updateTextureStreaming(globals, frameIndex, camera.pos, lodScale);
     }
     {
         // materials
@@ -378,6 +420,11 @@ void GltfTest::updateFrameResources(u32 frameIndex)
 
 void GltfTest::destroyPipelines()
 {
+    if (skinningInstance != ~0u) {
+        skinningPass.destroy(globals);
+        skinningInstance = ~0u;
+    }
+
     for (u32 i = 0; i < pipelineLayouts.size(); ++i) {
         vkDestroyPipelineLayout(globals.device.handle, pipelineLayouts[i], globals.allocator);
     }
@@ -404,10 +451,7 @@ void GltfTest::destroyResourceDescriptors()
 
 void GltfTest::destroyFrameResources()
 {
-    for (u32 i = 0; i < frameResources.size(); ++i) {
-        vkUnmapMemory(globals.device.handle, frameResources[i].passBuffer.memory);
-        destroyBuffer(globals, frameResources[i].passBuffer);
-    }
+    frameResources.clear();
 }
 
 void GltfTest::destroyTextures()
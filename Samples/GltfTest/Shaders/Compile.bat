@@ -1,3 +1,4 @@
 C:/VulkanSDK/1.3.275.0/Bin/glslc.exe Cube.vert -o Vertex.spv
 C:/VulkanSDK/1.3.275.0/Bin/glslc.exe Cube.frag -o Fragment.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe Skinning.comp -o Skinning.spv
 pause
@@ -1,7 +1,9 @@
 #version 460
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inNormal;
+// Quantized vertex: unorm16 position inside the model bounds, octahedral normal and half texture coordinates.
+// Skinned nodes read float model space positions written by the skinning pass instead.
+layout(location = 0) in vec4 inPos;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(std140, set = 0, binding = 0) uniform PassBuffer {
@@ -12,6 +14,8 @@ layout(std140, set = 0, binding = 0) uniform PassBuffer {
 
 struct RenderObject {
     mat4 world;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
 layout(std140, set = 2, binding = 0) uniform RenderObjectBuffer {
@@ -21,16 +25,34 @@ layout(std140, set = 2, binding = 0) uniform RenderObjectBuffer {
 layout(push_constant) uniform PushConstants
 {
     uint materialIndex;
+    uint skinned;
 };
 
 layout(location = 0) out vec3 outPosW;
 layout(location = 1) out vec3 outNormalW;
 layout(location = 2) out vec2 outTexCoord;
 
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    outPosW = vec3(renderObject.world * vec4(inPos, 1.f));
-    outNormalW = mat3(transpose(inverse(renderObject.world))) * inNormal;
+    // Skinned vertices ignore the node's transform, the joint matrices already end in model space
+    mat4 world = renderObject.world;
+    vec3 pos = renderObject.positionOffset.xyz + renderObject.positionScale.xyz * inPos.xyz;
+    if (skinned != 0) {
+        world = mat4(1.f);
+        pos = inPos.xyz;
+    }
+
+    outPosW = vec3(world * vec4(pos, 1.f));
+    outNormalW = mat3(transpose(inverse(world))) * decodeOctahedral(inNormal);
     outTexCoord = inTexCoord;
-    gl_Position = proj * view * renderObject.world * vec4(inPos, 1.f);
+    gl_Position = proj * view * world * vec4(pos, 1.f);
 }
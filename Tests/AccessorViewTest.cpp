@@ -0,0 +1,242 @@
+#include "Boilerplate/AccessorView.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+ComponentType const componentTypes[] = {
+    ComponentType::BYTE, ComponentType::UNSIGNED_BYTE, ComponentType::SHORT,
+    ComponentType::UNSIGNED_SHORT, ComponentType::UNSIGNED_INT, ComponentType::FLOAT
+};
+
+// One component straight from the bytes, in double precision and written out the way the specification states it
+double referenceValue(AccessorView const& view, u64 element, u32 component)
+{
+    auto src = view.data + element * view.stride + component * componentTypeSize(view.componentType);
+    auto load = [src](auto value) {
+        memcpy(&value, src, sizeof(value));
+        return value;
+    };
+    switch (view.componentType) {
+    case ComponentType::BYTE: {
+        double value = load(i8());
+        return view.normalized ? std::max(value / 127.0, -1.0) : value;
+    }
+    case ComponentType::UNSIGNED_BYTE: {
+        double value = load(u8());
+        return view.normalized ? value / 255.0 : value;
+    }
+    case ComponentType::SHORT: {
+        double value = load(i16());
+        return view.normalized ? std::max(value / 32767.0, -1.0) : value;
+    }
+    case ComponentType::UNSIGNED_SHORT: {
+        double value = load(u16());
+        return view.normalized ? value / 65535.0 : value;
+    }
+    case ComponentType::UNSIGNED_INT: {
+        double value = load(u32());
+        return view.normalized ? value / 4294967295.0 : value;
+    }
+    case ComponentType::FLOAT:
+        return load(float());
+    }
+    return 0.0;
+}
+
+double referenceComponent(AccessorView const& view, u64 element, u32 component)
+{
+    if (component >= view.componentCount) {
+        return component == 3 ? 1.0 : 0.0;
+    }
+    return view.data != nullptr ? referenceValue(view, element, component) : 0.0;
+}
+
+// Random bytes laid out with the given stride, starting one byte into the storage so nothing is aligned
+struct Source {
+    std::vector<u8> storage;
+    AccessorView view;
+};
+
+Source createSource(std::mt19937& random, ComponentType componentType, u32 componentCount, u64 count, u32 padding)
+{
+    Source source;
+    source.view.count = count;
+    source.view.componentType = componentType;
+    source.view.componentCount = componentCount;
+    source.view.stride = source.view.elementSize() + padding;
+    source.storage.resize(1 + count * source.view.stride);
+    for (auto& byte : source.storage) {
+        byte = static_cast<u8>(random());
+    }
+    if (componentType == ComponentType::FLOAT) {
+        // Random bits would include NaNs, which never compare equal
+        std::uniform_real_distribution<float> values(-1000.f, 1000.f);
+        for (u64 i = 0; i < count; ++i) {
+            for (u32 c = 0; c < componentCount; ++c) {
+                auto value = values(random);
+                memcpy(source.storage.data() + 1 + i * source.view.stride + c * sizeof(float), &value, sizeof(value));
+            }
+        }
+    }
+    source.view.data = source.storage.data() + 1;
+    return source;
+}
+
+// The SIMD kernels scale by a reciprocal where the scalar code divides, so normalized values may differ in the last bits
+void checkFloats(AccessorView const& view, std::vector<float> const& dst, u32 dstComponents)
+{
+    for (u64 i = 0; i < view.count; ++i) {
+        for (u32 c = 0; c < dstComponents; ++c) {
+            auto expected = referenceComponent(view, i, c);
+            auto tolerance = view.normalized ? 1e-6 : std::abs(expected) * 1e-7;
+            CHECK(std::abs(dst[i * dstComponents + c] - expected) <= tolerance);
+        }
+    }
+}
+
+template<typename D>
+void checkIntegers(AccessorView const& view, std::vector<D> const& dst, u32 dstComponents)
+{
+    for (u64 i = 0; i < view.count; ++i) {
+        for (u32 c = 0; c < dstComponents; ++c) {
+            CHECK(dst[i * dstComponents + c] == static_cast<D>(referenceComponent(view, i, c)));
+        }
+    }
+}
+
+// Element counts around the 8 and 16 wide kernels, so the vector loops and every length of scalar tail run
+u64 const counts[] = { 0, 1, 5, 7, 16, 33, 101, 1023 };
+
+void testPackedToFloat()
+{
+    std::mt19937 random(1);
+    for (auto componentType : componentTypes) {
+        for (u32 components = 1; components <= 4; ++components) {
+            for (auto count : counts) {
+                for (bool normalized : { false, true }) {
+                    auto source = createSource(random, componentType, components, count, 0);
+                    source.view.normalized = normalized && componentType != ComponentType::FLOAT;
+                    std::vector<float> dst(count * components);
+                    readAccessor(source.view, dst.data(), components);
+                    checkFloats(source.view, dst, components);
+                }
+            }
+        }
+    }
+}
+
+void testPackedToIntegers()
+{
+    std::mt19937 random(2);
+    for (auto componentType : { ComponentType::UNSIGNED_BYTE, ComponentType::UNSIGNED_SHORT, ComponentType::UNSIGNED_INT }) {
+        for (u32 components : { 1u, 4u }) {
+            for (auto count : counts) {
+                auto source = createSource(random, componentType, components, count, 0);
+                std::vector<u32> dst32(count * components);
+                readAccessor(source.view, dst32.data(), components);
+                checkIntegers(source.view, dst32, components);
+
+                // Joint indices go to 16 bits, only from the types that fit
+                if (componentType != ComponentType::UNSIGNED_INT) {
+                    std::vector<u16> dst16(count * components);
+                    readAccessor(source.view, dst16.data(), components);
+                    checkIntegers(source.view, dst16, components);
+                }
+            }
+        }
+    }
+}
+
+// Interleaved attributes and component count mismatches take the element by element path
+void testStrided()
+{
+    std::mt19937 random(3);
+    for (auto componentType : componentTypes) {
+        for (u32 components = 1; components <= 4; ++components) {
+            for (u32 dstComponents = 1; dstComponents <= 4; ++dstComponents) {
+                for (u32 padding : { 0u, 3u, 12u }) {
+                    if (padding == 0 && dstComponents == components) {
+                        continue;
+                    }
+                    auto source = createSource(random, componentType, components, 37, padding);
+                    source.view.normalized = componentType != ComponentType::FLOAT && padding == 3;
+                    std::vector<float> dst(source.view.count * dstComponents);
+                    readAccessor(source.view, dst.data(), dstComponents);
+                    checkFloats(source.view, dst, dstComponents);
+
+                    // Negative values have no unsigned result to compare against
+                    if (componentType == ComponentType::UNSIGNED_BYTE || componentType == ComponentType::UNSIGNED_SHORT ||
+                        componentType == ComponentType::UNSIGNED_INT) {
+                        source.view.normalized = false;
+                        std::vector<u32> integers(source.view.count * dstComponents);
+                        readAccessor(source.view, integers.data(), dstComponents);
+                        checkIntegers(source.view, integers, dstComponents);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Accessors without a buffer view read as zero, with the fourth component filled with one
+void testZeroFill()
+{
+    AccessorView view;
+    view.count = 11;
+    view.componentCount = 3;
+    view.stride = view.elementSize();
+    std::vector<float> dst(view.count * 4, -5.f);
+    readAccessor(view, dst.data(), 4);
+    checkFloats(view, dst, 4);
+    CHECK(dst[3] == 1.f && dst[0] == 0.f);
+
+    view.componentType = ComponentType::UNSIGNED_SHORT;
+    view.componentCount = 4;
+    std::vector<u16> joints(view.count * 4, 7);
+    readAccessor(view, joints.data(), 4);
+    checkIntegers(view, joints, 4);
+}
+
+// The vec3 positions of a 100k vertex mesh, the case the packed kernels exist for
+void benchmark()
+{
+    std::mt19937 random(4);
+    auto source = createSource(random, ComponentType::SHORT, 3, 100000, 0);
+    source.view.normalized = true;
+    std::vector<float> dst(source.view.count * 3);
+
+    constexpr u32 repeats = 50;
+    Stopwatch packedStopwatch;
+    for (u32 i = 0; i < repeats; ++i) {
+        readAccessor(source.view, dst.data(), 3);
+    }
+    auto packedSeconds = packedStopwatch.elapsed() / repeats;
+
+    // Asking for a fourth component forces the element by element path over the same data
+    std::vector<float> padded(source.view.count * 4);
+    Stopwatch stridedStopwatch;
+    for (u32 i = 0; i < repeats; ++i) {
+        readAccessor(source.view, padded.data(), 4);
+    }
+    auto stridedSeconds = stridedStopwatch.elapsed() / repeats;
+    std::printf("benchmark: 100000 normalized short vec3, packed %.3f ms, element by element %.3f ms\n",
+        packedSeconds * 1e3, stridedSeconds * 1e3);
+}
+
+}
+
+int main()
+{
+    testPackedToFloat();
+    testPackedToIntegers();
+    testStrided();
+    testZeroFill();
+    benchmark();
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include "Boilerplate/Animation.h"
+#include "Boilerplate/MatrixMath.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+bool isNear(glm::vec4 const& a, glm::vec4 const& b, float tolerance = 1e-5f)
+{
+    return glm::length(a - b) <= tolerance;
+}
+
+bool isNear(glm::mat4 const& a, glm::mat4 const& b)
+{
+    for (u32 i = 0; i < 4; ++i) {
+        if (!isNear(a[i], b[i], 1e-4f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The cursor has to find the same key as a binary search, playing forwards in small steps and after random jumps
+void testFindKeyframe()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> step(0.01f, 0.2f);
+    std::vector<float> times(300);
+    float time = 0.5f;
+    for (auto& key : times) {
+        key = time;
+        time += step(random);
+    }
+    auto keyCount = static_cast<u32>(times.size());
+    auto reference = [&](float t) {
+        if (t <= times[0]) {
+            return 0u;
+        }
+        return static_cast<u32>(std::upper_bound(times.begin(), times.end(), t) - times.begin()) - 1;
+    };
+
+    std::uniform_real_distribution<float> anywhere(0.f, times.back() + 1.f);
+    std::uniform_real_distribution<float> frame(0.f, 0.05f);
+    u32 hint = 0;
+    float t = 0.f;
+    for (u32 i = 0; i < 26000; ++i) {
+        t = i % 100 == 0 ? anywhere(random) : t + frame(random);
+        if (t > times.back() + 1.f) {
+            t = 0.f;
+        }
+        auto key = findKeyframe(times.data(), keyCount, t, hint);
+        CHECK(key == reference(t));
+        hint = key;
+    }
+
+    // Exactly on keys, and clamped before the first and after the last one
+    for (u32 k = 0; k < keyCount; ++k) {
+        CHECK(findKeyframe(times.data(), keyCount, times[k], k == 0 ? 0 : k - 1) == k);
+    }
+    CHECK(findKeyframe(times.data(), keyCount, -1.f, 100) == 0);
+    CHECK(findKeyframe(times.data(), keyCount, times.back() + 5.f, 3) == keyCount - 1);
+    CHECK(findKeyframe(times.data(), 0, 1.f, 0) == 0);
+    CHECK(findKeyframe(times.data(), 1, 1.f, 0) == 0);
+}
+
+// One track per interpolation mode between two keys at 1 and 3 seconds
+void testSampling()
+{
+    AnimationSet set;
+    set.times = { 1.f, 3.f };
+    auto addTrack = [&](u32 node, AnimationPath path, AnimationInterpolation interpolation, std::vector<glm::vec4> const& values) {
+        AnimationTrack track;
+        track.node = node;
+        track.path = path;
+        track.interpolation = interpolation;
+        track.firstKey = 0;
+        track.keyCount = 2;
+        track.firstValue = static_cast<u32>(set.values.size());
+        set.values.insert(set.values.end(), values.begin(), values.end());
+        set.tracks.push_back(track);
+    };
+    auto halfTurn = std::sqrt(0.5f);
+    addTrack(0, AnimationPath::TRANSLATION, AnimationInterpolation::STEP, { glm::vec4(1.f, 2.f, 3.f, 0.f), glm::vec4(5.f, 6.f, 7.f, 0.f) });
+    addTrack(1, AnimationPath::TRANSLATION, AnimationInterpolation::LINEAR, { glm::vec4(0.f), glm::vec4(4.f, -2.f, 8.f, 0.f) });
+    // Identity to a quarter turn about z
+    addTrack(1, AnimationPath::ROTATION, AnimationInterpolation::LINEAR, { glm::vec4(0.f, 0.f, 0.f, 1.f), glm::vec4(0.f, 0.f, halfTurn, halfTurn) });
+    // In-tangent, value and out-tangent per key; with flat tangents the midpoint is the average of the values
+    addTrack(2, AnimationPath::SCALE, AnimationInterpolation::CUBIC_SPLINE,
+        { glm::vec4(0.f), glm::vec4(1.f, 1.f, 1.f, 0.f), glm::vec4(0.f), glm::vec4(0.f), glm::vec4(3.f, 5.f, 1.f, 0.f), glm::vec4(0.f) });
+    AnimationClip clip;
+    clip.duration = 3.f;
+    clip.trackCount = static_cast<u32>(set.tracks.size());
+    set.clips.push_back(clip);
+
+    std::vector<u32> cursors;
+    std::vector<NodePose> poses(4);
+    poses[3].translation = glm::vec3(9.f, 9.f, 9.f);
+
+    sampleAnimation(set, 0, 2.f, cursors, poses.data());
+    CHECK(cursors.size() == set.tracks.size());
+    CHECK(isNear(glm::vec4(poses[0].translation, 0.f), glm::vec4(1.f, 2.f, 3.f, 0.f)));
+    CHECK(isNear(glm::vec4(poses[1].translation, 0.f), glm::vec4(2.f, -1.f, 4.f, 0.f)));
+    auto eighthTurn = glm::vec4(0.f, 0.f, std::sin(3.14159265f / 8.f), std::cos(3.14159265f / 8.f));
+    auto rotation = poses[1].rotation;
+    CHECK(isNear(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w), eighthTurn));
+    CHECK(isNear(glm::vec4(poses[2].scale, 0.f), glm::vec4(2.f, 3.f, 1.f, 0.f)));
+    // Nodes without a track keep their pose
+    CHECK(isNear(glm::vec4(poses[3].translation, 0.f), glm::vec4(9.f, 9.f, 9.f, 0.f)));
+
+    // Before the first and after the last key the values are clamped
+    sampleAnimation(set, 0, 0.f, cursors, poses.data());
+    CHECK(isNear(glm::vec4(poses[1].translation, 0.f), glm::vec4(0.f)));
+    CHECK(isNear(glm::vec4(poses[2].scale, 0.f), glm::vec4(1.f, 1.f, 1.f, 0.f)));
+    sampleAnimation(set, 0, 10.f, cursors, poses.data());
+    CHECK(isNear(glm::vec4(poses[0].translation, 0.f), glm::vec4(5.f, 6.f, 7.f, 0.f)));
+    rotation = poses[1].rotation;
+    CHECK(isNear(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w), glm::vec4(0.f, 0.f, halfTurn, halfTurn)));
+    CHECK(isNear(glm::vec4(poses[2].scale, 0.f), glm::vec4(3.f, 5.f, 1.f, 0.f)));
+}
+
+// T * R * S applied to a point: scaled, turned a quarter about z, then moved
+void testComposeTransform()
+{
+    NodePose pose;
+    pose.translation = glm::vec3(10.f, 20.f, 30.f);
+    pose.rotation = glm::quat(std::sqrt(0.5f), 0.f, 0.f, std::sqrt(0.5f));
+    pose.scale = glm::vec3(2.f, 3.f, 4.f);
+    auto transform = composeTransform(pose);
+    CHECK(isNear(transform * glm::vec4(1.f, 1.f, 1.f, 1.f), glm::vec4(7.f, 22.f, 34.f, 1.f)));
+}
+
+glm::mat4 randomMatrix(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> element(-2.f, 2.f);
+    glm::mat4 matrix;
+    for (u32 i = 0; i < 4; ++i) {
+        matrix[i] = glm::vec4(element(random), element(random), element(random), element(random));
+    }
+    return matrix;
+}
+
+glm::mat4 referenceProduct(glm::mat4 const& a, glm::mat4 const& b)
+{
+    glm::mat4 result;
+    for (u32 column = 0; column < 4; ++column) {
+        for (u32 row = 0; row < 4; ++row) {
+            float sum = 0.f;
+            for (u32 k = 0; k < 4; ++k) {
+                sum += a[k][row] * b[column][k];
+            }
+            result[column][row] = sum;
+        }
+    }
+    return result;
+}
+
+// The SSE products against a plain loop, in place included, and the hierarchy against a chain of products
+void testMatrixMath()
+{
+    std::mt19937 random(2);
+    for (u32 i = 0; i < 1000; ++i) {
+        auto a = randomMatrix(random);
+        auto b = randomMatrix(random);
+        auto expected = referenceProduct(a, b);
+        glm::mat4 result;
+        multiplyMatrix(a, b, result);
+        CHECK(isNear(result, expected));
+        auto inPlace = a;
+        multiplyMatrix(inPlace, b, inPlace);
+        CHECK(isNear(inPlace, expected));
+        inPlace = b;
+        multiplyMatrix(a, inPlace, inPlace);
+        CHECK(isNear(inPlace, expected));
+    }
+
+    std::vector<glm::mat4> as(64);
+    std::vector<glm::mat4> bs(64);
+    std::vector<glm::mat4> products(64);
+    for (u32 i = 0; i < 64; ++i) {
+        as[i] = randomMatrix(random);
+        bs[i] = randomMatrix(random);
+    }
+    multiplyMatrices(as.data(), bs.data(), products.data(), products.size());
+    for (u32 i = 0; i < 64; ++i) {
+        CHECK(isNear(products[i], referenceProduct(as[i], bs[i])));
+    }
+
+    // Two roots, node 3 under 2 under 0, listed parent first but not in index order
+    std::vector<glm::mat4> locals(5);
+    for (auto& local : locals) {
+        local = randomMatrix(random);
+    }
+    std::vector<u32> nodes = { 0, 4, 2, 1, 3 };
+    std::vector<i32> parents = { -1, -1, 0, 4, 2 };
+    std::vector<glm::mat4> globals(5);
+    multiplyHierarchy(locals.data(), nodes.data(), parents.data(), nodes.size(), globals.data());
+    CHECK(isNear(globals[0], locals[0]));
+    CHECK(isNear(globals[4], locals[4]));
+    CHECK(isNear(globals[2], referenceProduct(locals[0], locals[2])));
+    CHECK(isNear(globals[1], referenceProduct(locals[4], locals[1])));
+    CHECK(isNear(globals[3], referenceProduct(referenceProduct(locals[0], locals[2]), locals[3])));
+}
+
+}
+
+int main()
+{
+    testFindKeyframe();
+    testSampling();
+    testComposeTransform();
+    testMatrixMath();
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "Boilerplate/Base64.h"
+#include "Check.h"
+
+#include <cctype>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+char const alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string encode(std::vector<u8> const& data, bool padding)
+{
+    std::string text;
+    u64 i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        u32 bits = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+        text += { alphabet[bits >> 18], alphabet[bits >> 12 & 63], alphabet[bits >> 6 & 63], alphabet[bits & 63] };
+    }
+    if (data.size() - i == 1) {
+        u32 bits = data[i] << 16;
+        text += { alphabet[bits >> 18], alphabet[bits >> 12 & 63] };
+        text += padding ? "==" : "";
+    } else if (data.size() - i == 2) {
+        u32 bits = data[i] << 16 | data[i + 1] << 8;
+        text += { alphabet[bits >> 18], alphabet[bits >> 12 & 63], alphabet[bits >> 6 & 63] };
+        text += padding ? "=" : "";
+    }
+    return text;
+}
+
+// The decoder tinygltf used for data URIs, René Nyffenegger's base64_decode (zlib license), kept as the baseline
+std::string tinygltfBase64Decode(std::string const& encoded)
+{
+    static std::string const characters = alphabet;
+    auto isBase64 = [](unsigned char c) { return std::isalnum(c) || c == '+' || c == '/'; };
+
+    int length = static_cast<int>(encoded.size());
+    int i = 0;
+    int in = 0;
+    unsigned char quad[4];
+    unsigned char triple[3];
+    std::string result;
+    while (length-- && encoded[in] != '=' && isBase64(encoded[in])) {
+        quad[i++] = encoded[in];
+        in++;
+        if (i == 4) {
+            for (i = 0; i < 4; i++) {
+                quad[i] = static_cast<unsigned char>(characters.find(static_cast<char>(quad[i])));
+            }
+            triple[0] = (quad[0] << 2) + ((quad[1] & 0x30) >> 4);
+            triple[1] = ((quad[1] & 0xf) << 4) + ((quad[2] & 0x3c) >> 2);
+            triple[2] = ((quad[2] & 0x3) << 6) + quad[3];
+            for (i = 0; i < 3; i++) {
+                result += triple[i];
+            }
+            i = 0;
+        }
+    }
+    if (i) {
+        for (int j = i; j < 4; j++) {
+            quad[j] = 0;
+        }
+        for (int j = 0; j < 4; j++) {
+            quad[j] = static_cast<unsigned char>(characters.find(static_cast<char>(quad[j])));
+        }
+        triple[0] = (quad[0] << 2) + ((quad[1] & 0x30) >> 4);
+        triple[1] = ((quad[1] & 0xf) << 4) + ((quad[2] & 0x3c) >> 2);
+        triple[2] = ((quad[2] & 0x3) << 6) + quad[3];
+        for (int j = 0; j < i - 1; j++) {
+            result += triple[j];
+        }
+    }
+    return result;
+}
+
+char const* getPath()
+{
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSSE3__) || defined(__AVX__)
+    return "SSSE3";
+#else
+    return "scalar";
+#endif
+}
+
+// Random lengths cover the SIMD blocks, the scalar tail and every padding case
+void testRoundTrip()
+{
+    std::mt19937 random(1);
+    for (u32 n = 0; n < 20000; ++n) {
+        std::vector<u8> data(random() % 400);
+        for (auto& byte : data) {
+            byte = static_cast<u8>(random());
+        }
+        auto text = encode(data, n % 2 == 0);
+        CHECK(base64DecodedSize(text.data(), text.size()) == data.size());
+
+        // One guard byte past the end catches overruns
+        std::vector<u8> decoded(data.size() + 1, 0xab);
+        CHECK(base64Decode(text.data(), text.size(), decoded.data()));
+        CHECK(memcmp(decoded.data(), data.data(), data.size()) == 0);
+        CHECK(decoded[data.size()] == 0xab);
+    }
+}
+
+// A single character outside the alphabet anywhere has to fail the decode, inside SIMD blocks as well as the tail
+void testInvalidCharacters()
+{
+    std::mt19937 random(2);
+    char const invalid[] = { '-', '_', ' ', '*', '\n', '\0', '\x80', '\xff' };
+    for (u32 n = 0; n < 2000; ++n) {
+        std::vector<u8> data(1 + random() % 300);
+        for (auto& byte : data) {
+            byte = static_cast<u8>(random());
+        }
+        auto text = encode(data, true);
+        auto unpadded = text.find('=');
+        auto position = random() % (unpadded == std::string::npos ? text.size() : unpadded);
+        text[position] = invalid[random() % sizeof(invalid)];
+        std::vector<u8> decoded(data.size());
+        CHECK(!base64Decode(text.data(), text.size(), decoded.data()));
+    }
+
+    // Padding in the middle and a dangling character
+    std::vector<u8> decoded(64);
+    std::string text = "QUJD=EFG";
+    CHECK(!base64Decode(text.data(), text.size(), decoded.data()));
+    text = "QUJDR";
+    CHECK(!base64Decode(text.data(), text.size(), decoded.data()));
+}
+
+// About the size of the payload embedded in Woman.gltf
+void benchmark()
+{
+    std::mt19937 random(3);
+    std::vector<u8> data(2100000);
+    for (auto& byte : data) {
+        byte = static_cast<u8>(random());
+    }
+    auto text = encode(data, true);
+    std::vector<u8> decoded(data.size());
+
+    constexpr u32 repeats = 20;
+    Stopwatch decodeStopwatch;
+    for (u32 i = 0; i < repeats; ++i) {
+        CHECK(base64Decode(text.data(), text.size(), decoded.data()));
+    }
+    auto decodeSeconds = decodeStopwatch.elapsed() / repeats;
+
+    std::string baseline;
+    Stopwatch baselineStopwatch;
+    for (u32 i = 0; i < repeats; ++i) {
+        baseline = tinygltfBase64Decode(text);
+    }
+    auto baselineSeconds = baselineStopwatch.elapsed() / repeats;
+
+    CHECK(memcmp(decoded.data(), data.data(), data.size()) == 0);
+    CHECK(baseline.size() == data.size() && memcmp(baseline.data(), data.data(), data.size()) == 0);
+    std::printf("benchmark: %.1f MB of base64, %s %.2f ms (%.2f GB/s), tinygltf %.2f ms\n",
+        text.size() * 1e-6, getPath(), decodeSeconds * 1e3, text.size() / decodeSeconds * 1e-9, baselineSeconds * 1e3);
+}
+
+}
+
+int main()
+{
+    std::printf("decoder path: %s\n", getPath());
+    testRoundTrip();
+    testInvalidCharacters();
+    benchmark();
+    return 0;
+}
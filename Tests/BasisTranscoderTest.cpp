@@ -0,0 +1,129 @@
+#include "Boilerplate/BasisTranscoder.h"
+#include "Boilerplate/BlockCompression.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+template<typename T>
+void append(std::vector<u8>& data, T const& value)
+{
+    auto bytes = reinterpret_cast<u8 const*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+// Smallest UASTC file there is: an sRGB RGB texture of all zero blocks, which every UASTC mode decodes to black.
+// The encoder is not part of the transcoder, so the file is put together here rather than cooked by basisu.
+std::vector<u8> createUastcKtx2(u32 width, u32 height)
+{
+    u32 levelCount = 1;
+    while (std::max(width, height) >> levelCount != 0) {
+        ++levelCount;
+    }
+
+    std::vector<u8> file = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+    u32 const dfdOffset = 80 + levelCount * 24;
+    u32 const dfdLength = 44;
+    // vkFormat, typeSize, width, height, depth, layers, faces, levels, supercompression, DFD, key/values, global data
+    for (u32 value : { 0u, 1u, width, height, 0u, 0u, 1u, levelCount, 0u, dfdOffset, dfdLength, dfdOffset + dfdLength, 0u }) {
+        append(file, value);
+    }
+    append(file, u64(0));
+    append(file, u64(0));
+
+    std::vector<u64> sizes(levelCount);
+    u64 offset = (dfdOffset + dfdLength + 15) / 16 * 16;
+    std::vector<u64> offsets(levelCount);
+    for (u32 i = levelCount; i-- > 0;) {
+        auto blocksX = (std::max(width >> i, 1u) + 3) / 4;
+        auto blocksY = (std::max(height >> i, 1u) + 3) / 4;
+        sizes[i] = static_cast<u64>(blocksX) * blocksY * 16;
+        offsets[i] = offset;
+        offset += sizes[i];
+    }
+    for (u32 i = 0; i < levelCount; ++i) {
+        append(file, offsets[i]);
+        append(file, sizes[i]);
+        append(file, sizes[i]);
+    }
+
+    // Basic descriptor block: UASTC colour model 166, BT.709 primaries, sRGB transfer, 4x4 texels in 16 bytes and one
+    // 128 bit RGB sample
+    for (u32 value : { dfdLength, 0u, 2u | (40u << 16), 166u | (1u << 8) | (2u << 16), 3u | (3u << 8), 16u, 0u,
+             127u << 16, 0u, 0u, ~0u }) {
+        append(file, value);
+    }
+    file.resize(offset, 0);
+    return file;
+}
+
+// The selector sees what the transcoder read from the file, and the levels come out the sizes of the target format
+void testTranscode(VkFormat target)
+{
+    auto file = createUastcKtx2(12, 7);
+    Ktx2Texture texture;
+    CHECK(parseKtx2(file.data(), file.size(), texture));
+    CHECK(isBasisKtx2(texture));
+
+    bool selected = false;
+    MipChain chain;
+    auto selectFormat = [&selected, target](bool alpha, bool srgb) {
+        selected = !alpha && srgb;
+        return target;
+    };
+    CHECK(transcodeBasisKtx2(texture, selectFormat, chain));
+    CHECK(selected);
+    CHECK(chain.format == target && chain.width == 12 && chain.height == 7 && chain.offsets.size() == 4);
+
+    auto blockSize = getBlockSize(target);
+    u64 size = 0;
+    for (u32 level = 0; level < chain.offsets.size(); ++level) {
+        auto width = std::max(12u >> level, 1u);
+        auto height = std::max(7u >> level, 1u);
+        CHECK(chain.offsets[level] == size);
+        size += blockSize != 0 ? static_cast<u64>((width + 3) / 4) * ((height + 3) / 4) * blockSize : static_cast<u64>(width) * height * 4;
+    }
+    CHECK(chain.pixels.size() == size);
+
+    // Every block of the file is the same, so every texel or block of the output is as well
+    auto unit = blockSize != 0 ? blockSize : 4;
+    for (u64 i = unit; i < chain.pixels.size(); i += unit) {
+        CHECK(memcmp(chain.pixels.data() + i, chain.pixels.data(), unit) == 0);
+    }
+    if (blockSize == 0) {
+        CHECK(chain.pixels[0] == 0 && chain.pixels[1] == 0 && chain.pixels[2] == 0);
+    }
+}
+
+// Files without Basis data, and targets the transcoder cannot write, are refused
+void testRejected()
+{
+    u8 const pixels[4] = { 1, 2, 3, 4 };
+    MipChain source;
+    buildMipChain(pixels, 1, 1, source);
+    auto file = writeKtx2(source);
+    Ktx2Texture texture;
+    CHECK(parseKtx2(file.data(), file.size(), texture));
+    CHECK(!isBasisKtx2(texture));
+    MipChain chain;
+    CHECK(!transcodeBasisKtx2(texture, [](bool, bool) { return VK_FORMAT_R8G8B8A8_SRGB; }, chain));
+
+    auto uastc = createUastcKtx2(8, 8);
+    CHECK(parseKtx2(uastc.data(), uastc.size(), texture));
+    CHECK(!transcodeBasisKtx2(texture, [](bool, bool) { return VK_FORMAT_BC1_RGB_SRGB_BLOCK; }, chain));
+}
+
+}
+
+int main()
+{
+    testTranscode(VK_FORMAT_R8G8B8A8_SRGB);
+    testTranscode(VK_FORMAT_BC7_SRGB_BLOCK);
+    testTranscode(VK_FORMAT_ASTC_4x4_SRGB_BLOCK);
+    testTranscode(VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK);
+    testRejected();
+    return 0;
+}
@@ -0,0 +1,382 @@
+#include "Boilerplate/BlockCompression.h"
+#include "Boilerplate/Ktx2.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Decoders written from the format specifications, independent of the encoders' own palettes
+
+void decodeRgb565(u16 packed, double color[3])
+{
+    color[0] = ((packed >> 11) & 31) * 255.0 / 31.0;
+    color[1] = ((packed >> 5) & 63) * 255.0 / 63.0;
+    color[2] = (packed & 31) * 255.0 / 31.0;
+}
+
+// BC3 colour blocks are always read in the four colour mode
+void decodeColorBlock(u8 const* block, bool alwaysFourColors, double texels[16][4])
+{
+    u16 color0;
+    u16 color1;
+    u32 indices;
+    memcpy(&color0, block, 2);
+    memcpy(&color1, block + 2, 2);
+    memcpy(&indices, block + 4, 4);
+
+    double palette[4][3];
+    decodeRgb565(color0, palette[0]);
+    decodeRgb565(color1, palette[1]);
+    for (u32 c = 0; c < 3; ++c) {
+        if (color0 > color1 || alwaysFourColors) {
+            palette[2][c] = (2.0 * palette[0][c] + palette[1][c]) / 3.0;
+            palette[3][c] = (palette[0][c] + 2.0 * palette[1][c]) / 3.0;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0;
+            palette[3][c] = 0.0;
+        }
+    }
+    for (u32 i = 0; i < 16; ++i) {
+        auto index = (indices >> (i * 2)) & 3;
+        for (u32 c = 0; c < 3; ++c) {
+            texels[i][c] = palette[index][c];
+        }
+        texels[i][3] = !alwaysFourColors && color0 <= color1 && index == 3 ? 0.0 : 255.0;
+    }
+}
+
+void decodeChannelBlock(u8 const* block, u32 channel, double texels[16][4])
+{
+    double palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (block[0] > block[1]) {
+        for (u32 i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7.0;
+        }
+    } else {
+        for (u32 i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5.0;
+        }
+        palette[6] = 0.0;
+        palette[7] = 255.0;
+    }
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; ++i) {
+        indices |= static_cast<u64>(block[2 + i]) << (i * 8);
+    }
+    for (u32 i = 0; i < 16; ++i) {
+        texels[i][channel] = palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+u32 readBits(u8 const* block, u32& position, u32 bitCount)
+{
+    u32 value = 0;
+    for (u32 i = 0; i < bitCount; ++i, ++position) {
+        value |= ((block[position / 8] >> (position % 8)) & 1) << i;
+    }
+    return value;
+}
+
+// Mode 6 only, the one mode the encoder writes
+bool decodeBc7Block(u8 const* block, double texels[16][4])
+{
+    u32 position = 0;
+    if (readBits(block, position, 7) != 1 << 6) {
+        return false;
+    }
+    u32 endpoints[2][4];
+    for (u32 c = 0; c < 4; ++c) {
+        endpoints[0][c] = readBits(block, position, 7) << 1;
+        endpoints[1][c] = readBits(block, position, 7) << 1;
+    }
+    auto pBit0 = readBits(block, position, 1);
+    auto pBit1 = readBits(block, position, 1);
+    for (u32 c = 0; c < 4; ++c) {
+        endpoints[0][c] |= pBit0;
+        endpoints[1][c] |= pBit1;
+    }
+    u32 const weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (u32 i = 0; i < 16; ++i) {
+        auto index = readBits(block, position, i == 0 ? 3 : 4);
+        for (u32 c = 0; c < 4; ++c) {
+            texels[i][c] = ((64 - weights[index]) * endpoints[0][c] + weights[index] * endpoints[1][c] + 32) >> 6;
+        }
+    }
+    return position == 128;
+}
+
+// Decodes the whole image into RGBA doubles; channels a format does not store come out as 0 and alpha as 255
+std::vector<double> decodeImage(BlockFormat format, u8 const* blocks, u32 width, u32 height)
+{
+    std::vector<double> image(static_cast<size_t>(width) * height * 4);
+    auto blockSize = getBlockSize(format);
+    auto blocksX = (width + 3) / 4;
+    auto blocksY = (height + 3) / 4;
+    for (u32 y = 0; y < blocksY; ++y) {
+        for (u32 x = 0; x < blocksX; ++x) {
+            auto block = blocks + (static_cast<size_t>(y) * blocksX + x) * blockSize;
+            double texels[16][4] = {};
+            for (auto& texel : texels) {
+                texel[3] = 255.0;
+            }
+            switch (format) {
+            case BlockFormat::BC1:
+                decodeColorBlock(block, false, texels);
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock(block + 8, true, texels);
+                decodeChannelBlock(block, 3, texels);
+                break;
+            case BlockFormat::BC4:
+                decodeChannelBlock(block, 0, texels);
+                break;
+            case BlockFormat::BC5:
+                decodeChannelBlock(block, 0, texels);
+                decodeChannelBlock(block + 8, 1, texels);
+                break;
+            case BlockFormat::BC7:
+                CHECK(decodeBc7Block(block, texels));
+                break;
+            }
+            for (u32 i = 0; i < 16; ++i) {
+                auto column = x * 4 + i % 4;
+                auto row = y * 4 + i / 4;
+                if (column < width && row < height) {
+                    memcpy(&image[(static_cast<size_t>(row) * width + column) * 4], texels[i], sizeof(texels[i]));
+                }
+            }
+        }
+    }
+    return image;
+}
+
+u32 getChannelMask(BlockFormat format)
+{
+    switch (format) {
+    case BlockFormat::BC1: return 0x7;
+    case BlockFormat::BC4: return 0x1;
+    case BlockFormat::BC5: return 0x3;
+    default: return 0xf;
+    }
+}
+
+// Gradients with a little noise, roughly what photographs and painted textures look like up close; the slopes do not
+// depend on the size, so small images are as hard to compress as large ones
+std::vector<u8> createPixels(u32 width, u32 height, u32 seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<i32> noise(-6, 6);
+    std::vector<u8> pixels(static_cast<size_t>(width) * height * 4);
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            auto texel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            i32 const values[4] = {
+                static_cast<i32>(40 + x * 3),
+                static_cast<i32>(20 + y * 3),
+                static_cast<i32>(128 + 100 * std::sin((x + y) * 0.2)),
+                static_cast<i32>(230 - (x + y) * 2),
+            };
+            for (u32 c = 0; c < 4; ++c) {
+                texel[c] = static_cast<u8>(std::clamp(values[c] + noise(random), 0, 255));
+            }
+        }
+    }
+    return pixels;
+}
+
+double calculatePsnr(BlockFormat format, u8 const* pixels, std::vector<double> const& decoded)
+{
+    auto mask = getChannelMask(format);
+    double error = 0.0;
+    u64 count = 0;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (mask & (1 << (i % 4))) {
+            auto d = decoded[i] - pixels[i];
+            error += d * d;
+            ++count;
+        }
+    }
+    return error == 0.0 ? 100.0 : 10.0 * std::log10(255.0 * 255.0 / (error / count));
+}
+
+// Worst case quality of each encoder on smooth content, edge blocks included through the odd sizes
+void testQuality()
+{
+    struct Case {
+        BlockFormat format;
+        double minimumPsnr;
+    };
+    Case const cases[] = { { BlockFormat::BC1, 31.0 }, { BlockFormat::BC3, 32.0 }, { BlockFormat::BC4, 46.0 },
+        { BlockFormat::BC5, 46.0 }, { BlockFormat::BC7, 34.5 } };
+    for (auto const& test : cases) {
+        for (auto [width, height] : { std::pair(64u, 64u), std::pair(13u, 7u), std::pair(1u, 1u), std::pair(3u, 33u) }) {
+            auto pixels = createPixels(width, height, width * 7 + height);
+            std::vector<u8> blocks(((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(test.format));
+            compressImage(test.format, pixels.data(), width, height, blocks.data());
+            auto decoded = decodeImage(test.format, blocks.data(), width, height);
+            auto psnr = calculatePsnr(test.format, pixels.data(), decoded);
+            CHECK(psnr >= test.minimumPsnr);
+        }
+    }
+}
+
+// A single channel block lies within half a palette step of the 8 value mode between its extremes, plus rounding
+void testChannelBound()
+{
+    std::mt19937 random(5);
+    for (u32 iteration = 0; iteration < 200; ++iteration) {
+        std::uniform_int_distribution<i32> bounds(0, 255);
+        auto a = bounds(random);
+        auto b = bounds(random);
+        std::uniform_int_distribution<i32> values(std::min(a, b), std::max(a, b));
+        u8 pixels[16 * 4] = {};
+        for (u32 i = 0; i < 16; ++i) {
+            pixels[i * 4] = static_cast<u8>(values(random));
+            pixels[i * 4 + 1] = static_cast<u8>(values(random));
+        }
+        u8 minValue = 255;
+        u8 maxValue = 0;
+        for (u32 i = 0; i < 16; ++i) {
+            minValue = std::min(minValue, pixels[i * 4]);
+            maxValue = std::max(maxValue, pixels[i * 4]);
+        }
+
+        u8 blocks[16];
+        compressImage(BlockFormat::BC4, pixels, 4, 4, blocks);
+        auto decoded = decodeImage(BlockFormat::BC4, blocks, 4, 4);
+        for (u32 i = 0; i < 16; ++i) {
+            CHECK(std::abs(decoded[i * 4] - pixels[i * 4]) <= (maxValue - minValue) / 14.0 + 1.0);
+        }
+
+        compressImage(BlockFormat::BC5, pixels, 4, 4, blocks);
+        decoded = decodeImage(BlockFormat::BC5, blocks, 4, 4);
+        for (u32 i = 0; i < 16; ++i) {
+            CHECK(std::abs(decoded[i * 4] - pixels[i * 4]) <= (maxValue - minValue) / 14.0 + 1.0);
+            CHECK(decoded[i * 4 + 1] >= std::min(a, b) - 1.0 && decoded[i * 4 + 1] <= std::max(a, b) + 1.0);
+        }
+    }
+}
+
+// Flat blocks come back within the precision of each format's endpoints
+void testFlat()
+{
+    std::mt19937 random(6);
+    for (u32 iteration = 0; iteration < 100; ++iteration) {
+        u8 color[4];
+        for (auto& value : color) {
+            value = static_cast<u8>(random());
+        }
+        u8 pixels[5 * 3 * 4];
+        for (u32 i = 0; i < 15; ++i) {
+            memcpy(pixels + i * 4, color, 4);
+        }
+
+        u8 blocks[2 * 16];
+        compressImage(BlockFormat::BC1, pixels, 5, 3, blocks);
+        auto decoded = decodeImage(BlockFormat::BC1, blocks, 5, 3);
+        for (u32 i = 0; i < 15; ++i) {
+            CHECK(std::abs(decoded[i * 4] - color[0]) <= 4.2 && std::abs(decoded[i * 4 + 1] - color[1]) <= 2.1 &&
+                std::abs(decoded[i * 4 + 2] - color[2]) <= 4.2);
+        }
+
+        for (auto format : { BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5 }) {
+            compressImage(format, pixels, 5, 3, blocks);
+            decoded = decodeImage(format, blocks, 5, 3);
+            for (u32 i = 0; i < 15; ++i) {
+                if (format == BlockFormat::BC3) {
+                    CHECK(decoded[i * 4 + 3] == color[3]);
+                } else {
+                    CHECK(decoded[i * 4] == color[0]);
+                }
+            }
+        }
+
+        // The shared p-bit can cost one step in a channel whose parity differs from the others
+        compressImage(BlockFormat::BC7, pixels, 5, 3, blocks);
+        decoded = decodeImage(BlockFormat::BC7, blocks, 5, 3);
+        for (u32 i = 0; i < 15 * 4; ++i) {
+            CHECK(std::abs(decoded[i] - color[i % 4]) <= 1.0);
+        }
+    }
+}
+
+// Every format through compressMipChain and a KTX2 file and back, byte for byte
+void testKtx2RoundTrip()
+{
+    struct Case {
+        BlockFormat format;
+        bool srgb;
+        bool compressed;
+    };
+    Case const cases[] = { { BlockFormat::BC1, true, false }, { BlockFormat::BC1, true, true },
+        { BlockFormat::BC1, false, true }, { BlockFormat::BC3, true, true }, { BlockFormat::BC4, false, true },
+        { BlockFormat::BC5, false, true }, { BlockFormat::BC7, true, true }, { BlockFormat::BC7, false, true } };
+    for (auto const& test : cases) {
+        auto pixels = createPixels(37, 19, 3);
+        MipChain chain;
+        buildMipChain(pixels.data(), 37, 19, chain, test.srgb);
+        if (test.compressed) {
+            compressMipChain(test.format, test.srgb, chain);
+            CHECK(chain.format == getBlockVkFormat(test.format, test.srgb));
+            CHECK(chain.pixels.size() == chain.offsets.back() + getBlockSize(test.format));
+        }
+
+        auto file = writeKtx2(chain, { { "LVSourceHash", "0123456789abcdef" } });
+        CHECK(!file.empty() && isKtx2(file.data(), file.size()));
+        Ktx2Texture texture;
+        CHECK(parseKtx2(file.data(), file.size(), texture));
+        CHECK(texture.format == chain.format && texture.width == 37 && texture.height == 19);
+        CHECK(texture.layerCount == 1 && texture.faceCount == 1 && texture.levels.size() == chain.offsets.size());
+        CHECK(texture.dataFormatDescriptor.size != 0);
+        for (auto const& level : texture.levels) {
+            CHECK(level.offset % (test.compressed ? getBlockSize(test.format) : 4) == 0);
+        }
+        CHECK(getKtx2Value(texture, "LVSourceHash") == "0123456789abcdef");
+        CHECK(getKtx2Value(texture, "KTXwriter") == "LearningVulkan");
+        CHECK(getKtx2Value(texture, "KTXorientation").empty());
+
+        MipChain read;
+        CHECK(readKtx2MipChain(texture, read));
+        CHECK(read.format == chain.format && read.width == chain.width && read.height == chain.height);
+        CHECK(read.offsets == chain.offsets && read.pixels == chain.pixels);
+
+        // Cut off inside the finest level, which is stored last
+        CHECK(!parseKtx2(file.data(), file.size() - 1, texture));
+    }
+
+    u8 const notKtx2[100] = {};
+    Ktx2Texture texture;
+    CHECK(!isKtx2(notKtx2, sizeof(notKtx2)) && !parseKtx2(notKtx2, sizeof(notKtx2), texture));
+}
+
+// The 1024x1024 texture of a typical material slot
+void benchmark()
+{
+    auto pixels = createPixels(1024, 1024, 4);
+    for (auto format : { BlockFormat::BC1, BlockFormat::BC7 }) {
+        std::vector<u8> blocks(256 * 256 * getBlockSize(format));
+        Stopwatch stopwatch;
+        compressImage(format, pixels.data(), 1024, 1024, blocks.data());
+        std::printf("benchmark: 1024x1024 %s in %.1f ms\n", format == BlockFormat::BC1 ? "BC1" : "BC7", stopwatch.elapsed() * 1e3);
+    }
+}
+
+}
+
+int main()
+{
+    testQuality();
+    testChannelBound();
+    testFlat();
+    testKtx2RoundTrip();
+    benchmark();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "Boilerplate/Base64.h"
+#include "Boilerplate/GltfReader.h"
+#include "Boilerplate/MappedFile.h"
+#include "Boilerplate/ThirdParty/nlohmann/json.hpp"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every heap allocation goes through these, so the peak of live heap bytes can be measured per parse.
+// The size is kept in front of each block since sized delete is not always called.
+namespace {
+
+constexpr u64 headerSize = alignof(std::max_align_t);
+u64 liveBytes = 0;
+u64 peakBytes = 0;
+
+void* allocate(std::size_t size)
+{
+    auto block = static_cast<u8*>(std::malloc(size + headerSize));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    memcpy(block, &size, sizeof(size));
+    liveBytes += size;
+    peakBytes = std::max(peakBytes, liveBytes);
+    return block + headerSize;
+}
+
+void release(void* pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+    auto block = static_cast<u8*>(pointer) - headerSize;
+    std::size_t size;
+    memcpy(&size, block, sizeof(size));
+    liveBytes -= size;
+    std::free(block);
+}
+
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { release(pointer); }
+
+namespace {
+
+struct Measurement {
+    double seconds = 0.0;
+    u64 peakBytes = 0;
+};
+
+// Best time of a few runs, and the heap peak of one run over what was live before it
+template<typename Parse>
+Measurement measure(Parse parse)
+{
+    Measurement result;
+    result.seconds = 1e9;
+    for (u32 i = 0; i < 5; ++i) {
+        auto baseBytes = liveBytes;
+        peakBytes = liveBytes;
+        Stopwatch stopwatch;
+        parse();
+        result.seconds = std::min(result.seconds, stopwatch.elapsed());
+        result.peakBytes = peakBytes - baseBytes;
+    }
+    return result;
+}
+
+// What tinygltf did before the SAX reader: the whole file as a DOM, then embedded buffers decoded out of it
+u64 parseDom(std::string const& filename)
+{
+    MappedFile file;
+    CHECK(file.open(filename));
+    auto root = nlohmann::json::parse(file.getData(), file.getData() + file.getSize());
+    u64 bufferBytes = 0;
+    for (auto const& buffer : root["buffers"]) {
+        auto const& uri = buffer["uri"].get_ref<std::string const&>();
+        auto comma = uri.find(',');
+        CHECK(uri.rfind("data:", 0) == 0 && comma != std::string::npos);
+        std::vector<u8> data(base64DecodedSize(uri.data() + comma + 1, uri.size() - comma - 1));
+        CHECK(base64Decode(uri.data() + comma + 1, uri.size() - comma - 1, data.data()));
+        bufferBytes += data.size();
+    }
+    return bufferBytes;
+}
+
+void benchmark(std::string const& filename)
+{
+    u64 readerBufferBytes = 0;
+    auto reader = measure([&]() {
+        GltfDocument document;
+        readGltf(filename, document);
+        CHECK(!document.meshes.empty() && !document.accessors.empty());
+        readerBufferBytes = 0;
+        for (auto const& buffer : document.buffers) {
+            readerBufferBytes += buffer.data.size();
+        }
+    });
+
+    u64 domBufferBytes = 0;
+    auto dom = measure([&]() { domBufferBytes = parseDom(filename); });
+    CHECK(readerBufferBytes == domBufferBytes);
+
+    std::printf("%s: %.1f MB of buffers, readGltf %.2f ms with %.1f MB heap peak, DOM %.2f ms with %.1f MB heap peak\n",
+        filename.c_str(), readerBufferBytes * 1e-6, reader.seconds * 1e3, reader.peakBytes * 1e-6, dom.seconds * 1e3,
+        dom.peakBytes * 1e-6);
+}
+
+}
+
+int main()
+{
+    benchmark("../Samples/GltfTest/Assets/Woman.gltf");
+    benchmark("../Samples/GltfTest/Assets/dq.gltf");
+    return 0;
+}
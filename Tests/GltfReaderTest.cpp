@@ -0,0 +1,115 @@
+#include "Boilerplate/GltfReader.h"
+#include "Check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct Indices {
+    std::string position = "0";
+    std::string indices = "1";
+    std::string material = "0";
+    std::string mesh = "0";
+    std::string skin = "0";
+    std::string sceneNode = "0";
+    std::string texture = "0";
+};
+
+// One triangle with every kind of index readGltf has to check, the buffer lives next to the .gltf
+std::string createDocument(Indices const& indices)
+{
+    return R"({
+        "asset": { "version": "2.0" },
+        "scenes": [ { "nodes": [ )" + indices.sceneNode + R"( ] } ],
+        "nodes": [ { "mesh": )" + indices.mesh + R"(, "skin": )" + indices.skin + R"( } ],
+        "skins": [ { "joints": [ 0 ] } ],
+        "meshes": [ { "primitives": [ {
+            "attributes": { "POSITION": )" + indices.position + R"( },
+            "indices": )" + indices.indices + R"(,
+            "material": )" + indices.material + R"( } ] } ],
+        "materials": [ { "pbrMetallicRoughness": { "baseColorTexture": { "index": )" + indices.texture + R"( } } } ],
+        "textures": [ {} ],
+        "buffers": [ { "uri": "tri%20angle.bin", "byteLength": 42 } ],
+        "bufferViews": [ { "buffer": 0, "byteLength": 36 }, { "buffer": 0, "byteOffset": 36, "byteLength": 6 } ],
+        "accessors": [
+            { "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3" },
+            { "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" } ]
+    })";
+}
+
+bool isRejected(std::string const& filename, Indices const& indices)
+{
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << createDocument(indices);
+    GltfDocument document;
+    try {
+        readGltf(filename, document);
+    } catch (std::runtime_error const&) {
+        return true;
+    }
+    return false;
+}
+
+void testUriPath()
+{
+    CHECK(decodeUriPath("plain.bin") == "plain.bin");
+    CHECK(decodeUriPath("a%20b.bin") == "a b.bin");
+    CHECK(decodeUriPath("textures/%C3%A9t%C3%A9.png") == "textures/\xc3\xa9t\xc3\xa9.png");
+}
+
+// The valid document reads, with its percent escaped buffer, and every index out of range is rejected
+void testIndices(std::string const& directory)
+{
+    std::ofstream(directory + "/tri angle.bin", std::ios::binary | std::ios::trunc) << std::string(42, '\0');
+    auto filename = directory + "/triangle.gltf";
+
+    Indices valid;
+    CHECK(!isRejected(filename, valid));
+    GltfDocument document;
+    readGltf(filename, document);
+    CHECK(document.buffers[0].data.size() == 42);
+    CHECK(document.meshes[0].primitives[0].attributes.at("POSITION") == 0);
+
+    for (auto index : { "2", "-2", "1000000" }) {
+        auto indices = valid;
+        indices.position = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.indices = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.material = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.mesh = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.skin = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.sceneNode = index;
+        CHECK(isRejected(filename, indices));
+        indices = valid;
+        indices.texture = index;
+        CHECK(isRejected(filename, indices));
+    }
+
+    // -1 stands for an absent property wherever the specification makes it optional
+    auto optional = valid;
+    optional.indices = optional.material = optional.mesh = optional.skin = optional.texture = "-1";
+    CHECK(!isRejected(filename, optional));
+}
+
+}
+
+int main()
+{
+    auto directory = std::filesystem::temp_directory_path() / "GltfReaderTest";
+    std::filesystem::create_directories(directory);
+    testUriPath();
+    testIndices(directory.string());
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "Boilerplate/ImageDecoder.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void appendBigEndian(std::vector<u8>& data, u32 value)
+{
+    for (i32 shift = 24; shift >= 0; shift -= 8) {
+        data.push_back(static_cast<u8>(value >> shift));
+    }
+}
+
+u32 calculateCrc32(u8 const* data, u64 size)
+{
+    u32 crc = ~0u;
+    for (u64 i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (u32 bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+void appendChunk(std::vector<u8>& png, char const type[4], std::vector<u8> const& data)
+{
+    appendBigEndian(png, static_cast<u32>(data.size()));
+    auto begin = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    appendBigEndian(png, calculateCrc32(png.data() + begin, png.size() - begin));
+}
+
+// 8 bit RGB or RGBA PNG with unfiltered rows in stored deflate blocks, which every decoder has to accept
+std::vector<u8> createPng(u32 width, u32 height, u32 channels, std::vector<u8> const& pixels)
+{
+    std::vector<u8> rows;
+    for (u32 y = 0; y < height; ++y) {
+        rows.push_back(0);
+        rows.insert(rows.end(), pixels.begin() + y * width * channels, pixels.begin() + (y + 1) * width * channels);
+    }
+
+    std::vector<u8> zlib = { 0x78, 0x01 };
+    for (u64 begin = 0; begin < rows.size(); begin += 65535) {
+        auto length = static_cast<u32>(std::min<u64>(rows.size() - begin, 65535));
+        zlib.push_back(begin + length == rows.size() ? 1 : 0);
+        for (u32 value : { length, ~length }) {
+            zlib.push_back(static_cast<u8>(value));
+            zlib.push_back(static_cast<u8>(value >> 8));
+        }
+        zlib.insert(zlib.end(), rows.begin() + begin, rows.begin() + begin + length);
+    }
+    u32 a = 1;
+    u32 b = 0;
+    for (auto byte : rows) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(zlib, (b << 16) | a);
+
+    std::vector<u8> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    // Bit depth, colour type, compression, filter and interlace method
+    header.insert(header.end(), { 8, static_cast<u8>(channels == 4 ? 6 : 2), 0, 0, 0 });
+
+    std::vector<u8> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlib);
+    appendChunk(png, "IEND", {});
+    return png;
+}
+
+std::vector<u8> createPixels(u32 width, u32 height, u32 channels, u32 seed)
+{
+    std::vector<u8> pixels(static_cast<size_t>(width) * height * channels);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<u8>(i * 37 + seed * 11);
+    }
+    return pixels;
+}
+
+// RGB pixels come back as RGBA with opaque alpha
+std::vector<u8> expandToRgba(std::vector<u8> const& pixels, u32 channels)
+{
+    if (channels == 4) {
+        return pixels;
+    }
+    std::vector<u8> rgba;
+    for (size_t i = 0; i < pixels.size(); i += 3) {
+        rgba.insert(rgba.end(), { pixels[i], pixels[i + 1], pixels[i + 2], 255 });
+    }
+    return rgba;
+}
+
+// Many decodes in flight at once, from memory and from a file, each future with its own image
+void testDecode(ImageDecoder& decoder, std::string const& directory)
+{
+    struct Case {
+        u32 width;
+        u32 height;
+        u32 channels;
+    };
+    Case const cases[] = { { 1, 1, 4 }, { 5, 3, 4 }, { 7, 2, 3 }, { 64, 48, 4 }, { 300, 250, 3 } };
+
+    std::vector<std::vector<u8>> files;
+    std::vector<std::future<DecodedImage>> futures;
+    for (u32 i = 0; i < 4; ++i) {
+        for (auto const& test : cases) {
+            files.push_back(createPng(test.width, test.height, test.channels, createPixels(test.width, test.height, test.channels, i)));
+        }
+    }
+    // The data of in-memory decodes has to stay put until the futures are ready, so nothing is added from here on
+    for (auto const& file : files) {
+        futures.push_back(decoder.decode(file.data(), file.size()));
+    }
+    auto filename = directory + "/image.png";
+    std::ofstream(filename, std::ios::binary | std::ios::trunc).write(reinterpret_cast<char const*>(files[3].data()), files[3].size());
+    auto fileFuture = decoder.decode(filename);
+
+    for (u32 i = 0; i < futures.size(); ++i) {
+        auto const& test = cases[i % std::size(cases)];
+        auto image = futures[i].get();
+        CHECK(image.width == test.width && image.height == test.height);
+        CHECK(image.pixels == expandToRgba(createPixels(test.width, test.height, test.channels, i / std::size(cases)), test.channels));
+    }
+    auto image = fileFuture.get();
+    CHECK(image.width == cases[3].width && image.height == cases[3].height);
+    CHECK(image.pixels == createPixels(cases[3].width, cases[3].height, cases[3].channels, 0));
+}
+
+bool isRejected(std::future<DecodedImage> future)
+{
+    try {
+        future.get();
+    } catch (std::runtime_error const&) {
+        return true;
+    }
+    return false;
+}
+
+// Failed decodes come out of get() as exceptions, and the decoder keeps working after them
+void testInvalid(ImageDecoder& decoder, std::string const& directory)
+{
+    std::vector<u8> const garbage(100, 0x5a);
+    auto png = createPng(5, 3, 4, createPixels(5, 3, 4, 0));
+    auto truncated = std::vector<u8>(png.begin(), png.begin() + png.size() / 2);
+    // A height beyond what stb_image accepts
+    auto corrupted = png;
+    corrupted[20] = 0xff;
+
+    CHECK(isRejected(decoder.decode(garbage.data(), garbage.size())));
+    CHECK(isRejected(decoder.decode(png.data(), 0)));
+    CHECK(isRejected(decoder.decode(truncated.data(), truncated.size())));
+    CHECK(isRejected(decoder.decode(corrupted.data(), corrupted.size())));
+    CHECK(isRejected(decoder.decode(directory + "/missing.png")));
+
+    auto image = decoder.decode(png.data(), png.size()).get();
+    CHECK(image.width == 5 && image.height == 3 && image.pixels == createPixels(5, 3, 4, 0));
+}
+
+}
+
+int main()
+{
+    auto directory = std::filesystem::temp_directory_path() / "ImageDecoderTest";
+    std::filesystem::create_directories(directory);
+
+    for (u32 threadCount : { 1u, 4u }) {
+        ThreadPool pool;
+        pool.create(threadCount);
+        ImageDecoder decoder;
+        decoder.create(&pool);
+        testDecode(decoder, directory.string());
+        testInvalid(decoder, directory.string());
+        decoder.destroy();
+        pool.destroy();
+    }
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "Boilerplate/MeshCache.h"
+#include "Check.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void writeFile(std::string const& filename, std::string const& contents)
+{
+    std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+    stream.write(contents.data(), contents.size());
+}
+
+std::string readFile(std::string const& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+// 64 bit FNV-1a test vectors
+void testHash()
+{
+    CHECK(MeshCache::hash("", 0) == 0xcbf29ce484222325ull);
+    CHECK(MeshCache::hash("a", 1) == 0xaf63dc4c8601ec8cull);
+    CHECK(MeshCache::hash("foobar", 6) == 0x85944171f73967e8ull);
+}
+
+// Chunks come back as written and 64 byte aligned, and any change to the sources, the version, the settings or the
+// file itself makes open fail so the model is cooked again
+void testRoundTrip(std::string const& directory)
+{
+    auto sourceFilename = directory + "/model.gltf";
+    auto cacheFilename = directory + "/model.gltf.cooked";
+    writeFile(sourceFilename, "{ \"buffers\": [ { \"uri\": \"model.bin\" } ] }");
+    writeFile(directory + "/model.bin", std::string(1000, 'x'));
+
+    std::vector<float> positions = { 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f };
+    std::vector<u32> indices = { 0, 1, 2 };
+    std::vector<u8> images(777, 0x5a);
+    {
+        MeshCache writer;
+        writer.addArray(MeshCache::Chunk::POSITIONS, positions);
+        writer.addArray(MeshCache::Chunk::INDICES, indices);
+        writer.addArray(MeshCache::Chunk::IMAGES, images);
+        CHECK(writer.write(cacheFilename, sourceFilename, { "model.bin" }, 1));
+    }
+    CHECK(!std::filesystem::exists(cacheFilename + ".tmp"));
+
+    {
+        MeshCache cache;
+        CHECK(cache.open(cacheFilename, sourceFilename, 1));
+        u64 count = 0;
+        auto cachedPositions = cache.getArray<float>(MeshCache::Chunk::POSITIONS, count);
+        CHECK(cachedPositions != nullptr && count == positions.size());
+        CHECK(std::vector<float>(cachedPositions, cachedPositions + count) == positions);
+        auto cachedIndices = cache.getArray<u32>(MeshCache::Chunk::INDICES, count);
+        CHECK(cachedIndices != nullptr && std::vector<u32>(cachedIndices, cachedIndices + count) == indices);
+        auto cachedImages = cache.getChunk(MeshCache::Chunk::IMAGES);
+        CHECK(cachedImages.size == images.size() && std::vector<u8>(cachedImages.data, cachedImages.data + cachedImages.size) == images);
+        for (auto chunk : { MeshCache::Chunk::POSITIONS, MeshCache::Chunk::INDICES, MeshCache::Chunk::IMAGES }) {
+            CHECK(reinterpret_cast<std::uintptr_t>(cache.getChunk(chunk).data) % MeshCache::alignment == 0);
+        }
+
+        // 777 bytes are not a whole number of u32, and chunks that were never written are empty
+        CHECK(cache.getArray<u32>(MeshCache::Chunk::IMAGES, count) == nullptr);
+        CHECK(cache.getChunk(MeshCache::Chunk::NORMALS).size == 0);
+    }
+
+    // A changed dependency, and the same file back again
+    writeFile(directory + "/model.bin", std::string(1000, 'y'));
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 1));
+    }
+    writeFile(directory + "/model.bin", std::string(1000, 'x'));
+    {
+        MeshCache cache;
+        CHECK(cache.open(cacheFilename, sourceFilename, 1));
+    }
+
+    // Cooked on a device with other texture formats
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 0));
+    }
+
+    // A changed source file
+    auto source = readFile(sourceFilename);
+    writeFile(sourceFilename, source + " ");
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 1));
+    }
+    writeFile(sourceFilename, source);
+
+    // A missing dependency
+    std::filesystem::remove(directory + "/model.bin");
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 1));
+    }
+    writeFile(directory + "/model.bin", std::string(1000, 'x'));
+
+    // Another version, and a file cut off inside the chunk table
+    auto cooked = readFile(cacheFilename);
+    auto changed = cooked;
+    changed[4] ^= 1;
+    writeFile(cacheFilename, changed);
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 1));
+    }
+    writeFile(cacheFilename, cooked.substr(0, 40));
+    {
+        MeshCache cache;
+        CHECK(!cache.open(cacheFilename, sourceFilename, 1));
+    }
+    writeFile(cacheFilename, cooked);
+    {
+        MeshCache cache;
+        CHECK(cache.open(cacheFilename, sourceFilename, 1));
+    }
+}
+
+}
+
+int main()
+{
+    auto directory = std::filesystem::temp_directory_path() / "MeshCacheTest";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    testHash();
+    testRoundTrip(directory.string());
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "Boilerplate/MeshOptimizer.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct TestMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<u32> indices;
+};
+
+// A size x size grid of quads with its triangles in random order, the worst case for the vertex cache
+TestMesh createShuffledGrid(u32 size)
+{
+    TestMesh mesh;
+    for (u32 y = 0; y <= size; ++y) {
+        for (u32 x = 0; x <= size; ++x) {
+            mesh.positions.push_back(glm::vec3(float(x), float(y), 0.f));
+        }
+    }
+    std::vector<std::array<u32, 3>> triangles;
+    for (u32 y = 0; y < size; ++y) {
+        for (u32 x = 0; x < size; ++x) {
+            auto a = y * (size + 1) + x;
+            triangles.push_back({ a, a + 1, a + size + 1 });
+            triangles.push_back({ a + 1, a + size + 2, a + size + 1 });
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+    for (auto const& triangle : triangles) {
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    }
+    return mesh;
+}
+
+// The triangles as a sorted list, each rotated to start at its smallest index so the winding is kept
+std::vector<std::array<u32, 3>> canonicalTriangles(std::vector<u32> const& indices)
+{
+    std::vector<std::array<u32, 3>> triangles;
+    for (u64 t = 0; t < indices.size(); t += 3) {
+        std::array<u32, 3> triangle = { indices[t], indices[t + 1], indices[t + 2] };
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+void testReordering()
+{
+    auto mesh = createShuffledGrid(100);
+    auto vertexCount = static_cast<u32>(mesh.positions.size());
+    auto indices = mesh.indices;
+    auto before = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+    optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    CHECK(canonicalTriangles(indices) == canonicalTriangles(mesh.indices));
+    auto cacheOptimized = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+    optimizeOverdraw(indices.data(), indices.size(), mesh.positions.data(), vertexCount);
+    CHECK(canonicalTriangles(indices) == canonicalTriangles(mesh.indices));
+    auto after = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+    std::printf("shuffled grid: ACMR %.3f -> %.3f after the vertex cache pass, %.3f after the overdraw pass\n",
+        before.acmr(), cacheOptimized.acmr(), after.acmr());
+    CHECK(before.triangleCount == indices.size() / 3);
+    CHECK(before.vertexCount == vertexCount);
+    CHECK(before.acmr() > 2.5f);
+    CHECK(cacheOptimized.acmr() < 0.7f);
+    // Clusters are only cut where the cache runs empty anyway
+    CHECK(after.acmr() < cacheOptimized.acmr() * 1.1f);
+
+    // First use order: every index is at most one past the largest index before it
+    auto fetchIndices = indices;
+    auto remap = optimizeVertexFetch(fetchIndices.data(), fetchIndices.size(), vertexCount);
+    CHECK(remap.size() == vertexCount);
+    u32 next = 0;
+    for (auto index : fetchIndices) {
+        CHECK(index <= next);
+        next = std::max(next, index + 1);
+    }
+    auto positions = mesh.positions;
+    remapVertices(remap, positions.data());
+    for (u64 i = 0; i < indices.size(); ++i) {
+        CHECK(positions[fetchIndices[i]] == mesh.positions[indices[i]]);
+    }
+
+    // 16 bit indices get the same order
+    std::vector<u16> shortIndices(mesh.indices.begin(), mesh.indices.end());
+    optimizeVertexCache(shortIndices.data(), shortIndices.size(), vertexCount);
+    optimizeOverdraw(shortIndices.data(), shortIndices.size(), mesh.positions.data(), vertexCount);
+    CHECK(std::equal(shortIndices.begin(), shortIndices.end(), indices.begin()));
+}
+
+// Every triangle split off with its own copies of the vertices, like some exporters write them
+void testWeld()
+{
+    auto mesh = createShuffledGrid(20);
+    std::vector<glm::vec3> positions;
+    std::vector<float> texCoords;
+    std::vector<u32> indices;
+    for (auto index : mesh.indices) {
+        indices.push_back(static_cast<u32>(positions.size()));
+        positions.push_back(mesh.positions[index]);
+        texCoords.push_back(mesh.positions[index].x * 0.25f);
+    }
+    // One copy that differs in a second stream must stay apart
+    texCoords[5] += 1.f;
+
+    auto original = indices;
+    std::vector<VertexStream> streams = {
+        { positions.data(), sizeof(glm::vec3) },
+        { texCoords.data(), sizeof(float) },
+    };
+    auto distinct = weldVertices(indices.data(), indices.size(), static_cast<u32>(positions.size()), streams);
+    CHECK(distinct == mesh.positions.size() + 1);
+    for (u64 i = 0; i < indices.size(); ++i) {
+        CHECK(indices[i] <= original[i]);
+        CHECK(positions[indices[i]] == positions[original[i]]);
+        CHECK(texCoords[indices[i]] == texCoords[original[i]]);
+    }
+    CHECK(indices[5] == 5);
+
+    auto welded = analyzeVertexCache(indices.data(), indices.size(), static_cast<u32>(positions.size()));
+    CHECK(welded.vertexCount == distinct);
+}
+
+}
+
+int main()
+{
+    testReordering();
+    testWeld();
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "Boilerplate/MeshSimplifier.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct TestMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<u32> indices;
+};
+
+// A closed sphere with bumps, so collapses have a real cost, and seams where the ends of each ring meet
+TestMesh createBumpySphere(u32 rings, u32 segments)
+{
+    TestMesh mesh;
+    for (u32 ring = 0; ring <= rings; ++ring) {
+        auto theta = 3.14159265f * ring / rings;
+        for (u32 segment = 0; segment <= segments; ++segment) {
+            auto phi = 2.f * 3.14159265f * (segment % segments) / segments;
+            auto radius = 1.f + 0.05f * std::sin(5.f * theta) * std::cos(3.f * phi);
+            mesh.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius);
+        }
+    }
+    for (u32 ring = 0; ring < rings; ++ring) {
+        for (u32 segment = 0; segment < segments; ++segment) {
+            auto a = ring * (segments + 1) + segment;
+            auto b = a + segments + 1;
+            if (ring != 0) {
+                mesh.indices.insert(mesh.indices.end(), { a, a + 1, b });
+            }
+            if (ring != rings - 1) {
+                mesh.indices.insert(mesh.indices.end(), { a + 1, b + 1, b });
+            }
+        }
+    }
+    return mesh;
+}
+
+float distanceToTriangle(glm::vec3 const& p, glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c)
+{
+    // Inside the prism over the triangle the distance is the one to its plane, otherwise to the closest edge
+    auto normal = glm::cross(b - a, c - a);
+    glm::vec3 const corners[] = { a, b, c };
+    bool inside = true;
+    for (u32 k = 0; k < 3; ++k) {
+        inside = inside && glm::dot(glm::cross(corners[(k + 1) % 3] - corners[k], p - corners[k]), normal) >= 0.f;
+    }
+    if (inside && glm::length(normal) > 0.f) {
+        return std::abs(glm::dot(p - a, normal)) / glm::length(normal);
+    }
+    auto closest = std::numeric_limits<float>::max();
+    for (u32 k = 0; k < 3; ++k) {
+        auto edge = corners[(k + 1) % 3] - corners[k];
+        auto lengthSquared = glm::dot(edge, edge);
+        auto t = lengthSquared > 0.f ? std::clamp(glm::dot(p - corners[k], edge) / lengthSquared, 0.f, 1.f) : 0.f;
+        closest = std::min(closest, glm::length(p - (corners[k] + edge * t)));
+    }
+    return closest;
+}
+
+// Brute force distance from random points all over the original surface to the simplified one
+float measureDistance(TestMesh const& mesh, std::vector<u32> const& simplified)
+{
+    // Spheres around the simplified triangles skip the ones that cannot be closer than the best so far
+    std::vector<glm::vec4> spheres;
+    for (u64 s = 0; s < simplified.size(); s += 3) {
+        auto const& p0 = mesh.positions[simplified[s]];
+        auto const& p1 = mesh.positions[simplified[s + 1]];
+        auto const& p2 = mesh.positions[simplified[s + 2]];
+        auto center = (p0 + p1 + p2) * (1.f / 3.f);
+        auto radius = std::max(glm::length(p0 - center), std::max(glm::length(p1 - center), glm::length(p2 - center)));
+        spheres.push_back(glm::vec4(center, radius));
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    float maxDistance = 0.f;
+    u64 closestTriangle = 0;
+    for (u64 t = 0; t < mesh.indices.size(); t += 3) {
+        auto const& p0 = mesh.positions[mesh.indices[t + 0]];
+        auto const& p1 = mesh.positions[mesh.indices[t + 1]];
+        auto const& p2 = mesh.positions[mesh.indices[t + 2]];
+        for (u32 sample = 0; sample < 4; ++sample) {
+            auto u = uniform(random);
+            auto v = uniform(random);
+            if (u + v > 1.f) {
+                u = 1.f - u;
+                v = 1.f - v;
+            }
+            auto point = p0 + (p1 - p0) * u + (p2 - p0) * v;
+            auto distanceTo = [&](u64 s) {
+                return distanceToTriangle(
+                    point, mesh.positions[simplified[s]], mesh.positions[simplified[s + 1]], mesh.positions[simplified[s + 2]]);
+            };
+            // Nearby samples usually share their closest triangle, starting from it prunes most of the others
+            auto closest = distanceTo(closestTriangle);
+            for (u64 s = 0; s < simplified.size(); s += 3) {
+                if (glm::length(point - glm::vec3(spheres[s / 3])) - spheres[s / 3].w >= closest) {
+                    continue;
+                }
+                auto distance = distanceTo(s);
+                if (distance < closest) {
+                    closest = distance;
+                    closestTriangle = s;
+                }
+            }
+            maxDistance = std::max(maxDistance, closest);
+        }
+    }
+    return maxDistance;
+}
+
+// The chain GltfModel::buildLods makes: every level halves the previous one and the errors add up to a bound
+// of the distance to the full detail mesh
+void testLodChain()
+{
+    auto mesh = createBumpySphere(32, 64);
+    auto source = mesh.indices;
+    float error = 0.f;
+    for (u32 level = 1; level <= 3; ++level) {
+        float levelError = 0.f;
+        auto simplified = simplifyMesh(
+            source.data(), source.size(), mesh.positions.data(), static_cast<u32>(mesh.positions.size()), source.size() / 2, levelError);
+        CHECK(simplified.size() % 3 == 0);
+        CHECK(simplified.size() <= source.size() / 2);
+        CHECK(simplified.size() >= source.size() * 3 / 8);
+        for (auto index : simplified) {
+            CHECK(index < mesh.positions.size());
+        }
+        CHECK(levelError > 0.f);
+        error += levelError;
+
+        auto distance = measureDistance(mesh, simplified);
+        std::printf("level %u: %zu triangles, error bound %.5f, measured distance %.5f\n", level, simplified.size() / 3, error, distance);
+        CHECK(distance <= error);
+        source = std::move(simplified);
+    }
+}
+
+// Collapses inside a plane move nothing off it, and the locked border keeps the outline
+void testPlane()
+{
+    TestMesh mesh;
+    constexpr u32 size = 33;
+    for (u32 y = 0; y < size; ++y) {
+        for (u32 x = 0; x < size; ++x) {
+            mesh.positions.push_back(glm::vec3(float(x), float(y), 0.f));
+        }
+    }
+    for (u32 y = 0; y + 1 < size; ++y) {
+        for (u32 x = 0; x + 1 < size; ++x) {
+            auto a = y * size + x;
+            mesh.indices.insert(mesh.indices.end(), { a, a + 1, a + size, a + 1, a + size + 1, a + size });
+        }
+    }
+
+    float error = 1.f;
+    auto simplified = simplifyMesh(
+        mesh.indices.data(), mesh.indices.size(), mesh.positions.data(), static_cast<u32>(mesh.positions.size()),
+        mesh.indices.size() / 4, error);
+    CHECK(simplified.size() <= mesh.indices.size() / 4);
+    CHECK(error < 1e-4f);
+    CHECK(measureDistance(mesh, simplified) < 1e-4f);
+}
+
+}
+
+int main()
+{
+    testLodChain();
+    testPlane();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "Boilerplate/Meshlets.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct TestMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<u32> indices;
+};
+
+// Counter-clockwise seen from outside, like the meshes the samples draw with back face culling
+TestMesh createSphere(u32 rings, u32 segments)
+{
+    TestMesh mesh;
+    for (u32 ring = 0; ring <= rings; ++ring) {
+        auto theta = 3.14159265f * ring / rings;
+        for (u32 segment = 0; segment <= segments; ++segment) {
+            auto phi = 2.f * 3.14159265f * segment / segments;
+            mesh.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+    for (u32 ring = 0; ring < rings; ++ring) {
+        for (u32 segment = 0; segment < segments; ++segment) {
+            auto a = ring * (segments + 1) + segment;
+            auto b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return mesh;
+}
+
+// Every cluster within the limits, and together they hold each input triangle exactly once
+void testCoverage(TestMesh const& mesh, MeshletData const& data, u32 baseVertex)
+{
+    std::vector<std::array<u32, 3>> expected;
+    for (u64 t = 0; t < mesh.indices.size(); t += 3) {
+        expected.push_back({ mesh.indices[t] + baseVertex, mesh.indices[t + 1] + baseVertex, mesh.indices[t + 2] + baseVertex });
+    }
+    std::vector<std::array<u32, 3>> clustered;
+    for (auto const& meshlet : data.meshlets) {
+        CHECK(meshlet.vertexCount <= maxMeshletVertices);
+        CHECK(meshlet.triangleCount <= maxMeshletTriangles);
+        CHECK(meshlet.triangleOffset % 4 == 0);
+        auto triangles = data.triangles.data() + meshlet.triangleOffset;
+        for (u32 t = 0; t < meshlet.triangleCount; ++t) {
+            std::array<u32, 3> triangle;
+            for (u32 corner = 0; corner < 3; ++corner) {
+                CHECK(triangles[t * 3 + corner] < meshlet.vertexCount);
+                triangle[corner] = data.vertices[meshlet.vertexOffset + triangles[t * 3 + corner]];
+            }
+            clustered.push_back(triangle);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(clustered.begin(), clustered.end());
+    CHECK(clustered == expected);
+}
+
+void testBounds(TestMesh const& mesh, MeshletData const& data, u32 baseVertex)
+{
+    auto position = [&](Meshlet const& meshlet, u32 localVertex) {
+        return mesh.positions[data.vertices[meshlet.vertexOffset + localVertex] - baseVertex];
+    };
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> coordinate(-4.f, 4.f);
+    u32 tests = 0;
+    u32 culled = 0;
+    for (auto const& meshlet : data.meshlets) {
+        glm::vec3 center(meshlet.boundingSphere);
+        for (u32 i = 0; i < meshlet.vertexCount; ++i) {
+            CHECK(glm::length(position(meshlet, i) - center) <= meshlet.boundingSphere.w * (1.f + 1e-5f));
+        }
+
+        // A culled cluster must not have a single triangle facing the camera
+        for (u32 k = 0; k < 100; ++k) {
+            glm::vec3 camera(coordinate(random), coordinate(random), coordinate(random));
+            ++tests;
+            if (!isMeshletBackfacing(meshlet, camera)) {
+                continue;
+            }
+            ++culled;
+            auto triangles = data.triangles.data() + meshlet.triangleOffset;
+            for (u32 t = 0; t < meshlet.triangleCount; ++t) {
+                auto p0 = position(meshlet, triangles[t * 3 + 0]);
+                auto p1 = position(meshlet, triangles[t * 3 + 1]);
+                auto p2 = position(meshlet, triangles[t * 3 + 2]);
+                auto normal = glm::cross(p1 - p0, p2 - p0);
+                CHECK(glm::dot(camera - p0, normal) <= 1e-6f);
+            }
+        }
+    }
+    // Clusters in index order are strips along the rings with wide cones, they still have to cull some of the time
+    CHECK(culled > tests / 10);
+    std::printf("%zu clusters, %.1f%% culled from random cameras\n", data.meshlets.size(), 100.0 * culled / tests);
+}
+
+}
+
+int main()
+{
+    auto mesh = createSphere(64, 128);
+    constexpr u32 baseVertex = 100;
+
+    MeshletData data;
+    auto count = buildMeshlets(
+        data, mesh.indices.data(), mesh.indices.size(), mesh.positions.data(), static_cast<u32>(mesh.positions.size()), baseVertex);
+    CHECK(count == data.meshlets.size());
+    testCoverage(mesh, data, baseVertex);
+    testBounds(mesh, data, baseVertex);
+
+    // 16-bit indices cluster the same way
+    std::vector<u16> shortIndices(mesh.indices.begin(), mesh.indices.end());
+    MeshletData shortData;
+    buildMeshlets(
+        shortData, shortIndices.data(), shortIndices.size(), mesh.positions.data(), static_cast<u32>(mesh.positions.size()), baseVertex);
+    CHECK(shortData.vertices == data.vertices);
+    CHECK(shortData.triangles == data.triangles);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "Boilerplate/MipChain.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+double toLinear(double c)
+{
+    c /= 255.0;
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+double fromLinear(double l)
+{
+    auto c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+    return c * 255.0;
+}
+
+std::vector<u8> createPixels(u32 width, u32 height, u32 seed)
+{
+    std::mt19937 random(seed);
+    std::vector<u8> pixels(static_cast<size_t>(width) * height * 4);
+    for (auto& value : pixels) {
+        value = static_cast<u8>(random());
+    }
+    return pixels;
+}
+
+// Levels halve with rounding down until both sides are 1, and lie back to back from the finest
+void testLayout()
+{
+    struct Case {
+        u32 width;
+        u32 height;
+        u32 levels;
+    };
+    Case const cases[] = { { 1, 1, 1 }, { 2, 2, 2 }, { 256, 256, 9 }, { 13, 5, 4 }, { 1, 7, 3 }, { 640, 3, 10 }, { 1023, 1025, 11 } };
+    for (auto const& test : cases) {
+        auto pixels = createPixels(test.width, test.height, 1);
+        MipChain chain;
+        buildMipChain(pixels.data(), test.width, test.height, chain);
+        CHECK(chain.width == test.width && chain.height == test.height);
+        CHECK(chain.format == VK_FORMAT_R8G8B8A8_SRGB);
+        CHECK(chain.offsets.size() == test.levels);
+
+        VkDeviceSize offset = 0;
+        for (u32 level = 0; level < test.levels; ++level) {
+            CHECK(chain.offsets[level] == offset);
+            offset += static_cast<VkDeviceSize>(std::max(test.width >> level, 1u)) * std::max(test.height >> level, 1u) * 4;
+        }
+        CHECK(chain.pixels.size() == offset);
+        CHECK(std::equal(pixels.begin(), pixels.end(), chain.pixels.begin()));
+    }
+}
+
+// Every level against a 2x2 box filter of the level above it, worked out in double precision; odd sizes drop the
+// last row or column and 1 texel wide levels repeat their only one
+void testFilter(u32 width, u32 height, bool srgb)
+{
+    auto pixels = createPixels(width, height, width * 31 + height);
+    MipChain chain;
+    buildMipChain(pixels.data(), width, height, chain, srgb);
+    CHECK(chain.format == (srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM));
+
+    for (u32 level = 1; level < chain.offsets.size(); ++level) {
+        auto srcWidth = std::max(width >> (level - 1), 1u);
+        auto srcHeight = std::max(height >> (level - 1), 1u);
+        auto dstWidth = std::max(width >> level, 1u);
+        auto dstHeight = std::max(height >> level, 1u);
+        auto src = chain.pixels.data() + chain.offsets[level - 1];
+        auto dst = chain.pixels.data() + chain.offsets[level];
+        for (u32 y = 0; y < dstHeight; ++y) {
+            for (u32 x = 0; x < dstWidth; ++x) {
+                double sum[4] = {};
+                for (u32 row : { std::min(y * 2, srcHeight - 1), std::min(y * 2 + 1, srcHeight - 1) }) {
+                    for (u32 column : { std::min(x * 2, srcWidth - 1), std::min(x * 2 + 1, srcWidth - 1) }) {
+                        auto texel = src + (static_cast<size_t>(row) * srcWidth + column) * 4;
+                        for (u32 c = 0; c < 4; ++c) {
+                            sum[c] += srgb && c < 3 ? toLinear(texel[c]) : texel[c];
+                        }
+                    }
+                }
+                auto texel = dst + (static_cast<size_t>(y) * dstWidth + x) * 4;
+                for (u32 c = 0; c < 4; ++c) {
+                    auto expected = srgb && c < 3 ? fromLinear(sum[c] / 4.0) : sum[c] / 4.0;
+                    // The linear values are quantized to 12 bits on the way back to sRGB
+                    CHECK(std::abs(texel[c] - expected) <= (srgb && c < 3 ? 1.0 : 0.5));
+                }
+            }
+        }
+    }
+}
+
+// Averaging in sRGB space darkens, in linear space a black and white checkerboard comes out at about 188, not 128
+void testLinearAverage()
+{
+    u8 const checkerboard[16] = { 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 255 };
+    MipChain chain;
+    buildMipChain(checkerboard, 2, 2, chain);
+    auto texel = chain.pixels.data() + chain.offsets[1];
+    CHECK(texel[0] >= 187 && texel[0] <= 189 && texel[0] == texel[1] && texel[1] == texel[2]);
+    CHECK(texel[3] == 255);
+
+    buildMipChain(checkerboard, 2, 2, chain, false);
+    texel = chain.pixels.data() + chain.offsets[1];
+    CHECK(texel[0] == 128);
+
+    // A flat colour keeps its value all the way down
+    std::vector<u8> flat(37 * 19 * 4);
+    for (size_t i = 0; i < flat.size(); ++i) {
+        flat[i] = static_cast<u8>(i % 4 == 0 ? 3 : i % 4 == 1 ? 77 : i % 4 == 2 ? 200 : 128);
+    }
+    buildMipChain(flat.data(), 37, 19, chain);
+    for (u32 level = 0; level < chain.offsets.size(); ++level) {
+        auto texel = chain.pixels.data() + chain.offsets[level];
+        CHECK(texel[0] == 3 && texel[1] == 77 && texel[2] == 200 && texel[3] == 128);
+    }
+}
+
+}
+
+int main()
+{
+    testLayout();
+    for (bool srgb : { true, false }) {
+        testFilter(64, 64, srgb);
+        testFilter(13, 5, srgb);
+        testFilter(1, 9, srgb);
+        testFilter(33, 1, srgb);
+        testFilter(101, 77, srgb);
+    }
+    testLinearAverage();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "Boilerplate/ThreadPool.h"
+#include "Check.h"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every task of a group has run and finished by the time wait() returns
+void testCompletion(ThreadPool& pool)
+{
+    ThreadPool::TaskGroup group;
+    std::vector<u32> results(1000, 0);
+    for (u32 i = 0; i < results.size(); ++i) {
+        pool.submit(group, [&results, i]() { results[i] = i * 3 + 1; });
+    }
+    pool.wait(group);
+    CHECK(group.pending.load() == 0);
+    for (u32 i = 0; i < results.size(); ++i) {
+        CHECK(results[i] == i * 3 + 1);
+    }
+
+    // Waiting on an empty group returns at once
+    ThreadPool::TaskGroup empty;
+    pool.wait(empty);
+}
+
+// The first exception comes out of wait() after the other tasks have finished, and the group can be used again
+void testException(ThreadPool& pool)
+{
+    ThreadPool::TaskGroup group;
+    std::atomic<u32> finished = 0;
+    for (u32 i = 0; i < 100; ++i) {
+        pool.submit(group, [&finished, i]() {
+            if (i == 37) {
+                throw std::runtime_error("task 37");
+            }
+            finished.fetch_add(1);
+        });
+    }
+
+    bool thrown = false;
+    try {
+        pool.wait(group);
+    } catch (std::runtime_error const& exception) {
+        thrown = std::string(exception.what()) == "task 37";
+    }
+    CHECK(thrown);
+    CHECK(finished.load() == 99);
+
+    pool.submit(group, [&finished]() { finished.fetch_add(1); });
+    pool.wait(group);
+    CHECK(finished.load() == 100);
+}
+
+// Tasks that wait on groups of their own run the queued work themselves; with one worker and more outer tasks
+// than threads, anything else would deadlock
+void testNestedWait()
+{
+    ThreadPool pool;
+    pool.create(1);
+
+    ThreadPool::TaskGroup outer;
+    std::atomic<u32> innerRuns = 0;
+    for (u32 i = 0; i < 8; ++i) {
+        pool.submit(outer, [&pool, &innerRuns]() {
+            ThreadPool::TaskGroup inner;
+            for (u32 j = 0; j < 16; ++j) {
+                pool.submit(inner, [&innerRuns]() { innerRuns.fetch_add(1); });
+            }
+            pool.wait(inner);
+        });
+    }
+    pool.wait(outer);
+    CHECK(innerRuns.load() == 8 * 16);
+
+    // parallelFor from inside a task goes through the same path
+    std::atomic<u32> sum = 0;
+    ThreadPool::TaskGroup group;
+    pool.submit(group, [&pool, &sum]() { pool.parallelFor(100, [&sum](u32 i) { sum.fetch_add(i); }); });
+    pool.wait(group);
+    CHECK(sum.load() == 99 * 100 / 2);
+    pool.destroy();
+}
+
+// Each index exactly once, for counts below, at and above the number of batches
+void testParallelFor(ThreadPool& pool)
+{
+    for (u32 count : { 0u, 1u, 2u, 7u, 64u, 1000u, 100003u }) {
+        auto hits = std::make_unique<std::atomic<u32>[]>(count);
+        for (u32 i = 0; i < count; ++i) {
+            hits[i] = 0;
+        }
+        pool.parallelFor(count, [&hits](u32 i) { hits[i].fetch_add(1); });
+        for (u32 i = 0; i < count; ++i) {
+            CHECK(hits[i].load() == 1);
+        }
+    }
+
+    bool thrown = false;
+    try {
+        pool.parallelFor(500, [](u32 i) {
+            if (i == 250) {
+                throw std::runtime_error("index 250");
+            }
+        });
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+}
+
+int main()
+{
+    for (u32 threadCount : { 1u, 3u, 0u }) {
+        ThreadPool pool;
+        pool.create(threadCount);
+        testCompletion(pool);
+        testException(pool);
+        testParallelFor(pool);
+        std::printf("%u workers: passed\n", pool.getThreadCount());
+        pool.destroy();
+    }
+    testNestedWait();
+    return 0;
+}
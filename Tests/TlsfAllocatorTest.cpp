@@ -0,0 +1,154 @@
+#include "Boilerplate/TlsfAllocator.h"
+#include "Check.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Allocation {
+    u64 offset = 0;
+    u64 size = 0;
+    u32 node = TlsfAllocator::invalidNode;
+};
+
+constexpr u64 capacity = 64ull * 1024 * 1024;
+
+// Sizes like the ones createBuffer and createImage ask for: many small buffers, some large images
+u64 randomSize(std::mt19937_64& random)
+{
+    return 1 + random() % (random() % 4 != 0 ? 4096 : 4 * 1024 * 1024);
+}
+
+u64 randomAlignment(std::mt19937_64& random)
+{
+    return 1ull << (random() % 17);
+}
+
+// Random allocations and frees against a map of the live ranges, checking every result
+void testStress()
+{
+    TlsfAllocator allocator;
+    allocator.init(capacity);
+    std::mt19937_64 random(1);
+    std::map<u64, Allocation> live;
+    u64 requested = 0;
+    u32 failures = 0;
+
+    auto freeRandom = [&]() {
+        auto it = live.begin();
+        std::advance(it, random() % live.size());
+        requested -= it->second.size;
+        allocator.free(it->second.node);
+        live.erase(it);
+    };
+
+    for (u32 i = 0; i < 200000; ++i) {
+        if (live.empty() || random() % 8 < 5) {
+            Allocation allocation;
+            allocation.size = randomSize(random);
+            auto alignment = randomAlignment(random);
+            allocation.node = allocator.allocate(allocation.size, alignment, allocation.offset);
+            if (allocation.node == TlsfAllocator::invalidNode) {
+                ++failures;
+                freeRandom();
+                continue;
+            }
+
+            CHECK(allocation.offset % alignment == 0);
+            CHECK(allocation.offset + allocation.size <= capacity);
+            // The live ranges are sorted by offset, so only the neighbours can overlap
+            auto next = live.lower_bound(allocation.offset);
+            CHECK(next == live.end() || allocation.offset + allocation.size <= next->second.offset);
+            if (next != live.begin()) {
+                auto previous = std::prev(next);
+                CHECK(previous->second.offset + previous->second.size <= allocation.offset);
+            }
+            live[allocation.offset] = allocation;
+            requested += allocation.size;
+        } else {
+            freeRandom();
+        }
+
+        CHECK(allocator.getAllocationCount() == live.size());
+        CHECK(allocator.getUsedSize() >= requested);
+        CHECK(allocator.getUsedSize() <= capacity);
+    }
+
+    for (auto const& [offset, allocation] : live) {
+        allocator.free(allocation.node);
+    }
+    CHECK(allocator.isEmpty());
+    CHECK(allocator.getUsedSize() == 0);
+
+    // Every free range has to have merged back into one
+    u64 offset;
+    CHECK(allocator.allocate(capacity, 1, offset) != TlsfAllocator::invalidNode);
+    CHECK(offset == 0);
+    std::printf("stress: 200000 operations, %u allocations did not fit\n", failures);
+}
+
+void testExhaustion()
+{
+    TlsfAllocator allocator;
+    allocator.init(1024 * 1024);
+    std::vector<u32> nodes;
+    u64 offset;
+    for (u32 node; (node = allocator.allocate(4096, 1, offset)) != TlsfAllocator::invalidNode;) {
+        nodes.push_back(node);
+    }
+    CHECK(nodes.size() == 256);
+    CHECK(allocator.getUsedSize() == 1024 * 1024);
+
+    // A hole in the middle is found again and cannot take more than its size
+    allocator.free(nodes[100]);
+    CHECK(allocator.allocate(8192, 1, offset) == TlsfAllocator::invalidNode);
+    nodes[100] = allocator.allocate(4096, 1, offset);
+    CHECK(nodes[100] != TlsfAllocator::invalidNode);
+    CHECK(offset == 100 * 4096);
+}
+
+// Steady state of a few thousand live allocations, the pattern of a scene streaming resources in and out
+void benchmark()
+{
+    TlsfAllocator allocator;
+    allocator.init(1ull << 32);
+    std::mt19937_64 random(2);
+    std::vector<u32> live;
+    u64 offset;
+    for (u32 i = 0; i < 4096; ++i) {
+        live.push_back(allocator.allocate(randomSize(random), randomAlignment(random), offset));
+    }
+
+    constexpr u32 count = 2000000;
+    std::vector<u64> sizes(count);
+    std::vector<u64> alignments(count);
+    std::vector<u32> slots(count);
+    for (u32 i = 0; i < count; ++i) {
+        sizes[i] = randomSize(random);
+        alignments[i] = randomAlignment(random);
+        slots[i] = static_cast<u32>(random() % live.size());
+    }
+
+    Stopwatch stopwatch;
+    for (u32 i = 0; i < count; ++i) {
+        allocator.free(live[slots[i]]);
+        live[slots[i]] = allocator.allocate(sizes[i], alignments[i], offset);
+    }
+    auto seconds = stopwatch.elapsed();
+    for (auto node : live) {
+        CHECK(node != TlsfAllocator::invalidNode);
+    }
+    std::printf("benchmark: %.1f M allocs/s, %.0f ns per allocate and free\n", count / seconds * 1e-6, seconds / count * 1e9);
+}
+
+}
+
+int main()
+{
+    testStress();
+    testExhaustion();
+    benchmark();
+    return 0;
+}
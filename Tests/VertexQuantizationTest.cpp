@@ -0,0 +1,125 @@
+#include "Boilerplate/VertexQuantization.h"
+#include "Check.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Every position comes back within half a step of the 16 bit grid over its box, the box corners exactly
+void testPositions()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> coordinate(-50.f, 50.f);
+    std::vector<glm::vec3> positions(10000);
+    for (auto& position : positions) {
+        // A flat axis, like a plane lying in y = 3, still has to encode
+        position = glm::vec3(coordinate(random), 3.f, coordinate(random) * 0.01f);
+    }
+    auto bounds = calculateQuantizationBounds(positions.data(), positions.size());
+    CHECK(bounds.scale.y == 1.f);
+
+    for (auto const& position : positions) {
+        auto quantized = quantizePosition(position, bounds);
+        CHECK(quantized.w == 65535);
+        for (u32 axis = 0; axis < 3; ++axis) {
+            auto restored = bounds.offset[axis] + bounds.scale[axis] * (quantized[axis] / 65535.f);
+            CHECK(std::abs(restored - position[axis]) <= bounds.scale[axis] * (0.5f / 65535.f) + 1e-5f);
+        }
+    }
+
+    auto low = quantizePosition(bounds.offset, bounds, 0.f);
+    CHECK(low == glm::u16vec4(0, 0, 0, 0));
+    auto high = quantizePosition(bounds.offset + bounds.scale, bounds);
+    CHECK(high.x == 65535 && high.z == 65535);
+}
+
+// Unit vectors all over the sphere, the axes and the folded corners of the octahedron included
+void testOctahedral()
+{
+    std::vector<glm::vec3> directions = {
+        glm::vec3(1.f, 0.f, 0.f), glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, -1.f, 0.f),
+        glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, -1.f), glm::normalize(glm::vec3(1.f, 1.f, -1.f)),
+        glm::normalize(glm::vec3(-1.f, -1.f, -1.f)), glm::normalize(glm::vec3(-1.f, 1.f, 1e-7f)),
+    };
+    std::mt19937 random(2);
+    std::normal_distribution<float> gaussian;
+    for (u32 i = 0; i < 100000; ++i) {
+        glm::vec3 direction(gaussian(random), gaussian(random), gaussian(random));
+        if (glm::length(direction) > 1e-3f) {
+            directions.push_back(glm::normalize(direction));
+        }
+    }
+
+    float maxError = 0.f;
+    for (auto const& direction : directions) {
+        auto decoded = decodeOctahedral(encodeOctahedral(direction));
+        maxError = std::max(maxError, glm::length(decoded - direction));
+    }
+    std::printf("octahedral: largest error %.2e over %zu directions\n", maxError, directions.size());
+    CHECK(maxError < 1e-4f);
+    CHECK(encodeOctahedral(glm::vec3(0.f)) == glm::i16vec2(0, 0));
+}
+
+void testHalf()
+{
+    CHECK(quantizeHalf(glm::vec2(1.f, -2.f)) == glm::u16vec2(0x3c00, 0xc000));
+    CHECK(quantizeHalf(glm::vec2(0.5f, 0.f)) == glm::u16vec2(0x3800, 0x0000));
+    CHECK(quantizeHalf(glm::vec2(65504.f, 0.25f)) == glm::u16vec2(0x7bff, 0x3400));
+
+    // Texture coordinates in [0, 1] keep 11 significant bits
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> coordinate(1e-3f, 1.f);
+    for (u32 i = 0; i < 10000; ++i) {
+        auto value = coordinate(random);
+        auto half = quantizeHalf(glm::vec2(value, 0.f)).x;
+        auto exponent = int((half >> 10) & 31) - 15;
+        auto restored = std::ldexp(1.f + (half & 1023) / 1024.f, exponent);
+        CHECK(std::abs(restored - value) <= value * (1.f / 2048.f));
+    }
+}
+
+void testUnorm8()
+{
+    CHECK(quantizeUnorm8(glm::vec4(-1.f, 0.f, 0.5f, 2.f)) == glm::u8vec4(0, 0, 128, 255));
+    CHECK(quantizeUnorm8(glm::vec4(1.f / 255.f, 0.499f / 255.f, 254.5f / 255.f, 1.f)) == glm::u8vec4(1, 0, 255, 255));
+}
+
+// Weights always sum to exactly 255 and only the largest one takes the rounding error
+void testWeights()
+{
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> weight(0.f, 1.f);
+    for (u32 i = 0; i < 100000; ++i) {
+        glm::vec4 weights(weight(random), weight(random), i % 2 ? weight(random) : 0.f, i % 3 ? weight(random) : 0.f);
+        auto quantized = quantizeWeights(weights);
+        auto sum = weights.x + weights.y + weights.z + weights.w;
+        // The first of the largest weights before the correction
+        auto rounded = quantizeUnorm8(weights / sum);
+        u32 total = 0;
+        u32 largest = 0;
+        for (u32 k = 0; k < 4; ++k) {
+            total += quantized[k];
+            largest = rounded[k] > rounded[largest] ? k : largest;
+        }
+        CHECK(total == 255);
+        for (u32 k = 0; k < 4; ++k) {
+            auto exact = weights[k] / sum * 255.f;
+            CHECK(std::abs(quantized[k] - exact) <= (k == largest ? 2.f : 0.5f) + 1e-3f);
+        }
+    }
+    CHECK(quantizeWeights(glm::vec4(0.f)) == glm::u8vec4(255, 0, 0, 0));
+}
+
+}
+
+int main()
+{
+    testPositions();
+    testOctahedral();
+    testHalf();
+    testUnorm8();
+    testWeights();
+    return 0;
+}